@@ -0,0 +1,244 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_METRICS_H_
+#define _ESP_METRICS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#ifndef __linux__
+#include "esp_private/wifi_os_adapter.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Registry of counters, gauges and histograms shared by the adapter,
+ * event loop and datapath instrumentation. Updates take no lock: each
+ * thread writes its own shard, with plain stores, until the shards run
+ * out; later threads share the last shard through atomic adds. Shards
+ * are not given back when a thread exits. Readers sum the shards.
+ *
+ * Histograms are HDR style: values below 2^ESP_METRICS_HDR_SUB_BITS
+ * are counted exactly, larger ones in 2^(ESP_METRICS_HDR_SUB_BITS - 1)
+ * buckets per power of two, up to 2^ESP_METRICS_HDR_MAX_EXP, and one
+ * more bucket counts the values above.
+ */
+
+#ifndef ESP_METRICS_MAX
+#define ESP_METRICS_MAX             64
+#endif
+
+#ifndef ESP_METRICS_SHARDS
+#ifdef __linux__
+#define ESP_METRICS_SHARDS          8
+#else
+#define ESP_METRICS_SHARDS          1
+#endif
+#endif
+
+#ifndef ESP_METRICS_HDR_SUB_BITS
+#define ESP_METRICS_HDR_SUB_BITS    5
+#endif
+
+#ifndef ESP_METRICS_HDR_MAX_EXP
+#define ESP_METRICS_HDR_MAX_EXP     40
+#endif
+
+#define ESP_METRICS_HDR_BUCKETS \
+  (((ESP_METRICS_HDR_MAX_EXP - ESP_METRICS_HDR_SUB_BITS + 2) << \
+    (ESP_METRICS_HDR_SUB_BITS - 1)) + 1)
+
+typedef enum
+{
+  ESP_METRIC_COUNTER = 0,    /**< monotonic, uint64_t */
+  ESP_METRIC_GAUGE,          /**< set or moved, int64_t */
+  ESP_METRIC_HISTOGRAM,      /**< distribution of uint64_t values */
+} esp_metric_type_t;
+
+typedef int32_t esp_metric_id_t;
+
+/** @brief Histogram summary */
+
+typedef struct
+{
+  uint64_t count;
+  uint64_t sum;
+  uint64_t p50;              /**< upper bound of the bucket */
+  uint64_t p90;
+  uint64_t p99;
+  uint64_t max;              /**< upper bound of the highest bucket */
+} esp_metrics_hist_summary_t;
+
+/**
+  * @brief     Output of esp_metrics_render
+  *
+  * @return    0 to go on, negative to stop rendering
+  */
+typedef int (*esp_metrics_write_t)(void *arg, const char *data, size_t len);
+
+/**
+  * @brief     Register a metric
+  *
+  * Names and labels must follow the Prometheus rules, labels are written
+  * between the braces as is, e.g. "fn=\"mutex_lock\"". Metrics of one
+  * name with different labels share the HELP and TYPE lines. Strings are
+  * not copied.
+  *
+  * @param     type    metric type
+  * @param     name    metric name
+  * @param     labels  label pairs, may be NULL
+  * @param     help    description, may be NULL
+  * @param     id      output handle
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid arguments
+  *    - ESP_ERR_NO_MEM: ESP_METRICS_MAX metrics registered or no memory
+  *      for the histogram buckets
+  */
+esp_err_t esp_metrics_register(esp_metric_type_t type, const char *name,
+                               const char *labels, const char *help,
+                               esp_metric_id_t *id);
+
+/**
+  * @brief     Add to a counter
+  */
+void esp_metrics_add(esp_metric_id_t id, uint64_t v);
+
+/**
+  * @brief     Increment a counter
+  */
+#define esp_metrics_inc(id) esp_metrics_add(id, 1)
+
+/**
+  * @brief     Set a gauge
+  */
+void esp_metrics_gauge_set(esp_metric_id_t id, int64_t v);
+
+/**
+  * @brief     Move a gauge
+  */
+void esp_metrics_gauge_add(esp_metric_id_t id, int64_t delta);
+
+/**
+  * @brief     Record a value into a histogram
+  */
+void esp_metrics_observe(esp_metric_id_t id, uint64_t v);
+
+/**
+  * @brief     Value of a counter, or of a gauge cast to uint64_t
+  */
+uint64_t esp_metrics_get(esp_metric_id_t id);
+
+/**
+  * @brief     Summarize a histogram
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: not a histogram
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_metrics_hist_summary(esp_metric_id_t id,
+                                   esp_metrics_hist_summary_t *summary);
+
+/**
+  * @brief     Write all metrics in the Prometheus text format
+  *
+  * Histograms list a fixed set of buckets, one per power of two: the
+  * le bound 2^n - 1 counts the values below 2^n.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_FAIL: write asked to stop
+  */
+esp_err_t esp_metrics_render(esp_metrics_write_t write, void *arg);
+
+/** @brief Benchmark outcome */
+
+typedef struct
+{
+  uint32_t ops;
+  uint32_t add_ns;               /**< per esp_metrics_add */
+  uint32_t observe_ns;           /**< per esp_metrics_observe */
+  uint32_t get_ns;               /**< per esp_metrics_get, shards summed */
+  uint32_t render_us;            /**< per esp_metrics_render */
+  uint32_t render_bytes;
+} esp_metrics_bench_t;
+
+/**
+  * @brief     Time ops counter increments and histogram observations
+  *            of random values against reading and rendering the
+  *            registry
+  *
+  * Three metrics are registered at every call. Before timing, the
+  * largest value of the top bucket and the smallest one above it are
+  * observed, and must land in that bucket and the overflow one.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: result is NULL or no op
+  *    - ESP_FAIL: a value counted in the wrong bucket
+  *    - others: refer to esp_metrics_register
+  */
+esp_err_t esp_metrics_bench(uint32_t ops, esp_metrics_bench_t *result);
+
+#ifndef __linux__
+/**
+  * @brief     Count and time the mutex_lock, semphr_take, queue_send,
+  *            queue_recv and event_post callbacks of an adapter, and
+  *            follow the WIFI_EVENTs posted and not handled yet
+  *
+  * Registers wifi_osi_calls_total and wifi_osi_wait_us, in
+  * microseconds, labelled by fn, and the wifi_event_depth gauge. Call it
+  * after esp_event_loop_create_default and before esp_wifi_init.
+  *
+  * @param     osi  adapter to hook, NULL for g_wifi_osi_funcs
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: already installed, or no default event
+  *      loop
+  *    - others: refer to esp_metrics_register
+  */
+esp_err_t esp_metrics_osi_install(wifi_osi_funcs_t *osi);
+#endif
+
+#ifdef __linux__
+/**
+  * @brief     Serve the metrics over HTTP on a Unix socket, from a thread
+  *
+  * e.g. curl --unix-socket path http://localhost/metrics
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: already serving
+  *    - ESP_FAIL: socket or thread error
+  */
+esp_err_t esp_metrics_serve_unix(const char *path);
+
+/**
+  * @brief     Stop serving and remove the socket
+  */
+void esp_metrics_serve_stop(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_METRICS_H_ */
@@ -0,0 +1,236 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_NOW_RATE_H_
+#define _ESP_NOW_RATE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Sampling rate control per destination, after Minstrel.
+ *
+ * Every frame to a peer is sent at the rate picked for it and its send
+ * status is counted against that rate. Each interval_ms the success
+ * ratio of a rate updates its EWMA probability, and the probability
+ * times the frame bits over the frame airtime its throughput; the rate
+ * of the best throughput is the peer's rate. sample_percent of the
+ * frames go to another rate instead, one that could do better than the
+ * best at full success, so that faster rates are found when the channel
+ * improves and slower ones are known when it fades. Group addressed
+ * frames are not acked and go at the slowest rate.
+ */
+
+#define ESP_NOW_RATE_MAX_RATES   16
+#define ESP_NOW_RATE_PEERS       16
+#define ESP_NOW_RATE_PENDING     8      /* frames in flight per peer */
+
+typedef struct
+{
+  wifi_phy_rate_t rates[ESP_NOW_RATE_MAX_RATES];
+  uint8_t n_rates;
+  uint32_t interval_ms;          /**< between two EWMA updates */
+  uint8_t ewma_percent;          /**< weight of the past */
+  uint8_t sample_percent;        /**< of the frames */
+  uint16_t frame_len;            /**< bytes, for the throughput */
+} esp_now_rate_config_t;
+
+/** @brief Counters */
+
+typedef struct
+{
+  uint32_t frames;
+  uint32_t samples;
+  uint32_t ok;
+  uint32_t failed;
+  uint32_t switches;             /**< of the rate of a peer */
+  uint32_t evictions;            /**< of a peer */
+} esp_now_rate_stats_t;
+
+typedef struct esp_now_rate esp_now_rate_t;
+
+/**
+  * @brief     Fill a configuration with defaults: LORA_250K, LORA_500K,
+  *            1, 2, 5.5 and 11 Mbps, MCS0 to MCS7 long GI, 100 ms
+  *            interval, 75% EWMA, 10% samples, 250 byte frames
+  */
+void esp_now_rate_default(esp_now_rate_config_t *cfg);
+
+/**
+  * @brief     Create a controller
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: cfg or rc is NULL, no rate, a rate
+  *      unknown, interval_ms 0 or a percentage above 100
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_now_rate_create(const esp_now_rate_config_t *cfg,
+                              esp_now_rate_t **rc);
+
+/**
+  * @brief     Delete a controller
+  */
+void esp_now_rate_delete(esp_now_rate_t *rc);
+
+/**
+  * @brief     Rate of the next frame to mac, pending its send status
+  */
+wifi_phy_rate_t esp_now_rate_pick(esp_now_rate_t *rc, const uint8_t mac[6],
+                                  uint32_t now_ms);
+
+/**
+  * @brief     The frame picked last for mac was not sent after all
+  */
+void esp_now_rate_drop(esp_now_rate_t *rc, const uint8_t mac[6]);
+
+/**
+  * @brief     Send status of the oldest frame pending for mac
+  */
+void esp_now_rate_result(esp_now_rate_t *rc, const uint8_t mac[6], bool ok,
+                         uint32_t now_ms);
+
+/**
+  * @brief     Rate of the best throughput for mac, the slowest unknown
+  */
+wifi_phy_rate_t esp_now_rate_best(const esp_now_rate_t *rc,
+                                  const uint8_t mac[6]);
+
+/**
+  * @brief     Get the counters
+  */
+void esp_now_rate_get_stats(const esp_now_rate_t *rc,
+                            esp_now_rate_stats_t *stats);
+
+/**
+  * @brief     Airtime of a frame of len bytes at rate, header, ACK and
+  *            interframe spaces included
+  *
+  * @return    microseconds, 0 for a rate unknown
+  */
+uint32_t esp_now_rate_airtime_us(wifi_phy_rate_t rate, uint16_t len);
+
+/**
+  * @brief     Send status from the ESP-NOW send callback, ok or not
+  */
+typedef void (*esp_now_rate_send_cb_t)(const uint8_t *mac, bool ok);
+
+/**
+  * @brief     Register the ESP-NOW send callback, chaining to cb, and
+  *            control the rate of ifx with esp_wifi_internal_set_fix_rate
+  *
+  * @attention The rate is fixed for the whole interface, not per frame.
+  *            esp_now_rate_send keeps one frame in flight and gives the
+  *            driver its rate control back once the status of the frame
+  *            is in; meanwhile, other frames sent on ifx, data to an AP
+  *            or stations included, go at the rate of that frame.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: rc is NULL
+  *    - ESP_ERR_INVALID_STATE: started already
+  *    - ESP_ERR_NO_MEM: out of memory
+  *    - others: refer to esp_now_register_send_cb
+  */
+esp_err_t esp_now_rate_start(esp_now_rate_t *rc, wifi_interface_t ifx,
+                             esp_now_rate_send_cb_t cb);
+
+/**
+  * @brief     Unregister the send callback and unfix the rate
+  */
+void esp_now_rate_stop(void);
+
+/**
+  * @brief     esp_now_send at the rate picked for mac
+  *
+  * Waits up to 200 ms for the send status of the previous frame, the
+  * send callback runs once it is free for the next one.
+  *
+  * @return
+  *    - ESP_ERR_INVALID_ARG: mac is NULL
+  *    - ESP_ERR_INVALID_STATE: not started
+  *    - ESP_ERR_TIMEOUT: the previous frame is still in flight
+  *    - others: refer to esp_now_send and esp_wifi_internal_set_fix_rate
+  */
+esp_err_t esp_now_rate_send(const uint8_t mac[6], const uint8_t *data,
+                            size_t len);
+
+/** @brief Channel model parameters */
+
+typedef struct
+{
+  uint32_t seconds;
+  uint8_t peers;                 /**< up to ESP_NOW_RATE_PEERS */
+  uint16_t frames_per_s;         /**< per peer */
+  uint16_t frame_len;
+  int8_t snr_min;                /**< dB, of the peers, spread evenly */
+  int8_t snr_max;
+  uint8_t fade_db;               /**< slow fading depth */
+  uint32_t fade_period_ms;
+  uint8_t noise_db;              /**< per frame, uniform +- */
+  uint32_t seed;
+} esp_now_rate_sim_t;
+
+/** @brief Outcome of one policy */
+
+typedef struct
+{
+  uint32_t delivered_permille;
+  uint32_t airtime_ms;
+  uint32_t goodput_kbps;         /**< delivered bits over airtime,
+                                      mean over the peers */
+} esp_now_rate_sim_stat_t;
+
+typedef struct
+{
+  uint32_t frames;
+  esp_now_rate_sim_stat_t low;      /**< 1 Mbps fixed */
+  esp_now_rate_sim_stat_t high;     /**< MCS7 fixed */
+  esp_now_rate_sim_stat_t adaptive; /**< the defaults */
+  esp_now_rate_sim_stat_t oracle;   /**< best rate for the fade, per frame */
+  uint32_t switches;
+  uint32_t samples;
+} esp_now_rate_sim_result_t;
+
+/**
+  * @brief     Fill channel model parameters with defaults: 60 s, 4
+  *            peers at 2 to 26 dB SNR, 50 frames a second of 250 bytes,
+  *            8 dB fades over 20 s, 2 dB noise
+  */
+void esp_now_rate_sim_default(esp_now_rate_sim_t *sim);
+
+/**
+  * @brief     Send the frames of the peers at fixed rates, with the
+  *            default controller and by an oracle, over the same channel
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: sim or result is NULL, no second, no peer,
+  *      too many or no frame
+  *    - others: refer to esp_now_rate_create
+  */
+esp_err_t esp_now_rate_sim_run(const esp_now_rate_sim_t *sim,
+                               esp_now_rate_sim_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_NOW_RATE_H_ */
@@ -0,0 +1,227 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_NOW_SCHED_H_
+#define _ESP_NOW_SCHED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Connectionless nodes wake up for window_ms every interval_ms, as set
+ * with esp_wifi_set_connectionless_wake_interval and
+ * esp_now_set_wake_window. The gateway splits the base interval into
+ * interval_ms / window_ms slots and gives every node a slot, plus a
+ * power of two multiplier of the base interval so that idle nodes sleep
+ * longer. Frames for a node are held until its next wake window.
+ *
+ *   cycle c, slot s: [c * interval + s * window, ... + window)
+ *   node wakes in cycle c iff c % (1 << shift) == phase
+ */
+
+#define ESP_NOW_SCHED_MAX_SHIFT  7
+
+typedef esp_err_t (*esp_now_sched_send_t)(const uint8_t mac[6],
+                                          const void *data, size_t len,
+                                          void *arg);
+typedef void (*esp_now_sched_free_t)(void *data, void *arg);
+
+/** @brief Gateway scheduler settings */
+
+typedef struct
+{
+  uint16_t interval_ms;       /**< base wake interval */
+  uint16_t window_ms;         /**< wake window of every node */
+  uint16_t max_nodes;         /**< size of the node table */
+  uint8_t  queue_len;         /**< frames held per node */
+  uint8_t  max_shift;         /**< longest interval is base << max_shift */
+  uint16_t slot_capacity;     /**< frames sent per wake window */
+  uint16_t max_latency_ms;    /**< bound on the interval of busy nodes */
+  uint16_t adapt_cycles;      /**< base intervals between adaptations */
+  bool     adaptive;          /**< adapt shift to demand, else keep 0 */
+  esp_now_sched_send_t send;  /**< sends one frame, esp_now_send */
+  esp_now_sched_free_t free;  /**< releases a sent or dropped frame */
+  void    *arg;               /**< passed to send and free */
+} esp_now_sched_config_t;
+
+/** @brief Wake schedule of one node, pushed to it by the gateway */
+
+typedef struct
+{
+  uint16_t interval_ms;       /**< for esp_wifi_set_connectionless_wake_interval */
+  uint16_t window_ms;         /**< for esp_now_set_wake_window */
+  uint32_t offset_ms;         /**< wake start from the schedule epoch */
+  uint16_t slot;
+  uint8_t  shift;
+  uint8_t  phase;
+} esp_now_sched_assign_t;
+
+/** @brief Gateway counters */
+
+typedef struct
+{
+  uint32_t enqueued;
+  uint32_t sent;
+  uint32_t send_failed;
+  uint32_t dropped;           /**< node queue full */
+  uint32_t reassigned;        /**< shift changes pushed to nodes */
+  uint64_t latency_sum_us;    /**< enqueue to send, over sent frames */
+  uint32_t latency_max_us;
+} esp_now_sched_stats_t;
+
+typedef struct esp_now_sched esp_now_sched_t;
+
+/**
+  * @brief     Fill a configuration with defaults: 100 ms interval,
+  *            10 ms windows, 500 nodes
+  */
+void esp_now_sched_default(esp_now_sched_config_t *cfg);
+
+/**
+  * @brief     Create a gateway scheduler
+  *
+  * @param     cfg     settings, copied
+  * @param     epoch   time of the first cycle, in us
+  * @param     out     created scheduler
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid settings
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_now_sched_create(const esp_now_sched_config_t *cfg,
+                               int64_t epoch, esp_now_sched_t **out);
+
+/**
+  * @brief     Delete a scheduler, freeing the frames still queued
+  */
+void esp_now_sched_delete(esp_now_sched_t *sched);
+
+/**
+  * @brief     Add a node and give it the least loaded slot
+  *
+  * @param     sched   scheduler
+  * @param     mac     ESP-NOW address of the node
+  * @param     id      output node index
+  * @param     assign  output schedule to push to the node
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_NO_MEM: node table full
+  */
+esp_err_t esp_now_sched_add_node(esp_now_sched_t *sched,
+                                 const uint8_t mac[6], uint16_t *id,
+                                 esp_now_sched_assign_t *assign);
+
+/**
+  * @brief     Queue a frame for the next wake window of a node
+  *
+  * The frame is owned by the scheduler until it is passed to free. now
+  * is the time of the call, on the clock of esp_now_sched_tick.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: unknown node
+  *    - ESP_ERR_NO_MEM: node queue full, the frame is not taken
+  */
+esp_err_t esp_now_sched_enqueue(esp_now_sched_t *sched, uint16_t id,
+                                void *data, size_t len, int64_t now);
+
+/**
+  * @brief     Send what is due in the window containing now
+  *
+  * Call at the start of every window, e.g. from a periodic esp_timer
+  * with a window_ms period. Adapts the node intervals every
+  * adapt_cycles cycles.
+  */
+void esp_now_sched_tick(esp_now_sched_t *sched, int64_t now);
+
+/**
+  * @brief     Pop the next node whose schedule changed
+  *
+  * @return
+  *    - ESP_OK: id and assign were filled, push assign to the node
+  *    - ESP_ERR_NOT_FOUND: no pending change
+  */
+esp_err_t esp_now_sched_next_change(esp_now_sched_t *sched, uint16_t *id,
+                                    esp_now_sched_assign_t *assign);
+
+/**
+  * @brief     Average fraction of time a node radio is on, in ppm
+  */
+uint32_t esp_now_sched_duty_ppm(const esp_now_sched_t *sched);
+
+/**
+  * @brief     Get the gateway counters
+  */
+void esp_now_sched_get_stats(const esp_now_sched_t *sched,
+                             esp_now_sched_stats_t *stats);
+
+/**
+  * @brief     Node side: apply a schedule received from the gateway
+  *
+  * Call when the node is at assign->offset_ms in the gateway schedule
+  * so that its wake windows line up with its slot.
+  *
+  * @return    error of the underlying WiFi or ESP-NOW call
+  */
+esp_err_t esp_now_sched_node_apply(const esp_now_sched_assign_t *assign);
+
+/** @brief Host simulation parameters */
+
+typedef struct
+{
+  esp_now_sched_config_t cfg;   /**< send and free are ignored */
+  uint32_t nodes;               /**< number of nodes */
+  uint32_t duration_ms;         /**< simulated time */
+  uint32_t busy_permille;       /**< share of busy nodes */
+  uint32_t busy_rate_mhz;       /**< frames per 1000 s to a busy node */
+  uint32_t idle_rate_mhz;       /**< frames per 1000 s to an idle node */
+  uint32_t seed;
+} esp_now_sched_sim_t;
+
+/** @brief Host simulation outcome */
+
+typedef struct
+{
+  uint32_t duty_ppm;            /**< time averaged node radio duty cycle */
+  uint32_t latency_avg_us;      /**< of the data frames, arrival to
+                                     send, control frames excluded */
+  uint32_t latency_max_us;
+  uint32_t delivered;
+  uint32_t dropped;
+  uint32_t reassigned;
+} esp_now_sched_sim_result_t;
+
+/**
+  * @brief     Simulate a gateway and its nodes with Poisson downlink
+  *            traffic, without any radio
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - others: refer to esp_now_sched_create
+  */
+esp_err_t esp_now_sched_simulate(const esp_now_sched_sim_t *sim,
+                                 esp_now_sched_sim_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_NOW_SCHED_H_ */
@@ -0,0 +1,227 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_SC_CHANNEL_H_
+#define _ESP_SC_CHANNEL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_smartconfig.h"
+#include "esp_sc_decode.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Channel lock engine for the frame-length decoder. Every channel keeps
+ * its own decoder across hops, so a sender seen with one guide code on a
+ * dwell locks on the next visit instead of starting over. Guide codes
+ * seen in a dwell raise the score of the channel, scores age on every
+ * dwell. The scored policy alternates between the best scored channel,
+ * with a doubled dwell, and the next channel of the sweep, so a false
+ * score costs at most half of the sweep rate. Without any score it is
+ * the sequential sweep.
+ *
+ * The engine only decides; esp_sc_chan_start drives it from the
+ * promiscuous callback and a timer on the target, the simulator drives
+ * it from synthesized traffic.
+ */
+
+#define ESP_SC_CHAN_MAX     14
+
+typedef enum
+{
+  ESP_SC_CHAN_SEQUENTIAL = 0,    /**< round-robin sweep, fixed dwell */
+  ESP_SC_CHAN_SCORED,            /**< sweep interleaved with best scored */
+} esp_sc_chan_policy_t;
+
+/** @brief Engine configuration */
+
+typedef struct
+{
+  smartconfig_type_t type;       /**< protocols to decode */
+  esp_sc_chan_policy_t policy;
+  uint16_t channel_mask;         /**< bit n for channel n */
+  uint32_t dwell_ms;             /**< dwell per channel */
+  uint32_t dwell_fast_ms;        /**< dwell per channel in fast mode */
+  bool fast_mode;                /**< as given to esp_smartconfig_fast_mode,
+                                      the phone sends at a higher rate */
+  uint32_t lock_timeout_ms;      /**< locked without result, hop again */
+} esp_sc_chan_config_t;
+
+typedef struct esp_sc_chan esp_sc_chan_t;
+
+/**
+  * @brief     Fill a configuration with defaults: ESPTouch, scored,
+  *            channels 1 to 13, 100 ms dwell, 50 ms in fast mode,
+  *            30 s lock timeout
+  */
+void esp_sc_chan_default(esp_sc_chan_config_t *cfg);
+
+/**
+  * @brief     Create an engine, with one decoder per channel of the mask
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: no channel or zero dwell
+  *    - ESP_ERR_NO_MEM: out of memory
+  *    - others: refer to esp_sc_decoder_create
+  */
+esp_err_t esp_sc_chan_create(const esp_sc_chan_config_t *cfg,
+                             esp_sc_chan_t **out);
+
+/**
+  * @brief     Delete an engine
+  */
+void esp_sc_chan_delete(esp_sc_chan_t *eng);
+
+/**
+  * @brief     Forget all scores and decoders, back to the first channel
+  */
+void esp_sc_chan_reset(esp_sc_chan_t *eng);
+
+/**
+  * @brief     Channel to listen on now
+  *
+  * @param     eng       engine
+  * @param     dwell_ms  dwell given by the last pick, may be NULL
+  */
+uint8_t esp_sc_chan_current(const esp_sc_chan_t *eng, uint32_t *dwell_ms);
+
+/**
+  * @brief     Feed the length of a data frame received on a channel
+  *
+  * @return    state of the decoder of that channel, a transition to
+  *            ESP_SC_DECODE_LOCKED should end the dwell
+  */
+esp_sc_decode_state_t esp_sc_chan_feed(esp_sc_chan_t *eng, uint8_t channel,
+                                       const uint8_t sa[6], uint8_t ds,
+                                       uint16_t len);
+
+/**
+  * @brief     End the dwell and pick the next channel
+  *
+  * A locked channel is kept for lock_timeout_ms; still without result
+  * on the next call, its decoder is reset and the search goes on.
+  *
+  * @param     eng       engine
+  * @param     channel   channel to listen on
+  * @param     dwell_ms  time before the next call, 0 when done
+  */
+void esp_sc_chan_next(esp_sc_chan_t *eng, uint8_t *channel,
+                      uint32_t *dwell_ms);
+
+/**
+  * @brief     Get the credentials from the channel that decoded them
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: not decoded yet
+  */
+esp_err_t esp_sc_chan_result(const esp_sc_chan_t *eng, uint8_t *channel,
+                             smartconfig_event_got_ssid_pswd_t *result);
+
+/**
+  * @brief     Get the score of every channel, index is the channel
+  */
+void esp_sc_chan_get_scores(const esp_sc_chan_t *eng,
+                            uint32_t scores[ESP_SC_CHAN_MAX + 1]);
+
+/**
+  * @brief     Result callback of esp_sc_chan_start, from the timer task
+  */
+typedef void (*esp_sc_chan_done_cb_t)(uint8_t channel,
+                              const smartconfig_event_got_ssid_pswd_t *result,
+                              void *arg);
+
+/**
+  * @brief     Drive an engine with promiscuous mode and esp_wifi_set_channel
+  *
+  * WiFi must be started in station mode. The engine must not be used by
+  * the caller until esp_sc_chan_stop.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: already running
+  *    - others: refer to esp_wifi_set_promiscuous and esp_timer_create
+  */
+esp_err_t esp_sc_chan_start(esp_sc_chan_t *eng, esp_sc_chan_done_cb_t cb,
+                            void *arg);
+
+/**
+  * @brief     Stop driving the engine and leave promiscuous mode
+  */
+void esp_sc_chan_stop(void);
+
+/** @brief Simulator parameters */
+
+typedef struct
+{
+  uint32_t frame_interval_us;    /**< between two frames of the phone */
+  uint16_t len_offset;           /**< over-the-air overhead of a frame */
+  uint32_t loss_permille;        /**< phone frames lost */
+  uint32_t interference_fps;     /**< frames per second of other stations,
+                                      on every channel */
+  uint32_t timeout_ms;           /**< a run fails past this */
+  uint32_t runs;
+  uint32_t seed;
+} esp_sc_chan_sim_t;
+
+/** @brief Simulator outcome of one policy */
+
+typedef struct
+{
+  uint32_t locked;               /**< runs locked on the phone's channel */
+  uint32_t wrong;                /**< runs locked on another channel */
+  uint32_t timeouts;
+  uint32_t lock_avg_ms;
+  uint32_t lock_max_ms;
+  uint32_t hops_avg;             /**< channel switches to the lock */
+} esp_sc_chan_sim_stat_t;
+
+typedef struct
+{
+  esp_sc_chan_sim_stat_t sequential;
+  esp_sc_chan_sim_stat_t scored;
+} esp_sc_chan_sim_result_t;
+
+/**
+  * @brief     Fill simulator parameters with defaults: 8 ms between
+  *            frames, 10% loss, 200 frames/s of interference
+  */
+void esp_sc_chan_sim_default(esp_sc_chan_sim_t *sim);
+
+/**
+  * @brief     Measure time-to-lock of the sequential and scored policies
+  *
+  * Every run puts the phone on a random channel of the mask at a random
+  * point of its guide and data rounds, then runs both policies from the
+  * first channel of the mask. The policy of cfg is ignored.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid parameters
+  *    - others: refer to esp_sc_chan_create
+  */
+esp_err_t esp_sc_chan_sim_run(const esp_sc_chan_config_t *cfg,
+                              const esp_sc_chan_sim_t *sim,
+                              esp_sc_chan_sim_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_SC_CHANNEL_H_ */
@@ -0,0 +1,196 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_SC_DECODE_H_
+#define _ESP_SC_DECODE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+#include "esp_smartconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Smartconfig decoder working on the length of sniffed data frames only,
+ * as libsmartconfig does, so that it runs on the host against
+ * synthesized frame streams as well as on promiscuous frames.
+ *
+ * ESPTouch: guide code 515, 514, 513, 512, then every data byte i as
+ * three lengths (crc_hi << 4 | data_hi), 256 + i, (crc_lo << 4 | data_lo),
+ * each plus 40, where crc = crc8(data, i). Data is total length,
+ * password length, SSID crc, BSSID crc, xor of the rest, phone IP,
+ * password, SSID, then the BSSID.
+ *
+ * AirKiss: guide code 1, 2, 3, 4, magic code (total length, SSID crc),
+ * prefix code (password length and its crc), then sequences of a crc
+ * and index header and up to four 0x100 | byte lengths over password,
+ * random token and SSID.
+ *
+ * All lengths are seen with an offset, the 802.11, LLC, IP and UDP
+ * overhead, learnt from the guide code.
+ */
+
+#define ESP_SC_DECODE_SOURCES  8
+
+typedef enum
+{
+  ESP_SC_DECODE_SEARCHING = 0,   /**< no guide code found yet */
+  ESP_SC_DECODE_LOCKED,          /**< sender and offset known */
+  ESP_SC_DECODE_DONE,            /**< result available */
+} esp_sc_decode_state_t;
+
+/** @brief Decoder counters */
+
+typedef struct
+{
+  uint32_t frames;               /**< frames fed */
+  uint32_t locked_frames;        /**< frames from the locked sender */
+  uint32_t guides;               /**< guide codes seen while searching */
+  uint32_t symbols;              /**< bytes or blocks that passed the crc */
+  uint32_t crc_errors;
+  uint32_t restarts;             /**< complete data failing its checks */
+} esp_sc_decode_stats_t;
+
+typedef struct esp_sc_decoder esp_sc_decoder_t;
+
+/**
+  * @brief     CRC-8/MAXIM used by both protocols
+  */
+uint8_t esp_sc_crc8(const uint8_t *data, size_t len);
+
+/**
+  * @brief     Create a decoder
+  *
+  * @param     type  SC_TYPE_ESPTOUCH, SC_TYPE_AIRKISS or both
+  * @param     out   created decoder
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_NOT_SUPPORTED: SC_TYPE_ESPTOUCH_V2
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_sc_decoder_create(smartconfig_type_t type,
+                                esp_sc_decoder_t **out);
+
+/**
+  * @brief     Delete a decoder
+  */
+void esp_sc_decoder_delete(esp_sc_decoder_t *dec);
+
+/**
+  * @brief     Forget the lock and everything decoded
+  */
+void esp_sc_decoder_reset(esp_sc_decoder_t *dec);
+
+/**
+  * @brief     Feed the length of one data frame
+  *
+  * @param     dec  decoder
+  * @param     sa   source address of the frame
+  * @param     ds   ToDS and FromDS bits, a sender relayed by the AP is
+  *                 seen with another offset and tracked apart
+  * @param     len  frame length
+  *
+  * @return    state after the frame
+  */
+esp_sc_decode_state_t esp_sc_decoder_feed(esp_sc_decoder_t *dec,
+                                          const uint8_t sa[6], uint8_t ds,
+                                          uint16_t len);
+
+/**
+  * @brief     Feed a frame from the promiscuous callback
+  *
+  * Frames other than WIFI_PKT_DATA are ignored.
+  */
+esp_sc_decode_state_t esp_sc_decoder_feed_pkt(esp_sc_decoder_t *dec,
+                                          const wifi_promiscuous_pkt_t *pkt,
+                                          wifi_promiscuous_pkt_type_t type);
+
+/**
+  * @brief     Get the decoded credentials, as in SC_EVENT_GOT_SSID_PSWD
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: not decoded yet
+  */
+esp_err_t esp_sc_decoder_result(const esp_sc_decoder_t *dec,
+                                smartconfig_event_got_ssid_pswd_t *result);
+
+/**
+  * @brief     Get the decoder counters
+  */
+void esp_sc_decoder_get_stats(const esp_sc_decoder_t *dec,
+                              esp_sc_decode_stats_t *stats);
+
+/** @brief Host harness parameters */
+
+typedef struct
+{
+  smartconfig_type_t type;       /**< SC_TYPE_ESPTOUCH or SC_TYPE_AIRKISS */
+  const char *ssid;
+  const char *password;
+  uint8_t bssid[6];
+  uint8_t phone_ip[4];
+  uint32_t frame_interval_us;    /**< between two frames of the phone */
+  uint16_t len_offset;           /**< over-the-air overhead of a frame */
+  uint32_t loss_permille;        /**< phone frames lost */
+  uint32_t noise_permille;       /**< phone frames followed by one of its
+                                      own frames of random length */
+  uint32_t interference_fps;     /**< frames per second of other stations */
+  uint32_t timeout_ms;           /**< a run fails past this */
+  uint32_t runs;
+  uint32_t seed;
+} esp_sc_sim_t;
+
+/** @brief Host harness outcome */
+
+typedef struct
+{
+  uint32_t decoded;              /**< runs decoded correctly */
+  uint32_t wrong;                /**< runs decoded to other credentials */
+  uint32_t timeouts;
+  uint32_t lock_avg_ms;          /**< time to the guide code lock */
+  uint32_t decode_avg_ms;        /**< time to decode, decoded runs */
+  uint32_t decode_max_ms;
+  uint64_t frames;               /**< frames fed, all runs */
+  uint32_t ns_per_frame;         /**< decoder CPU time per frame */
+} esp_sc_sim_result_t;
+
+/**
+  * @brief     Fill harness parameters with defaults: ESPTouch, 8 ms
+  *            between frames, 10% loss, 200 frames/s of interference
+  */
+void esp_sc_sim_default(esp_sc_sim_t *sim);
+
+/**
+  * @brief     Synthesize encoded frame streams with loss and
+  *            interference and run them through the decoder
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid parameters or credentials too long
+  *    - others: refer to esp_sc_decoder_create
+  */
+esp_err_t esp_sc_sim_run(const esp_sc_sim_t *sim,
+                         esp_sc_sim_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_SC_DECODE_H_ */
@@ -0,0 +1,369 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_ACTION_MUX_H_
+#define _ESP_WIFI_ACTION_MUX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Action frame and remain-on-channel multiplexer.
+ *
+ * The driver runs one off-channel operation at a time. Clients queue
+ * action frames to send and channel dwells to listen instead, and the
+ * multiplexer serves them in windows: a window is one remain-on-channel
+ * on the channel of the oldest request, holding every request queued
+ * for that channel, its frames sent at the start and as long as the
+ * longest dwell among them. A window begins once its oldest request has
+ * waited hold_ms, for more requests to join it. Received action frames
+ * go to the clients registered for their category and, for the vendor
+ * specific ones, their OUI.
+ */
+
+#define ESP_WIFI_ACTION_MUX_CLIENTS   8
+#define ESP_WIFI_ACTION_MUX_QUEUE     16
+
+#define ESP_WIFI_ACTION_CAT_PUBLIC    4
+#define ESP_WIFI_ACTION_CAT_VENDOR    127
+
+typedef struct
+{
+  wifi_interface_t ifx;          /**< of the frames and dwells */
+  uint32_t hold_ms;              /**< before a window begins */
+  uint32_t tx_dwell_ms;          /**< of a window of frames alone */
+  uint8_t max_merge;             /**< requests per window, 1 one by one */
+} esp_wifi_action_mux_config_t;
+
+/** @brief Counters */
+
+typedef struct
+{
+  uint32_t requests;
+  uint32_t windows;
+  uint32_t switches;             /**< of the radio channel */
+  uint64_t latency_sum_ms;       /**< queued to window begin */
+  uint32_t latency_max_ms;
+  uint32_t dwell_ms;             /**< sum over the windows, begin to end */
+  uint32_t tx_failed;
+  uint32_t rx;
+  uint32_t rx_unrouted;
+} esp_wifi_action_mux_stats_t;
+
+/**
+  * @brief     Action frame received, body from the category on
+  */
+typedef void (*esp_wifi_action_mux_rx_cb_t)(void *ctx, const uint8_t *hdr,
+                                            const uint8_t *body, size_t len,
+                                            uint8_t channel);
+
+/**
+  * @brief     Request id done: the frame sent, or not, or the dwell over
+  */
+typedef void (*esp_wifi_action_mux_done_cb_t)(void *ctx, uint32_t id,
+                                              esp_err_t status);
+
+typedef struct
+{
+  uint8_t category;              /**< of the frames received */
+  bool any_oui;
+  uint8_t oui[3];                /**< vendor specific frames only */
+  esp_wifi_action_mux_rx_cb_t rx;
+  esp_wifi_action_mux_done_cb_t done;
+  void *ctx;
+} esp_wifi_action_mux_client_t;
+
+/** @brief A callback to make once out of the lock */
+
+typedef struct
+{
+  esp_wifi_action_mux_done_cb_t done;
+  void *ctx;
+  uint32_t id;
+  esp_err_t status;
+} esp_wifi_action_mux_done_t;
+
+typedef struct
+{
+  wifi_interface_t ifx;
+  uint8_t channel;
+  uint8_t requests;
+  uint8_t frames;
+  uint32_t dwell_ms;
+} esp_wifi_action_mux_window_t;
+
+typedef struct esp_wifi_action_mux esp_wifi_action_mux_t;
+
+/**
+  * @brief     Fill a configuration with defaults: station interface,
+  *            20 ms hold, 30 ms dwell for frames, merging on
+  */
+void esp_wifi_action_mux_default(esp_wifi_action_mux_config_t *cfg);
+
+/**
+  * @brief     Create a multiplexer
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: cfg or mux is NULL, or max_merge 0
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_action_mux_create(const esp_wifi_action_mux_config_t *cfg,
+                                     esp_wifi_action_mux_t **mux);
+
+/**
+  * @brief     Delete a multiplexer and its queued frames
+  */
+void esp_wifi_action_mux_delete(esp_wifi_action_mux_t *mux);
+
+/**
+  * @brief     Register a client
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: client or id is NULL
+  *    - ESP_ERR_NO_MEM: ESP_WIFI_ACTION_MUX_CLIENTS registered already
+  */
+esp_err_t esp_wifi_action_mux_register(esp_wifi_action_mux_t *mux,
+                                       const esp_wifi_action_mux_client_t
+                                       *client, uint8_t *id);
+
+/**
+  * @brief     Unregister a client, dropping its requests, those of the
+  *            window on included, without callback
+  */
+void esp_wifi_action_mux_unregister(esp_wifi_action_mux_t *mux, uint8_t id);
+
+/**
+  * @brief     Set the channel the radio stays on between windows, 0 when
+  *            not connected
+  */
+void esp_wifi_action_mux_set_home(esp_wifi_action_mux_t *mux,
+                                  uint8_t channel);
+
+/**
+  * @brief     Queue an action frame, body from the category on
+  *
+  * @return
+  *    - ESP_OK: succeed, *id set
+  *    - ESP_ERR_INVALID_ARG: unknown client, channel 0 or no body
+  *    - ESP_ERR_NO_MEM: queue full or out of memory
+  */
+esp_err_t esp_wifi_action_mux_queue_tx(esp_wifi_action_mux_t *mux,
+                                       uint8_t client, uint8_t channel,
+                                       const uint8_t dest[6],
+                                       const uint8_t *body, size_t len,
+                                       bool no_ack, uint32_t now_ms,
+                                       uint32_t *id);
+
+/**
+  * @brief     Queue a dwell on channel, to receive on
+  *
+  * @return
+  *    - ESP_OK: succeed, *id set
+  *    - ESP_ERR_INVALID_ARG: unknown client, channel 0 or dwell 0
+  *    - ESP_ERR_NO_MEM: queue full
+  */
+esp_err_t esp_wifi_action_mux_queue_roc(esp_wifi_action_mux_t *mux,
+                                        uint8_t client, uint8_t channel,
+                                        uint32_t dwell_ms, uint32_t now_ms,
+                                        uint32_t *id);
+
+/**
+  * @brief     Drop a request not begun
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_NOT_FOUND: no such request, or in the window
+  */
+esp_err_t esp_wifi_action_mux_cancel(esp_wifi_action_mux_t *mux,
+                                     uint32_t id);
+
+/**
+  * @brief     Milliseconds until a window may begin, UINT32_MAX with
+  *            nothing queued or a window on
+  */
+uint32_t esp_wifi_action_mux_wait_ms(const esp_wifi_action_mux_t *mux,
+                                     uint32_t now_ms);
+
+/**
+  * @brief     Begin the next window
+  *
+  * @return
+  *    - ESP_OK: succeed, win filled
+  *    - ESP_ERR_INVALID_STATE: a window on
+  *    - ESP_ERR_NOT_FOUND: nothing queued, or held
+  */
+esp_err_t esp_wifi_action_mux_begin(esp_wifi_action_mux_t *mux,
+                                    uint32_t now_ms,
+                                    esp_wifi_action_mux_window_t *win);
+
+/**
+  * @brief     Next frame of the window to send, NULL when all sent
+  *
+  * The frame belongs to the multiplexer and stays valid up to
+  * esp_wifi_action_mux_tx_done. Its rx_cb is left for the caller.
+  */
+wifi_action_tx_req_t *esp_wifi_action_mux_next_tx(esp_wifi_action_mux_t
+                                                  *mux);
+
+/**
+  * @brief     The frame from esp_wifi_action_mux_next_tx is out
+  *
+  * @return    true with done filled, false with no frame out
+  */
+bool esp_wifi_action_mux_tx_done(esp_wifi_action_mux_t *mux, bool ok,
+                                 esp_wifi_action_mux_done_t *done);
+
+/**
+  * @brief     End the window at now_ms, frames not sent failing
+  *
+  * @return    callbacks filled in done, up to max which is best
+  *            ESP_WIFI_ACTION_MUX_QUEUE
+  */
+size_t esp_wifi_action_mux_end(esp_wifi_action_mux_t *mux, uint32_t now_ms,
+                               esp_wifi_action_mux_done_t *done, size_t max);
+
+/**
+  * @brief     Clients of a received action frame, body from the category
+  *            on
+  *
+  * @return    clients filled in out, up to max
+  */
+size_t esp_wifi_action_mux_route(esp_wifi_action_mux_t *mux,
+                                 const uint8_t *body, size_t len,
+                                 esp_wifi_action_mux_client_t *out,
+                                 size_t max);
+
+/**
+  * @brief     Get the counters
+  */
+void esp_wifi_action_mux_get_stats(const esp_wifi_action_mux_t *mux,
+                                   esp_wifi_action_mux_stats_t *stats);
+
+/**
+  * @brief     Drive mux with esp_wifi_remain_on_channel and
+  *            esp_wifi_action_tx_req, on the WiFi events
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: mux is NULL
+  *    - ESP_ERR_INVALID_STATE: started already
+  *    - ESP_ERR_NO_MEM: out of memory
+  *    - others: refer to esp_event_handler_register
+  */
+esp_err_t esp_wifi_action_mux_start(esp_wifi_action_mux_t *mux);
+
+/**
+  * @brief     Stop, the window on cancelled
+  */
+void esp_wifi_action_mux_stop(void);
+
+/**
+  * @brief     Register a client on the started multiplexer
+  *
+  * @return    refer to esp_wifi_action_mux_register, ESP_ERR_INVALID_STATE
+  *            when not started
+  */
+esp_err_t esp_wifi_action_mux_attach(const esp_wifi_action_mux_client_t
+                                     *client, uint8_t *id);
+
+/**
+  * @brief     Unregister a client from the started multiplexer
+  */
+void esp_wifi_action_mux_detach(uint8_t id);
+
+/**
+  * @brief     Queue an action frame on the started multiplexer
+  *
+  * @return    refer to esp_wifi_action_mux_queue_tx, ESP_ERR_INVALID_STATE
+  *            when not started
+  */
+esp_err_t esp_wifi_action_mux_send(uint8_t client, uint8_t channel,
+                                   const uint8_t dest[6],
+                                   const uint8_t *body, size_t len,
+                                   bool no_ack, uint32_t *id);
+
+/**
+  * @brief     Queue a dwell on the started multiplexer
+  *
+  * @return    refer to esp_wifi_action_mux_queue_roc, ESP_ERR_INVALID_STATE
+  *            when not started
+  */
+esp_err_t esp_wifi_action_mux_listen(uint8_t client, uint8_t channel,
+                                     uint32_t dwell_ms, uint32_t *id);
+
+/** @brief Simulator parameters */
+
+typedef struct
+{
+  uint32_t seconds;
+  uint8_t home_channel;          /**< 0 not connected */
+  uint16_t tx_per_s;             /**< frames, on channels 1, 6 and 11 */
+  uint16_t roc_per_s;            /**< dwells, on the same channels */
+  uint32_t roc_dwell_ms;
+  uint32_t switch_ms;            /**< cost of a channel switch */
+  uint32_t seed;
+} esp_wifi_action_mux_sim_t;
+
+/** @brief Simulator outcome of one policy */
+
+typedef struct
+{
+  uint32_t windows;
+  uint32_t switches;
+  uint32_t latency_avg_ms;
+  uint32_t latency_max_ms;
+  uint32_t off_home_ms;          /**< switches included */
+  uint32_t dropped;              /**< queue full */
+} esp_wifi_action_mux_sim_stat_t;
+
+typedef struct
+{
+  uint32_t requests;
+  esp_wifi_action_mux_sim_stat_t serial;  /**< one request per window */
+  esp_wifi_action_mux_sim_stat_t merged;  /**< the defaults */
+} esp_wifi_action_mux_sim_result_t;
+
+/**
+  * @brief     Fill simulator parameters with defaults: 60 s on home
+  *            channel 6, 10 frames and 2 dwells of 100 ms a second,
+  *            5 ms per switch
+  */
+void esp_wifi_action_mux_sim_default(esp_wifi_action_mux_sim_t *sim);
+
+/**
+  * @brief     Replay random requests one per window, then merged
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: sim or result is NULL, no second or no
+  *      request
+  *    - others: refer to esp_wifi_action_mux_create
+  */
+esp_err_t esp_wifi_action_mux_sim_run(const esp_wifi_action_mux_sim_t *sim,
+                                      esp_wifi_action_mux_sim_result_t
+                                      *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_ACTION_MUX_H_ */
@@ -0,0 +1,240 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_ANT_H_
+#define _ESP_WIFI_ANT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Antenna diversity engine for two antennas.
+ *
+ * Received frames give an RSSI sample on the antenna they came in on,
+ * sent frames a success or a failure on the antenna in use. Both are
+ * summed per peer and antenna over a window; a window with min_samples
+ * RSSI samples or more leaves the mean RSSI and the PER of the antenna
+ * for the peer. The antenna not in use is sampled by a probe of
+ * probe_ms about every probe_interval_ms, both ways on it, its mean
+ * counted from probe_samples. The other antenna scores the mean RSSI
+ * less per_weight dB at 100% PER above the one in use, averaged over
+ * the peers known on both by their traffic; scoring hysteresis dB better
+ * at two evaluations in a row, no sooner than min_dwell_ms after the
+ * last switch, it becomes the antenna in use.
+ *
+ * The engine only decides; esp_wifi_ant_start drives it on the target
+ * with esp_wifi_set_ant, esp_wifi_ant_replay drives it from an RSSI
+ * trace of both antennas.
+ */
+
+#define ESP_WIFI_ANT_PEERS            8
+
+typedef struct
+{
+  uint32_t window_ms;
+  uint16_t min_samples;          /**< RSSI samples of a window counted */
+  uint8_t hysteresis;            /**< dB */
+  uint8_t per_weight;            /**< dB taken off at 100% PER */
+  uint32_t min_dwell_ms;         /**< between two switches */
+  uint32_t probe_interval_ms;    /**< 0 never probe, jittered a quarter */
+  uint32_t probe_ms;
+  uint16_t probe_samples;        /**< RSSI samples of a probe counted */
+  uint32_t stale_ms;             /**< antenna mean older is ignored */
+  uint8_t enabled_ant0;          /**< antenna GPIO configuration index */
+  uint8_t enabled_ant1;
+} esp_wifi_ant_config_t;
+
+/** @brief Counters */
+
+typedef struct
+{
+  uint32_t rx;
+  uint32_t tx;
+  uint32_t windows;
+  uint32_t evaluations;          /**< with a peer known on both */
+  uint32_t switches;
+  uint32_t probes;
+  uint32_t writes;               /**< of the antenna configuration */
+} esp_wifi_ant_stats_t;
+
+typedef struct esp_wifi_ant esp_wifi_ant_t;
+
+/**
+  * @brief     Fill a configuration with defaults: 1 s windows of 10
+  *            samples, 4 dB hysteresis, 10 dB PER weight, 5 s dwell,
+  *            200 ms probes of 3 samples every 10 s, stale after 30 s,
+  *            antennas 0 and 1
+  */
+void esp_wifi_ant_default(esp_wifi_ant_config_t *cfg);
+
+/**
+  * @brief     Create an engine on antenna 0
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: cfg or ant is NULL, window_ms or
+  *      min_samples 0, or a probe of 0 ms or 0 samples
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_ant_create(const esp_wifi_ant_config_t *cfg,
+                              uint32_t now_ms, esp_wifi_ant_t **ant);
+
+/**
+  * @brief     Delete an engine
+  */
+void esp_wifi_ant_delete(esp_wifi_ant_t *ant);
+
+/**
+  * @brief     A frame from peer received on antenna 0 or 1
+  */
+void esp_wifi_ant_rx(esp_wifi_ant_t *ant, const uint8_t peer[6],
+                     uint8_t antenna, int8_t rssi, uint32_t now_ms);
+
+/**
+  * @brief     A frame to peer sent on the antenna in use, acked or not
+  */
+void esp_wifi_ant_tx(esp_wifi_ant_t *ant, const uint8_t peer[6], bool ok,
+                     uint32_t now_ms);
+
+/**
+  * @brief     Close windows, probe and decide
+  *
+  * @return    true with config to write, false to leave it
+  */
+bool esp_wifi_ant_update(esp_wifi_ant_t *ant, uint32_t now_ms,
+                         wifi_ant_config_t *config);
+
+/**
+  * @brief     Antenna frames are sent and received on now, 0 or 1
+  */
+uint8_t esp_wifi_ant_current(const esp_wifi_ant_t *ant);
+
+/**
+  * @brief     Antenna configuration of the antenna in use now, one
+  *            antenna both ways
+  */
+void esp_wifi_ant_config(const esp_wifi_ant_t *ant,
+                         wifi_ant_config_t *config);
+
+/**
+  * @brief     Get the counters
+  */
+void esp_wifi_ant_get_stats(const esp_wifi_ant_t *ant,
+                            esp_wifi_ant_stats_t *stats);
+
+/**
+  * @brief     Sample the AP with esp_wifi_sta_get_ap_info every tick_ms
+  *            and write the antenna configuration with esp_wifi_set_ant
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: ant is NULL or tick_ms 0
+  *    - ESP_ERR_INVALID_STATE: started already
+  *    - ESP_ERR_NO_MEM: out of memory
+  *    - others: refer to esp_timer_create and esp_wifi_set_ant
+  */
+esp_err_t esp_wifi_ant_start(esp_wifi_ant_t *ant, uint32_t tick_ms);
+
+/**
+  * @brief     Stop sampling, leaving the antenna configuration
+  */
+void esp_wifi_ant_stop(void);
+
+/**
+  * @brief     Feed a frame received, from a promiscuous or ESP-NOW
+  *            callback, to the started engine
+  */
+void esp_wifi_ant_feed_rx(const uint8_t peer[6], uint8_t antenna,
+                          int8_t rssi);
+
+/**
+  * @brief     Feed a send status, from an ESP-NOW send callback, to the
+  *            started engine
+  */
+void esp_wifi_ant_feed_tx(const uint8_t peer[6], bool ok);
+
+/** @brief One frame of an RSSI trace, as received on each antenna */
+
+typedef struct
+{
+  uint32_t t_ms;
+  int8_t rssi[2];
+} esp_wifi_ant_sample_t;
+
+/** @brief Trace replay outcome */
+
+typedef struct
+{
+  uint32_t samples;
+  uint32_t switches;
+  uint32_t probes;
+  uint32_t writes;
+  int32_t avg_x10;               /**< dBm x 10, on the antenna in use */
+  int32_t fixed_x10;             /**< on antenna 0 alone */
+  int32_t best_x10;              /**< on the better one at every frame */
+  uint32_t better_permille;      /**< frames on the better antenna, by
+                                      the means over the window */
+} esp_wifi_ant_replay_t;
+
+/**
+  * @brief     Replay a trace of frames from one peer through an engine
+  *            with cfg, the engine seeing the antenna in use only
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: NULL argument or empty trace
+  *    - others: refer to esp_wifi_ant_create
+  */
+esp_err_t esp_wifi_ant_replay(const esp_wifi_ant_config_t *cfg,
+                              const esp_wifi_ant_sample_t *trace, size_t n,
+                              esp_wifi_ant_replay_t *result);
+
+/** @brief Synthetic trace parameters */
+
+typedef struct
+{
+  uint32_t seconds;
+  uint16_t frames_per_s;
+  int8_t mean[2];                /**< dBm per antenna */
+  uint8_t fade_db;               /**< slow fading depth */
+  uint32_t fade_period_ms;       /**< the antennas fade in opposition */
+  uint8_t noise_db;              /**< fast fading, uniform +- */
+  uint32_t seed;
+} esp_wifi_ant_trace_t;
+
+/**
+  * @brief     Fill trace parameters with defaults: 120 s of 20 frames a
+  *            second, -62 and -64 dBm, 8 dB fades over 40 s, 4 dB noise
+  */
+void esp_wifi_ant_trace_default(esp_wifi_ant_trace_t *trace);
+
+/**
+  * @brief     Generate a trace of up to max frames
+  *
+  * @return    frames generated
+  */
+size_t esp_wifi_ant_trace_make(const esp_wifi_ant_trace_t *trace,
+                               esp_wifi_ant_sample_t *samples, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_ANT_H_ */
@@ -0,0 +1,213 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_AP_STA_H_
+#define _ESP_WIFI_AP_STA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* SoftAP station table, kept in sync from the AP events.
+ *
+ * Stations sit at dense indexes 0 to count - 1, each field in its own
+ * array, so that a pass over one counter touches one cache line. A MAC
+ * is found through an open addressing index of ESP_WIFI_AP_STA_SLOTS
+ * slots with linear probing, at most a third full, and an AID through a
+ * direct map of the 255 AIDs the events can carry. Removal moves the
+ * last station into the hole and shifts the probe run back, there are
+ * no tombstones.
+ *
+ * The table is not locked, and an index is only good until the next
+ * add or remove. All calls on a table must come from one task or be
+ * serialized by the caller, across a lookup and the use of its index.
+ * No event handler is provided for this reason: the one of the
+ * application takes its lock around esp_wifi_ap_sta_event, which keeps
+ * the table in sync from WIFI_EVENT.
+ */
+
+#define ESP_WIFI_AP_STA_MAX           ESP_WIFI_MAX_CONN_NUM
+#define ESP_WIFI_AP_STA_SLOTS         32
+
+/** @brief A station as seen by the table */
+
+typedef struct
+{
+  uint8_t mac[6];
+  uint8_t aid;
+  int8_t rssi;                   /**< last from esp_wifi_ap_get_sta_list,
+                                      0 if none yet */
+  uint64_t rx_bytes;             /**< from the station */
+  uint64_t tx_bytes;             /**< to the station */
+  uint32_t rx_packets;
+  uint32_t tx_packets;
+  uint32_t connected_s;          /**< time of the connect event */
+} esp_wifi_ap_sta_info_t;
+
+typedef struct esp_wifi_ap_sta esp_wifi_ap_sta_t;
+
+/**
+  * @brief     Create an empty table
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: tab is NULL
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_ap_sta_create(esp_wifi_ap_sta_t **tab);
+
+/**
+  * @brief     Delete a table
+  */
+void esp_wifi_ap_sta_delete(esp_wifi_ap_sta_t *tab);
+
+/**
+  * @brief     Add a station, or give a known one its new AID
+  *
+  * Counters of a known station are kept.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: AID 0
+  *    - ESP_ERR_NO_MEM: ESP_WIFI_AP_STA_MAX stations already
+  */
+esp_err_t esp_wifi_ap_sta_add(esp_wifi_ap_sta_t *tab, const uint8_t mac[6],
+                              uint8_t aid, uint32_t now_s);
+
+/**
+  * @brief     Remove a station
+  *
+  * The last station takes the index of the removed one.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_NOT_FOUND: unknown station
+  */
+esp_err_t esp_wifi_ap_sta_remove(esp_wifi_ap_sta_t *tab,
+                                 const uint8_t mac[6]);
+
+/**
+  * @brief     Remove all stations
+  */
+void esp_wifi_ap_sta_flush(esp_wifi_ap_sta_t *tab);
+
+/**
+  * @brief     Number of stations
+  */
+uint8_t esp_wifi_ap_sta_count(const esp_wifi_ap_sta_t *tab);
+
+/**
+  * @brief     Find a station by MAC
+  *
+  * @return    its index, valid until the next add or remove, or -1
+  */
+int esp_wifi_ap_sta_find(const esp_wifi_ap_sta_t *tab, const uint8_t mac[6]);
+
+/**
+  * @brief     Find a station by AID
+  *
+  * @return    its index, valid until the next add or remove, or -1
+  */
+int esp_wifi_ap_sta_find_aid(const esp_wifi_ap_sta_t *tab, uint8_t aid);
+
+/**
+  * @brief     Account a received packet to the station at index i
+  */
+void esp_wifi_ap_sta_rx(esp_wifi_ap_sta_t *tab, int i, uint32_t bytes);
+
+/**
+  * @brief     Account a sent packet to the station at index i
+  */
+void esp_wifi_ap_sta_tx(esp_wifi_ap_sta_t *tab, int i, uint32_t bytes);
+
+/**
+  * @brief     Get the station at index i
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: no station at i
+  */
+esp_err_t esp_wifi_ap_sta_get(const esp_wifi_ap_sta_t *tab, int i,
+                              esp_wifi_ap_sta_info_t *info);
+
+/**
+  * @brief     Take the RSSI of the stations from a station list
+  *
+  * @return    stations of the list unknown to the table
+  */
+uint8_t esp_wifi_ap_sta_sync(esp_wifi_ap_sta_t *tab,
+                             const wifi_sta_list_t *list);
+
+/**
+  * @brief     Apply a WIFI_EVENT to the table: stations are added on
+  *            WIFI_EVENT_AP_STACONNECTED, removed on
+  *            WIFI_EVENT_AP_STADISCONNECTED and flushed on
+  *            WIFI_EVENT_AP_STOP, other events are ignored
+  *
+  * @param     id     event id
+  * @param     data   event data
+  * @param     now_s  time of the event, in seconds
+  */
+void esp_wifi_ap_sta_event(esp_wifi_ap_sta_t *tab, int32_t id,
+                           const void *data, uint32_t now_s);
+
+/**
+  * @brief     Take the RSSI of the stations from
+  *            esp_wifi_ap_get_sta_list, adding the stations unknown to
+  *            the table, connected before it was created for instance
+  *
+  * It is serialized as any other call on the table, the driver being
+  * called meanwhile.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - others: refer to esp_wifi_ap_get_sta_list
+  */
+esp_err_t esp_wifi_ap_sta_refresh(esp_wifi_ap_sta_t *tab);
+
+/** @brief Benchmark outcome, per lookup */
+
+typedef struct
+{
+  uint32_t lookups;
+  uint32_t list_ns;              /**< wifi_sta_list_t copied and scanned */
+  uint32_t table_ns;             /**< esp_wifi_ap_sta_find */
+  uint32_t misses;               /**< lookups of absent stations */
+} esp_wifi_ap_sta_bench_t;
+
+/**
+  * @brief     Look up random stations of a full table, one in eight
+  *            absent, against a copy and scan of the station list
+  *
+  * The copy stands for esp_wifi_ap_get_sta_list, without its locking.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: no lookup
+  *    - others: refer to esp_wifi_ap_sta_create
+  */
+esp_err_t esp_wifi_ap_sta_bench(uint32_t lookups, uint32_t seed,
+                                esp_wifi_ap_sta_bench_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_AP_STA_H_ */
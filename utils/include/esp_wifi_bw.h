@@ -0,0 +1,289 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_BW_H_
+#define _ESP_WIFI_BW_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_event_base.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* HT20/HT40 selection of a station by the expected goodput.
+ *
+ * The airtime of the frames heard on a channel over the time listened
+ * to it gives the occupancy of the channel for a window, averaged over
+ * the windows. Scans give the overlapping BSSs: those heard above
+ * obss_rssi with their primary channel within the 40 MHz affected range
+ * and off ours, and among them those on our secondary channel, each
+ * taken as obss_percent busy there while the secondary is not listened
+ * to. At the end of a window HT20 is expected to do rate20_kbps over the
+ * time the primary is free, HT40 rate40_kbps over the time both are;
+ * the other bandwidth doing hysteresis_percent better at two windows in
+ * a row, no sooner than min_dwell_ms after the last switch, becomes the
+ * bandwidth. HT2040 coexistence management is on while overlapping BSSs
+ * are known.
+ *
+ * The engine only decides; esp_wifi_bw_start drives it on the target with
+ * esp_wifi_set_bandwidth and the WIFI_IOCTL_SET_STA_HT2040_COEX ioctl,
+ * esp_wifi_bw_replay drives it from a channel occupancy trace.
+ */
+
+typedef struct
+{
+  uint32_t window_ms;
+  uint16_t min_listen_ms;        /**< to a channel in a window counted */
+  uint8_t ewma_percent;          /**< weight of the past windows */
+  uint32_t rate20_kbps;
+  uint32_t rate40_kbps;
+  int8_t obss_rssi;              /**< dBm, weaker BSSs ignored */
+  uint8_t obss_percent;          /**< busy, of a BSS on the secondary */
+  uint8_t hysteresis_percent;
+  uint32_t min_dwell_ms;         /**< between two switches */
+  uint32_t stale_ms;             /**< occupancy and scans older ignored */
+  uint32_t scan_interval_ms;     /**< of the secondary, by the driver */
+} esp_wifi_bw_config_t;
+
+/** @brief What to write */
+
+typedef struct
+{
+  wifi_bandwidth_t bw;
+  bool coex;                     /**< HT2040 coexistence management */
+} esp_wifi_bw_decision_t;
+
+/** @brief Counters */
+
+typedef struct
+{
+  uint32_t windows;
+  uint32_t evaluations;          /**< with a secondary channel */
+  uint32_t switches;
+  uint32_t coex_toggles;
+  uint32_t scans;
+  uint32_t writes;
+} esp_wifi_bw_stats_t;
+
+typedef struct esp_wifi_bw esp_wifi_bw_t;
+
+/**
+  * @brief     Fill a configuration with defaults: 5 s windows counting
+  *            50 ms listened, 30% EWMA, 65 and 135 Mbps, BSSs above
+  *            -82 dBm and 10% busy each, 10% hysteresis, 30 s dwell,
+  *            stale after 120 s, the secondary scanned every 10 s
+  */
+void esp_wifi_bw_default(esp_wifi_bw_config_t *cfg);
+
+/**
+  * @brief     Create an engine on HT20, coexistence management off
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: cfg or bw is NULL, window_ms 0, a rate 0 or
+  *      ewma_percent above 100
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_bw_create(const esp_wifi_bw_config_t *cfg,
+                             uint32_t now_ms, esp_wifi_bw_t **bw);
+
+/**
+  * @brief     Delete an engine
+  */
+void esp_wifi_bw_delete(esp_wifi_bw_t *bw);
+
+/**
+  * @brief     Channel of the AP and where its secondary is, if any
+  *
+  * A new channel forgets the occupancies and the scans.
+  */
+void esp_wifi_bw_set_channel(esp_wifi_bw_t *bw, uint8_t primary,
+                             wifi_second_chan_t second);
+
+/**
+  * @brief     Secondary channel, 0 without
+  */
+uint8_t esp_wifi_bw_secondary(const esp_wifi_bw_t *bw);
+
+/**
+  * @brief     The radio listened to channel for us
+  */
+void esp_wifi_bw_listen(esp_wifi_bw_t *bw, uint8_t channel, uint32_t us);
+
+/**
+  * @brief     A frame of us airtime heard on channel
+  */
+void esp_wifi_bw_airtime(esp_wifi_bw_t *bw, uint8_t channel, uint32_t us);
+
+/**
+  * @brief     Records of a scan of channel, 0 for all channels
+  */
+void esp_wifi_bw_scan(esp_wifi_bw_t *bw, const wifi_ap_record_t *aps,
+                      uint16_t n, uint8_t channel, uint32_t now_ms);
+
+/**
+  * @brief     Close the window and decide
+  *
+  * @return    true with decision to write, false to leave it
+  */
+bool esp_wifi_bw_update(esp_wifi_bw_t *bw, uint32_t now_ms,
+                        esp_wifi_bw_decision_t *decision);
+
+/**
+  * @brief     Bandwidth and coexistence management in use
+  */
+void esp_wifi_bw_current(const esp_wifi_bw_t *bw,
+                         esp_wifi_bw_decision_t *decision);
+
+/**
+  * @brief     Get the configuration of an engine
+  */
+void esp_wifi_bw_get_config(const esp_wifi_bw_t *bw,
+                            esp_wifi_bw_config_t *cfg);
+
+/**
+  * @brief     Get the counters
+  */
+void esp_wifi_bw_get_stats(const esp_wifi_bw_t *bw,
+                           esp_wifi_bw_stats_t *stats);
+
+/**
+  * @brief     Airtime of a frame from its promiscuous metadata,
+  *            preamble included
+  *
+  * @return    microseconds, 0 for a rate unknown
+  */
+uint32_t esp_wifi_bw_frame_us(const wifi_pkt_rx_ctrl_t *rx_ctrl);
+
+/**
+  * @brief     Follow the AP of ifx every tick_ms, scan its secondary
+  *            channel every scan_interval_ms for scan_ms, and write the
+  *            decisions with esp_wifi_set_bandwidth and
+  *            esp_wifi_internal_ioctl
+  *
+  * Frames are heard from esp_wifi_bw_feed_rx, the scans of the engine from
+  * esp_wifi_bw_event_handler; those of the application are left to it.
+  * The application enables promiscuous RX and feeds the frames from its
+  * callback: time is only taken as listened to, on the primary in a tick
+  * and on the secondary in a scan, when frames were fed meanwhile. Until
+  * then the occupancy of the channels comes from the BSSs scanned.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: bw is NULL, tick_ms or scan_ms 0
+  *    - ESP_ERR_INVALID_STATE: started already
+  *    - ESP_ERR_NO_MEM: out of memory
+  *    - others: refer to esp_timer_create
+  */
+esp_err_t esp_wifi_bw_start(esp_wifi_bw_t *bw, wifi_interface_t ifx,
+                            uint32_t tick_ms, uint32_t scan_ms);
+
+/**
+  * @brief     Stop, leaving the bandwidth
+  */
+void esp_wifi_bw_stop(void);
+
+/**
+  * @brief     Feed a frame from a promiscuous callback to the started
+  *            engine
+  */
+void esp_wifi_bw_feed_rx(const wifi_promiscuous_pkt_t *pkt);
+
+/**
+  * @brief     Event handler feeding the scans to the started engine
+  *
+  * Register with esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+  * esp_wifi_bw_event_handler, NULL).
+  */
+void esp_wifi_bw_event_handler(void *arg, esp_event_base_t base,
+                               int32_t id, void *data);
+
+/** @brief One sample of a channel occupancy trace */
+
+typedef struct
+{
+  uint32_t t_ms;
+  uint16_t busy_permille[2];     /**< primary and secondary */
+  uint8_t obss;                  /**< BSSs on the secondary */
+} esp_wifi_bw_sample_t;
+
+/** @brief Trace replay outcome, goodput as expected from the trace */
+
+typedef struct
+{
+  uint32_t samples;
+  uint32_t switches;
+  uint32_t writes;
+  uint32_t ht20_kbps;            /**< HT20 throughout */
+  uint32_t ht40_kbps;            /**< HT40 throughout */
+  uint32_t engine_kbps;
+  uint32_t best_kbps;            /**< the better one at every sample */
+  uint32_t better_permille;      /**< samples on the better one */
+} esp_wifi_bw_replay_t;
+
+/**
+  * @brief     Replay a trace through an engine with cfg, the engine
+  *            hearing the primary throughout and the secondary during
+  *            a scan of 120 ms every scan_interval_ms
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: NULL argument or fewer than 2 samples
+  *    - others: refer to esp_wifi_bw_create
+  */
+esp_err_t esp_wifi_bw_replay(const esp_wifi_bw_config_t *cfg,
+                             const esp_wifi_bw_sample_t *trace, size_t n,
+                             esp_wifi_bw_replay_t *result);
+
+/** @brief Synthetic trace parameters */
+
+typedef struct
+{
+  uint32_t seconds;
+  uint32_t period_ms;            /**< between two samples */
+  uint16_t primary_permille;
+  uint16_t idle_permille;        /**< secondary, its BSSs idle */
+  uint16_t busy_permille;        /**< secondary, its BSSs busy */
+  uint32_t busy_ms;              /**< of a busy spell */
+  uint32_t idle_ms;              /**< between two, jittered a half */
+  uint8_t obss;                  /**< BSSs on the secondary */
+  uint16_t noise_permille;       /**< uniform +- */
+  uint32_t seed;
+} esp_wifi_bw_trace_t;
+
+/**
+  * @brief     Fill trace parameters with defaults: 1 h of 100 ms
+  *            samples, 20% busy primary, secondary 5% busy and 70% in
+  *            spells of 2 min every 5 min, 2 BSSs on it, 5% noise
+  */
+void esp_wifi_bw_trace_default(esp_wifi_bw_trace_t *trace);
+
+/**
+  * @brief     Generate a trace of up to max samples
+  *
+  * @return    samples generated
+  */
+size_t esp_wifi_bw_trace_make(const esp_wifi_bw_trace_t *trace,
+                              esp_wifi_bw_sample_t *samples, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_BW_H_ */
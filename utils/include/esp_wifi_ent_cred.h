@@ -0,0 +1,255 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_ENT_CRED_H_
+#define _ESP_WIFI_ENT_CRED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Credential store in front of the esp_wifi_sta_wpa2_ent_* setters.
+ *
+ * The supplicant keeps the certificate and key pointers it is given and
+ * hands them to mbedtls on every connect, which PEM decodes them into a
+ * temporary heap buffer before parsing. The store decodes PEM once,
+ * checks the ASN.1 structure of every certificate and key and that the
+ * key belongs to the client certificate, and gives the supplicant the
+ * DER. A single certificate is passed as DER, a chain as re-encoded PEM
+ * without anything but the certificates, since mbedtls only reads one
+ * DER certificate. Keys encrypted with a legacy PEM header stay PEM.
+ *
+ * Setting the same material again, as reconnect handlers usually do, is
+ * recognized by comparing it with the last input and costs no parse
+ * and no setter call. Certificates, identity and username are public
+ * and compared with a copy; the private key and the password only with
+ * their SHA-256 digest, so that the store keeps no second copy of them.
+ * The key password, whose pointer the supplicant keeps, is wiped before
+ * it is freed. The blobs are shared
+ * read-only with the supplicant and only freed on replacement or by the
+ * esp_wifi_ent_cred_clear_* calls.
+ */
+
+#define ESP_WIFI_ENT_CRED_MAX_CERTS   8
+
+#define ESP_WIFI_ENT_CRED_HASH_INIT   0xcbf29ce484222325ull
+
+typedef enum
+{
+  ESP_WIFI_ENT_KEY_NONE = 0,     /**< certificates */
+  ESP_WIFI_ENT_KEY_RSA,          /**< PKCS#1 */
+  ESP_WIFI_ENT_KEY_EC,           /**< SEC1 */
+  ESP_WIFI_ENT_KEY_PKCS8,        /**< PKCS#8, RSA or EC */
+  ESP_WIFI_ENT_KEY_PKCS8_ENC,    /**< encrypted PKCS#8 */
+  ESP_WIFI_ENT_KEY_PEM_ENC,      /**< PEM with Proc-Type, kept as PEM */
+} esp_wifi_ent_key_type_t;
+
+/** @brief Parsed certificates or key, as handed to the supplicant */
+
+typedef struct
+{
+  uint8_t *data;                 /**< DER, or NUL terminated PEM */
+  size_t len;                    /**< NUL included for PEM */
+  size_t der_len;                /**< DER size of all certificates or key */
+  bool pem;
+  uint8_t ncerts;
+  esp_wifi_ent_key_type_t key_type;
+  int64_t not_before;            /**< latest notBefore, seconds since 1970 */
+  int64_t not_after;             /**< earliest notAfter */
+  uint64_t hash;                 /**< of the input */
+  size_t in_len;                 /**< input length */
+} esp_wifi_ent_blob_t;
+
+/** @brief Store counters */
+
+typedef struct
+{
+  uint32_t parses;               /**< inputs decoded and checked */
+  uint32_t hits;                 /**< inputs matching the stored ones */
+  uint32_t invalidations;        /**< clear calls dropping a blob */
+  uint32_t in_bytes;             /**< input size of the stored blobs */
+  uint32_t kept_bytes;           /**< stored blobs and certificate
+                                      input copies */
+} esp_wifi_ent_cred_stats_t;
+
+/** @brief Benchmark outcome, per enable/connect cycle */
+
+typedef struct
+{
+  uint32_t cycles;
+  uint32_t reparse_pem_ns;       /**< PEM decoded and checked every cycle */
+  uint32_t reparse_der_ns;       /**< stored DER checked every cycle */
+  uint32_t store_ns;             /**< input compared with the copy, the
+                                      key with its digest */
+  uint32_t transient_bytes;      /**< decoded PEM, allocated by mbedtls on
+                                      every connect when given PEM */
+  uint32_t in_bytes;             /**< PEM kept by the application */
+  uint32_t kept_bytes;           /**< DER and certificate input kept by
+                                      the store */
+} esp_wifi_ent_cred_bench_t;
+
+/**
+  * @brief     Chain a 64-bit FNV-1a hash over data
+  */
+uint64_t esp_wifi_ent_cred_hash(uint64_t h, const void *data, size_t len);
+
+/**
+  * @brief     Compute the SHA-256 digest of data
+  */
+void esp_wifi_ent_cred_sha256(const void *data, size_t len,
+                              uint8_t digest[32]);
+
+/**
+  * @brief     Decode and check PEM or DER certificates
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: no certificate or malformed input
+  *    - ESP_ERR_INVALID_SIZE: more than ESP_WIFI_ENT_CRED_MAX_CERTS
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_ent_cred_parse_certs(const uint8_t *in, size_t len,
+                                        esp_wifi_ent_blob_t *out);
+
+/**
+  * @brief     Decode and check a client certificate and its private key
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: malformed input
+  *    - ESP_ERR_INVALID_STATE: key does not match the first certificate
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_ent_cred_parse_cert_key(const uint8_t *cert,
+                                           size_t cert_len,
+                                           const uint8_t *key,
+                                           size_t key_len,
+                                           esp_wifi_ent_blob_t *cert_out,
+                                           esp_wifi_ent_blob_t *key_out);
+
+/**
+  * @brief     Wipe and free the data of a blob
+  */
+void esp_wifi_ent_cred_blob_free(esp_wifi_ent_blob_t *blob);
+
+/**
+  * @brief     Set the CA certificates, see esp_wifi_sta_wpa2_ent_set_ca_cert
+  *
+  * The input is not referenced after the call.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - others: refer to esp_wifi_ent_cred_parse_certs and
+  *      esp_wifi_sta_wpa2_ent_set_ca_cert
+  */
+esp_err_t esp_wifi_ent_cred_set_ca_cert(const unsigned char *ca_cert,
+                                        int ca_cert_len);
+
+/**
+  * @brief     Set the client certificate and key, see
+  *            esp_wifi_sta_wpa2_ent_set_cert_key
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - others: refer to esp_wifi_ent_cred_parse_cert_key and
+  *      esp_wifi_sta_wpa2_ent_set_cert_key
+  */
+esp_err_t esp_wifi_ent_cred_set_cert_key(const unsigned char *client_cert,
+                                         int client_cert_len,
+                                         const unsigned char *private_key,
+                                         int private_key_len,
+                                         const unsigned char *private_key_passwd,
+                                         int private_key_passwd_len);
+
+/**
+  * @brief     Set the identity unless unchanged, see
+  *            esp_wifi_sta_wpa2_ent_set_identity
+  */
+esp_err_t esp_wifi_ent_cred_set_identity(const unsigned char *identity,
+                                         int len);
+
+/**
+  * @brief     Set the username unless unchanged, see
+  *            esp_wifi_sta_wpa2_ent_set_username
+  */
+esp_err_t esp_wifi_ent_cred_set_username(const unsigned char *username,
+                                         int len);
+
+/**
+  * @brief     Set the password unless unchanged, see
+  *            esp_wifi_sta_wpa2_ent_set_password
+  */
+esp_err_t esp_wifi_ent_cred_set_password(const unsigned char *password,
+                                         int len);
+
+/**
+  * @brief     Clear the CA certificates from the supplicant and the store
+  */
+void esp_wifi_ent_cred_clear_ca_cert(void);
+
+/**
+  * @brief     Clear the client certificate and key
+  */
+void esp_wifi_ent_cred_clear_cert_key(void);
+
+/**
+  * @brief     Clear the identity
+  */
+void esp_wifi_ent_cred_clear_identity(void);
+
+/**
+  * @brief     Clear the username
+  */
+void esp_wifi_ent_cred_clear_username(void);
+
+/**
+  * @brief     Clear the password
+  */
+void esp_wifi_ent_cred_clear_password(void);
+
+/**
+  * @brief     Get the store counters
+  */
+void esp_wifi_ent_cred_get_stats(esp_wifi_ent_cred_stats_t *stats);
+
+/**
+  * @brief     Time the decode and checks of this module on PEM and on
+  *            the stored DER, and the match of the store on a repeated
+  *            input
+  *
+  * Neither mbedtls nor the supplicant are measured: their parse on every
+  * connect stays whatever the store hands them, so the figures are the
+  * cost of the store, not a saving on the connect.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - others: refer to esp_wifi_ent_cred_parse_certs and
+  *      esp_wifi_ent_cred_parse_cert_key
+  */
+esp_err_t esp_wifi_ent_cred_bench(const uint8_t *ca, size_t ca_len,
+                                  const uint8_t *cert, size_t cert_len,
+                                  const uint8_t *key, size_t key_len,
+                                  uint32_t cycles,
+                                  esp_wifi_ent_cred_bench_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_ENT_CRED_H_ */
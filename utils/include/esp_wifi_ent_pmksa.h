@@ -0,0 +1,253 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_ENT_PMKSA_H_
+#define _ESP_WIFI_ENT_PMKSA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_event_base.h"
+#include "esp_wifi_types.h"
+#include "esp_private/wifi_os_adapter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* PMKSA aware reconnect for WPA2-Enterprise.
+ *
+ * After a full EAP exchange the supplicant caches the PMKSA of the AP,
+ * keyed by its BSSID, and a later association to the same BSSID skips
+ * EAP and only runs the 4-way handshake. The supplicant keeps no
+ * opportunistic key caching, so any other AP of the same ESS costs a
+ * full EAP again, 1 to 3 s with EAP-TLS, PEAP or TTLS against a remote
+ * RADIUS server. The station connects to the strongest AP, which moves
+ * between APs of similar signal from one reconnect to the next.
+ *
+ * The table mirrors the supplicant cache from the connect events: an
+ * enterprise association leaves a PMKSA for its BSSID until the
+ * lifetime runs out, an authentication failure or a stop of the station
+ * drops it. On reconnect, the strongest cached BSSID of the SSID is
+ * preferred over the strongest one while it is at most rssi_margin dB
+ * weaker and above rssi_min.
+ *
+ * A table is locked on its own, so that the event handler and readers
+ * on other tasks, such as the roaming engine on the timer task, may
+ * share it. Lookups leave the table as is, expired entries are dropped
+ * by the next esp_wifi_ent_pmksa_add or esp_wifi_ent_pmksa_purge.
+ */
+
+#define ESP_WIFI_ENT_PMKSA_MAX        32
+
+typedef struct
+{
+  uint8_t max_entries;           /**< up to ESP_WIFI_ENT_PMKSA_MAX, the
+                                      oldest entry is evicted past it */
+  uint32_t lifetime_s;           /**< PMK lifetime of the supplicant */
+  int8_t rssi_margin;            /**< dB a cached AP may be weaker */
+  int8_t rssi_min;               /**< cached AP never preferred below */
+} esp_wifi_ent_pmksa_config_t;
+
+/** @brief Table counters */
+
+typedef struct
+{
+  uint32_t added;                /**< BSSIDs given a PMKSA */
+  uint32_t refreshed;            /**< connects to a cached BSSID */
+  uint32_t expired;
+  uint32_t evicted;
+  uint32_t dropped;              /**< failures and flushes */
+  uint32_t picks_cached;         /**< selections of a cached BSSID */
+  uint32_t picks_strongest;      /**< selections of the strongest BSSID
+                                      without a usable PMKSA */
+  uint32_t picks_weaker;         /**< cached selections that were not
+                                      the strongest BSSID */
+} esp_wifi_ent_pmksa_stats_t;
+
+typedef struct esp_wifi_ent_pmksa esp_wifi_ent_pmksa_t;
+
+/**
+  * @brief     Fill a configuration with defaults: 16 entries, 43200 s
+  *            lifetime, 8 dB margin, -80 dBm minimum
+  */
+void esp_wifi_ent_pmksa_default(esp_wifi_ent_pmksa_config_t *cfg);
+
+/**
+  * @brief     Create a table locked with the mutex of g_wifi_osi_funcs
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: no entry or zero lifetime
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_ent_pmksa_create(const esp_wifi_ent_pmksa_config_t *cfg,
+                                    esp_wifi_ent_pmksa_t **tab);
+
+/**
+  * @brief     Create a table locked with the mutex of a given adapter,
+  *            esp_wifi_ent_pmksa_create without the default
+  *
+  * @param     osi  adapter, NULL for a table used by one task only
+  *
+  * @return    refer to esp_wifi_ent_pmksa_create
+  */
+esp_err_t esp_wifi_ent_pmksa_alloc(const wifi_osi_funcs_t *osi,
+                                   const esp_wifi_ent_pmksa_config_t *cfg,
+                                   esp_wifi_ent_pmksa_t **tab);
+
+/**
+  * @brief     Delete a table
+  */
+void esp_wifi_ent_pmksa_delete(esp_wifi_ent_pmksa_t *tab);
+
+/**
+  * @brief     Record a PMKSA for a BSSID of an SSID at time now_s
+  */
+void esp_wifi_ent_pmksa_add(esp_wifi_ent_pmksa_t *tab, const uint8_t *ssid,
+                            uint8_t ssid_len, const uint8_t bssid[6],
+                            int64_t now_s);
+
+/**
+  * @brief     Drop the PMKSA of a BSSID
+  */
+void esp_wifi_ent_pmksa_remove(esp_wifi_ent_pmksa_t *tab,
+                               const uint8_t bssid[6]);
+
+/**
+  * @brief     Drop all entries
+  */
+void esp_wifi_ent_pmksa_flush(esp_wifi_ent_pmksa_t *tab);
+
+/**
+  * @brief     Drop the entries expired at time now_s
+  */
+void esp_wifi_ent_pmksa_purge(esp_wifi_ent_pmksa_t *tab, int64_t now_s);
+
+/**
+  * @brief     Check whether a BSSID holds a live PMKSA at time now_s
+  */
+bool esp_wifi_ent_pmksa_cached(esp_wifi_ent_pmksa_t *tab,
+                               const uint8_t bssid[6], int64_t now_s);
+
+/**
+  * @brief     Select the AP to reconnect to among scan records
+  *
+  * Only records of the SSID are considered, expired entries are
+  * skipped.
+  *
+  * @return    index in aps, or -1 if no record matches the SSID
+  */
+int esp_wifi_ent_pmksa_select(esp_wifi_ent_pmksa_t *tab,
+                              const wifi_ap_record_t *aps, uint16_t n,
+                              const uint8_t *ssid, uint8_t ssid_len,
+                              int64_t now_s, bool *cached);
+
+/**
+  * @brief     Get the table counters
+  */
+void esp_wifi_ent_pmksa_get_stats(esp_wifi_ent_pmksa_t *tab,
+                                  esp_wifi_ent_pmksa_stats_t *stats);
+
+/**
+  * @brief     Event handler keeping the table in step with the supplicant
+  *
+  * Register with esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+  * esp_wifi_ent_pmksa_event_handler, tab).
+  */
+void esp_wifi_ent_pmksa_event_handler(void *arg, esp_event_base_t base,
+                                      int32_t id, void *data);
+
+/**
+  * @brief     Reconnect the station to the AP selected from scan records
+  *
+  * The SSID is the one of the station configuration. The selected BSSID
+  * and channel are set with bssid_set and stay until the next call; with
+  * no matching record bssid_set is cleared. Call it for instance on
+  * WIFI_EVENT_SCAN_DONE with esp_wifi_scan_get_ap_records.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - others: refer to esp_wifi_get_config, esp_wifi_set_config and
+  *      esp_wifi_connect
+  */
+esp_err_t esp_wifi_ent_pmksa_connect(esp_wifi_ent_pmksa_t *tab,
+                                     const wifi_ap_record_t *aps,
+                                     uint16_t n);
+
+/** @brief Simulator parameters */
+
+typedef struct
+{
+  uint8_t aps;                   /**< APs of the ESS in range */
+  int8_t rssi_spread;            /**< mean RSSI of the APs spread over
+                                      -50 dBm down by this */
+  int8_t rssi_jitter;            /**< scan to scan RSSI jitter, +/- dB */
+  uint32_t full_eap_min_ms;      /**< full EAP and 4-way handshake */
+  uint32_t full_eap_max_ms;
+  uint32_t cached_ms;            /**< association and 4-way handshake */
+  uint32_t reconnect_s;          /**< between two reconnects */
+  uint32_t duration_s;           /**< per run */
+  uint32_t runs;
+  uint32_t seed;
+} esp_wifi_ent_pmksa_sim_t;
+
+/** @brief Simulator outcome of one policy */
+
+typedef struct
+{
+  uint32_t reconnects;
+  uint32_t full_eaps;
+  uint32_t avg_ms;               /**< per reconnect */
+  uint32_t max_ms;
+  uint32_t rssi_loss_x10;        /**< average dB below the strongest AP,
+                                      times 10 */
+} esp_wifi_ent_pmksa_sim_stat_t;
+
+typedef struct
+{
+  esp_wifi_ent_pmksa_sim_stat_t strongest;
+  esp_wifi_ent_pmksa_sim_stat_t cached;
+} esp_wifi_ent_pmksa_sim_result_t;
+
+/**
+  * @brief     Fill simulator parameters with defaults: 4 APs within
+  *            10 dB, 6 dB jitter, 1 to 3 s full EAP, 60 ms cached,
+  *            reconnect every 10 minutes for a day
+  */
+void esp_wifi_ent_pmksa_sim_default(esp_wifi_ent_pmksa_sim_t *sim);
+
+/**
+  * @brief     Measure reconnect time with strongest-AP and PMKSA aware
+  *            selection
+  *
+  * The supplicant cache is modelled per BSSID with the lifetime of cfg
+  * and room for 32 entries, a full EAP is drawn uniformly between the
+  * minimum and maximum. Both policies see the same scans.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid parameters
+  *    - others: refer to esp_wifi_ent_pmksa_create
+  */
+esp_err_t esp_wifi_ent_pmksa_sim_run(const esp_wifi_ent_pmksa_config_t *cfg,
+                                     const esp_wifi_ent_pmksa_sim_t *sim,
+                                     esp_wifi_ent_pmksa_sim_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_ENT_PMKSA_H_ */
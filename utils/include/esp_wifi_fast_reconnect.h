@@ -0,0 +1,212 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_FAST_RECONNECT_H_
+#define _ESP_WIFI_FAST_RECONNECT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+#include "esp_event_base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_FAST_RECONNECT_NVS_NAMESPACE  "fast_reconn"
+#define ESP_FAST_RECONNECT_NVS_KEY        "ap"
+#define ESP_FAST_RECONNECT_MAGIC          0xfa57
+#define ESP_FAST_RECONNECT_VERSION        2
+
+/* Consecutive failed attempts with the cached AP before falling back */
+
+#define ESP_FAST_RECONNECT_MAX_RETRY      2
+
+/** @brief Last successful AP, as persisted in NVS */
+
+typedef struct
+{
+  uint16_t magic;          /**< ESP_FAST_RECONNECT_MAGIC when valid */
+  uint8_t  version;        /**< Layout version of this record */
+  uint8_t  ssid_len;       /**< Length of ssid */
+  uint8_t  ssid[32];       /**< SSID the record belongs to */
+  uint8_t  bssid[6];       /**< BSSID of the AP */
+  uint8_t  channel;        /**< Primary channel of the AP */
+  uint8_t  authmode;       /**< wifi_auth_mode_t of the AP */
+  uint8_t  pmk_valid;      /**< Whether pmk may be used for this authmode */
+  uint8_t  pmk[32];        /**< PBKDF2(passphrase, ssid) */
+} esp_fast_reconnect_record_t;
+
+/** @brief Counters of the fast reconnect path */
+
+typedef struct
+{
+  uint32_t fast_attempts;  /**< Connects started from the cached record */
+  uint32_t fast_success;   /**< Connects completed from the cached record */
+  uint32_t fallbacks;      /**< Connects that fell back to a full scan */
+} esp_fast_reconnect_stats_t;
+
+/**
+  * @brief     Load the cached AP record from NVS
+  *
+  * @attention NVS must be initialized before calling this API, and this
+  *            API before any other of the module.
+  *
+  * @return
+  *    - ESP_OK: succeed, a valid record is cached
+  *    - ESP_ERR_NOT_FOUND: no usable record stored
+  *    - ESP_ERR_NO_MEM: out of memory
+  *    - others: NVS or esp_timer error
+  */
+esp_err_t esp_fast_reconnect_init(void);
+
+/**
+  * @brief     Prefill a station configuration from the cached record
+  *
+  * The record is applied only if its SSID matches sta->ssid. bssid_set,
+  * bssid, channel and scan_method = WIFI_FAST_SCAN are set and, for
+  * WPA/WPA2-PSK, the passphrase is replaced by the 64 hex digit PMK so
+  * that the supplicant skips the 4096 round PBKDF2. The record keeps no
+  * digest of the passphrase: a PMK left from an older passphrase fails
+  * the handshake, and esp_fast_reconnect_connect then falls back to the
+  * passphrase.
+  *
+  * @param     sta  station configuration to patch in place
+  *
+  * @return
+  *    - ESP_OK: configuration was prefilled
+  *    - ESP_ERR_INVALID_ARG: sta is NULL
+  *    - ESP_ERR_INVALID_STATE: esp_fast_reconnect_init not called
+  *    - ESP_ERR_NOT_FOUND: no cached record for this SSID
+  */
+esp_err_t esp_fast_reconnect_prefill(wifi_sta_config_t *sta);
+
+/**
+  * @brief     Configure and start a station connection, using the cache
+  *
+  * Keeps a copy of sta so that a failed fast attempt can be retried with
+  * a full channel scan without any action from the caller. Requires
+  * esp_fast_reconnect_event_handler to be registered for WIFI_EVENT.
+  *
+  * @param     sta  station configuration as provided by the application
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: sta is NULL
+  *    - ESP_ERR_INVALID_STATE: esp_fast_reconnect_init not called
+  *    - others: refer to esp_wifi_set_config and esp_wifi_connect
+  */
+esp_err_t esp_fast_reconnect_connect(const wifi_sta_config_t *sta);
+
+/**
+  * @brief     WIFI_EVENT handler tracking the outcome of connections
+  *
+  * Register with esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+  * esp_fast_reconnect_event_handler, NULL). It persists the record on
+  * WIFI_EVENT_STA_CONNECTED and falls back to a full scan after
+  * ESP_FAST_RECONNECT_MAX_RETRY failed fast attempts. After a connection
+  * made with the passphrase, the PMK is derived on the esp_timer task,
+  * holding it for the 4096 rounds, and replaces a cached PMK it differs
+  * from; the record is persisted once it is done. A PMK the AP rejects
+  * is dropped from NVS as well.
+  */
+void esp_fast_reconnect_event_handler(void *arg, esp_event_base_t base,
+                                      int32_t id, void *data);
+
+/**
+  * @brief     Drop the cached record from RAM and NVS
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: esp_fast_reconnect_init not called
+  *    - others: NVS error
+  */
+esp_err_t esp_fast_reconnect_erase(void);
+
+/**
+  * @brief     Get the fast reconnect counters
+  *
+  * @param     stats  output counters
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: stats is NULL
+  *    - ESP_ERR_INVALID_STATE: esp_fast_reconnect_init not called
+  */
+esp_err_t esp_fast_reconnect_get_stats(esp_fast_reconnect_stats_t *stats);
+
+/** @brief Simulator parameters */
+
+typedef struct
+{
+  uint32_t boots;                /**< reconnects, the first without record */
+  uint8_t channels;              /**< visited by a full scan */
+  uint32_t dwell_ms;             /**< per channel scanned */
+  uint32_t pbkdf2_ms;            /**< 4096 round PMK derivation */
+  uint32_t connect_ms;           /**< auth, assoc and 4-way handshake */
+  uint16_t moved_permille;       /**< boots the AP left the cached BSSID
+                                      or channel */
+  uint16_t rekey_permille;       /**< boots the passphrase changed */
+  uint32_t seed;
+} esp_fast_reconnect_sim_t;
+
+/** @brief Simulator outcome of one policy */
+
+typedef struct
+{
+  uint32_t avg_ms;               /**< esp_wifi_connect to connected */
+  uint32_t min_ms;
+  uint32_t max_ms;
+} esp_fast_reconnect_sim_stat_t;
+
+typedef struct
+{
+  esp_fast_reconnect_sim_stat_t baseline;   /**< full scan and PBKDF2 on
+                                                 every boot */
+  esp_fast_reconnect_sim_stat_t cached;
+  uint32_t fast_success;         /**< boots connected from the record */
+  uint32_t fallbacks;            /**< boots that fell back to a full scan */
+  uint32_t pmk_hits;             /**< boots that skipped PBKDF2 */
+} esp_fast_reconnect_sim_result_t;
+
+/**
+  * @brief     Fill simulator parameters with defaults: 1000 boots, 13
+  *            channels of 120 ms, 400 ms PBKDF2, 60 ms connect, the AP
+  *            moved on 2% and the passphrase changed on 1% of the boots
+  */
+void esp_fast_reconnect_sim_default(esp_fast_reconnect_sim_t *sim);
+
+/**
+  * @brief     Measure time-to-connect with and without the cache
+  *
+  * The cached policy follows esp_fast_reconnect_connect: one channel is
+  * scanned per fast attempt, an AP that moved costs
+  * ESP_FAST_RECONNECT_MAX_RETRY of them before the full scan, and
+  * PBKDF2 is skipped with the PMK of the record. After a passphrase
+  * change that PMK fails the handshake and the full scan follows. The
+  * deferred derivation after the connection is not counted.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid parameters
+  */
+esp_err_t esp_fast_reconnect_sim_run(const esp_fast_reconnect_sim_t *sim,
+                                     esp_fast_reconnect_sim_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_FAST_RECONNECT_H_ */
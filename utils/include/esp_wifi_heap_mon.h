@@ -0,0 +1,174 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_HEAP_MON_H_
+#define _ESP_WIFI_HEAP_MON_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_event_base.h"
+#include "esp_private/wifi_os_adapter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Allocation callbacks of the OS adapter that are monitored. Blocks are
+ * tracked in a table on the side, keyed by address, so that their layout
+ * is left as the allocator made it.
+ */
+
+typedef enum
+{
+  ESP_WIFI_HEAP_MALLOC = 0,          /**< _malloc */
+  ESP_WIFI_HEAP_MALLOC_INTERNAL,     /**< _malloc_internal and _zalloc_internal */
+  ESP_WIFI_HEAP_CALLOC_INTERNAL,     /**< _calloc_internal */
+  ESP_WIFI_HEAP_REALLOC_INTERNAL,    /**< _realloc_internal */
+  ESP_WIFI_HEAP_WIFI_MALLOC,         /**< _wifi_malloc and _wifi_zalloc */
+  ESP_WIFI_HEAP_WIFI_CALLOC,         /**< _wifi_calloc */
+  ESP_WIFI_HEAP_WIFI_REALLOC,        /**< _wifi_realloc */
+  ESP_WIFI_HEAP_CB_MAX
+} esp_wifi_heap_cb_t;
+
+typedef enum
+{
+  ESP_WIFI_HEAP_PHASE_IDLE = 0,
+  ESP_WIFI_HEAP_PHASE_SCAN,
+  ESP_WIFI_HEAP_PHASE_CONNECT,
+  ESP_WIFI_HEAP_PHASE_CONNECTED,
+  ESP_WIFI_HEAP_PHASE_AP,
+  ESP_WIFI_HEAP_PHASE_MAX
+} esp_wifi_heap_phase_t;
+
+/** @brief Monitor settings */
+
+typedef struct
+{
+  uint32_t table_size;               /**< blocks tracked, a power of two */
+  uint32_t sample_period_ms;         /**< heap sampling period, 0 for none */
+
+  /* Largest free block of the heap the adapter allocates from, as
+   * provided by the platform, e.g. mallinfo().mxordblk. Optional.
+   */
+
+  uint32_t (*largest_free_block)(void);
+} esp_wifi_heap_mon_config_t;
+
+/** @brief Counters of one allocation callback */
+
+typedef struct
+{
+  uint32_t live_bytes;
+  uint32_t live_count;
+  uint32_t peak_bytes;               /**< high-water mark of live_bytes */
+  uint32_t allocs;
+  uint32_t fails;
+} esp_wifi_heap_cb_stats_t;
+
+/** @brief High-water marks of one phase */
+
+typedef struct
+{
+  uint32_t peak_bytes;               /**< most bytes live, all callbacks */
+  uint32_t min_free;                 /**< least free heap sampled */
+  uint32_t min_largest;              /**< smallest largest free block */
+  uint32_t max_frag_permille;        /**< worst fragmentation index */
+  uint32_t entries;                  /**< times the phase was entered */
+} esp_wifi_heap_phase_stats_t;
+
+/** @brief Monitor snapshot */
+
+typedef struct
+{
+  esp_wifi_heap_cb_stats_t cb[ESP_WIFI_HEAP_CB_MAX];
+  esp_wifi_heap_phase_stats_t phase[ESP_WIFI_HEAP_PHASE_MAX];
+  esp_wifi_heap_phase_t cur_phase;
+  uint32_t live_bytes;               /**< all callbacks */
+  uint32_t peak_bytes;
+  uint32_t free_heap;                /**< at the time of the snapshot */
+  uint32_t largest_free;             /**< 0 when not provided */
+
+  /* 1000 * (1 - largest_free / free_heap), 0 when not provided */
+
+  uint32_t frag_permille;
+  uint32_t untracked;                /**< blocks missed, table full */
+} esp_wifi_heap_snapshot_t;
+
+/**
+  * @brief     Fill a configuration with defaults: 1024 blocks, sampling
+  *            every second
+  */
+void esp_wifi_heap_mon_default(esp_wifi_heap_mon_config_t *cfg);
+
+/**
+  * @brief     Wrap the allocation callbacks of an adapter
+  *
+  * Must be called before esp_wifi_init, blocks allocated before are not
+  * accounted when freed.
+  *
+  * @param     osi  adapter to hook, NULL for g_wifi_osi_funcs
+  * @param     cfg  settings, copied
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid settings
+  *    - ESP_ERR_INVALID_STATE: already installed
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_heap_mon_install(wifi_osi_funcs_t *osi,
+                                    const esp_wifi_heap_mon_config_t *cfg);
+
+/**
+  * @brief     Enter a phase, high-water marks are then kept for it
+  */
+void esp_wifi_heap_mon_set_phase(esp_wifi_heap_phase_t phase);
+
+/**
+  * @brief     Sample free heap and largest free block into the current
+  *            phase, also done periodically when configured
+  */
+void esp_wifi_heap_mon_sample(void);
+
+/**
+  * @brief     WIFI_EVENT handler following the phases: scan done,
+  *            station connected or disconnected, softAP started or stopped
+  *
+  * Register with esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+  * ...). Scans are not reported by an event when they start, call
+  * esp_wifi_heap_mon_set_phase before esp_wifi_scan_start.
+  */
+void esp_wifi_heap_mon_event_handler(void *arg, esp_event_base_t base,
+                                     int32_t id, void *data);
+
+/**
+  * @brief     Take a snapshot of the monitor
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: not installed
+  */
+esp_err_t esp_wifi_heap_mon_snapshot(esp_wifi_heap_snapshot_t *snap);
+
+/**
+  * @brief     Restart the high-water marks from the current values
+  */
+void esp_wifi_heap_mon_reset_peaks(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_HEAP_MON_H_ */
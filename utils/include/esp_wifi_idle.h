@@ -0,0 +1,190 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_IDLE_H_
+#define _ESP_WIFI_IDLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_event_base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* SoftAP client inactivity tracker.
+ *
+ * Clients are keyed by AID and filed on a hashed timing wheel of
+ * ESP_WIFI_IDLE_SLOTS slots of tick_ms, by the tick their timeout ends
+ * at. A touch only stores the time of the activity. The sweep walks the
+ * slots of the ticks gone by, expires the clients idle past their
+ * timeout and files the others again by their latest activity, so that
+ * the wheel follows the traffic in batches rather than on every packet.
+ *
+ * The tracker is not locked. A touch stores one aligned word and may
+ * race with a sweep, which then sees the activity or the one before.
+ * Other calls must be serialized by the caller.
+ */
+
+#define ESP_WIFI_IDLE_SLOTS           64
+#define ESP_WIFI_IDLE_AID_MAX         255
+
+typedef struct
+{
+  uint32_t tick_ms;              /**< wheel granularity */
+  uint32_t timeout_s;            /**< of a client added with 0 */
+} esp_wifi_idle_config_t;
+
+typedef struct esp_wifi_idle esp_wifi_idle_t;
+
+/**
+  * @brief     Client expired, called after its deauthentication
+  */
+typedef void (*esp_wifi_idle_cb_t)(void *arg, uint16_t aid);
+
+/**
+  * @brief     Fill a configuration with defaults: ticks of 1 second and
+  *            a 300 second timeout, as esp_wifi_set_inactive_time
+  */
+void esp_wifi_idle_default(esp_wifi_idle_config_t *cfg);
+
+/**
+  * @brief     Create an empty tracker, its wheel at now_ms
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: tick_ms or timeout_s 0
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_idle_create(const esp_wifi_idle_config_t *cfg,
+                               uint32_t now_ms, esp_wifi_idle_t **idle);
+
+/**
+  * @brief     Delete a tracker
+  */
+void esp_wifi_idle_delete(esp_wifi_idle_t *idle);
+
+/**
+  * @brief     Track a client, active at now_ms, or give a tracked one a
+  *            new timeout
+  *
+  * @param     timeout_s  0 for the default
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: AID 0 or above ESP_WIFI_IDLE_AID_MAX
+  */
+esp_err_t esp_wifi_idle_add(esp_wifi_idle_t *idle, uint16_t aid,
+                            uint32_t timeout_s, uint32_t now_ms);
+
+/**
+  * @brief     Stop tracking a client
+  */
+void esp_wifi_idle_remove(esp_wifi_idle_t *idle, uint16_t aid);
+
+/**
+  * @brief     Note activity of a client, ignored when not tracked
+  */
+void esp_wifi_idle_touch(esp_wifi_idle_t *idle, uint16_t aid,
+                         uint32_t now_ms);
+
+/**
+  * @brief     Expire the clients idle past their timeout at now_ms
+  *
+  * Clients expired are no longer tracked. When more than max expire,
+  * the others are returned by the next sweep.
+  *
+  * @param     aids  filled with the AIDs expired
+  *
+  * @return    clients expired
+  */
+size_t esp_wifi_idle_sweep(esp_wifi_idle_t *idle, uint32_t now_ms,
+                           uint16_t *aids, size_t max);
+
+/**
+  * @brief     Number of clients tracked
+  */
+uint16_t esp_wifi_idle_count(const esp_wifi_idle_t *idle);
+
+/**
+  * @brief     Wheel granularity, the period to sweep at
+  */
+uint32_t esp_wifi_idle_tick_ms(const esp_wifi_idle_t *idle);
+
+/**
+  * @brief     Sweep a tracker every tick, deauthenticating the clients
+  *            expired with esp_wifi_deauth_sta
+  *
+  * Clients are added and removed on WIFI_EVENT_AP_STACONNECTED and
+  * WIFI_EVENT_AP_STADISCONNECTED. The application touches them from its
+  * receive and send paths. The inactive time of the driver keeps
+  * running, set it with esp_wifi_set_inactive_time above the longest
+  * timeout.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: idle is NULL
+  *    - ESP_ERR_INVALID_STATE: a tracker is swept already
+  *    - ESP_ERR_NO_MEM: out of memory
+  *    - others: refer to esp_event_handler_register and esp_timer
+  */
+esp_err_t esp_wifi_idle_start(esp_wifi_idle_t *idle, esp_wifi_idle_cb_t cb,
+                              void *arg);
+
+/**
+  * @brief     Stop sweeping
+  */
+void esp_wifi_idle_stop(void);
+
+/**
+  * @brief     Touch a client of the tracker swept, at the current time
+  */
+void esp_wifi_idle_touch_now(uint16_t aid);
+
+/** @brief Benchmark outcome */
+
+typedef struct
+{
+  uint32_t stations;
+  uint32_t touches;
+  uint32_t wheel_ns;             /**< per touch, sweeps included */
+  uint32_t touch_ns;             /**< per touch, without sweeping */
+  uint32_t restart_ns;           /**< per touch, a timer restarted */
+  uint32_t expired;              /**< by the tracker */
+  uint32_t timer_expired;        /**< by the timers */
+} esp_wifi_idle_bench_t;
+
+/**
+  * @brief     Run stations with timeouts of 60 to 300 seconds for
+  *            seconds of constant traffic, one in eight falling silent
+  *            halfway, against one timer per station restarted on every
+  *            packet as with esp_timer, a list sorted by deadline
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: stations 0 or above ESP_WIFI_IDLE_AID_MAX,
+  *      no touch
+  *    - others: refer to esp_wifi_idle_create
+  */
+esp_err_t esp_wifi_idle_bench(uint16_t stations, uint32_t seconds,
+                              uint32_t touches_per_s, uint32_t seed,
+                              esp_wifi_idle_bench_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_IDLE_H_ */
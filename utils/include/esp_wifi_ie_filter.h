@@ -0,0 +1,192 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_IE_FILTER_H_
+#define _ESP_WIFI_IE_FILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Vendor IE filter, in front of the esp_wifi_set_vendor_ie_cb callback.
+ *
+ * An IE is let through when its OUI and OUI type are allowed, all of
+ * them with an empty allowlist, and it is new or changed: the CRC-32 of
+ * its length and payload is kept per (SA, OUI, OUI type) in a cache of
+ * ESP_WIFI_IE_FILTER_SETS sets of ESP_WIFI_IE_FILTER_WAYS entries. The
+ * entry used the longest time ago gives its way to a new one, which is
+ * then let through once more should it come back. With refresh_ms, an
+ * unchanged IE is let through again once that long after the last time,
+ * for its RSSI.
+ */
+
+#define ESP_WIFI_IE_FILTER_WAYS       4
+#define ESP_WIFI_IE_FILTER_SETS       64
+#define ESP_WIFI_IE_FILTER_OUIS       8
+#define ESP_WIFI_IE_FILTER_ANY_TYPE   0x100  /**< every OUI type */
+
+typedef enum
+{
+  ESP_WIFI_IE_FILTER_NEW = 0,
+  ESP_WIFI_IE_FILTER_CHANGED,
+  ESP_WIFI_IE_FILTER_REFRESH,
+  ESP_WIFI_IE_FILTER_UNCHANGED,  /**< this and below are not let through */
+  ESP_WIFI_IE_FILTER_NOT_ALLOWED,
+} esp_wifi_ie_filter_verdict_t;
+
+typedef struct
+{
+  uint32_t refresh_ms;           /**< 0 never */
+} esp_wifi_ie_filter_config_t;
+
+/** @brief Counters */
+
+typedef struct
+{
+  uint32_t ies;
+  uint32_t passed;               /**< new, changed or refreshed */
+  uint32_t changed;
+  uint32_t unchanged;
+  uint32_t not_allowed;
+  uint32_t evictions;
+} esp_wifi_ie_filter_stats_t;
+
+typedef struct esp_wifi_ie_filter esp_wifi_ie_filter_t;
+
+/**
+  * @brief     Fill a configuration with defaults: no refresh
+  */
+void esp_wifi_ie_filter_default(esp_wifi_ie_filter_config_t *cfg);
+
+/**
+  * @brief     Create a filter allowing every OUI
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: cfg or filter is NULL
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_ie_filter_create(const esp_wifi_ie_filter_config_t *cfg,
+                                    esp_wifi_ie_filter_t **filter);
+
+/**
+  * @brief     Delete a filter
+  */
+void esp_wifi_ie_filter_delete(esp_wifi_ie_filter_t *filter);
+
+/**
+  * @brief     Allow an OUI, with one OUI type or ESP_WIFI_IE_FILTER_ANY_TYPE
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: type above ESP_WIFI_IE_FILTER_ANY_TYPE
+  *    - ESP_ERR_NO_MEM: ESP_WIFI_IE_FILTER_OUIS allowed already
+  */
+esp_err_t esp_wifi_ie_filter_allow(esp_wifi_ie_filter_t *filter,
+                                   const uint8_t oui[3], uint16_t type);
+
+/**
+  * @brief     Empty the allowlist and the cache
+  */
+void esp_wifi_ie_filter_reset(esp_wifi_ie_filter_t *filter);
+
+/**
+  * @brief     Check an IE received from sa
+  *
+  * @return    the verdict, below ESP_WIFI_IE_FILTER_UNCHANGED to let the
+  *            IE through
+  */
+esp_wifi_ie_filter_verdict_t
+esp_wifi_ie_filter_check(esp_wifi_ie_filter_t *filter, const uint8_t sa[6],
+                         const vendor_ie_data_t *ie, uint32_t now_ms);
+
+/**
+  * @brief     Get the counters
+  */
+void esp_wifi_ie_filter_get_stats(const esp_wifi_ie_filter_t *filter,
+                                  esp_wifi_ie_filter_stats_t *stats);
+
+/**
+  * @brief     CRC-32 (IEEE 802.3) of data, from crc 0
+  */
+uint32_t esp_wifi_ie_filter_crc32(uint32_t crc, const uint8_t *data,
+                                  size_t len);
+
+/**
+  * @brief     IE let through, with the arguments of esp_vendor_ie_cb_t
+  */
+typedef void (*esp_wifi_ie_filter_cb_t)(void *ctx,
+                                        wifi_vendor_ie_type_t type,
+                                        const uint8_t sa[6],
+                                        const vendor_ie_data_t *vnd_ie,
+                                        int rssi);
+
+/**
+  * @brief     Put a filter in front of cb, registered with
+  *            esp_wifi_set_vendor_ie_cb
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: filter or cb is NULL
+  *    - ESP_ERR_NO_MEM: out of memory
+  *    - others: refer to esp_wifi_set_vendor_ie_cb
+  */
+esp_err_t esp_wifi_ie_filter_start(esp_wifi_ie_filter_t *filter,
+                                   esp_wifi_ie_filter_cb_t cb, void *ctx);
+
+/**
+  * @brief     Unregister the vendor IE callback
+  */
+void esp_wifi_ie_filter_stop(void);
+
+/** @brief Benchmark outcome */
+
+typedef struct
+{
+  uint32_t ies;
+  uint32_t passed;
+  uint32_t unchanged;
+  uint32_t not_allowed;
+  uint32_t direct_ns;            /**< per IE, every IE to the callback */
+  uint32_t filtered_ns;          /**< per IE, the filter in front */
+} esp_wifi_ie_filter_bench_t;
+
+/**
+  * @brief     Replay seconds of beacons of aps access points, every
+  *            102.4 ms, each with a WMM IE, a WPS IE and an Espressif IE
+  *            whose counter changes every second beacon on one AP in
+  *            four, every twentieth beacon on the others
+  *
+  * The allowlist holds WPS and the Espressif OUI. The callback copies
+  * the IE into a table per AP.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: no AP or no second, or above 255 APs
+  *    - others: refer to esp_wifi_ie_filter_create
+  */
+esp_err_t esp_wifi_ie_filter_bench(uint32_t aps, uint32_t seconds,
+                                   esp_wifi_ie_filter_bench_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_IE_FILTER_H_ */
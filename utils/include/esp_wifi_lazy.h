@@ -0,0 +1,180 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_LAZY_H_
+#define _ESP_WIFI_LAZY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "esp_smartconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default time a released subsystem stays up before the sweep tears it
+ * down, see esp_wifi_lazy_init
+ */
+
+#define ESP_WIFI_LAZY_IDLE_TIMEOUT_MS  30000
+
+typedef enum
+{
+  ESP_WIFI_LAZY_SUPPLICANT = 0,  /**< esp_supplicant_init/deinit */
+  ESP_WIFI_LAZY_WPA2_ENT,        /**< esp_wifi_sta_wpa2_ent_enable/disable */
+  ESP_WIFI_LAZY_WAPI,            /**< esp_wifi_internal_wapi_init/deinit */
+  ESP_WIFI_LAZY_SMARTCONFIG,     /**< esp_smartconfig_start/stop */
+  ESP_WIFI_LAZY_MESH,            /**< registered by the application */
+  ESP_WIFI_LAZY_MAX
+} esp_wifi_lazy_subsys_t;
+
+/** @brief Bring-up and tear-down of one optional subsystem */
+
+typedef struct
+{
+  esp_err_t (*init)(void *arg);    /**< allocate the subsystem */
+  esp_err_t (*deinit)(void *arg);  /**< release the subsystem */
+  void *arg;                       /**< passed to init and deinit */
+  uint32_t idle_timeout_ms;        /**< 0 tears down on last release */
+} esp_wifi_lazy_ops_t;
+
+/** @brief State and memory accounting of one subsystem */
+
+typedef struct
+{
+  bool     registered;    /**< ops were provided */
+  bool     active;        /**< subsystem is currently initialized */
+  uint32_t refcnt;        /**< outstanding esp_wifi_lazy_acquire calls */
+  uint32_t footprint;     /**< heap taken by the last init, in bytes */
+  uint32_t saved;         /**< footprint while not active, 0 otherwise */
+  uint32_t init_count;    /**< times the subsystem was brought up */
+  uint32_t deinit_count;  /**< times the subsystem was torn down */
+} esp_wifi_lazy_stats_t;
+
+/**
+  * @brief     Initialize the lazy initialization framework
+  *
+  * Registers the supplicant, WPA2-enterprise and WAPI subsystems and
+  * starts the idle sweep. Call it instead of esp_supplicant_init and
+  * leave the optional subsystems out of the boot sequence.
+  *
+  * These subsystems are registered with ESP_WIFI_LAZY_IDLE_TIMEOUT_MS.
+  * The framework itself holds a reference on ESP_WIFI_LAZY_SUPPLICANT
+  * from WIFI_EVENT_STA_START or WIFI_EVENT_AP_START to the matching stop
+  * event, so that the sweep leaves the supplicant of a running station
+  * or softAP alone. A softAP sets up WPA as it starts: acquire the
+  * supplicant before esp_wifi_start, it may be released once started.
+  *
+  * @param     sweep_period_ms  period of the idle sweep, 0 disables it
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_NO_MEM: out of memory
+  *    - others: refer to esp_event_handler_register and esp_timer_create
+  */
+esp_err_t esp_wifi_lazy_init(uint32_t sweep_period_ms);
+
+/**
+  * @brief     Tear down every active subsystem and the framework itself
+  */
+void esp_wifi_lazy_deinit(void);
+
+/**
+  * @brief     Register or replace the ops of a subsystem
+  *
+  * @attention The subsystem must not be active.
+  *
+  * @param     id   subsystem
+  * @param     ops  bring-up and tear-down callbacks, copied
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid id or ops
+  *    - ESP_ERR_INVALID_STATE: subsystem is active
+  */
+esp_err_t esp_wifi_lazy_register(esp_wifi_lazy_subsys_t id,
+                                 const esp_wifi_lazy_ops_t *ops);
+
+/**
+  * @brief     Register esp_smartconfig_start/stop as ESP_WIFI_LAZY_SMARTCONFIG
+  *
+  * @param     config  smartconfig configuration, must outlive the framework
+  *
+  * @return    refer to esp_wifi_lazy_register
+  */
+esp_err_t esp_wifi_lazy_register_smartconfig(
+                const smartconfig_start_config_t *config);
+
+/**
+  * @brief     Take a reference on a subsystem, initializing it on first use
+  *
+  * @param     id  subsystem
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid id
+  *    - ESP_ERR_NOT_SUPPORTED: subsystem is not registered
+  *    - others: error of the subsystem init
+  */
+esp_err_t esp_wifi_lazy_acquire(esp_wifi_lazy_subsys_t id);
+
+/**
+  * @brief     Drop a reference on a subsystem
+  *
+  * The subsystem is torn down by the idle sweep once it has been
+  * unreferenced for idle_timeout_ms.
+  *
+  * @param     id  subsystem
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid id
+  *    - ESP_ERR_INVALID_STATE: subsystem is not referenced
+  */
+esp_err_t esp_wifi_lazy_release(esp_wifi_lazy_subsys_t id);
+
+/**
+  * @brief     Tear down every unreferenced subsystem past its idle timeout
+  */
+void esp_wifi_lazy_sweep(void);
+
+/**
+  * @brief     Get the state and memory accounting of a subsystem
+  *
+  * The footprint is the free heap delta across init, so it also counts
+  * allocations made concurrently by other tasks.
+  *
+  * @param     id     subsystem
+  * @param     stats  output statistics
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid id or stats
+  */
+esp_err_t esp_wifi_lazy_get_stats(esp_wifi_lazy_subsys_t id,
+                                  esp_wifi_lazy_stats_t *stats);
+
+/**
+  * @brief     Get the heap currently saved by all inactive subsystems
+  *
+  * @return    saved heap in bytes
+  */
+uint32_t esp_wifi_lazy_get_saved(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_LAZY_H_ */
@@ -0,0 +1,165 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_LOG_FILTER_H_
+#define _ESP_WIFI_LOG_FILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_private/wifi.h"
+#include "esp_private/wifi_os_adapter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Filter in front of the _log_write and _log_writev callbacks of the OS
+ * adapter. A message is dropped, before its arguments are looked at,
+ * when its level is above the level of its tag, or when the rate limit
+ * budget is spent. Module and submodule selection is done at the source
+ * by esp_wifi_internal_set_log_mod.
+ */
+
+#define ESP_WIFI_LOG_FILTER_MAX_TAGS  8
+
+/** @brief Filter settings */
+
+typedef struct
+{
+  wifi_log_level_t level;       /**< most verbose level passed by default */
+  wifi_log_level_t rate_level;  /**< levels from this one are rate limited */
+  uint32_t rate_per_sec;        /**< messages per second, 0 for no limit */
+  uint32_t burst;               /**< messages passed back to back */
+} esp_wifi_log_filter_config_t;
+
+/** @brief Filter counters, updated without locking */
+
+typedef struct
+{
+  uint32_t passed;
+  uint32_t dropped_level;       /**< above the default level */
+  uint32_t dropped_tag;         /**< above the level of their tag */
+  uint32_t dropped_rate;        /**< over the rate limit */
+} esp_wifi_log_filter_stats_t;
+
+/**
+  * @brief     Fill a configuration with defaults: info level, debug and
+  *            verbose messages limited to 20 per second
+  */
+void esp_wifi_log_filter_default(esp_wifi_log_filter_config_t *cfg);
+
+/**
+  * @brief     Put the filter in front of the log callbacks of an adapter
+  *
+  * Install it before other hooks of the same callbacks, such as
+  * esp_wifi_statis_install, so that they are not filtered.
+  *
+  * @param     osi  adapter to hook, NULL for g_wifi_osi_funcs
+  * @param     cfg  settings, copied
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid settings
+  *    - ESP_ERR_INVALID_STATE: already installed
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_log_filter_install(wifi_osi_funcs_t *osi,
+                                      const esp_wifi_log_filter_config_t *cfg);
+
+/**
+  * @brief     Put the filter in front of the log callbacks of a given
+  *            adapter, esp_wifi_log_filter_install without the default
+  *
+  * @return    refer to esp_wifi_log_filter_install, ESP_ERR_INVALID_ARG
+  *            as well when osi is NULL
+  */
+esp_err_t esp_wifi_log_filter_hook(wifi_osi_funcs_t *osi,
+                                   const esp_wifi_log_filter_config_t *cfg);
+
+/**
+  * @brief     Set the most verbose level passed for one tag
+  *
+  * @param     tag    log tag, compared by hash
+  * @param     level  level of the tag
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: tag is NULL
+  *    - ESP_ERR_NO_MEM: ESP_WIFI_LOG_FILTER_MAX_TAGS tags already set
+  */
+esp_err_t esp_wifi_log_filter_set_tag(const char *tag,
+                                      wifi_log_level_t level);
+
+/**
+  * @brief     Get the most verbose level the filter passes, of the default
+  *            and the tags
+  */
+wifi_log_level_t esp_wifi_log_filter_get_level(void);
+
+/**
+  * @brief     Set the level of the libraries to the most verbose level
+  *            the filter passes, so that they do not log what would be
+  *            dropped
+  *
+  * @return    refer to esp_wifi_internal_set_log_level
+  */
+esp_err_t esp_wifi_log_filter_sync(void);
+
+/**
+  * @brief     Get the filter counters
+  */
+void esp_wifi_log_filter_get_stats(esp_wifi_log_filter_stats_t *stats);
+
+/**
+  * @brief     Clear the filter counters
+  */
+void esp_wifi_log_filter_reset_stats(void);
+
+/** @brief Benchmark outcome */
+
+typedef struct
+{
+  uint32_t messages;
+  uint32_t passed;              /**< formatted by the sink when filtered */
+  uint32_t unfiltered_ns;       /**< per message, every one formatted */
+  uint32_t filtered_ns;         /**< per message, through the filter */
+  esp_wifi_log_filter_stats_t stats;
+} esp_wifi_log_filter_bench_t;
+
+/**
+  * @brief     Time the log callbacks of a host adapter with debug logging
+  *            compiled in, with and without the filter in front
+  *
+  * The messages, per_sec of them, are split over six library tags: 5%
+  * warning, 15% info, 50% debug and 30% verbose. The filter runs the
+  * default settings with the "pp" tag raised to debug. The sink formats
+  * every message it gets with vsnprintf, its output is not timed. The
+  * filter stays hooked to the host adapter, so this runs once, in place
+  * of esp_wifi_log_filter_install.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid parameters
+  *    - others: refer to esp_wifi_log_filter_hook
+  */
+esp_err_t esp_wifi_log_filter_bench(uint32_t messages, uint32_t per_sec,
+                                    esp_wifi_log_filter_bench_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_LOG_FILTER_H_ */
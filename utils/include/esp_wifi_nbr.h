@@ -0,0 +1,360 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_NBR_H_
+#define _ESP_WIFI_NBR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_event_base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 802.11k neighbor reports and 802.11v BSS transition management for
+ * the station.
+ *
+ * The supplicant linked here is built without RRM and WNM, so the
+ * frames are built and parsed in this module. Neighbor Report Requests
+ * go out with esp_wifi_action_tx_req after every connect. Reports and
+ * BTM Requests come in through the promiscuous management filter, which
+ * only sees them in clear: with PMF the AP sends them protected and they
+ * are ignored. rm_enabled and btm_enabled are set in the station
+ * configuration so that the AP sees the capabilities.
+ *
+ * Reported neighbors and BTM candidates are cached and handed to the
+ * roaming engine, whose scans then go to their channels before any AP
+ * was heard there. A BTM Request with a candidate is accepted and the
+ * station moves to the most preferred candidate by BSSID and channel,
+ * without any scan.
+ */
+
+#define ESP_WIFI_NBR_MAX              16
+
+/* BTM Request mode bits */
+
+#define ESP_WIFI_BTM_PREF_CAND_LIST   (1 << 0)
+#define ESP_WIFI_BTM_ABRIDGED         (1 << 1)
+#define ESP_WIFI_BTM_DISASSOC_IMMINENT (1 << 2)
+#define ESP_WIFI_BTM_BSS_TERM_INCL    (1 << 3)
+#define ESP_WIFI_BTM_ESS_DISASSOC     (1 << 4)
+
+/* BTM Response status codes */
+
+#define ESP_WIFI_BTM_ACCEPT           0
+#define ESP_WIFI_BTM_REJECT           1
+#define ESP_WIFI_BTM_REJECT_NO_CAND   7
+
+/** @brief One neighbor report element */
+
+typedef struct
+{
+  uint8_t bssid[6];
+  uint32_t bssid_info;
+  uint8_t op_class;
+  uint8_t channel;
+  uint8_t phy_type;
+  uint8_t preference;            /**< BTM candidate preference, 0 if none */
+} esp_wifi_nbr_t;
+
+/** @brief A parsed BTM Request */
+
+typedef struct
+{
+  uint8_t token;
+  uint8_t mode;                  /**< ESP_WIFI_BTM_* bits */
+  uint16_t disassoc_timer;       /**< beacon intervals */
+  uint8_t validity;              /**< beacon intervals */
+  uint8_t ncands;
+  esp_wifi_nbr_t cands[ESP_WIFI_NBR_MAX];
+} esp_wifi_btm_req_t;
+
+typedef struct
+{
+  uint32_t lifetime_ms;          /**< of a cached neighbor */
+  uint32_t request_wait_ms;      /**< on channel wait for the report */
+  bool roam;                     /**< feed the engine running under
+                                      esp_wifi_roam_start */
+} esp_wifi_nbr_config_t;
+
+/** @brief Counters */
+
+typedef struct
+{
+  uint32_t requests;
+  uint32_t reports;
+  uint32_t neighbors;            /**< elements received in reports */
+  uint32_t btm_requests;
+  uint32_t btm_accepted;
+  uint32_t btm_rejected;
+  uint32_t malformed;
+} esp_wifi_nbr_stats_t;
+
+typedef struct esp_wifi_nbr_cache esp_wifi_nbr_cache_t;
+
+/**
+  * @brief     Build the action body of a Neighbor Report Request
+  *
+  * @param     ssid optional SSID element, NULL for the current ESS
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_SIZE: buffer too small
+  */
+esp_err_t esp_wifi_nbr_build_request(uint8_t token, const uint8_t *ssid,
+                                     uint8_t ssid_len, uint8_t *buf,
+                                     size_t size, size_t *len);
+
+/**
+  * @brief     Build the action body of a Neighbor Report Response
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_SIZE: buffer too small
+  */
+esp_err_t esp_wifi_nbr_build_report(uint8_t token,
+                                    const esp_wifi_nbr_t *nbrs, uint8_t n,
+                                    uint8_t *buf, size_t size, size_t *len);
+
+/**
+  * @brief     Parse the action body of a Neighbor Report Response
+  *
+  * @param     n in: room in nbrs, out: elements parsed
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: not a report or malformed
+  */
+esp_err_t esp_wifi_nbr_parse_report(const uint8_t *body, size_t len,
+                                    uint8_t *token, esp_wifi_nbr_t *nbrs,
+                                    uint8_t *n);
+
+/**
+  * @brief     Build the action body of a BTM Request
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_SIZE: buffer too small
+  */
+esp_err_t esp_wifi_btm_build_request(const esp_wifi_btm_req_t *req,
+                                     uint8_t *buf, size_t size,
+                                     size_t *len);
+
+/**
+  * @brief     Parse the action body of a BTM Request
+  *
+  * Candidates beyond ESP_WIFI_NBR_MAX are dropped.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: not a BTM Request or malformed
+  */
+esp_err_t esp_wifi_btm_parse_request(const uint8_t *body, size_t len,
+                                     esp_wifi_btm_req_t *req);
+
+/**
+  * @brief     Build the action body of a BTM Response
+  *
+  * @param     target BSSID moved to, only with ESP_WIFI_BTM_ACCEPT
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_SIZE: buffer too small
+  */
+esp_err_t esp_wifi_btm_build_response(uint8_t token, uint8_t status,
+                                      const uint8_t *target, uint8_t *buf,
+                                      size_t size, size_t *len);
+
+/**
+  * @brief     Pick the most preferred candidate of a BTM Request
+  *
+  * Candidates with preference 0 and the current AP are excluded.
+  *
+  * @return    index in req->cands, or -1
+  */
+int esp_wifi_btm_select(const esp_wifi_btm_req_t *req,
+                        const uint8_t *current);
+
+/**
+  * @brief     Create a neighbor cache
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_nbr_cache_create(uint32_t lifetime_ms,
+                                    esp_wifi_nbr_cache_t **cache);
+
+/**
+  * @brief     Delete a neighbor cache
+  */
+void esp_wifi_nbr_cache_delete(esp_wifi_nbr_cache_t *cache);
+
+/**
+  * @brief     Add or refresh neighbors at time now_ms, the oldest are
+  *            evicted past ESP_WIFI_NBR_MAX
+  */
+void esp_wifi_nbr_cache_add(esp_wifi_nbr_cache_t *cache,
+                            const esp_wifi_nbr_t *nbrs, uint8_t n,
+                            int64_t now_ms);
+
+/**
+  * @brief     Drop all neighbors, on a change of ESS
+  */
+void esp_wifi_nbr_cache_flush(esp_wifi_nbr_cache_t *cache);
+
+/**
+  * @brief     Channels of the live neighbors
+  *
+  * @return    bit n set for channel n
+  */
+uint16_t esp_wifi_nbr_cache_channels(esp_wifi_nbr_cache_t *cache,
+                                     int64_t now_ms);
+
+/**
+  * @brief     Get the live neighbors
+  *
+  * @param     n in: room in nbrs, out: neighbors written
+  */
+void esp_wifi_nbr_cache_get(esp_wifi_nbr_cache_t *cache, int64_t now_ms,
+                            esp_wifi_nbr_t *nbrs, uint8_t *n);
+
+/**
+  * @brief     Fill a configuration with defaults: 10 minute lifetime,
+  *            100 ms report wait, roaming engine fed
+  */
+void esp_wifi_nbr_default(esp_wifi_nbr_config_t *cfg);
+
+/**
+  * @brief     Start requesting reports and honoring BTM Requests
+  *
+  * WiFi must be started in station mode. esp_wifi_nbr_event_handler must
+  * be registered as well. Promiscuous mode is taken over until
+  * esp_wifi_nbr_stop.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: already running
+  *    - others: refer to esp_wifi_set_config, esp_wifi_set_promiscuous
+  *      and esp_timer_create
+  */
+esp_err_t esp_wifi_nbr_start(const esp_wifi_nbr_config_t *cfg);
+
+/**
+  * @brief     Stop and leave promiscuous mode
+  */
+void esp_wifi_nbr_stop(void);
+
+/**
+  * @brief     Send a Neighbor Report Request to the current AP
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: not started or not connected
+  *    - others: refer to esp_wifi_action_tx_req
+  */
+esp_err_t esp_wifi_nbr_request(void);
+
+/**
+  * @brief     Check whether the station is moving to a BTM candidate, the
+  *            disconnect handler of the application must not reconnect
+  *            meanwhile
+  */
+bool esp_wifi_nbr_in_progress(void);
+
+/**
+  * @brief     Get the live neighbors of the current ESS
+  *
+  * @param     n in: room in nbrs, out: neighbors written
+  */
+void esp_wifi_nbr_get(esp_wifi_nbr_t *nbrs, uint8_t *n);
+
+/**
+  * @brief     Get the counters
+  */
+void esp_wifi_nbr_get_stats(esp_wifi_nbr_stats_t *stats);
+
+/**
+  * @brief     Event handler of the running module
+  *
+  * Register with esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+  * esp_wifi_nbr_event_handler, NULL).
+  */
+void esp_wifi_nbr_event_handler(void *arg, esp_event_base_t base,
+                                int32_t id, void *data);
+
+/** @brief Simulator parameters */
+
+typedef struct
+{
+  uint8_t aps;                   /**< APs of the ESS, on a square grid */
+  uint32_t spacing_cm;           /**< between two grid points */
+  uint16_t channel_mask;         /**< channels the APs are spread over */
+  uint32_t full_scan_ch_ms;      /**< active time per channel, full scan */
+  uint32_t scan_ch_ms;           /**< active time per channel, targeted */
+  uint32_t report_radius_cm;     /**< APs an AP reports as neighbors */
+  uint32_t btm_hit_permille;     /**< BTM candidate is the best AP */
+  uint32_t roams;
+  uint32_t seed;
+} esp_wifi_nbr_sim_t;
+
+/** @brief Simulator outcome of one strategy */
+
+typedef struct
+{
+  uint32_t scan_avg_ms;          /**< per roam, fallbacks included */
+  uint32_t best_permille;        /**< roams that reached the best AP */
+  uint32_t fallbacks;            /**< targeted scans that found nothing */
+} esp_wifi_nbr_sim_stat_t;
+
+typedef struct
+{
+  esp_wifi_nbr_sim_stat_t full;  /**< all channels of the mask */
+  esp_wifi_nbr_sim_stat_t report; /**< channels of the neighbor report */
+  esp_wifi_nbr_sim_stat_t btm;   /**< BTM candidate, connect without scan */
+  uint32_t report_bytes;         /**< average report body size */
+  uint32_t btm_bytes;            /**< average BTM Request body size */
+} esp_wifi_nbr_sim_result_t;
+
+/**
+  * @brief     Fill simulator parameters with defaults: 16 APs 25 m apart
+  *            on channels 1 to 13, 120 ms full and 30 ms targeted channel
+  *            time, 40 m report radius, 90% BTM hits, 1000 roams
+  */
+void esp_wifi_nbr_sim_default(esp_wifi_nbr_sim_t *sim);
+
+/**
+  * @brief     Measure scan time per roam without help, from neighbor
+  *            reports and from BTM candidates
+  *
+  * An AP stand-in builds the report and the BTM Request of the serving
+  * AP, which go through the parsers and the cache as received frames do.
+  * The station roams from the serving AP at a random point of its cell.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid parameters
+  *    - others: refer to esp_wifi_nbr_cache_create
+  */
+esp_err_t esp_wifi_nbr_sim_run(const esp_wifi_nbr_sim_t *sim,
+                               esp_wifi_nbr_sim_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_NBR_H_ */
@@ -0,0 +1,243 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_PROBE_H_
+#define _ESP_WIFI_PROBE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* SoftAP probe request stage.
+ *
+ * Every probe request is accounted to its sender in a cache of
+ * ESP_WIFI_PROBE_SETS sets of ESP_WIFI_PROBE_WAYS senders. A sender
+ * holds a token bucket of burst probes refilled at rate per second:
+ * probes past it are limited and not handed on. A new sender takes the
+ * way of the sender with the fullest bucket, so that senders past their
+ * rate stay limited while many others come and go.
+ *
+ * The probes of every second are counted. Past flood_pps the stage
+ * suppresses wildcard probes, those without an SSID, until a second
+ * stays below calm_pps.
+ *
+ * The driver answers probes itself: on the target the verdicts only
+ * decide which probes reach the application. Suppression can reach the
+ * driver only by hiding the SSID of the softAP, which esp_wifi_probe_start
+ * does on request alone, see there.
+ */
+
+#define ESP_WIFI_PROBE_WAYS           4
+#define ESP_WIFI_PROBE_SETS           16
+
+typedef enum
+{
+  ESP_WIFI_PROBE_PASS = 0,       /**< handed on */
+  ESP_WIFI_PROBE_LIMITED,        /**< sender past its bucket */
+  ESP_WIFI_PROBE_SUPPRESSED,     /**< wildcard probe during a flood */
+} esp_wifi_probe_verdict_t;
+
+typedef struct
+{
+  uint16_t rate;                 /**< probes per second of a sender */
+  uint16_t burst;                /**< bucket depth, in probes */
+  uint16_t flood_pps;            /**< all senders, to suppress */
+  uint16_t calm_pps;             /**< all senders, to stop suppressing */
+} esp_wifi_probe_config_t;
+
+/** @brief Counters */
+
+typedef struct
+{
+  uint32_t probes;
+  uint32_t passed;
+  uint32_t limited;
+  uint32_t suppressed;
+  uint32_t wildcard;             /**< probes without an SSID */
+  uint32_t evictions;            /**< senders dropped from the cache */
+  uint32_t floods;               /**< suppressions started */
+} esp_wifi_probe_stats_t;
+
+/** @brief A sender as seen by the cache */
+
+typedef struct
+{
+  uint8_t mac[6];
+  int8_t rssi;                   /**< of the last probe */
+  uint32_t last_ms;              /**< of the last probe */
+  uint32_t probes;
+  uint32_t limited;
+  uint32_t wildcard;
+} esp_wifi_probe_sender_t;
+
+typedef struct esp_wifi_probe esp_wifi_probe_t;
+
+/**
+  * @brief     Probe handed on
+  *
+  * @param     wildcard  probe without an SSID, false when unknown
+  */
+typedef void (*esp_wifi_probe_cb_t)(void *arg, const uint8_t mac[6],
+                                    int8_t rssi, bool wildcard);
+
+/**
+  * @brief     Fill a configuration with defaults: 2 probes per second in
+  *            bursts of 4 per sender, suppression past 200 probes per
+  *            second until below 100
+  */
+void esp_wifi_probe_default(esp_wifi_probe_config_t *cfg);
+
+/**
+  * @brief     Create a stage
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: rate or burst 0, calm_pps not below
+  *      flood_pps
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_probe_create(const esp_wifi_probe_config_t *cfg,
+                                esp_wifi_probe_t **probe);
+
+/**
+  * @brief     Delete a stage
+  */
+void esp_wifi_probe_delete(esp_wifi_probe_t *probe);
+
+/**
+  * @brief     Parse a probe request, from its 802.11 header on
+  *
+  * @param     mac       transmitter
+  * @param     wildcard  true when the SSID element is empty
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: not a probe request
+  *    - ESP_ERR_INVALID_SIZE: truncated
+  */
+esp_err_t esp_wifi_probe_parse(const uint8_t *frame, size_t len,
+                               uint8_t mac[6], bool *wildcard);
+
+/**
+  * @brief     Account a probe request
+  */
+esp_wifi_probe_verdict_t esp_wifi_probe_rx(esp_wifi_probe_t *probe,
+                                           const uint8_t mac[6],
+                                           int8_t rssi, bool wildcard,
+                                           uint32_t now_ms);
+
+/**
+  * @brief     End the second of probes counted when due, to stop
+  *            suppressing once probes have stopped coming
+  *
+  * @return    whether wildcard probes are suppressed
+  */
+bool esp_wifi_probe_tick(esp_wifi_probe_t *probe, uint32_t now_ms);
+
+/**
+  * @brief     Get a sender of the cache
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_NOT_FOUND: not in the cache
+  */
+esp_err_t esp_wifi_probe_get_sender(const esp_wifi_probe_t *probe,
+                                    const uint8_t mac[6],
+                                    esp_wifi_probe_sender_t *sender);
+
+/**
+  * @brief     Get the counters
+  */
+void esp_wifi_probe_get_stats(const esp_wifi_probe_t *probe,
+                              esp_wifi_probe_stats_t *stats);
+
+/**
+  * @brief     Feed the probes of the softAP to a stage, handing on those
+  *            it passes
+  *
+  * With promisc the probes are taken in promiscuous mode, from
+  * management frames, and wildcard probes are told apart. Without, they
+  * come from WIFI_EVENT_AP_PROBEREQRECVED, which is unmasked, and are
+  * never taken for wildcard probes. Either way the driver still answers
+  * every probe; limited and suppressed probes only miss cb.
+  *
+  * With hide the SSID is hidden while the stage suppresses, checked
+  * every second, unless the application hid it already, so that the
+  * driver leaves wildcard probes unanswered. Each change rewrites the
+  * softAP configuration with esp_wifi_set_config: beacons go out with a
+  * blank SSID, and stations associated may be disconnected during a
+  * flood. Stations that do not know the SSID cannot find the softAP
+  * meanwhile.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: probe is NULL
+  *    - ESP_ERR_INVALID_STATE: a stage is fed already
+  *    - ESP_ERR_NO_MEM: out of memory
+  *    - others: refer to esp_wifi_set_promiscuous and
+  *      esp_event_handler_register
+  */
+esp_err_t esp_wifi_probe_start(esp_wifi_probe_t *probe, bool promisc,
+                               bool hide, esp_wifi_probe_cb_t cb,
+                               void *arg);
+
+/**
+  * @brief     Stop feeding the stage, showing the SSID again if hidden by
+  *            the stage and masking WIFI_EVENT_AP_PROBEREQRECVED as before
+  */
+void esp_wifi_probe_stop(void);
+
+/** @brief Benchmark outcome */
+
+typedef struct
+{
+  uint32_t probes;
+  uint32_t ns_per_probe;         /**< parse and rx */
+  uint32_t parse_ns_per_probe;   /**< parse alone */
+  uint32_t passed;
+  uint32_t limited;
+  uint32_t suppressed;
+  uint32_t evictions;
+  uint32_t suppressed_ms;        /**< replay time spent suppressing */
+} esp_wifi_probe_bench_t;
+
+/**
+  * @brief     Replay a probe flood at pps probes per second for seconds:
+  *            four times as many senders as the cache holds, an eighth
+  *            of them sending half the probes, three in four probes
+  *            wildcard
+  *
+  * Frames are parsed as in promiscuous mode and the stage ticked every
+  * second as on the target.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: no probe
+  *    - others: refer to esp_wifi_probe_create
+  */
+esp_err_t esp_wifi_probe_bench(uint32_t pps, uint32_t seconds,
+                               uint32_t seed,
+                               esp_wifi_probe_bench_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_PROBE_H_ */
@@ -0,0 +1,145 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_PS_SIM_H_
+#define _ESP_WIFI_PS_SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The simulator only depends on the types of the WiFi headers and may be
+ * built for the host to evaluate power save settings off target.
+ */
+
+#define ESP_PS_SIM_TU_US  1024
+
+typedef enum
+{
+  ESP_PS_SIM_RX = 0,     /**< unicast frame from the AP */
+  ESP_PS_SIM_RX_GROUP,   /**< broadcast/multicast frame, buffered to DTIM */
+  ESP_PS_SIM_TX,         /**< frame sent by the station */
+} esp_ps_sim_dir_t;
+
+/** @brief One frame of a traffic trace, traces are sorted by time_us */
+
+typedef struct
+{
+  uint64_t time_us;      /**< time the frame is ready at its sender */
+  uint16_t len;          /**< frame length in bytes */
+  uint8_t  dir;          /**< esp_ps_sim_dir_t */
+} esp_ps_sim_pkt_t;
+
+/** @brief AP and link parameters */
+
+typedef struct
+{
+  uint16_t beacon_interval;  /**< beacon interval in TU */
+  uint8_t  dtim_period;      /**< DTIM period in beacon intervals */
+  uint32_t phy_rate_kbps;    /**< data rate used for frame airtime */
+  uint32_t beacon_rx_us;     /**< time to receive one beacon */
+  uint32_t ps_poll_us;       /**< PS-Poll/null frame exchange overhead */
+} esp_ps_sim_ap_t;
+
+/** @brief Radio supply currents, in uA, and supply voltage in mV */
+
+typedef struct
+{
+  uint32_t rx_ua;
+  uint32_t tx_ua;
+  uint32_t sleep_ua;
+  uint32_t voltage_mv;
+} esp_ps_sim_power_t;
+
+/** @brief Power save settings under evaluation */
+
+typedef struct
+{
+  wifi_ps_type_t ps;          /**< as passed to esp_wifi_set_ps */
+  uint16_t listen_interval;   /**< wifi_sta_config_t listen_interval */
+  uint32_t sleep_delay_us;    /**< esp_wifi_set_sleep_delay_time */
+  uint32_t keep_alive_us;     /**< esp_wifi_set_keep_alive_time */
+  uint32_t wake_ahead_us;     /**< radio on time before each TBTT */
+} esp_ps_sim_policy_t;
+
+/** @brief Outcome of one policy against one trace */
+
+typedef struct
+{
+  uint64_t duration_us;       /**< simulated time */
+  uint64_t radio_on_us;       /**< time the radio was not sleeping */
+  uint64_t tx_us;             /**< part of radio_on_us spent transmitting */
+  uint32_t wakes;             /**< sleep to awake transitions */
+  uint32_t keep_alives;       /**< null frames sent to keep the link */
+  uint32_t rx_count;          /**< delivered RX frames */
+  uint32_t rx_latency_avg_us; /**< mean AP to station RX latency */
+  uint32_t rx_latency_max_us; /**< worst AP to station RX latency */
+  uint32_t tx_latency_avg_us; /**< mean TX latency, including wake up */
+  uint64_t energy_uj;         /**< radio energy over duration_us */
+  uint32_t avg_current_ua;    /**< energy_uj spread over duration_us */
+  bool     pareto;            /**< set by esp_ps_sim_pareto */
+} esp_ps_sim_result_t;
+
+/**
+  * @brief     Fill AP and power parameters with typical ESP32 values
+  *
+  * @param     ap     100 TU beacons, DTIM 1, 1 Mbps beacons, 54 Mbps data
+  * @param     power  ESP32 datasheet currents at 3.3 V
+  */
+void esp_ps_sim_default(esp_ps_sim_ap_t *ap, esp_ps_sim_power_t *power);
+
+/**
+  * @brief     Run one policy against a traffic trace
+  *
+  * @param     ap       AP and link parameters
+  * @param     power    radio supply currents
+  * @param     policy   power save settings
+  * @param     pkts     trace, sorted by time_us
+  * @param     npkts    number of frames in pkts
+  * @param     result   output
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid parameters or unsorted trace
+  */
+esp_err_t esp_ps_sim_run(const esp_ps_sim_ap_t *ap,
+                         const esp_ps_sim_power_t *power,
+                         const esp_ps_sim_policy_t *policy,
+                         const esp_ps_sim_pkt_t *pkts, size_t npkts,
+                         esp_ps_sim_result_t *result);
+
+/**
+  * @brief     Mark the results that are Pareto optimal in energy vs latency
+  *
+  * A result is kept when no other result has both lower or equal energy
+  * and lower or equal mean RX latency, with one of them strictly lower.
+  *
+  * @param     results  results of esp_ps_sim_run for several policies
+  * @param     n        number of results
+  *
+  * @return    number of Pareto optimal results
+  */
+size_t esp_ps_sim_pareto(esp_ps_sim_result_t *results, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_PS_SIM_H_ */
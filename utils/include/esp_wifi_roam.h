@@ -0,0 +1,319 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_ROAM_H_
+#define _ESP_WIFI_ROAM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_event_base.h"
+#include "esp_wifi_types.h"
+#include "esp_wifi_ent_pmksa.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Background roaming engine driven by the RSSI threshold.
+ *
+ * Above the soft threshold the engine does nothing and the station only
+ * waits for WIFI_EVENT_STA_BSS_RSSI_LOW. Below it, the link RSSI is
+ * sampled and single-channel scans are spread over the channels of the
+ * learned neighbor list, one every scan interval, so the station leaves
+ * its channel for one channel time at most. APs of the SSID seen in any
+ * scan join the list. Candidates are scored by their RSSI projected over
+ * the horizon from its trend, less a penalty for the load and plus a
+ * bonus when a PMKSA is cached for them. A candidate scoring the
+ * hysteresis above the current AP, or any better one below the hard
+ * threshold, is connected to by BSSID and channel, without a full scan.
+ *
+ * The engine only decides; esp_wifi_roam_start drives it from the WiFi
+ * events and a timer on the target, the simulator drives it from
+ * mobility traces.
+ */
+
+#define ESP_WIFI_ROAM_MAX_NEIGHBORS   16
+
+typedef struct
+{
+  int8_t soft_threshold;         /**< dBm, background scans below */
+  int8_t hard_threshold;         /**< dBm, roam without hysteresis below */
+  uint8_t hysteresis;            /**< dB a candidate must score above */
+  uint16_t channel_mask;         /**< swept while no neighbor is known */
+  uint32_t scan_interval_ms;     /**< between two single-channel scans */
+  uint32_t scan_time_ms;         /**< active scan time of a channel */
+  uint32_t stale_ms;             /**< candidate not seen since is ignored */
+  uint32_t horizon_ms;           /**< RSSI trend projection */
+  uint8_t load_weight;           /**< dB taken off at full load */
+  uint8_t pmksa_bonus;           /**< dB given with a cached PMKSA */
+  uint32_t roam_timeout_ms;      /**< connect to a candidate gives up */
+  uint32_t hold_ms;              /**< no soft roam after a roam or a
+                                      failed candidate */
+  esp_wifi_ent_pmksa_t *pmksa;   /**< optional PMKSA table, only looked
+                                      up, under the lock of the table */
+} esp_wifi_roam_config_t;
+
+typedef enum
+{
+  ESP_WIFI_ROAM_NONE = 0,
+  ESP_WIFI_ROAM_SCAN,            /**< scan the channel */
+  ESP_WIFI_ROAM_CONNECT,         /**< connect to the BSSID on the channel */
+  ESP_WIFI_ROAM_RECONNECT,       /**< the candidate failed, connect as
+                                      configured */
+} esp_wifi_roam_action_type_t;
+
+typedef struct
+{
+  esp_wifi_roam_action_type_t type;
+  uint8_t channel;
+  uint8_t bssid[6];
+} esp_wifi_roam_action_t;
+
+/** @brief A neighbor as scored by the engine */
+
+typedef struct
+{
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t load;                  /**< channel utilization, 255 busy */
+  int8_t rssi;                   /**< filtered */
+  int16_t trend_x10;             /**< dB/s, times 10 */
+  int16_t score;                 /**< dB, comparable to the current AP */
+  uint32_t age_ms;               /**< since last seen */
+} esp_wifi_roam_candidate_t;
+
+/** @brief Engine counters */
+
+typedef struct
+{
+  uint32_t scans;
+  uint32_t roams;                /**< connects to a candidate */
+  uint32_t hard_roams;           /**< of which below the hard threshold */
+  uint32_t failures;             /**< candidates that timed out */
+  uint32_t last_gap_ms;          /**< roam decision to connected */
+  uint32_t max_gap_ms;
+} esp_wifi_roam_stats_t;
+
+typedef struct esp_wifi_roam esp_wifi_roam_t;
+
+/**
+  * @brief     Fill a configuration with defaults: -70 dBm soft and -80 dBm
+  *            hard threshold, 6 dB hysteresis, channels 1 to 13, a 30 ms
+  *            channel scan every 500 ms, 3 s staleness, 2 s horizon,
+  *            10 dB full load penalty, 5 dB PMKSA bonus, 1 s roam timeout
+  *            and 5 s hold
+  */
+void esp_wifi_roam_default(esp_wifi_roam_config_t *cfg);
+
+/**
+  * @brief     Create an engine
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid configuration
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_roam_create(const esp_wifi_roam_config_t *cfg,
+                               esp_wifi_roam_t **eng);
+
+/**
+  * @brief     Delete an engine
+  */
+void esp_wifi_roam_delete(esp_wifi_roam_t *eng);
+
+/**
+  * @brief     Get the configuration of an engine
+  */
+void esp_wifi_roam_get_config(esp_wifi_roam_t *eng,
+                              esp_wifi_roam_config_t *cfg);
+
+/**
+  * @brief     Report the station connected at time now_ms
+  *
+  * The neighbor list is kept across connects to the same SSID.
+  */
+void esp_wifi_roam_connected(esp_wifi_roam_t *eng, const uint8_t *ssid,
+                             uint8_t ssid_len, const uint8_t bssid[6],
+                             uint8_t channel, int64_t now_ms);
+
+/**
+  * @brief     Report the station disconnected
+  */
+void esp_wifi_roam_disconnected(esp_wifi_roam_t *eng, int64_t now_ms);
+
+/**
+  * @brief     Feed an RSSI sample of the current AP
+  */
+void esp_wifi_roam_rssi(esp_wifi_roam_t *eng, int8_t rssi, int64_t now_ms);
+
+/**
+  * @brief     Feed scan records, APs of the SSID join the neighbor list
+  */
+void esp_wifi_roam_scan_done(esp_wifi_roam_t *eng,
+                             const wifi_ap_record_t *aps, uint16_t n,
+                             int64_t now_ms);
+
+/**
+  * @brief     Add a neighbor known from elsewhere, a neighbor report for
+  *            instance
+  *
+  * Its channel joins the scans, it becomes a candidate once a scan
+  * finds it.
+  */
+void esp_wifi_roam_add_neighbor(esp_wifi_roam_t *eng, const uint8_t bssid[6],
+                                uint8_t channel, int64_t now_ms);
+
+/**
+  * @brief     Set the load of a neighbor, for instance from its BSS Load
+  *            element, scan records do not carry it
+  */
+void esp_wifi_roam_set_load(esp_wifi_roam_t *eng, const uint8_t bssid[6],
+                            uint8_t load);
+
+/**
+  * @brief     Decide what to do at time now_ms
+  *
+  * @return    true when below the soft threshold or roaming, the engine
+  *            then wants to be called every scan interval
+  */
+bool esp_wifi_roam_next(esp_wifi_roam_t *eng, int64_t now_ms,
+                        esp_wifi_roam_action_t *act);
+
+/**
+  * @brief     Get the scored neighbors, best first
+  *
+  * @param     n in: room in cands, out: neighbors written
+  */
+void esp_wifi_roam_get_candidates(esp_wifi_roam_t *eng, int64_t now_ms,
+                                  esp_wifi_roam_candidate_t *cands,
+                                  uint8_t *n);
+
+/**
+  * @brief     Get the engine counters
+  */
+void esp_wifi_roam_get_stats(esp_wifi_roam_t *eng,
+                             esp_wifi_roam_stats_t *stats);
+
+/**
+  * @brief     Drive an engine from the WiFi events and a timer
+  *
+  * esp_wifi_roam_event_handler must be registered as well. The engine
+  * must not be used by the caller until esp_wifi_roam_stop. Candidates
+  * are scored on the timer task; a PMKSA table of the configuration
+  * may stay registered with esp_wifi_ent_pmksa_event_handler, as it is
+  * locked on its own, always after the engine.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: already running
+  *    - others: refer to esp_timer_create
+  */
+esp_err_t esp_wifi_roam_start(esp_wifi_roam_t *eng);
+
+/**
+  * @brief     Stop driving the engine
+  */
+void esp_wifi_roam_stop(void);
+
+/**
+  * @brief     Add a neighbor to the running engine, see
+  *            esp_wifi_roam_add_neighbor, nothing when not running
+  */
+void esp_wifi_roam_report_neighbor(const uint8_t bssid[6], uint8_t channel);
+
+/**
+  * @brief     Check whether the engine is switching APs, the disconnect
+  *            handler of the application must not reconnect meanwhile
+  */
+bool esp_wifi_roam_in_progress(void);
+
+/**
+  * @brief     Event handler of the running engine
+  *
+  * Register with esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+  * esp_wifi_roam_event_handler, NULL).
+  */
+void esp_wifi_roam_event_handler(void *arg, esp_event_base_t base,
+                                 int32_t id, void *data);
+
+/** @brief Simulator parameters */
+
+typedef struct
+{
+  uint8_t aps;                   /**< along a corridor, channels 1, 6, 11 */
+  uint32_t spacing_cm;           /**< between two APs */
+  uint32_t offset_cm;            /**< of the corridor from the APs */
+  uint32_t speed_cm_s;           /**< walking speed, end to end and back */
+  uint8_t path_loss_x10;         /**< exponent, times 10 */
+  uint8_t shadow_db;             /**< slow shadowing, +/- dB */
+  uint32_t pps;                  /**< downlink packets per second */
+  uint32_t full_scan_ms;         /**< all channel scan of a reconnect */
+  uint32_t connect_ms;           /**< auth, assoc and 4-way handshake */
+  uint32_t runs;
+  uint32_t seed;
+} esp_wifi_roam_sim_t;
+
+/** @brief Simulator outcome of one policy */
+
+typedef struct
+{
+  uint32_t handoffs;
+  uint32_t gap_avg_ms;           /**< link down to link up */
+  uint32_t gap_max_ms;
+  uint32_t scans;                /**< single-channel background scans */
+  uint32_t lost_permille;        /**< packets lost to gaps, scans and
+                                      weak signal */
+} esp_wifi_roam_sim_stat_t;
+
+typedef struct
+{
+  esp_wifi_roam_sim_stat_t baseline;  /**< disconnect and full scan on
+                                           the soft threshold event,
+                                           armed again above it */
+  esp_wifi_roam_sim_stat_t engine;
+} esp_wifi_roam_sim_result_t;
+
+/**
+  * @brief     Fill simulator parameters with defaults: 4 APs 30 m apart,
+  *            corridor 3 m off, 1.2 m/s, -30 dBm at 1 m and exponent 3.5,
+  *            4 dB shadowing, 50 packets/s, 1560 ms full scan, 60 ms
+  *            connect
+  */
+void esp_wifi_roam_sim_default(esp_wifi_roam_sim_t *sim);
+
+/**
+  * @brief     Measure handoff gap and packet loss of the engine against
+  *            disconnect and full scan on the threshold event
+  *
+  * Both policies walk the same traces. Loss grows linearly from none at
+  * -75 dBm to all at -90 dBm, below which the link is lost after 6 s of
+  * beacon timeout. Time off channel counts as lost. The load and PMKSA
+  * terms of cfg are not exercised.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid parameters
+  *    - others: refer to esp_wifi_roam_create
+  */
+esp_err_t esp_wifi_roam_sim_run(const esp_wifi_roam_config_t *cfg,
+                                const esp_wifi_roam_sim_t *sim,
+                                esp_wifi_roam_sim_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_ROAM_H_ */
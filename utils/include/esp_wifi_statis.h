@@ -0,0 +1,218 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_STATIS_H_
+#define _ESP_WIFI_STATIS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_private/wifi_os_adapter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* esp_wifi_statis_dump prints its counters as tables through the
+ * _log_write adapter: a section line, a row of column names and one or
+ * more rows of values. While a capture is running, the adapter hook
+ * takes the names and values straight from the arguments of these
+ * calls and stores them into the structures below, nothing is printed
+ * nor formatted.
+ */
+
+#define ESP_WIFI_STATIS_BUF_TYPES  8
+
+/** @brief One row of the BUFFER table, indexed by buffer type */
+
+typedef struct
+{
+  uint32_t max;
+  uint32_t alloc;
+  uint32_t total_alloc;
+  uint32_t total_free;
+  uint32_t fail_fc;
+  uint32_t fail_oom;
+} esp_wifi_statis_buf_t;
+
+/** @brief LMAC TX, LMAC RX and HW RX tables */
+
+typedef struct
+{
+  uint32_t tx_all;
+  uint32_t tx_src;
+  uint32_t tx_lrc;
+  uint32_t tx_to;
+  uint32_t tx_age;
+  uint32_t rx_mpdu;
+  uint32_t rx_ampdu;
+  uint32_t rx_frag;
+  uint32_t rx_ctrl;
+  uint32_t rx_mgmt;
+  uint32_t hw_rx_end;
+  uint32_t hw_rx_suc;
+  uint32_t hw_rx_full1;
+  uint32_t hw_rx_full2;
+} esp_wifi_statis_rxtx_t;
+
+/** @brief Hardware table */
+
+typedef struct
+{
+  uint32_t rxcckerr;
+  uint32_t rxbufbk;
+  uint32_t fifofull;
+  uint32_t rx_fcs;
+  uint32_t rx_abort;
+  uint32_t rxsf;
+  uint32_t rx_agc;
+  uint32_t ofdmerr;
+  uint32_t rx_oth;
+  uint32_t afull;
+  uint32_t rifs_int;
+  uint32_t cts_int;
+  uint32_t rts_int;
+  uint32_t ack_int;
+  uint32_t samebm;
+  uint32_t tkiperr;
+  uint32_t hoperr;
+  uint32_t blockerr;
+  uint32_t panic;
+  uint32_t txhung;
+  uint32_t trigger;
+  uint32_t trcts;
+  uint32_t track;
+  uint32_t txcts;
+  uint32_t txrts;
+} esp_wifi_statis_hw_t;
+
+/** @brief DIAG table, raw register values */
+
+typedef struct
+{
+  uint32_t diag[13];
+  uint32_t diagsel;
+} esp_wifi_statis_diag_t;
+
+/** @brief Power save table */
+
+typedef struct
+{
+  uint32_t sleep;
+  uint32_t wake;
+  uint32_t sleept;
+  uint32_t waket;
+  uint32_t totalt;
+  uint32_t percent_x100;     /**< sleep time share, in 0.01 % */
+  uint32_t tbtt;
+  uint32_t beacon;
+  uint32_t timset;
+  uint32_t dtimset;
+  uint32_t tbttdrm;
+  uint32_t actto;
+  uint32_t txwake;
+  uint32_t null0;
+  uint32_t null1;
+  uint32_t bcndly;
+} esp_wifi_statis_ps_t;
+
+/** @brief All counters, only made of uint32_t */
+
+typedef struct
+{
+  esp_wifi_statis_buf_t  buf[ESP_WIFI_STATIS_BUF_TYPES];
+  esp_wifi_statis_rxtx_t rxtx;
+  esp_wifi_statis_hw_t   hw;
+  esp_wifi_statis_diag_t diag;
+  esp_wifi_statis_ps_t   ps;
+} esp_wifi_statis_counters_t;
+
+/** @brief One capture, or the difference between two */
+
+typedef struct
+{
+  int64_t  time_us;          /**< capture time, or interval for a delta */
+  uint32_t modules;          /**< WIFI_STATIS_* captured */
+  uint32_t unknown;          /**< values whose column has no field */
+  esp_wifi_statis_counters_t c;
+} esp_wifi_statis_snapshot_t;
+
+/**
+  * @brief     Hook the capture into the log callbacks of an OS adapter
+  *
+  * Must be called once, before esp_wifi_init when osi is the adapter
+  * passed in wifi_init_config_t. Other logs are passed on unchanged.
+  *
+  * @param     osi  adapter to hook, NULL for g_wifi_osi_funcs
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: already installed
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_statis_install(wifi_osi_funcs_t *osi);
+
+/**
+  * @brief     Run esp_wifi_statis_dump and capture its output
+  *
+  * The previous capture is kept to compute the delta returned by
+  * esp_wifi_statis_get.
+  *
+  * @param     modules  WIFI_STATIS_* to capture
+  * @param     out      capture, may be NULL
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: not installed
+  *    - ESP_ERR_NOT_FOUND: nothing recognized in the dump
+  *    - others: refer to esp_wifi_statis_dump
+  */
+esp_err_t esp_wifi_statis_snapshot(uint32_t modules,
+                                   esp_wifi_statis_snapshot_t *out);
+
+/**
+  * @brief     Take snapshots periodically from an esp_timer
+  *
+  * @param     modules    WIFI_STATIS_* to capture
+  * @param     period_ms  snapshot period, 0 stops the timer
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_STATE: not installed
+  *    - others: refer to esp_timer_create
+  */
+esp_err_t esp_wifi_statis_start(uint32_t modules, uint32_t period_ms);
+
+/**
+  * @brief     Copy the latest snapshot and its delta to the previous one
+  *
+  * Delta fields are differences modulo 2^32. For gauges such as
+  * buf[].alloc, ps.percent_x100 or diag, read the latest value instead.
+  *
+  * @param     latest  latest snapshot, may be NULL
+  * @param     delta   latest minus previous, may be NULL
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_NOT_FOUND: fewer than two snapshots for a delta, or none
+  */
+esp_err_t esp_wifi_statis_get(esp_wifi_statis_snapshot_t *latest,
+                              esp_wifi_statis_snapshot_t *delta);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_STATIS_H_ */
@@ -0,0 +1,276 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_TPC_H_
+#define _ESP_WIFI_TPC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Transmit power control of one radio by link margin and PER.
+ *
+ * The radio sends at one of its levels, from the top at first. Send
+ * statuses are summed over a window; a window of min_frames or more
+ * above target_per_permille steps the level up, one at half of it or
+ * below steps it down, if the margin left at the lower level is
+ * margin_db or more and no step up was taken within hold_ms. The margin
+ * is the mean RSSI of the peer, as if it sent at our level rather than
+ * at peer_dbm, above sensitivity_dbm; unknown without RSSI, it does not
+ * hold the level. loss_burst failures in a row bring the top level back
+ * at once.
+ *
+ * The engine only decides; esp_wifi_tpc_start drives one for Wi-Fi with
+ * esp_wifi_set_max_tx_power and one for Bluetooth with
+ * esp_ble_tx_power_set, esp_wifi_tpc_sim_run drives them over links
+ * interfering with each other.
+ */
+
+#define ESP_WIFI_TPC_LEVELS           16
+
+typedef enum
+{
+  ESP_WIFI_TPC_WIFI,
+  ESP_WIFI_TPC_BLE,
+  ESP_WIFI_TPC_RADIOS
+} esp_wifi_tpc_radio_t;
+
+typedef struct
+{
+  int16_t levels[ESP_WIFI_TPC_LEVELS];  /**< 0.25 dBm, ascending */
+  uint8_t n_levels;
+  uint16_t target_per_permille;
+  uint32_t window_ms;
+  uint16_t min_frames;           /**< of a window counted */
+  uint8_t loss_burst;            /**< failures in a row, 0 never */
+  uint32_t hold_ms;              /**< no step down after a step up */
+  int8_t sensitivity_dbm;        /**< of the peer at the rate in use */
+  int8_t peer_dbm;               /**< the peer sends at */
+  uint8_t margin_db;
+} esp_wifi_tpc_config_t;
+
+/** @brief Counters */
+
+typedef struct
+{
+  uint32_t sent;
+  uint32_t failed;
+  uint32_t windows;              /**< of min_frames or more */
+  uint32_t downs;
+  uint32_t ups;
+  uint32_t recoveries;           /**< to the top on a loss burst */
+  uint32_t held;                 /**< steps down kept by the margin */
+  uint32_t writes;               /**< of the level */
+} esp_wifi_tpc_stats_t;
+
+typedef struct esp_wifi_tpc esp_wifi_tpc_t;
+
+/**
+  * @brief     Fill a configuration with defaults for radio: for Wi-Fi
+  *            the levels of esp_wifi_set_max_tx_power from 2 to 20 dBm,
+  *            -80 dBm sensitivity, a peer at 20 dBm; for BLE -12 to
+  *            +9 dBm in 3 dB, -94 dBm sensitivity, a peer at 0 dBm;
+  *            10% PER over 1 s windows of 10 frames, bursts of 4, 10 s
+  *            hold, 10 dB margin
+  */
+void esp_wifi_tpc_default(esp_wifi_tpc_radio_t radio,
+                          esp_wifi_tpc_config_t *cfg);
+
+/**
+  * @brief     Create an engine at the top level
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: cfg or tpc is NULL, no level or too many,
+  *      levels not ascending, window_ms 0 or target_per_permille above
+  *      1000
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_tpc_create(const esp_wifi_tpc_config_t *cfg,
+                              uint32_t now_ms, esp_wifi_tpc_t **tpc);
+
+/**
+  * @brief     Delete an engine
+  */
+void esp_wifi_tpc_delete(esp_wifi_tpc_t *tpc);
+
+/**
+  * @brief     RSSI of a frame from the peer
+  */
+void esp_wifi_tpc_rssi(esp_wifi_tpc_t *tpc, int8_t rssi);
+
+/**
+  * @brief     Frames sent since the last call and how many of them failed,
+  *            a burst of failures counted only over calls failing all
+  */
+void esp_wifi_tpc_tx(esp_wifi_tpc_t *tpc, uint16_t sent, uint16_t failed);
+
+/**
+  * @brief     Recover on a burst, close the window and step
+  *
+  * @return    true with the level to write, 0.25 dBm, false to leave it
+  */
+bool esp_wifi_tpc_update(esp_wifi_tpc_t *tpc, uint32_t now_ms,
+                         int16_t *level);
+
+/**
+  * @brief     Level in use, 0.25 dBm
+  */
+int16_t esp_wifi_tpc_level(const esp_wifi_tpc_t *tpc);
+
+/**
+  * @brief     Get the configuration of an engine
+  */
+void esp_wifi_tpc_get_config(const esp_wifi_tpc_t *tpc,
+                             esp_wifi_tpc_config_t *cfg);
+
+/**
+  * @brief     Get the counters
+  */
+void esp_wifi_tpc_get_stats(const esp_wifi_tpc_t *tpc,
+                            esp_wifi_tpc_stats_t *stats);
+
+/**
+  * @brief     Update the engines every tick_ms, sampling the AP RSSI with
+  *            esp_wifi_sta_get_ap_info for Wi-Fi, and write their levels
+  *
+  * Wi-Fi levels under 2 dBm or above CONFIG_ESP32_PHY_MAX_TX_POWER, the
+  * limit of the PHY init data, are refused, as are BLE levels off the
+  * 3 dB steps of esp_power_level_t. BLE levels go to the default power
+  * type, which only the connections to come take, to the power type of
+  * the connection set with esp_wifi_tpc_ble_conn and, with Classic
+  * Bluetooth enabled, to BR/EDR as well. A level that fails to be
+  * written is written again at the next ticks until it is.
+  *
+  * @param     wifi     engine for Wi-Fi, may be NULL
+  * @param     ble      engine for Bluetooth, may be NULL
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: both NULL, tick_ms 0, or a level out of the
+  *      radio's range
+  *    - ESP_ERR_INVALID_STATE: started already
+  *    - ESP_ERR_NOT_SUPPORTED: ble given, Bluetooth not enabled
+  *    - ESP_ERR_NO_MEM: out of memory
+  *    - others: refer to esp_timer_create, esp_wifi_set_max_tx_power and
+  *      esp_ble_tx_power_set
+  */
+esp_err_t esp_wifi_tpc_start(esp_wifi_tpc_t *wifi, esp_wifi_tpc_t *ble,
+                             uint32_t tick_ms);
+
+/**
+  * @brief     Stop, leaving the levels
+  */
+void esp_wifi_tpc_stop(void);
+
+/**
+  * @brief     Set the BLE connection the level of the Bluetooth engine is
+  *            written to, ESP_BLE_PWR_TYPE_CONN_HDL0 + handle
+  *
+  * Call it on connection, the level of the started engine is written to
+  * the connection at once, and with -1 on disconnection. May be called
+  * before esp_wifi_tpc_start.
+  *
+  * @param     handle  connection handle, 0 to 8, or -1 for none
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: handle out of range
+  *    - ESP_ERR_NOT_SUPPORTED: Bluetooth not enabled
+  *    - others: refer to esp_ble_tx_power_set
+  */
+esp_err_t esp_wifi_tpc_ble_conn(int handle);
+
+/**
+  * @brief     Feed a frame sent, from an ESP-NOW send callback or a BLE
+  *            write response, to the started engine of radio
+  */
+void esp_wifi_tpc_feed_tx(esp_wifi_tpc_radio_t radio, bool ok);
+
+/**
+  * @brief     Feed an RSSI of the peer, from a received frame or
+  *            esp_ble_gap_read_rssi, to the started engine of radio
+  */
+void esp_wifi_tpc_feed_rssi(esp_wifi_tpc_radio_t radio, int8_t rssi);
+
+#define ESP_WIFI_TPC_SIM_LINKS        8
+
+/** @brief Interference model parameters */
+
+typedef struct
+{
+  uint32_t seconds;
+  uint8_t links;                 /**< up to ESP_WIFI_TPC_SIM_LINKS */
+  uint16_t slots_per_s;
+  uint8_t duty_percent;          /**< of the slots a link sends in */
+  uint8_t loss_min;              /**< dB, of the links, spread evenly */
+  uint8_t loss_max;
+  uint8_t coupling_min;          /**< dB, from a sender to the receiver */
+  uint8_t coupling_max;          /**< of another link, drawn once */
+  int8_t noise_dbm;
+  uint8_t snr50;                 /**< dB of SINR for 50% delivery */
+  uint8_t noise_db;              /**< of the RSSI, uniform +- */
+  uint32_t seed;
+} esp_wifi_tpc_sim_t;
+
+/** @brief Outcome of one policy */
+
+typedef struct
+{
+  uint32_t per_permille;
+  int32_t power_x10;             /**< dBm x 10, mean over the frames */
+  int32_t interference_x10;      /**< dBm x 10, at the receivers */
+} esp_wifi_tpc_sim_stat_t;
+
+typedef struct
+{
+  uint32_t frames;
+  esp_wifi_tpc_sim_stat_t fixed; /**< every link at the top level */
+  esp_wifi_tpc_sim_stat_t tpc;   /**< an engine per link, the defaults */
+  uint32_t downs;
+  uint32_t ups;
+  uint32_t recoveries;
+} esp_wifi_tpc_sim_result_t;
+
+/**
+  * @brief     Fill model parameters with defaults: 60 s, 6 links of 55
+  *            to 80 dB loss, 100 slots a second at 30% duty, 80 to
+  *            105 dB coupling, -95 dBm noise, 12 dB SINR, 2 dB RSSI noise
+  */
+void esp_wifi_tpc_sim_default(esp_wifi_tpc_sim_t *sim);
+
+/**
+  * @brief     Send over the links at the top Wi-Fi level and, with the
+  *            same draws, with an engine each
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: sim or result is NULL, no second, no link,
+  *      too many, no slot or loss_min above loss_max
+  *    - others: refer to esp_wifi_tpc_create
+  */
+esp_err_t esp_wifi_tpc_sim_run(const esp_wifi_tpc_sim_t *sim,
+                               esp_wifi_tpc_sim_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_TPC_H_ */
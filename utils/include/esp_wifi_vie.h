@@ -0,0 +1,223 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_VIE_H_
+#define _ESP_WIFI_VIE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Vendor IE templates.
+ *
+ * Every frame type keeps its two vendor IEs serialized back to back,
+ * headers included, so that each is what esp_wifi_set_vendor_ie takes
+ * and both are copied into a frame at once. Setting an IE to the
+ * bytes it already has, or patching a payload range with the bytes it
+ * already holds, leaves it clean. Only the bytes that differ are
+ * written and only the (type, index) pairs that changed are pushed
+ * again, each push making the driver rebuild its frame.
+ *
+ * The beacon budget is checked when an IE grows: the beacon without
+ * vendor IEs plus both beacon IEs must fit in beacon_max_len.
+ */
+
+#define ESP_WIFI_VIE_TYPES            (WIFI_VND_IE_TYPE_ASSOC_RESP + 1)
+#define ESP_WIFI_VIE_SLOTS            2
+#define ESP_WIFI_VIE_HDR_LEN          6      /* id, length, OUI, type */
+#define ESP_WIFI_VIE_PAYLOAD_MAX      (255 - 4)
+
+/* Frame types, for the type masks below */
+
+#define ESP_WIFI_VIE_BIT(type)        (1 << (type))
+#define ESP_WIFI_VIE_AP_FRAMES \
+  (ESP_WIFI_VIE_BIT(WIFI_VND_IE_TYPE_BEACON) | \
+   ESP_WIFI_VIE_BIT(WIFI_VND_IE_TYPE_PROBE_RESP))
+
+typedef struct
+{
+  uint16_t beacon_max_len;       /**< as in wifi_init_config_t */
+  uint16_t beacon_base_len;      /**< beacon without vendor IEs, FCS
+                                      included */
+} esp_wifi_vie_config_t;
+
+/** @brief Counters */
+
+typedef struct
+{
+  uint32_t sets;                 /**< set and patch calls */
+  uint32_t unchanged;            /**< of which left the IE as it was */
+  uint32_t bytes_written;        /**< IE bytes that differed */
+  uint32_t pushes;               /**< esp_wifi_set_vendor_ie calls */
+} esp_wifi_vie_stats_t;
+
+/**
+  * @brief     Push one IE to the driver
+  *
+  * @param     ie   serialized IE, NULL to remove it
+  */
+typedef esp_err_t (*esp_wifi_vie_push_t)(void *arg,
+                                         wifi_vendor_ie_type_t type,
+                                         wifi_vendor_ie_id_t idx,
+                                         const uint8_t *ie);
+
+typedef struct esp_wifi_vie esp_wifi_vie_t;
+
+/**
+  * @brief     Fill a configuration with defaults: WIFI_SOFTAP_BEACON_MAX_LEN
+  *            and a 220 byte beacon, 32-byte SSID, WPA2, HT and WMM
+  */
+void esp_wifi_vie_default(esp_wifi_vie_config_t *cfg);
+
+/**
+  * @brief     Create empty templates
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: beacon_base_len not below beacon_max_len
+  *    - ESP_ERR_NO_MEM: out of memory
+  */
+esp_err_t esp_wifi_vie_create(const esp_wifi_vie_config_t *cfg,
+                              esp_wifi_vie_t **vie);
+
+/**
+  * @brief     Delete templates, the IEs pushed stay in the driver
+  */
+void esp_wifi_vie_delete(esp_wifi_vie_t *vie);
+
+/**
+  * @brief     Set the IE at index idx of the frame types in mask
+  *
+  * @param     mask  ESP_WIFI_VIE_BIT of the frame types
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid mask, index or length
+  *    - ESP_ERR_INVALID_SIZE: the beacon would exceed beacon_max_len
+  */
+esp_err_t esp_wifi_vie_set(esp_wifi_vie_t *vie, uint8_t mask,
+                           wifi_vendor_ie_id_t idx, const uint8_t oui[3],
+                           uint8_t oui_type, const uint8_t *payload,
+                           uint8_t len);
+
+/**
+  * @brief     Write payload bytes from offset off of an IE already set
+  *
+  * The payload grows when the range ends past it.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid mask, index or range
+  *    - ESP_ERR_INVALID_STATE: IE not set for a type of mask
+  *    - ESP_ERR_INVALID_SIZE: the beacon would exceed beacon_max_len
+  */
+esp_err_t esp_wifi_vie_patch(esp_wifi_vie_t *vie, uint8_t mask,
+                             wifi_vendor_ie_id_t idx, uint8_t off,
+                             const uint8_t *data, uint8_t len);
+
+/**
+  * @brief     Remove the IE at index idx of the frame types in mask
+  */
+void esp_wifi_vie_clear(esp_wifi_vie_t *vie, uint8_t mask,
+                        wifi_vendor_ie_id_t idx);
+
+/**
+  * @brief     Get the serialized IE of a frame type
+  *
+  * @return    the IE, ESP_WIFI_VIE_HDR_LEN bytes and the payload, or NULL
+  *            when not set
+  */
+const uint8_t *esp_wifi_vie_get(const esp_wifi_vie_t *vie,
+                                wifi_vendor_ie_type_t type,
+                                wifi_vendor_ie_id_t idx);
+
+/**
+  * @brief     Get the vendor IEs of a frame type, back to back in index
+  *            order as they go in the frame
+  *
+  * @param     len  bytes they take
+  */
+const uint8_t *esp_wifi_vie_block(const esp_wifi_vie_t *vie,
+                                  wifi_vendor_ie_type_t type,
+                                  uint16_t *len);
+
+/**
+  * @brief     Push the changed IEs
+  *
+  * An IE whose push fails stays changed and is pushed again next time.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - others: the first error of push
+  */
+esp_err_t esp_wifi_vie_flush(esp_wifi_vie_t *vie, esp_wifi_vie_push_t push,
+                             void *arg);
+
+/**
+  * @brief     Push the changed IEs with esp_wifi_set_vendor_ie
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - others: refer to esp_wifi_set_vendor_ie
+  */
+esp_err_t esp_wifi_vie_commit(esp_wifi_vie_t *vie);
+
+/**
+  * @brief     Get the counters
+  */
+void esp_wifi_vie_get_stats(const esp_wifi_vie_t *vie,
+                            esp_wifi_vie_stats_t *stats);
+
+/** @brief Benchmark outcome, per rotation */
+
+typedef struct
+{
+  uint32_t rotations;
+  uint32_t rebuild_ns;           /**< IEs serialized again and all pushed */
+  uint32_t patch_ns;             /**< changed bytes patched and flushed */
+  uint32_t rebuild_pushes_x100;  /**< pushes, average times 100 */
+  uint32_t patch_pushes_x100;
+  uint32_t rebuild_bytes;        /**< IE bytes written */
+  uint32_t patch_bytes;
+  uint32_t beacon_rebuild_ns;    /**< beacon built from the IE fields */
+  uint32_t beacon_copy_ns;       /**< beacon built from the templates */
+} esp_wifi_vie_bench_t;
+
+/**
+  * @brief     Rotate a dynamic IE of beacon and probe response, a 4-byte
+  *            sequence number and a 16-byte token changing every
+  *            rotation besides 64 static bytes, next to a static IE, and
+  *            build a beacon after each rotation
+  *
+  * Pushes go to a stub, the driver rebuild they cause is not measured.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: no rotation
+  *    - others: refer to esp_wifi_vie_create
+  */
+esp_err_t esp_wifi_vie_bench(uint32_t rotations,
+                             esp_wifi_vie_bench_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_VIE_H_ */
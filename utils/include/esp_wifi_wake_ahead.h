@@ -0,0 +1,168 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WIFI_WAKE_AHEAD_H_
+#define _ESP_WIFI_WAKE_AHEAD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Controller settings */
+
+typedef struct
+{
+  uint32_t min_us;           /**< lower bound of the wake-ahead time */
+  uint32_t max_us;           /**< upper bound, also used until warmed up */
+  uint32_t guard_us;         /**< fixed margin added to the quantile */
+  uint32_t target_miss_ppm;  /**< tolerated beacon miss rate, in ppm */
+  uint32_t update_every;     /**< samples between two adjustments */
+  uint32_t miss_window;      /**< beacons over which misses are counted */
+  uint32_t miss_step_us;     /**< margin added when misses exceed target */
+} esp_wake_ahead_config_t;
+
+/** @brief Controller state, owned by the caller */
+
+typedef struct
+{
+  esp_wake_ahead_config_t cfg;
+
+  /* P-square streaming quantile estimate of the TBTT error */
+
+  float    q;                /**< quantile tracked, 1 - target miss rate */
+  float    height[5];
+  float    pos[5];
+  float    desired[5];
+  float    inc[5];
+  uint32_t count;
+
+  /* Miss rate feedback */
+
+  uint32_t window_beacons;
+  uint32_t window_misses;
+  uint32_t boost_us;
+
+  /* Last TSF/local time pair, to turn TSF samples into TBTT error */
+
+  int64_t  anchor_tsf;
+  int64_t  anchor_local;
+  bool     anchored;
+
+  uint32_t wake_ahead_us;    /**< current output */
+} esp_wake_ahead_ctrl_t;
+
+/** @brief Outcome of esp_wake_ahead_replay */
+
+typedef struct
+{
+  uint32_t samples;          /**< beacons replayed */
+  uint32_t misses;           /**< beacons earlier than the margin in use */
+  uint32_t miss_ppm;         /**< misses over samples, in ppm */
+  uint32_t avg_wake_ahead_us;
+  uint32_t max_wake_ahead_us;
+} esp_wake_ahead_replay_result_t;
+
+/**
+  * @brief     Fill a configuration with defaults
+  *
+  * 500 us to 10 ms, 1% target miss rate, 200 us guard.
+  */
+void esp_wake_ahead_default(esp_wake_ahead_config_t *cfg);
+
+/**
+  * @brief     Initialize a controller
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid configuration
+  */
+esp_err_t esp_wake_ahead_init(esp_wake_ahead_ctrl_t *ctrl,
+                              const esp_wake_ahead_config_t *cfg);
+
+/**
+  * @brief     Convert a TSF/local time pair, taken at beacon reception,
+  *            into the TBTT error since the previous pair
+  *
+  * The error is how much earlier the beacon arrived than predicted from
+  * the previous pair, i.e. the margin the wake-ahead had to cover.
+  *
+  * @param     ctrl      controller
+  * @param     tsf_us    esp_wifi_get_tsf_time at reception
+  * @param     local_us  esp_timer_get_time at reception
+  * @param     error_us  output error, only valid when ESP_OK
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_NOT_FOUND: first pair, no error available yet
+  */
+esp_err_t esp_wake_ahead_tbtt_error(esp_wake_ahead_ctrl_t *ctrl,
+                                    int64_t tsf_us, int64_t local_us,
+                                    int32_t *error_us);
+
+/**
+  * @brief     Feed one beacon into the controller
+  *
+  * @param     ctrl      controller
+  * @param     error_us  TBTT error of the beacon, ignored when missed
+  * @param     missed    the beacon was not received
+  *
+  * @return    true if the wake-ahead time changed
+  */
+bool esp_wake_ahead_sample(esp_wake_ahead_ctrl_t *ctrl, int32_t error_us,
+                           bool missed);
+
+/**
+  * @brief     Current wake-ahead time, in us
+  */
+uint32_t esp_wake_ahead_get(const esp_wake_ahead_ctrl_t *ctrl);
+
+/**
+  * @brief     Replay a recorded TBTT error trace through a controller
+  *
+  * A beacon counts as missed when its error exceeds the wake-ahead time
+  * in use when it arrived. Runs on the host.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_ERR_INVALID_ARG: invalid parameters
+  */
+esp_err_t esp_wake_ahead_replay(const esp_wake_ahead_config_t *cfg,
+                                const int32_t *errors_us, size_t n,
+                                esp_wake_ahead_replay_result_t *result);
+
+#if SOC_WIFI_HW_TSF
+/**
+  * @brief     Sample the station TSF and apply the controller output
+  *
+  * Call on every beacon the station wakes up for, with missed set when a
+  * beacon timeout was detected instead. Does nothing while the TSF is not
+  * active.
+  *
+  * @return    true if esp_wifi_internal_update_light_sleep_wake_ahead_time
+  *            was called
+  */
+bool esp_wake_ahead_on_beacon(esp_wake_ahead_ctrl_t *ctrl, bool missed);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WIFI_WAKE_AHEAD_H_ */
@@ -0,0 +1,538 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_metrics.h"
+
+#define METRICS_HALF     (1u << (ESP_METRICS_HDR_SUB_BITS - 1))
+#define METRICS_SHARED   (ESP_METRICS_SHARDS - 1)
+#define METRICS_LINE     160
+
+struct metrics_hist_shard
+{
+  uint64_t sum;
+  uint64_t buckets[ESP_METRICS_HDR_BUCKETS];
+};
+
+struct metrics_desc
+{
+  esp_metric_type_t type;
+  const char *name;
+  const char *labels;
+  const char *help;
+  struct metrics_hist_shard *hist;
+  uint32_t ready;
+};
+
+struct metrics_shard
+{
+  uint64_t counters[ESP_METRICS_MAX];
+} __attribute__((aligned(64)));
+
+static struct metrics_desc s_desc[ESP_METRICS_MAX];
+static uint32_t s_reserved;
+static struct metrics_shard s_shards[ESP_METRICS_SHARDS];
+static int64_t s_gauges[ESP_METRICS_MAX];
+
+#if ESP_METRICS_SHARDS > 1
+static uint32_t s_next_shard;
+static __thread int t_shard = -1;
+
+/* Owned shards are written by one thread, the last one is shared */
+
+static inline int metrics_shard(void)
+{
+  if (t_shard < 0)
+    {
+      t_shard = __atomic_fetch_add(&s_next_shard, 1, __ATOMIC_RELAXED);
+      if (t_shard > METRICS_SHARED)
+        {
+          t_shard = METRICS_SHARED;
+        }
+    }
+
+  return t_shard;
+}
+#else
+static inline int metrics_shard(void)
+{
+  return METRICS_SHARED;
+}
+#endif
+
+static inline void metrics_add64(uint64_t *p, uint64_t v, int shard)
+{
+  if (shard == METRICS_SHARED)
+    {
+      __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+    }
+  else
+    {
+      __atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + v,
+                       __ATOMIC_RELAXED);
+    }
+}
+
+static inline const struct metrics_desc *metrics_get(esp_metric_id_t id,
+                                                     esp_metric_type_t type)
+{
+  if (id < 0 || id >= ESP_METRICS_MAX ||
+      !__atomic_load_n(&s_desc[id].ready, __ATOMIC_ACQUIRE) ||
+      s_desc[id].type != type)
+    {
+      return NULL;
+    }
+
+  return &s_desc[id];
+}
+
+static uint32_t metrics_bucket(uint64_t v)
+{
+  uint32_t m;
+  uint32_t e;
+
+  if (v < 2 * METRICS_HALF)
+    {
+      return (uint32_t)v;
+    }
+
+  m = 63 - __builtin_clzll(v);
+  if (m >= ESP_METRICS_HDR_MAX_EXP)
+    {
+      return ESP_METRICS_HDR_BUCKETS - 1;
+    }
+
+  e = m - ESP_METRICS_HDR_SUB_BITS + 1;
+  return e * METRICS_HALF + (uint32_t)(v >> e);
+}
+
+/* Largest value counted in a bucket */
+
+static uint64_t metrics_bucket_max(uint32_t idx)
+{
+  uint32_t e;
+  uint64_t sub;
+
+  if (idx < 2 * METRICS_HALF)
+    {
+      return idx;
+    }
+
+  if (idx == ESP_METRICS_HDR_BUCKETS - 1)
+    {
+      return UINT64_MAX;
+    }
+
+  e = idx / METRICS_HALF - 1;
+  sub = idx % METRICS_HALF + METRICS_HALF;
+  return ((sub + 1) << e) - 1;
+}
+
+static uint64_t metrics_hist_total(const struct metrics_desc *d,
+                                   uint64_t *buckets)
+{
+  uint64_t sum = 0;
+  int s;
+  int i;
+
+  memset(buckets, 0, sizeof(uint64_t) * ESP_METRICS_HDR_BUCKETS);
+
+  for (s = 0; s < ESP_METRICS_SHARDS; s++)
+    {
+      sum += __atomic_load_n(&d->hist[s].sum, __ATOMIC_RELAXED);
+      for (i = 0; i < ESP_METRICS_HDR_BUCKETS; i++)
+        {
+          buckets[i] += __atomic_load_n(&d->hist[s].buckets[i],
+                                        __ATOMIC_RELAXED);
+        }
+    }
+
+  return sum;
+}
+
+esp_err_t esp_metrics_register(esp_metric_type_t type, const char *name,
+                               const char *labels, const char *help,
+                               esp_metric_id_t *id)
+{
+  struct metrics_desc *d;
+  struct metrics_hist_shard *hist = NULL;
+  uint32_t slot;
+
+  if (name == NULL || id == NULL || type > ESP_METRIC_HISTOGRAM)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (type == ESP_METRIC_HISTOGRAM)
+    {
+      hist = calloc(ESP_METRICS_SHARDS, sizeof(*hist));
+      if (hist == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  slot = __atomic_fetch_add(&s_reserved, 1, __ATOMIC_RELAXED);
+  if (slot >= ESP_METRICS_MAX)
+    {
+      free(hist);
+      return ESP_ERR_NO_MEM;
+    }
+
+  d = &s_desc[slot];
+  d->type = type;
+  d->name = name;
+  d->labels = labels;
+  d->help = help;
+  d->hist = hist;
+  __atomic_store_n(&d->ready, 1, __ATOMIC_RELEASE);
+
+  *id = (esp_metric_id_t)slot;
+  return ESP_OK;
+}
+
+void esp_metrics_add(esp_metric_id_t id, uint64_t v)
+{
+  int shard = metrics_shard();
+
+  if (id >= 0 && id < ESP_METRICS_MAX)
+    {
+      metrics_add64(&s_shards[shard].counters[id], v, shard);
+    }
+}
+
+void esp_metrics_gauge_set(esp_metric_id_t id, int64_t v)
+{
+  if (id >= 0 && id < ESP_METRICS_MAX)
+    {
+      __atomic_store_n(&s_gauges[id], v, __ATOMIC_RELAXED);
+    }
+}
+
+void esp_metrics_gauge_add(esp_metric_id_t id, int64_t delta)
+{
+  if (id >= 0 && id < ESP_METRICS_MAX)
+    {
+      __atomic_fetch_add(&s_gauges[id], delta, __ATOMIC_RELAXED);
+    }
+}
+
+void esp_metrics_observe(esp_metric_id_t id, uint64_t v)
+{
+  const struct metrics_desc *d = metrics_get(id, ESP_METRIC_HISTOGRAM);
+  struct metrics_hist_shard *h;
+  int shard;
+
+  if (d == NULL)
+    {
+      return;
+    }
+
+  shard = metrics_shard();
+  h = &d->hist[shard];
+  metrics_add64(&h->buckets[metrics_bucket(v)], 1, shard);
+  metrics_add64(&h->sum, v, shard);
+}
+
+uint64_t esp_metrics_get(esp_metric_id_t id)
+{
+  uint64_t v = 0;
+  int s;
+
+  if (metrics_get(id, ESP_METRIC_GAUGE))
+    {
+      return (uint64_t)__atomic_load_n(&s_gauges[id], __ATOMIC_RELAXED);
+    }
+
+  if (metrics_get(id, ESP_METRIC_COUNTER) == NULL)
+    {
+      return 0;
+    }
+
+  for (s = 0; s < ESP_METRICS_SHARDS; s++)
+    {
+      v += __atomic_load_n(&s_shards[s].counters[id], __ATOMIC_RELAXED);
+    }
+
+  return v;
+}
+
+esp_err_t esp_metrics_hist_summary(esp_metric_id_t id,
+                                   esp_metrics_hist_summary_t *summary)
+{
+  const struct metrics_desc *d = metrics_get(id, ESP_METRIC_HISTOGRAM);
+  uint64_t *buckets;
+  uint64_t rank[3];
+  uint64_t *out[3];
+  uint64_t cum = 0;
+  int q = 0;
+  int i;
+
+  if (d == NULL || summary == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  buckets = malloc(sizeof(uint64_t) * ESP_METRICS_HDR_BUCKETS);
+  if (buckets == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  memset(summary, 0, sizeof(*summary));
+  summary->sum = metrics_hist_total(d, buckets);
+
+  for (i = 0; i < ESP_METRICS_HDR_BUCKETS; i++)
+    {
+      summary->count += buckets[i];
+    }
+
+  rank[0] = (summary->count * 50 + 99) / 100;
+  rank[1] = (summary->count * 90 + 99) / 100;
+  rank[2] = (summary->count * 99 + 99) / 100;
+  out[0] = &summary->p50;
+  out[1] = &summary->p90;
+  out[2] = &summary->p99;
+
+  for (i = 0; i < ESP_METRICS_HDR_BUCKETS; i++)
+    {
+      if (buckets[i] == 0)
+        {
+          continue;
+        }
+
+      cum += buckets[i];
+      while (q < 3 && cum >= rank[q])
+        {
+          *out[q++] = metrics_bucket_max(i);
+        }
+
+      summary->max = metrics_bucket_max(i);
+    }
+
+  free(buckets);
+  return ESP_OK;
+}
+
+static int metrics_printf(esp_metrics_write_t write, void *arg,
+                          const char *fmt, ...)
+  __attribute__((format(printf, 3, 4)));
+
+static int metrics_printf(esp_metrics_write_t write, void *arg,
+                          const char *fmt, ...)
+{
+  char line[METRICS_LINE];
+  char *buf = line;
+  va_list ap;
+  int ret;
+  int n;
+
+  va_start(ap, fmt);
+  n = vsnprintf(line, sizeof(line), fmt, ap);
+  va_end(ap);
+
+  if (n < 0)
+    {
+      return n;
+    }
+
+  /* Longer lines are formatted again in full, never cut */
+
+  if ((size_t)n >= sizeof(line))
+    {
+      buf = malloc((size_t)n + 1);
+      if (buf == NULL)
+        {
+          return -1;
+        }
+
+      va_start(ap, fmt);
+      vsnprintf(buf, (size_t)n + 1, fmt, ap);
+      va_end(ap);
+    }
+
+  ret = write(arg, buf, (size_t)n);
+  if (buf != line)
+    {
+      free(buf);
+    }
+
+  return ret;
+}
+
+/* Write a "name{labels,extra} value" sample line */
+
+static int metrics_sample(esp_metrics_write_t write, void *arg,
+                          const struct metrics_desc *d, const char *suffix,
+                          const char *extra, const char *value)
+{
+  const char *labels = d->labels ? d->labels : "";
+  const char *sep = (*labels && extra) ? "," : "";
+
+  if (*labels == '\0' && extra == NULL)
+    {
+      return metrics_printf(write, arg, "%s%s %s\n", d->name, suffix,
+                            value);
+    }
+
+  return metrics_printf(write, arg, "%s%s{%s%s%s} %s\n", d->name, suffix,
+                        labels, sep, extra ? extra : "", value);
+}
+
+static int metrics_render_hist(esp_metrics_write_t write, void *arg,
+                               const struct metrics_desc *d)
+{
+  char value[24];
+  char le[32];
+  uint64_t *buckets;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t cum = 0;
+  int ret = 0;
+  int i;
+
+  buckets = malloc(sizeof(uint64_t) * ESP_METRICS_HDR_BUCKETS);
+  if (buckets == NULL)
+    {
+      return -1;
+    }
+
+  sum = metrics_hist_total(d, buckets);
+
+  /* One line per power of two, so that every scrape has the same le
+   * bounds whatever was observed
+   */
+
+  for (i = 0; i < ESP_METRICS_HDR_BUCKETS - 1 && ret >= 0; i++)
+    {
+      cum += buckets[i];
+      max = metrics_bucket_max(i);
+      if ((max & (max + 1)) != 0)
+        {
+          continue;
+        }
+
+      snprintf(le, sizeof(le), "le=\"%" PRIu64 "\"", max);
+      snprintf(value, sizeof(value), "%" PRIu64, cum);
+      ret = metrics_sample(write, arg, d, "_bucket", le, value);
+    }
+
+  cum += buckets[ESP_METRICS_HDR_BUCKETS - 1];
+  free(buckets);
+
+  snprintf(value, sizeof(value), "%" PRIu64, cum);
+  if (ret >= 0)
+    {
+      ret = metrics_sample(write, arg, d, "_bucket", "le=\"+Inf\"", value);
+    }
+
+  if (ret >= 0)
+    {
+      snprintf(le, sizeof(le), "%" PRIu64, sum);
+      ret = metrics_sample(write, arg, d, "_sum", NULL, le);
+    }
+
+  if (ret >= 0)
+    {
+      ret = metrics_sample(write, arg, d, "_count", NULL, value);
+    }
+
+  return ret;
+}
+
+esp_err_t esp_metrics_render(esp_metrics_write_t write, void *arg)
+{
+  static const char *const types[] =
+  {
+    "counter", "gauge", "histogram"
+  };
+
+  const struct metrics_desc *d;
+  char value[24];
+  uint32_t n = __atomic_load_n(&s_reserved, __ATOMIC_RELAXED);
+  uint32_t i;
+  uint32_t j;
+  int ret = 0;
+
+  if (n > ESP_METRICS_MAX)
+    {
+      n = ESP_METRICS_MAX;
+    }
+
+  for (i = 0; i < n && ret >= 0; i++)
+    {
+      d = &s_desc[i];
+      if (!__atomic_load_n(&d->ready, __ATOMIC_ACQUIRE))
+        {
+          continue;
+        }
+
+      /* HELP and TYPE once per name, on its first registration */
+
+      for (j = 0; j < i; j++)
+        {
+          if (__atomic_load_n(&s_desc[j].ready, __ATOMIC_ACQUIRE) &&
+              strcmp(s_desc[j].name, d->name) == 0)
+            {
+              break;
+            }
+        }
+
+      if (j == i)
+        {
+          if (d->help)
+            {
+              ret = metrics_printf(write, arg, "# HELP %s %s\n", d->name,
+                                   d->help);
+            }
+
+          if (ret >= 0)
+            {
+              ret = metrics_printf(write, arg, "# TYPE %s %s\n", d->name,
+                                   types[d->type]);
+            }
+        }
+
+      if (ret < 0)
+        {
+          break;
+        }
+
+      switch (d->type)
+        {
+          case ESP_METRIC_COUNTER:
+            snprintf(value, sizeof(value), "%" PRIu64, esp_metrics_get(i));
+            ret = metrics_sample(write, arg, d, "", NULL, value);
+            break;
+
+          case ESP_METRIC_GAUGE:
+            snprintf(value, sizeof(value), "%" PRId64,
+                     (int64_t)esp_metrics_get(i));
+            ret = metrics_sample(write, arg, d, "", NULL, value);
+            break;
+
+          default:
+            ret = metrics_render_hist(write, arg, d);
+            break;
+        }
+    }
+
+  return ret < 0 ? ESP_FAIL : ESP_OK;
+}
@@ -0,0 +1,166 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_metrics.h"
+
+#define METRICS_BENCH_VALUES    1024     /* observed in turn */
+#define METRICS_BENCH_RENDERS   10000    /* ops per render timed */
+
+static uint32_t metrics_bench_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static uint32_t metrics_bench_ns(clock_t cpu, uint32_t ops)
+{
+  return (uint32_t)((double)cpu * 1e9 / CLOCKS_PER_SEC / ops);
+}
+
+static int metrics_bench_write(void *arg, const char *data, size_t len)
+{
+  *(uint32_t *)arg += len;
+  return 0;
+}
+
+/* The top of the range in the last bucket before the overflow one */
+
+static esp_err_t metrics_bench_edges(void)
+{
+  esp_metrics_hist_summary_t summary;
+  esp_metric_id_t id;
+  uint64_t top = (1ull << ESP_METRICS_HDR_MAX_EXP) - 1;
+  esp_err_t ret;
+
+  ret = esp_metrics_register(ESP_METRIC_HISTOGRAM, "esp_metrics_bench_edge",
+                             NULL, NULL, &id);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  esp_metrics_observe(id, top);
+  ret = esp_metrics_hist_summary(id, &summary);
+  if (ret != ESP_OK || summary.max != top)
+    {
+      return ret != ESP_OK ? ret : ESP_FAIL;
+    }
+
+  esp_metrics_observe(id, top + 1);
+  ret = esp_metrics_hist_summary(id, &summary);
+  if (ret != ESP_OK || summary.max != UINT64_MAX || summary.p50 != top)
+    {
+      return ret != ESP_OK ? ret : ESP_FAIL;
+    }
+
+  return ESP_OK;
+}
+
+esp_err_t esp_metrics_bench(uint32_t ops, esp_metrics_bench_t *result)
+{
+  uint64_t values[METRICS_BENCH_VALUES];
+  esp_metric_id_t counter;
+  esp_metric_id_t hist;
+  volatile uint64_t sink = 0;
+  uint32_t rng = 1;
+  uint32_t renders;
+  uint32_t bytes = 0;
+  uint32_t i;
+  clock_t c0;
+  esp_err_t ret;
+
+  if (result == NULL || ops == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ret = metrics_bench_edges();
+  if (ret == ESP_OK)
+    {
+      ret = esp_metrics_register(ESP_METRIC_COUNTER,
+                                 "esp_metrics_bench_ops_total", NULL,
+                                 "Benchmark increments", &counter);
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_metrics_register(ESP_METRIC_HISTOGRAM,
+                                 "esp_metrics_bench_latency_us",
+                                 "layer=\"bench\"", "Benchmark values",
+                                 &hist);
+    }
+
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  /* Latencies of a few us to a few ms, as the datapath records */
+
+  for (i = 0; i < METRICS_BENCH_VALUES; i++)
+    {
+      values[i] = metrics_bench_rand(&rng) >> (20 + i % 12);
+    }
+
+  memset(result, 0, sizeof(*result));
+  result->ops = ops;
+
+  c0 = clock();
+  for (i = 0; i < ops; i++)
+    {
+      esp_metrics_inc(counter);
+    }
+
+  result->add_ns = metrics_bench_ns(clock() - c0, ops);
+
+  c0 = clock();
+  for (i = 0; i < ops; i++)
+    {
+      esp_metrics_observe(hist, values[i % METRICS_BENCH_VALUES]);
+    }
+
+  result->observe_ns = metrics_bench_ns(clock() - c0, ops);
+
+  c0 = clock();
+  for (i = 0; i < ops; i++)
+    {
+      sink += esp_metrics_get(counter);
+    }
+
+  result->get_ns = metrics_bench_ns(clock() - c0, ops);
+
+  renders = ops / METRICS_BENCH_RENDERS ? ops / METRICS_BENCH_RENDERS : 1;
+  c0 = clock();
+  for (i = 0; i < renders; i++)
+    {
+      bytes = 0;
+      if (esp_metrics_render(metrics_bench_write, &bytes) != ESP_OK)
+        {
+          return ESP_FAIL;
+        }
+    }
+
+  result->render_us = metrics_bench_ns(clock() - c0, renders) / 1000;
+  result->render_bytes = bytes;
+  return ESP_OK;
+}
@@ -0,0 +1,157 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "esp_metrics.h"
+
+static const char s_http_header[] =
+  "HTTP/1.0 200 OK\r\n"
+  "Content-Type: text/plain; version=0.0.4\r\n"
+  "Connection: close\r\n"
+  "\r\n";
+
+static int s_listen_fd = -1;
+static pthread_t s_thread;
+static struct sockaddr_un s_addr;
+
+static int metrics_unix_write(void *arg, const char *data, size_t len)
+{
+  int fd = *(int *)arg;
+  ssize_t n;
+
+  while (len > 0)
+    {
+      n = send(fd, data, len, MSG_NOSIGNAL);
+      if (n <= 0)
+        {
+          return -1;
+        }
+
+      data += n;
+      len -= n;
+    }
+
+  return 0;
+}
+
+static void *metrics_unix_thread(void *arg)
+{
+  struct timeval tv =
+  {
+    .tv_sec = 0,
+    .tv_usec = 100000,
+  };
+
+  char req[512];
+  int fd;
+
+  for (; ; )
+    {
+      /* Stop shuts the socket down, accept then fails with EINVAL */
+
+      fd = accept(s_listen_fd, NULL, NULL);
+      if (fd < 0)
+        {
+          if (errno == EINTR || errno == ECONNABORTED)
+            {
+              continue;
+            }
+
+          break;
+        }
+
+      /* The request is not looked at, every path returns the metrics */
+
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+      if (recv(fd, req, sizeof(req), 0) >= 0 &&
+          metrics_unix_write(&fd, s_http_header,
+                             sizeof(s_http_header) - 1) == 0)
+        {
+          esp_metrics_render(metrics_unix_write, &fd);
+        }
+
+      close(fd);
+    }
+
+  return NULL;
+}
+
+esp_err_t esp_metrics_serve_unix(const char *path)
+{
+  int fd;
+
+  if (path == NULL || strlen(path) >= sizeof(s_addr.sun_path))
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_listen_fd >= 0)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    {
+      return ESP_FAIL;
+    }
+
+  memset(&s_addr, 0, sizeof(s_addr));
+  s_addr.sun_family = AF_UNIX;
+  strcpy(s_addr.sun_path, path);
+  unlink(path);
+
+  if (bind(fd, (struct sockaddr *)&s_addr, sizeof(s_addr)) != 0 ||
+      listen(fd, 4) != 0)
+    {
+      close(fd);
+      return ESP_FAIL;
+    }
+
+  s_listen_fd = fd;
+  if (pthread_create(&s_thread, NULL, metrics_unix_thread, NULL) != 0)
+    {
+      s_listen_fd = -1;
+      close(fd);
+      unlink(path);
+      return ESP_FAIL;
+    }
+
+  return ESP_OK;
+}
+
+void esp_metrics_serve_stop(void)
+{
+  if (s_listen_fd < 0)
+    {
+      return;
+    }
+
+  shutdown(s_listen_fd, SHUT_RDWR);
+  pthread_join(s_thread, NULL);
+  close(s_listen_fd);
+  s_listen_fd = -1;
+  unlink(s_addr.sun_path);
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,182 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_metrics.h"
+
+enum
+{
+  METRICS_OSI_MUTEX_LOCK = 0,
+  METRICS_OSI_SEMPHR_TAKE,
+  METRICS_OSI_QUEUE_SEND,
+  METRICS_OSI_QUEUE_RECV,
+  METRICS_OSI_EVENT_POST,
+  METRICS_OSI_MAX
+};
+
+static const char *const g_metrics_osi_labels[METRICS_OSI_MAX] =
+{
+  "fn=\"mutex_lock\"",
+  "fn=\"semphr_take\"",
+  "fn=\"queue_send\"",
+  "fn=\"queue_recv\"",
+  "fn=\"event_post\"",
+};
+
+static wifi_osi_funcs_t *s_osi;
+static wifi_osi_funcs_t s_orig;
+static esp_metric_id_t s_calls[METRICS_OSI_MAX];
+static esp_metric_id_t s_wait[METRICS_OSI_MAX];
+static esp_metric_id_t s_depth;
+
+static void metrics_osi_done(int fn, int64_t t0)
+{
+  esp_metrics_inc(s_calls[fn]);
+  esp_metrics_observe(s_wait[fn], esp_timer_get_time() - t0);
+}
+
+static int32_t metrics_osi_mutex_lock(void *mutex)
+{
+  int64_t t0 = esp_timer_get_time();
+  int32_t ret = s_orig._mutex_lock(mutex);
+
+  metrics_osi_done(METRICS_OSI_MUTEX_LOCK, t0);
+  return ret;
+}
+
+static int32_t metrics_osi_semphr_take(void *semphr, uint32_t ticks)
+{
+  int64_t t0 = esp_timer_get_time();
+  int32_t ret = s_orig._semphr_take(semphr, ticks);
+
+  metrics_osi_done(METRICS_OSI_SEMPHR_TAKE, t0);
+  return ret;
+}
+
+static int32_t metrics_osi_queue_send(void *queue, void *item,
+                                      uint32_t ticks)
+{
+  int64_t t0 = esp_timer_get_time();
+  int32_t ret = s_orig._queue_send(queue, item, ticks);
+
+  metrics_osi_done(METRICS_OSI_QUEUE_SEND, t0);
+  return ret;
+}
+
+static int32_t metrics_osi_queue_recv(void *queue, void *item,
+                                      uint32_t ticks)
+{
+  int64_t t0 = esp_timer_get_time();
+  int32_t ret = s_orig._queue_recv(queue, item, ticks);
+
+  metrics_osi_done(METRICS_OSI_QUEUE_RECV, t0);
+  return ret;
+}
+
+/* The depth is raised before posting, the handler may run first. Only
+ * WIFI_EVENT is followed, the handler is registered for it alone.
+ */
+
+static int32_t metrics_osi_event_post(const char *base, int32_t id,
+                                      void *data, size_t size,
+                                      uint32_t ticks)
+{
+  int64_t t0 = esp_timer_get_time();
+  bool follow = base == WIFI_EVENT;
+  int32_t ret;
+
+  if (follow)
+    {
+      esp_metrics_gauge_add(s_depth, 1);
+    }
+
+  ret = s_orig._event_post(base, id, data, size, ticks);
+  if (follow && ret != ESP_OK)
+    {
+      esp_metrics_gauge_add(s_depth, -1);
+    }
+
+  metrics_osi_done(METRICS_OSI_EVENT_POST, t0);
+  return ret;
+}
+
+static void metrics_event_handler(void *arg, esp_event_base_t base,
+                                  int32_t id, void *data)
+{
+  esp_metrics_gauge_add(s_depth, -1);
+}
+
+esp_err_t esp_metrics_osi_install(wifi_osi_funcs_t *osi)
+{
+  esp_err_t ret = ESP_OK;
+  int i;
+
+  if (s_osi != NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  if (osi == NULL)
+    {
+      osi = &g_wifi_osi_funcs;
+    }
+
+  for (i = 0; i < METRICS_OSI_MAX && ret == ESP_OK; i++)
+    {
+      ret = esp_metrics_register(ESP_METRIC_COUNTER, "wifi_osi_calls_total",
+                                 g_metrics_osi_labels[i],
+                                 "Calls of the WiFi OS adapter",
+                                 &s_calls[i]);
+      if (ret == ESP_OK)
+        {
+          ret = esp_metrics_register(ESP_METRIC_HISTOGRAM,
+                                     "wifi_osi_wait_us",
+                                     g_metrics_osi_labels[i],
+                                     "Time spent in the WiFi OS adapter",
+                                     &s_wait[i]);
+        }
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_metrics_register(ESP_METRIC_GAUGE, "wifi_event_depth",
+                                 NULL, "WiFi events posted, not handled",
+                                 &s_depth);
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+                                       metrics_event_handler, NULL);
+    }
+
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  s_orig = *osi;
+  s_osi = osi;
+
+  osi->_mutex_lock = metrics_osi_mutex_lock;
+  osi->_semphr_take = metrics_osi_semphr_take;
+  osi->_queue_send = metrics_osi_queue_send;
+  osi->_queue_recv = metrics_osi_queue_recv;
+  osi->_event_post = metrics_osi_event_post;
+  return ESP_OK;
+}
@@ -0,0 +1,434 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_now_rate.h"
+
+#define RATE_ONE            1024 /* probability 1 */
+#define RATE_MIN_PROB       (RATE_ONE / 10)
+#define RATE_FRAME_HDR      50   /* MAC header, action and vendor fields */
+#define RATE_OVERHEAD_US    150  /* SIFS, ACK, DIFS and mean backoff */
+
+struct rate_info
+{
+  uint8_t rate;
+  uint8_t preamble_us;
+  uint32_t kbps;
+};
+
+static const struct rate_info g_rate_info[] =
+{
+  { WIFI_PHY_RATE_LORA_250K, 192, 250 },
+  { WIFI_PHY_RATE_LORA_500K, 192, 500 },
+  { WIFI_PHY_RATE_1M_L,      192, 1000 },
+  { WIFI_PHY_RATE_2M_L,      192, 2000 },
+  { WIFI_PHY_RATE_5M_L,      192, 5500 },
+  { WIFI_PHY_RATE_11M_L,     192, 11000 },
+  { WIFI_PHY_RATE_2M_S,      96,  2000 },
+  { WIFI_PHY_RATE_5M_S,      96,  5500 },
+  { WIFI_PHY_RATE_11M_S,     96,  11000 },
+  { WIFI_PHY_RATE_6M,        20,  6000 },
+  { WIFI_PHY_RATE_9M,        20,  9000 },
+  { WIFI_PHY_RATE_12M,       20,  12000 },
+  { WIFI_PHY_RATE_18M,       20,  18000 },
+  { WIFI_PHY_RATE_24M,       20,  24000 },
+  { WIFI_PHY_RATE_36M,       20,  36000 },
+  { WIFI_PHY_RATE_48M,       20,  48000 },
+  { WIFI_PHY_RATE_54M,       20,  54000 },
+  { WIFI_PHY_RATE_MCS0_LGI,  36,  6500 },
+  { WIFI_PHY_RATE_MCS1_LGI,  36,  13000 },
+  { WIFI_PHY_RATE_MCS2_LGI,  36,  19500 },
+  { WIFI_PHY_RATE_MCS3_LGI,  36,  26000 },
+  { WIFI_PHY_RATE_MCS4_LGI,  36,  39000 },
+  { WIFI_PHY_RATE_MCS5_LGI,  36,  52000 },
+  { WIFI_PHY_RATE_MCS6_LGI,  36,  58500 },
+  { WIFI_PHY_RATE_MCS7_LGI,  36,  65000 },
+  { WIFI_PHY_RATE_MCS0_SGI,  36,  7200 },
+  { WIFI_PHY_RATE_MCS1_SGI,  36,  14400 },
+  { WIFI_PHY_RATE_MCS2_SGI,  36,  21700 },
+  { WIFI_PHY_RATE_MCS3_SGI,  36,  28900 },
+  { WIFI_PHY_RATE_MCS4_SGI,  36,  43300 },
+  { WIFI_PHY_RATE_MCS5_SGI,  36,  57800 },
+  { WIFI_PHY_RATE_MCS6_SGI,  36,  65000 },
+  { WIFI_PHY_RATE_MCS7_SGI,  36,  72200 },
+};
+
+/* Rates are indices into the configured rates */
+
+struct rate_peer
+{
+  bool used;
+  uint8_t mac[6];
+  uint8_t best;
+  uint8_t head;                  /* of the pending ring */
+  uint8_t count;
+  uint8_t pending[ESP_NOW_RATE_PENDING];
+  uint16_t known;                /* rates with a probability */
+  uint32_t seen_ms;
+  uint32_t start_ms;             /* of the interval */
+  uint16_t att[ESP_NOW_RATE_MAX_RATES];
+  uint16_t succ[ESP_NOW_RATE_MAX_RATES];
+  uint16_t prob[ESP_NOW_RATE_MAX_RATES];
+  uint32_t tput[ESP_NOW_RATE_MAX_RATES];
+};
+
+struct esp_now_rate
+{
+  esp_now_rate_config_t cfg;
+  esp_now_rate_stats_t stats;
+  uint32_t rng;
+  uint8_t slowest;
+  uint32_t ideal[ESP_NOW_RATE_MAX_RATES];  /* kbps at full success */
+  struct rate_peer peers[ESP_NOW_RATE_PEERS];
+};
+
+static const struct rate_info *rate_info(wifi_phy_rate_t rate)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof(g_rate_info) / sizeof(g_rate_info[0]); i++)
+    {
+      if (g_rate_info[i].rate == rate)
+        {
+          return &g_rate_info[i];
+        }
+    }
+
+  return NULL;
+}
+
+static uint32_t rate_rand(esp_now_rate_t *rc)
+{
+  /* xorshift32 */
+
+  rc->rng ^= rc->rng << 13;
+  rc->rng ^= rc->rng >> 17;
+  rc->rng ^= rc->rng << 5;
+  return rc->rng;
+}
+
+static struct rate_peer *rate_find(const esp_now_rate_t *rc,
+                                   const uint8_t mac[6])
+{
+  const struct rate_peer *p;
+  int i;
+
+  for (i = 0; i < ESP_NOW_RATE_PEERS; i++)
+    {
+      p = &rc->peers[i];
+      if (p->used && memcmp(p->mac, mac, 6) == 0)
+        {
+          return (struct rate_peer *)p;
+        }
+    }
+
+  return NULL;
+}
+
+static struct rate_peer *rate_peer(esp_now_rate_t *rc, const uint8_t mac[6],
+                                   uint32_t now_ms)
+{
+  struct rate_peer *lru = &rc->peers[0];
+  struct rate_peer *p;
+  int i;
+
+  p = rate_find(rc, mac);
+  if (p)
+    {
+      p->seen_ms = now_ms;
+      return p;
+    }
+
+  for (i = 1; i < ESP_NOW_RATE_PEERS && lru->used; i++)
+    {
+      p = &rc->peers[i];
+      if (!p->used || now_ms - p->seen_ms > now_ms - lru->seen_ms)
+        {
+          lru = p;
+        }
+    }
+
+  if (lru->used)
+    {
+      rc->stats.evictions++;
+    }
+
+  memset(lru, 0, sizeof(*lru));
+  lru->used = true;
+  memcpy(lru->mac, mac, 6);
+  lru->best = rc->slowest;
+  lru->seen_ms = now_ms;
+  lru->start_ms = now_ms;
+  return lru;
+}
+
+/* Close the interval: success ratios into the EWMA, the best rate */
+
+static void rate_update(esp_now_rate_t *rc, struct rate_peer *p,
+                        uint32_t now_ms)
+{
+  uint32_t ratio;
+  uint8_t best = p->best;
+  int i;
+
+  if (now_ms - p->start_ms < rc->cfg.interval_ms)
+    {
+      return;
+    }
+
+  p->start_ms = now_ms;
+  for (i = 0; i < rc->cfg.n_rates; i++)
+    {
+      if (p->att[i] == 0)
+        {
+          continue;
+        }
+
+      ratio = (uint32_t)p->succ[i] * RATE_ONE / p->att[i];
+      if (p->known & (1u << i))
+        {
+          p->prob[i] = (p->prob[i] * rc->cfg.ewma_percent +
+                        ratio * (100 - rc->cfg.ewma_percent)) / 100;
+        }
+      else
+        {
+          p->prob[i] = ratio;
+          p->known |= 1u << i;
+        }
+
+      p->tput[i] = p->prob[i] < RATE_MIN_PROB ? 0 :
+                   rc->ideal[i] * p->prob[i] / RATE_ONE;
+      p->att[i] = 0;
+      p->succ[i] = 0;
+    }
+
+  for (i = 0; i < rc->cfg.n_rates; i++)
+    {
+      if ((p->known & (1u << i)) && p->tput[i] > p->tput[best])
+        {
+          best = i;
+        }
+    }
+
+  if (best != p->best)
+    {
+      p->best = best;
+      rc->stats.switches++;
+    }
+}
+
+/* A rate that could beat the best at full success, from a random one */
+
+static int rate_sample(esp_now_rate_t *rc, const struct rate_peer *p)
+{
+  uint8_t n = rc->cfg.n_rates;
+  uint8_t j;
+  int k;
+
+  j = rate_rand(rc) % n;
+  for (k = 0; k < n; k++, j = (j + 1) % n)
+    {
+      if (j != p->best && rc->ideal[j] > p->tput[p->best])
+        {
+          return j;
+        }
+    }
+
+  return -1;
+}
+
+void esp_now_rate_default(esp_now_rate_config_t *cfg)
+{
+  static const wifi_phy_rate_t rates[] =
+  {
+    WIFI_PHY_RATE_LORA_250K, WIFI_PHY_RATE_LORA_500K,
+    WIFI_PHY_RATE_1M_L, WIFI_PHY_RATE_2M_S, WIFI_PHY_RATE_5M_S,
+    WIFI_PHY_RATE_11M_S, WIFI_PHY_RATE_MCS0_LGI, WIFI_PHY_RATE_MCS1_LGI,
+    WIFI_PHY_RATE_MCS2_LGI, WIFI_PHY_RATE_MCS3_LGI,
+    WIFI_PHY_RATE_MCS4_LGI, WIFI_PHY_RATE_MCS5_LGI,
+    WIFI_PHY_RATE_MCS6_LGI, WIFI_PHY_RATE_MCS7_LGI
+  };
+
+  memset(cfg, 0, sizeof(*cfg));
+  memcpy(cfg->rates, rates, sizeof(rates));
+  cfg->n_rates = sizeof(rates) / sizeof(rates[0]);
+  cfg->interval_ms = 100;
+  cfg->ewma_percent = 75;
+  cfg->sample_percent = 10;
+  cfg->frame_len = 250;
+}
+
+esp_err_t esp_now_rate_create(const esp_now_rate_config_t *cfg,
+                              esp_now_rate_t **rc)
+{
+  esp_now_rate_t *r;
+  int i;
+
+  if (cfg == NULL || rc == NULL || cfg->n_rates == 0 ||
+      cfg->n_rates > ESP_NOW_RATE_MAX_RATES || cfg->interval_ms == 0 ||
+      cfg->ewma_percent > 100 || cfg->sample_percent > 100)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  for (i = 0; i < cfg->n_rates; i++)
+    {
+      if (rate_info(cfg->rates[i]) == NULL)
+        {
+          return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+  r = calloc(1, sizeof(*r));
+  if (r == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  r->cfg = *cfg;
+  r->rng = 1;
+  for (i = 0; i < cfg->n_rates; i++)
+    {
+      r->ideal[i] = (uint32_t)cfg->frame_len * 8 * 1000 /
+                    esp_now_rate_airtime_us(cfg->rates[i], cfg->frame_len);
+      if (r->ideal[i] < r->ideal[r->slowest])
+        {
+          r->slowest = i;
+        }
+    }
+
+  *rc = r;
+  return ESP_OK;
+}
+
+void esp_now_rate_delete(esp_now_rate_t *rc)
+{
+  free(rc);
+}
+
+wifi_phy_rate_t esp_now_rate_pick(esp_now_rate_t *rc, const uint8_t mac[6],
+                                  uint32_t now_ms)
+{
+  struct rate_peer *p;
+  int i;
+
+  rc->stats.frames++;
+  if (mac[0] & 0x01)
+    {
+      return rc->cfg.rates[rc->slowest];
+    }
+
+  p = rate_peer(rc, mac, now_ms);
+  rate_update(rc, p, now_ms);
+
+  i = p->best;
+  if (rate_rand(rc) % 100 < rc->cfg.sample_percent)
+    {
+      i = rate_sample(rc, p);
+      if (i < 0)
+        {
+          i = p->best;
+        }
+      else
+        {
+          rc->stats.samples++;
+        }
+    }
+
+  /* The oldest status is lost past the ring */
+
+  if (p->count == ESP_NOW_RATE_PENDING)
+    {
+      p->head = (p->head + 1) % ESP_NOW_RATE_PENDING;
+      p->count--;
+    }
+
+  p->pending[(p->head + p->count) % ESP_NOW_RATE_PENDING] = i;
+  p->count++;
+  return rc->cfg.rates[i];
+}
+
+void esp_now_rate_drop(esp_now_rate_t *rc, const uint8_t mac[6])
+{
+  struct rate_peer *p = rate_find(rc, mac);
+
+  if (p && p->count)
+    {
+      p->count--;
+    }
+}
+
+void esp_now_rate_result(esp_now_rate_t *rc, const uint8_t mac[6], bool ok,
+                         uint32_t now_ms)
+{
+  struct rate_peer *p = rate_find(rc, mac);
+  uint8_t i;
+
+  if (p == NULL || p->count == 0)
+    {
+      return;
+    }
+
+  i = p->pending[p->head];
+  p->head = (p->head + 1) % ESP_NOW_RATE_PENDING;
+  p->count--;
+  if (p->att[i] < UINT16_MAX)
+    {
+      p->att[i]++;
+      p->succ[i] += ok;
+    }
+
+  if (ok)
+    {
+      rc->stats.ok++;
+    }
+  else
+    {
+      rc->stats.failed++;
+    }
+
+  rate_update(rc, p, now_ms);
+}
+
+wifi_phy_rate_t esp_now_rate_best(const esp_now_rate_t *rc,
+                                  const uint8_t mac[6])
+{
+  const struct rate_peer *p = rate_find(rc, mac);
+
+  return rc->cfg.rates[p ? p->best : rc->slowest];
+}
+
+void esp_now_rate_get_stats(const esp_now_rate_t *rc,
+                            esp_now_rate_stats_t *stats)
+{
+  *stats = rc->stats;
+}
+
+uint32_t esp_now_rate_airtime_us(wifi_phy_rate_t rate, uint16_t len)
+{
+  const struct rate_info *info = rate_info(rate);
+  uint32_t bits = ((uint32_t)len + RATE_FRAME_HDR) * 8;
+
+  if (info == NULL)
+    {
+      return 0;
+    }
+
+  return info->preamble_us + (bits * 1000 + info->kbps - 1) / info->kbps +
+         RATE_OVERHEAD_US;
+}
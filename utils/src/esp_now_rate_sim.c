@@ -0,0 +1,289 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_now_rate.h"
+
+#define SIM_SLOPE_DB        3    /* from 50% to 0 and 100% delivery */
+
+enum
+{
+  SIM_LOW,
+  SIM_HIGH,
+  SIM_ADAPTIVE,
+  SIM_ORACLE,
+  SIM_POLICIES
+};
+
+struct sim_acc
+{
+  uint32_t ok;
+  uint64_t airtime_us;
+};
+
+static uint32_t rate_sim_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+/* SNR of 50% delivery, dB, roughly after the receiver sensitivities */
+
+static int rate_sim_snr50(wifi_phy_rate_t rate)
+{
+  switch (rate)
+    {
+      case WIFI_PHY_RATE_LORA_250K:
+        return 0;
+      case WIFI_PHY_RATE_LORA_500K:
+        return 2;
+      case WIFI_PHY_RATE_1M_L:
+        return 4;
+      case WIFI_PHY_RATE_2M_L:
+      case WIFI_PHY_RATE_2M_S:
+        return 6;
+      case WIFI_PHY_RATE_5M_L:
+      case WIFI_PHY_RATE_5M_S:
+        return 8;
+      case WIFI_PHY_RATE_11M_L:
+      case WIFI_PHY_RATE_11M_S:
+        return 11;
+      case WIFI_PHY_RATE_6M:
+      case WIFI_PHY_RATE_MCS0_LGI:
+      case WIFI_PHY_RATE_MCS0_SGI:
+        return 5;
+      case WIFI_PHY_RATE_9M:
+        return 7;
+      case WIFI_PHY_RATE_12M:
+      case WIFI_PHY_RATE_MCS1_LGI:
+      case WIFI_PHY_RATE_MCS1_SGI:
+        return 8;
+      case WIFI_PHY_RATE_18M:
+      case WIFI_PHY_RATE_MCS2_LGI:
+      case WIFI_PHY_RATE_MCS2_SGI:
+        return 11;
+      case WIFI_PHY_RATE_24M:
+      case WIFI_PHY_RATE_MCS3_LGI:
+      case WIFI_PHY_RATE_MCS3_SGI:
+        return 14;
+      case WIFI_PHY_RATE_36M:
+      case WIFI_PHY_RATE_MCS4_LGI:
+      case WIFI_PHY_RATE_MCS4_SGI:
+        return 18;
+      case WIFI_PHY_RATE_48M:
+      case WIFI_PHY_RATE_MCS5_LGI:
+      case WIFI_PHY_RATE_MCS5_SGI:
+        return 22;
+      case WIFI_PHY_RATE_54M:
+      case WIFI_PHY_RATE_MCS6_LGI:
+      case WIFI_PHY_RATE_MCS6_SGI:
+        return 24;
+      default:
+        return 26;
+    }
+}
+
+/* Delivery probability at snr, permille, linear around the 50% point */
+
+static int32_t rate_sim_permille(wifi_phy_rate_t rate, int32_t snr)
+{
+  int32_t p;
+
+  p = 500 + (snr - rate_sim_snr50(rate)) * 500 / SIM_SLOPE_DB;
+  return p < 0 ? 0 : p > 1000 ? 1000 : p;
+}
+
+/* The configured rate of the best expected throughput at snr */
+
+static wifi_phy_rate_t rate_sim_oracle(const esp_now_rate_config_t *cfg,
+                                       int32_t snr)
+{
+  wifi_phy_rate_t best = cfg->rates[0];
+  uint64_t best_tput = 0;
+  uint64_t tput;
+  int i;
+
+  for (i = 0; i < cfg->n_rates; i++)
+    {
+      tput = (uint64_t)rate_sim_permille(cfg->rates[i], snr) * 1000000 /
+             esp_now_rate_airtime_us(cfg->rates[i], cfg->frame_len);
+      if (tput > best_tput)
+        {
+          best = cfg->rates[i];
+          best_tput = tput;
+        }
+    }
+
+  return best;
+}
+
+/* Over the peers, the goodput of each weighing the same, not to be
+ * swamped by the airtime of the farthest
+ */
+
+static void rate_sim_stat(const struct sim_acc *acc, uint8_t peers,
+                          uint32_t frames, uint16_t len,
+                          esp_now_rate_sim_stat_t *stat)
+{
+  uint64_t airtime_us = 0;
+  uint64_t goodput = 0;
+  uint32_t ok = 0;
+  int i;
+
+  for (i = 0; i < peers; i++)
+    {
+      ok += acc[i].ok;
+      airtime_us += acc[i].airtime_us;
+      if (acc[i].airtime_us)
+        {
+          goodput += (uint64_t)acc[i].ok * len * 8 * 1000 /
+                     acc[i].airtime_us;
+        }
+    }
+
+  stat->delivered_permille = (uint64_t)ok * 1000 / frames;
+  stat->airtime_ms = airtime_us / 1000;
+  stat->goodput_kbps = goodput / peers;
+}
+
+void esp_now_rate_sim_default(esp_now_rate_sim_t *sim)
+{
+  memset(sim, 0, sizeof(*sim));
+  sim->seconds = 60;
+  sim->peers = 4;
+  sim->frames_per_s = 50;
+  sim->frame_len = 250;
+  sim->snr_min = 2;
+  sim->snr_max = 26;
+  sim->fade_db = 8;
+  sim->fade_period_ms = 20000;
+  sim->noise_db = 2;
+  sim->seed = 1;
+}
+
+esp_err_t esp_now_rate_sim_run(const esp_now_rate_sim_t *sim,
+                               esp_now_rate_sim_result_t *result)
+{
+  struct sim_acc acc[SIM_POLICIES][ESP_NOW_RATE_PEERS];
+  wifi_phy_rate_t rate[SIM_POLICIES];
+  esp_now_rate_config_t cfg;
+  esp_now_rate_stats_t stats;
+  esp_now_rate_t *rc;
+  uint8_t mac[6] =
+  {
+    0x24, 0x0a, 0xc4, 0x00, 0x00, 0x00
+  };
+
+  uint32_t rng;
+  uint32_t period;
+  uint32_t steps;
+  uint32_t now;
+  uint32_t x;
+  int32_t u;
+  uint32_t k;
+  int32_t base;
+  int32_t snr;
+  esp_err_t ret;
+  int i;
+  int j;
+
+  if (sim == NULL || result == NULL || sim->seconds == 0 ||
+      sim->peers == 0 || sim->peers > ESP_NOW_RATE_PEERS ||
+      sim->frames_per_s == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  esp_now_rate_default(&cfg);
+  cfg.frame_len = sim->frame_len;
+  ret = esp_now_rate_create(&cfg, &rc);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  memset(acc, 0, sizeof(acc));
+  rng = sim->seed ? sim->seed : 1;
+  period = sim->fade_period_ms ? sim->fade_period_ms : 1;
+  steps = sim->seconds * sim->frames_per_s;
+  rate[SIM_LOW] = WIFI_PHY_RATE_1M_L;
+  rate[SIM_HIGH] = WIFI_PHY_RATE_MCS7_LGI;
+
+  for (k = 0; k < steps; k++)
+    {
+      now = (uint64_t)k * 1000 / sim->frames_per_s;
+      for (i = 0; i < sim->peers; i++)
+        {
+          mac[5] = i + 1;
+          base = sim->snr_min;
+          if (sim->peers > 1)
+            {
+              base += (sim->snr_max - sim->snr_min) * i / (sim->peers - 1);
+            }
+
+          /* Triangle from 0 down to -fade and back, the peers out of
+           * phase, known to the oracle, and the noise of the frame on top
+           */
+
+          x = (uint64_t)((now + period * i / sim->peers) % period) * 2 *
+              sim->fade_db / period;
+          snr = base - (int32_t)(x < sim->fade_db ? x :
+                                 2 * sim->fade_db - x);
+          rate[SIM_ORACLE] = rate_sim_oracle(&cfg, snr);
+          if (sim->noise_db)
+            {
+              snr += (int32_t)(rate_sim_rand(&rng) %
+                               (2 * sim->noise_db + 1)) - sim->noise_db;
+            }
+
+          /* One draw for all the policies, the same channel for each */
+
+          u = rate_sim_rand(&rng) % 1000;
+          rate[SIM_ADAPTIVE] = esp_now_rate_pick(rc, mac, now);
+          for (j = 0; j < SIM_POLICIES; j++)
+            {
+              acc[j][i].ok += u < rate_sim_permille(rate[j], snr);
+              acc[j][i].airtime_us += esp_now_rate_airtime_us(rate[j],
+                                                              sim->frame_len);
+            }
+
+          esp_now_rate_result(rc, mac,
+                              u < rate_sim_permille(rate[SIM_ADAPTIVE], snr),
+                              now);
+        }
+    }
+
+  esp_now_rate_get_stats(rc, &stats);
+  esp_now_rate_delete(rc);
+
+  memset(result, 0, sizeof(*result));
+  result->frames = steps * sim->peers;
+  rate_sim_stat(acc[SIM_LOW], sim->peers, result->frames,
+                sim->frame_len, &result->low);
+  rate_sim_stat(acc[SIM_HIGH], sim->peers, result->frames,
+                sim->frame_len, &result->high);
+  rate_sim_stat(acc[SIM_ADAPTIVE], sim->peers, result->frames,
+                sim->frame_len, &result->adaptive);
+  rate_sim_stat(acc[SIM_ORACLE], sim->peers, result->frames,
+                sim->frame_len, &result->oracle);
+  result->switches = stats.switches;
+  result->samples = stats.samples;
+  return ESP_OK;
+}
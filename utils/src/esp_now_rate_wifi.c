@@ -0,0 +1,208 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_now_rate.h"
+
+/* Provided by libespnow.a, esp_now.h is not part of this tree */
+
+extern esp_err_t esp_now_send(const uint8_t *peer_addr, const uint8_t *data,
+                              size_t len);
+extern esp_err_t esp_now_register_send_cb(void (*cb)(const uint8_t *mac_addr,
+                                                     int status));
+extern esp_err_t esp_now_unregister_send_cb(void);
+
+#define RATE_NONE           WIFI_PHY_RATE_MAX
+#define RATE_SEND_WAIT_MS   200     /* for the status of the last frame */
+
+static esp_now_rate_t *s_rc;
+static void *s_lock;
+static void *s_idle;                        /* taken by the frame in flight */
+static bool s_busy;
+static wifi_interface_t s_ifx;
+static wifi_phy_rate_t s_rate = RATE_NONE;  /* fixed on s_ifx */
+static esp_now_rate_send_cb_t s_cb;
+
+static uint32_t rate_now_ms(void)
+{
+  return esp_timer_get_time() / 1000;
+}
+
+/* Called with s_lock held by the one that ends the frame in flight:
+ * the driver gets its rate control back and the next send may go.
+ */
+
+static void rate_idle(void)
+{
+  if (s_rate != RATE_NONE)
+    {
+      esp_wifi_internal_set_fix_rate(s_ifx, false, s_rate);
+      s_rate = RATE_NONE;
+    }
+
+  if (s_busy)
+    {
+      s_busy = false;
+      g_wifi_osi_funcs._semphr_give(s_idle);
+    }
+}
+
+/* ESP_NOW_SEND_SUCCESS is 0 */
+
+static void rate_send_cb(const uint8_t *mac_addr, int status)
+{
+  esp_now_rate_send_cb_t cb;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_rc)
+    {
+      esp_now_rate_result(s_rc, mac_addr, status == 0, rate_now_ms());
+    }
+
+  rate_idle();
+  cb = s_cb;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  if (cb)
+    {
+      cb(mac_addr, status == 0);
+    }
+}
+
+esp_err_t esp_now_rate_start(esp_now_rate_t *rc, wifi_interface_t ifx,
+                             esp_now_rate_send_cb_t cb)
+{
+  esp_err_t ret;
+
+  if (rc == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      s_idle = g_wifi_osi_funcs._semphr_create(1, 1);
+      if (s_idle == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          g_wifi_osi_funcs._semphr_delete(s_idle);
+          s_idle = NULL;
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_rc)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  s_rc = rc;
+  s_ifx = ifx;
+  s_rate = RATE_NONE;
+  s_cb = cb;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  ret = esp_now_register_send_cb(rate_send_cb);
+  if (ret != ESP_OK)
+    {
+      esp_now_rate_stop();
+    }
+
+  return ret;
+}
+
+void esp_now_rate_stop(void)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  esp_now_unregister_send_cb();
+
+  /* A frame in flight gets no status any more */
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  rate_idle();
+  s_rc = NULL;
+  s_cb = NULL;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+esp_err_t esp_now_rate_send(const uint8_t mac[6], const uint8_t *data,
+                            size_t len)
+{
+  wifi_phy_rate_t rate;
+  uint32_t wait;
+  esp_err_t ret;
+
+  if (mac == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  /* The rate is fixed for the interface, not the frame: one frame is in
+   * flight at a time, and the rate control of the driver is back as
+   * soon as its status is in, so that other traffic of the interface
+   * goes at a fixed rate for no longer than an ESP-NOW frame.
+   */
+
+  wait = g_wifi_osi_funcs._task_ms_to_tick(RATE_SEND_WAIT_MS);
+  if (!g_wifi_osi_funcs._semphr_take(s_idle, wait))
+    {
+      return ESP_ERR_TIMEOUT;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  s_busy = true;
+  if (s_rc == NULL)
+    {
+      rate_idle();
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  rate = esp_now_rate_pick(s_rc, mac, rate_now_ms());
+  ret = esp_wifi_internal_set_fix_rate(s_ifx, true, rate);
+  if (ret == ESP_OK)
+    {
+      s_rate = rate;
+      ret = esp_now_send(mac, data, len);
+    }
+
+  if (ret != ESP_OK)
+    {
+      esp_now_rate_drop(s_rc, mac);
+      rate_idle();
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+  return ret;
+}
@@ -0,0 +1,721 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_now_sched.h"
+
+#define SCHED_NONE       0xffff
+
+/* Demand is kept as frames per base interval, 10 bit fixed point */
+
+#define RATE_ONE         1024
+
+struct sched_frame
+{
+  void *data;
+  size_t len;
+  int64_t time;
+};
+
+struct sched_node
+{
+  uint8_t mac[6];
+  bool used;
+  bool change_pending;   /* not yet popped by esp_now_sched_next_change */
+  bool switch_pending;   /* gateway still uses the old schedule */
+  uint8_t shift;
+  uint8_t phase;
+  uint8_t next_shift;
+  uint8_t next_phase;
+  uint16_t slot;
+  uint16_t next_in_slot;
+  uint8_t q_head;
+  uint8_t q_count;
+  uint32_t arrivals;
+  uint32_t rate;
+};
+
+struct esp_now_sched
+{
+  esp_now_sched_config_t cfg;
+  int64_t epoch;
+  int64_t last_window;
+  uint16_t nslots;
+  uint16_t nnodes;
+  uint16_t change_cursor;
+  uint16_t *slot_head;
+  uint32_t *slot_load;
+  struct sched_node *nodes;
+  struct sched_frame *frames;
+  esp_now_sched_stats_t stats;
+};
+
+static uint32_t sched_weight(const esp_now_sched_t *sched, uint8_t shift)
+{
+  return 1u << (sched->cfg.max_shift - shift);
+}
+
+static struct sched_frame *sched_frame(esp_now_sched_t *sched, uint16_t id,
+                                       uint8_t i)
+{
+  return &sched->frames[id * sched->cfg.queue_len +
+                        (i % sched->cfg.queue_len)];
+}
+
+static void sched_assign(const esp_now_sched_t *sched,
+                         const struct sched_node *node,
+                         esp_now_sched_assign_t *assign)
+{
+  uint8_t shift = node->switch_pending ? node->next_shift : node->shift;
+  uint8_t phase = node->switch_pending ? node->next_phase : node->phase;
+
+  assign->interval_ms = (uint16_t)(sched->cfg.interval_ms << shift);
+  assign->window_ms = sched->cfg.window_ms;
+  assign->offset_ms = (uint32_t)phase * sched->cfg.interval_ms +
+                      (uint32_t)node->slot * sched->cfg.window_ms;
+  assign->slot = node->slot;
+  assign->shift = shift;
+  assign->phase = phase;
+}
+
+static uint8_t sched_pick_shift(const esp_now_sched_t *sched,
+                                const struct sched_node *node)
+{
+  const esp_now_sched_config_t *cfg = &sched->cfg;
+  uint8_t shift = 0;
+  bool busy;
+
+  /* Longest interval that still sees about one frame per wake up and,
+   * for a node expecting traffic within the longest interval, meets the
+   * latency bound.
+   */
+
+  busy = node->q_count > 1 ||
+         (node->rate << cfg->max_shift) >= RATE_ONE / 2;
+
+  while (shift < cfg->max_shift)
+    {
+      if ((node->rate << (shift + 1)) > RATE_ONE)
+        {
+          break;
+        }
+
+      if (busy &&
+          ((uint32_t)cfg->interval_ms << (shift + 1)) > cfg->max_latency_ms)
+        {
+          break;
+        }
+
+      shift++;
+    }
+
+  /* Back off one step at a time so that a short lull does not send a
+   * busy node to the longest interval.
+   */
+
+  if (shift > node->shift + 1)
+    {
+      shift = node->shift + 1;
+    }
+
+  return shift;
+}
+
+static void sched_adapt(esp_now_sched_t *sched, int64_t cycle)
+{
+  struct sched_node *node;
+  uint32_t sample;
+  uint8_t shift;
+  uint16_t id;
+
+  for (id = 0; id < sched->nnodes; id++)
+    {
+      node = &sched->nodes[id];
+      if (!node->used || node->switch_pending)
+        {
+          continue;
+        }
+
+      sample = node->arrivals * RATE_ONE / sched->cfg.adapt_cycles;
+      node->rate = (node->rate * 7 + sample) / 8;
+      node->arrivals = 0;
+
+      shift = sched_pick_shift(sched, node);
+      if (shift == node->shift)
+        {
+          continue;
+        }
+
+      /* Start the new schedule on the next cycle it allows */
+
+      node->next_shift = shift;
+      node->next_phase = (uint8_t)((cycle + 1) & ((1 << shift) - 1));
+      node->change_pending = true;
+      node->switch_pending = true;
+    }
+}
+
+static void sched_switch(esp_now_sched_t *sched, struct sched_node *node)
+{
+  sched->slot_load[node->slot] -= sched_weight(sched, node->shift);
+  node->shift = node->next_shift;
+  node->phase = node->next_phase;
+  sched->slot_load[node->slot] += sched_weight(sched, node->shift);
+  node->switch_pending = false;
+  sched->stats.reassigned++;
+}
+
+static void sched_serve(esp_now_sched_t *sched, int64_t cycle,
+                        uint16_t slot, int64_t now)
+{
+  const esp_now_sched_config_t *cfg = &sched->cfg;
+  struct sched_frame *frame;
+  struct sched_node *node;
+  uint32_t budget = cfg->slot_capacity;
+  uint32_t latency;
+  bool progress = true;
+  uint16_t id;
+
+  /* Round robin, one frame per awake node per pass */
+
+  while (budget != 0 && progress)
+    {
+      progress = false;
+
+      for (id = sched->slot_head[slot]; id != SCHED_NONE && budget != 0;
+           id = node->next_in_slot)
+        {
+          node = &sched->nodes[id];
+          if ((cycle & ((1 << node->shift) - 1)) != node->phase ||
+              node->q_count == 0)
+            {
+              continue;
+            }
+
+          frame = sched_frame(sched, id, node->q_head);
+          node->q_head++;
+          node->q_count--;
+          budget--;
+          progress = true;
+
+          if (cfg->send(node->mac, frame->data, frame->len, cfg->arg) ==
+              ESP_OK)
+            {
+              latency = (uint32_t)(now - frame->time);
+              sched->stats.sent++;
+              sched->stats.latency_sum_us += latency;
+              if (latency > sched->stats.latency_max_us)
+                {
+                  sched->stats.latency_max_us = latency;
+                }
+            }
+          else
+            {
+              sched->stats.send_failed++;
+            }
+
+          if (cfg->free)
+            {
+              cfg->free(frame->data, cfg->arg);
+            }
+        }
+    }
+
+  /* A node moves to its new schedule once the gateway had the chance to
+   * deliver it, i.e. after a window that drained its queue.
+   */
+
+  for (id = sched->slot_head[slot]; id != SCHED_NONE;
+       id = node->next_in_slot)
+    {
+      node = &sched->nodes[id];
+      if (node->switch_pending && !node->change_pending &&
+          node->q_count == 0 &&
+          (cycle & ((1 << node->shift) - 1)) == node->phase)
+        {
+          sched_switch(sched, node);
+        }
+    }
+}
+
+void esp_now_sched_default(esp_now_sched_config_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->interval_ms = 100;
+  cfg->window_ms = 10;
+  cfg->max_nodes = 500;
+  cfg->queue_len = 8;
+  cfg->max_shift = 5;
+  cfg->slot_capacity = 20;
+  cfg->max_latency_ms = 400;
+  cfg->adapt_cycles = 50;
+  cfg->adaptive = true;
+}
+
+esp_err_t esp_now_sched_create(const esp_now_sched_config_t *cfg,
+                               int64_t epoch, esp_now_sched_t **out)
+{
+  esp_now_sched_t *sched;
+  uint16_t i;
+
+  if (cfg == NULL || out == NULL || cfg->send == NULL ||
+      cfg->window_ms == 0 || cfg->interval_ms < cfg->window_ms ||
+      cfg->max_nodes == 0 || cfg->max_nodes == SCHED_NONE ||
+      cfg->queue_len == 0 || cfg->slot_capacity == 0 ||
+      cfg->max_shift > ESP_NOW_SCHED_MAX_SHIFT || cfg->adapt_cycles == 0 ||
+      ((uint32_t)cfg->interval_ms << cfg->max_shift) > UINT16_MAX)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  sched = calloc(1, sizeof(*sched));
+  if (sched == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  sched->cfg = *cfg;
+  sched->epoch = epoch;
+  sched->last_window = -1;
+  sched->nslots = cfg->interval_ms / cfg->window_ms;
+  sched->slot_head = malloc(sched->nslots * sizeof(uint16_t));
+  sched->slot_load = calloc(sched->nslots, sizeof(uint32_t));
+  sched->nodes = calloc(cfg->max_nodes, sizeof(struct sched_node));
+  sched->frames = calloc((size_t)cfg->max_nodes * cfg->queue_len,
+                         sizeof(struct sched_frame));
+
+  if (sched->slot_head == NULL || sched->slot_load == NULL ||
+      sched->nodes == NULL || sched->frames == NULL)
+    {
+      esp_now_sched_delete(sched);
+      return ESP_ERR_NO_MEM;
+    }
+
+  for (i = 0; i < sched->nslots; i++)
+    {
+      sched->slot_head[i] = SCHED_NONE;
+    }
+
+  *out = sched;
+  return ESP_OK;
+}
+
+void esp_now_sched_delete(esp_now_sched_t *sched)
+{
+  struct sched_node *node;
+  uint16_t id;
+
+  if (sched == NULL)
+    {
+      return;
+    }
+
+  for (id = 0; sched->nodes && id < sched->nnodes; id++)
+    {
+      node = &sched->nodes[id];
+      while (node->q_count != 0)
+        {
+          if (sched->cfg.free)
+            {
+              sched->cfg.free(sched_frame(sched, id, node->q_head)->data,
+                              sched->cfg.arg);
+            }
+
+          node->q_head++;
+          node->q_count--;
+        }
+    }
+
+  free(sched->slot_head);
+  free(sched->slot_load);
+  free(sched->nodes);
+  free(sched->frames);
+  free(sched);
+}
+
+esp_err_t esp_now_sched_add_node(esp_now_sched_t *sched,
+                                 const uint8_t mac[6], uint16_t *id,
+                                 esp_now_sched_assign_t *assign)
+{
+  struct sched_node *node;
+  uint16_t slot = 0;
+  uint16_t i;
+
+  if (sched->nnodes >= sched->cfg.max_nodes)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  for (i = 1; i < sched->nslots; i++)
+    {
+      if (sched->slot_load[i] < sched->slot_load[slot])
+        {
+          slot = i;
+        }
+    }
+
+  *id = sched->nnodes++;
+  node = &sched->nodes[*id];
+  memset(node, 0, sizeof(*node));
+  memcpy(node->mac, mac, 6);
+  node->used = true;
+  node->slot = slot;
+  node->shift = sched->cfg.adaptive ? sched->cfg.max_shift : 0;
+  node->phase = (uint8_t)(*id & ((1 << node->shift) - 1));
+  node->next_in_slot = sched->slot_head[slot];
+  sched->slot_head[slot] = *id;
+  sched->slot_load[slot] += sched_weight(sched, node->shift);
+
+  if (assign)
+    {
+      sched_assign(sched, node, assign);
+    }
+
+  return ESP_OK;
+}
+
+esp_err_t esp_now_sched_enqueue(esp_now_sched_t *sched, uint16_t id,
+                                void *data, size_t len, int64_t now)
+{
+  struct sched_node *node;
+  struct sched_frame *frame;
+
+  if (id >= sched->nnodes)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  node = &sched->nodes[id];
+  node->arrivals++;
+
+  if (node->q_count >= sched->cfg.queue_len)
+    {
+      sched->stats.dropped++;
+      return ESP_ERR_NO_MEM;
+    }
+
+  frame = sched_frame(sched, id, node->q_head + node->q_count);
+  frame->data = data;
+  frame->len = len;
+  frame->time = now;
+  node->q_count++;
+  sched->stats.enqueued++;
+
+  return ESP_OK;
+}
+
+void esp_now_sched_tick(esp_now_sched_t *sched, int64_t now)
+{
+  int64_t window_us = (int64_t)sched->cfg.window_ms * 1000;
+  int64_t backlog = (int64_t)sched->nslots << sched->cfg.max_shift;
+  int64_t window;
+  int64_t cycle;
+  uint16_t slot;
+
+  if (now < sched->epoch)
+    {
+      return;
+    }
+
+  window = (now - sched->epoch) / window_us;
+
+  /* After a long stall only replay the last full schedule period */
+
+  if (window - sched->last_window > backlog)
+    {
+      sched->last_window = window - backlog;
+    }
+
+  while (sched->last_window < window)
+    {
+      sched->last_window++;
+      cycle = sched->last_window / sched->nslots;
+      slot = (uint16_t)(sched->last_window % sched->nslots);
+
+      if (slot == 0 && sched->cfg.adaptive && cycle != 0 &&
+          cycle % sched->cfg.adapt_cycles == 0)
+        {
+          sched_adapt(sched, cycle);
+        }
+
+      sched_serve(sched, cycle, slot, now);
+    }
+}
+
+esp_err_t esp_now_sched_next_change(esp_now_sched_t *sched, uint16_t *id,
+                                    esp_now_sched_assign_t *assign)
+{
+  struct sched_node *node;
+  uint16_t n;
+  uint16_t i;
+
+  for (n = 0; n < sched->nnodes; n++)
+    {
+      i = sched->change_cursor;
+      sched->change_cursor = (uint16_t)((i + 1) % sched->nnodes);
+
+      node = &sched->nodes[i];
+      if (node->change_pending)
+        {
+          node->change_pending = false;
+          *id = i;
+          sched_assign(sched, node, assign);
+          return ESP_OK;
+        }
+    }
+
+  return ESP_ERR_NOT_FOUND;
+}
+
+uint32_t esp_now_sched_duty_ppm(const esp_now_sched_t *sched)
+{
+  uint64_t sum = 0;
+  uint16_t id;
+
+  if (sched->nnodes == 0)
+    {
+      return 0;
+    }
+
+  for (id = 0; id < sched->nnodes; id++)
+    {
+      sum += (uint64_t)sched->cfg.window_ms * 1000000 /
+             ((uint32_t)sched->cfg.interval_ms << sched->nodes[id].shift);
+    }
+
+  return (uint32_t)(sum / sched->nnodes);
+}
+
+void esp_now_sched_get_stats(const esp_now_sched_t *sched,
+                             esp_now_sched_stats_t *stats)
+{
+  *stats = sched->stats;
+}
+
+/* Host simulation */
+
+/* Arrival times of the data frames queued to each node, in the order
+ * of the node queue, so that control frames stay out of the latency
+ */
+
+struct sched_sim_ctx
+{
+  int64_t now;
+  int64_t *times;
+  uint8_t *head;
+  uint8_t *count;
+  uint8_t queue_len;
+  uint32_t delivered;
+  uint64_t latency_sum_us;
+  uint32_t latency_max_us;
+};
+
+struct sched_sim_arrival
+{
+  int64_t time;
+  uint16_t id;
+};
+
+static uint8_t s_sim_ctrl;
+
+static esp_err_t sched_sim_send(const uint8_t mac[6], const void *data,
+                                size_t len, void *arg)
+{
+  struct sched_sim_ctx *ctx = arg;
+  uint16_t id = (uint16_t)(mac[4] << 8 | mac[5]);
+  uint32_t latency;
+
+  if (data != &s_sim_ctrl)
+    {
+      latency = (uint32_t)(ctx->now - ctx->times[id * ctx->queue_len +
+                                                 ctx->head[id]]);
+      ctx->head[id] = (uint8_t)((ctx->head[id] + 1) % ctx->queue_len);
+      ctx->count[id]--;
+      ctx->delivered++;
+      ctx->latency_sum_us += latency;
+      if (latency > ctx->latency_max_us)
+        {
+          ctx->latency_max_us = latency;
+        }
+    }
+
+  return ESP_OK;
+}
+
+static int sched_sim_cmp(const void *a, const void *b)
+{
+  const struct sched_sim_arrival *x = a;
+  const struct sched_sim_arrival *y = b;
+
+  return (x->time > y->time) - (x->time < y->time);
+}
+
+static uint32_t sched_sim_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+esp_err_t esp_now_sched_simulate(const esp_now_sched_sim_t *sim,
+                                 esp_now_sched_sim_result_t *result)
+{
+  struct sched_sim_ctx ctx;
+  struct sched_sim_arrival *arrivals;
+  esp_now_sched_config_t cfg;
+  esp_now_sched_stats_t stats;
+  esp_now_sched_assign_t assign;
+  esp_now_sched_t *sched;
+  uint32_t *threshold;
+  uint32_t narrivals;
+  uint32_t state;
+  uint64_t duty_sum = 0;
+  uint32_t duty_samples = 0;
+  int64_t window_us;
+  int64_t windows;
+  int64_t w;
+  int64_t t;
+  uint8_t mac[6] = {0};
+  uint16_t id;
+  uint32_t i;
+  uint32_t slot;
+  esp_err_t ret;
+
+  if (sim == NULL || result == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  memset(&ctx, 0, sizeof(ctx));
+  cfg = sim->cfg;
+  cfg.send = sched_sim_send;
+  cfg.free = NULL;
+  cfg.arg = &ctx;
+  if (cfg.max_nodes < sim->nodes)
+    {
+      cfg.max_nodes = (uint16_t)sim->nodes;
+    }
+
+  ret = esp_now_sched_create(&cfg, 0, &sched);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  ctx.queue_len = cfg.queue_len;
+  ctx.times = malloc(sim->nodes * cfg.queue_len * sizeof(int64_t));
+  ctx.head = calloc(sim->nodes, 1);
+  ctx.count = calloc(sim->nodes, 1);
+  arrivals = malloc(sim->nodes * sizeof(*arrivals));
+  threshold = malloc(sim->nodes * sizeof(uint32_t));
+  if (ctx.times == NULL || ctx.head == NULL || ctx.count == NULL ||
+      arrivals == NULL || threshold == NULL)
+    {
+      free(ctx.times);
+      free(ctx.head);
+      free(ctx.count);
+      free(arrivals);
+      free(threshold);
+      esp_now_sched_delete(sched);
+      return ESP_ERR_NO_MEM;
+    }
+
+  /* Per window arrival probability, scaled to 2^32 */
+
+  state = sim->seed ? sim->seed : 1;
+  for (i = 0; i < sim->nodes; i++)
+    {
+      uint64_t rate = sched_sim_rand(&state) % 1000 < sim->busy_permille ?
+                      sim->busy_rate_mhz : sim->idle_rate_mhz;
+      uint64_t p = (rate * cfg.window_ms << 32) / 1000000000ull;
+
+      threshold[i] = p > UINT32_MAX ? UINT32_MAX : (uint32_t)p;
+      mac[4] = (uint8_t)(i >> 8);
+      mac[5] = (uint8_t)i;
+      esp_now_sched_add_node(sched, mac, &id, NULL);
+    }
+
+  window_us = (int64_t)cfg.window_ms * 1000;
+  windows = (int64_t)sim->duration_ms / cfg.window_ms;
+
+  for (w = 0; w < windows; w++)
+    {
+      t = w * window_us;
+      ctx.now = t;
+      esp_now_sched_tick(sched, t);
+
+      while (esp_now_sched_next_change(sched, &id, &assign) == ESP_OK)
+        {
+          esp_now_sched_enqueue(sched, id, &s_sim_ctrl, 0, t);
+        }
+
+      /* Frames arrive spread over the window, each queued at its own
+       * arrival, with the clock moved there first
+       */
+
+      narrivals = 0;
+      for (i = 0; i < sim->nodes; i++)
+        {
+          if (sched_sim_rand(&state) < threshold[i])
+            {
+              arrivals[narrivals].time = t + sched_sim_rand(&state) %
+                                             window_us;
+              arrivals[narrivals++].id = (uint16_t)i;
+            }
+        }
+
+      qsort(arrivals, narrivals, sizeof(*arrivals), sched_sim_cmp);
+      for (i = 0; i < narrivals; i++)
+        {
+          id = arrivals[i].id;
+          ctx.now = arrivals[i].time;
+          esp_now_sched_tick(sched, ctx.now);
+          if (esp_now_sched_enqueue(sched, id, NULL, 0, ctx.now) == ESP_OK)
+            {
+              slot = (ctx.head[id] + ctx.count[id]++) % cfg.queue_len;
+              ctx.times[id * cfg.queue_len + slot] = ctx.now;
+            }
+        }
+
+      if (w % sched->nslots == 0)
+        {
+          duty_sum += esp_now_sched_duty_ppm(sched);
+          duty_samples++;
+        }
+    }
+
+  esp_now_sched_get_stats(sched, &stats);
+
+  memset(result, 0, sizeof(*result));
+  result->duty_ppm = duty_samples ? (uint32_t)(duty_sum / duty_samples) : 0;
+  result->latency_avg_us = ctx.delivered ?
+                           (uint32_t)(ctx.latency_sum_us / ctx.delivered) :
+                           0;
+  result->latency_max_us = ctx.latency_max_us;
+  result->delivered = ctx.delivered;
+  result->dropped = stats.dropped;
+  result->reassigned = stats.reassigned;
+
+  free(ctx.times);
+  free(ctx.head);
+  free(ctx.count);
+  free(arrivals);
+  free(threshold);
+  esp_now_sched_delete(sched);
+  return ESP_OK;
+}
@@ -0,0 +1,46 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_now_sched.h"
+
+/* Provided by libespnow.a, esp_now.h is not part of this tree */
+
+extern esp_err_t esp_now_set_wake_window(uint16_t window);
+
+/* Kept out of esp_now_sched.c so that the gateway scheduler and its
+ * simulation build on the host.
+ */
+
+esp_err_t esp_now_sched_node_apply(const esp_now_sched_assign_t *assign)
+{
+  esp_err_t ret;
+
+  if (assign == NULL || assign->window_ms > assign->interval_ms)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ret = esp_wifi_set_connectionless_wake_interval(assign->interval_ms);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  return esp_now_set_wake_window(assign->window_ms);
+}
@@ -0,0 +1,359 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_sc_channel.h"
+
+#define SC_CHAN_GUIDE_SCORE  64
+#define SC_CHAN_SCORE_MAX    1024
+#define SC_CHAN_AGE_SHIFT    3     /* scores lose 1/8 per dwell */
+
+struct sc_chan_slot
+{
+  esp_sc_decoder_t *dec;
+  uint32_t guides;               /* decoder guide count at the last dwell */
+  uint32_t score;
+  uint32_t visited;              /* dwell count at the last visit */
+};
+
+struct esp_sc_chan
+{
+  esp_sc_chan_config_t cfg;
+  uint8_t channel;
+  uint8_t sweep;                 /* last channel of the sweep */
+  uint8_t locked;                /* 0 when searching */
+  bool done;
+  bool exploit;                  /* current dwell picked by score */
+  bool lock_wait;                /* lock timeout already given */
+  uint32_t dwell_ms;
+  uint32_t dwells;
+  struct sc_chan_slot ch[ESP_SC_CHAN_MAX + 1];
+};
+
+static bool sc_chan_in_mask(const esp_sc_chan_t *eng, uint8_t channel)
+{
+  return channel >= 1 && channel <= ESP_SC_CHAN_MAX &&
+         (eng->cfg.channel_mask & (1 << channel));
+}
+
+static uint8_t sc_chan_after(const esp_sc_chan_t *eng, uint8_t channel)
+{
+  int i;
+
+  for (i = 0; i < ESP_SC_CHAN_MAX; i++)
+    {
+      channel = channel % ESP_SC_CHAN_MAX + 1;
+      if (sc_chan_in_mask(eng, channel))
+        {
+          return channel;
+        }
+    }
+
+  return channel;
+}
+
+static uint32_t sc_chan_dwell(const esp_sc_chan_t *eng)
+{
+  return eng->cfg.fast_mode ? eng->cfg.dwell_fast_ms : eng->cfg.dwell_ms;
+}
+
+/* Age every score and credit the dwell that just ended */
+
+static void sc_chan_score(esp_sc_chan_t *eng)
+{
+  struct sc_chan_slot *slot = &eng->ch[eng->channel];
+  esp_sc_decode_stats_t stats;
+  uint32_t score;
+  int c;
+
+  for (c = 1; c <= ESP_SC_CHAN_MAX; c++)
+    {
+      eng->ch[c].score -= eng->ch[c].score >> SC_CHAN_AGE_SHIFT;
+    }
+
+  esp_sc_decoder_get_stats(slot->dec, &stats);
+  score = slot->score + (stats.guides - slot->guides) * SC_CHAN_GUIDE_SCORE;
+  slot->score = score < SC_CHAN_SCORE_MAX ? score : SC_CHAN_SCORE_MAX;
+  slot->guides = stats.guides;
+  slot->visited = eng->dwells;
+}
+
+/* Best scored channel other than the current one, least recently
+ * visited on ties, 0 when nothing scored
+ */
+
+static uint8_t sc_chan_best(const esp_sc_chan_t *eng)
+{
+  const struct sc_chan_slot *s;
+  uint8_t best = 0;
+  int c;
+
+  for (c = 1; c <= ESP_SC_CHAN_MAX; c++)
+    {
+      s = &eng->ch[c];
+      if (!sc_chan_in_mask(eng, c) || c == eng->channel || s->score == 0)
+        {
+          continue;
+        }
+
+      if (best == 0 || s->score > eng->ch[best].score ||
+          (s->score == eng->ch[best].score &&
+           s->visited < eng->ch[best].visited))
+        {
+          best = c;
+        }
+    }
+
+  return best;
+}
+
+void esp_sc_chan_default(esp_sc_chan_config_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->type = SC_TYPE_ESPTOUCH;
+  cfg->policy = ESP_SC_CHAN_SCORED;
+  cfg->channel_mask = 0x3ffe;
+  cfg->dwell_ms = 100;
+  cfg->dwell_fast_ms = 50;
+  cfg->lock_timeout_ms = 30000;
+}
+
+esp_err_t esp_sc_chan_create(const esp_sc_chan_config_t *cfg,
+                             esp_sc_chan_t **out)
+{
+  esp_sc_chan_t *eng;
+  esp_err_t ret;
+  int c;
+
+  if (cfg == NULL || out == NULL ||
+      (cfg->channel_mask & (((1 << ESP_SC_CHAN_MAX) - 1) << 1)) == 0 ||
+      cfg->dwell_ms == 0 || (cfg->fast_mode && cfg->dwell_fast_ms == 0))
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  eng = calloc(1, sizeof(*eng));
+  if (eng == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  eng->cfg = *cfg;
+  for (c = 1; c <= ESP_SC_CHAN_MAX; c++)
+    {
+      if (!sc_chan_in_mask(eng, c))
+        {
+          continue;
+        }
+
+      ret = esp_sc_decoder_create(cfg->type, &eng->ch[c].dec);
+      if (ret != ESP_OK)
+        {
+          esp_sc_chan_delete(eng);
+          return ret;
+        }
+    }
+
+  esp_sc_chan_reset(eng);
+  *out = eng;
+  return ESP_OK;
+}
+
+void esp_sc_chan_delete(esp_sc_chan_t *eng)
+{
+  int c;
+
+  if (eng == NULL)
+    {
+      return;
+    }
+
+  for (c = 1; c <= ESP_SC_CHAN_MAX; c++)
+    {
+      if (eng->ch[c].dec)
+        {
+          esp_sc_decoder_delete(eng->ch[c].dec);
+        }
+    }
+
+  free(eng);
+}
+
+void esp_sc_chan_reset(esp_sc_chan_t *eng)
+{
+  struct sc_chan_slot *s;
+  int c;
+
+  for (c = 1; c <= ESP_SC_CHAN_MAX; c++)
+    {
+      s = &eng->ch[c];
+      if (s->dec)
+        {
+          esp_sc_decoder_reset(s->dec);
+        }
+
+      s->guides = 0;
+      s->score = 0;
+      s->visited = 0;
+    }
+
+  eng->channel = sc_chan_after(eng, 0);
+  eng->sweep = eng->channel;
+  eng->locked = 0;
+  eng->done = false;
+  eng->exploit = false;
+  eng->lock_wait = false;
+  eng->dwell_ms = sc_chan_dwell(eng);
+  eng->dwells = 0;
+}
+
+uint8_t esp_sc_chan_current(const esp_sc_chan_t *eng, uint32_t *dwell_ms)
+{
+  if (dwell_ms)
+    {
+      *dwell_ms = eng->dwell_ms;
+    }
+
+  return eng->channel;
+}
+
+esp_sc_decode_state_t esp_sc_chan_feed(esp_sc_chan_t *eng, uint8_t channel,
+                                       const uint8_t sa[6], uint8_t ds,
+                                       uint16_t len)
+{
+  esp_sc_decode_state_t state;
+
+  if (!sc_chan_in_mask(eng, channel))
+    {
+      return ESP_SC_DECODE_SEARCHING;
+    }
+
+  /* Once locked, the other channels are not worth the CPU */
+
+  if (eng->locked && channel != eng->locked)
+    {
+      return ESP_SC_DECODE_SEARCHING;
+    }
+
+  state = esp_sc_decoder_feed(eng->ch[channel].dec, sa, ds, len);
+  if (state != ESP_SC_DECODE_SEARCHING && !eng->locked)
+    {
+      eng->locked = channel;
+      eng->lock_wait = false;
+    }
+
+  if (state == ESP_SC_DECODE_DONE && channel == eng->locked)
+    {
+      eng->done = true;
+    }
+
+  return state;
+}
+
+void esp_sc_chan_next(esp_sc_chan_t *eng, uint8_t *channel,
+                      uint32_t *dwell_ms)
+{
+  struct sc_chan_slot *s;
+  uint8_t best;
+
+  sc_chan_score(eng);
+  eng->dwells++;
+
+  if (eng->locked)
+    {
+      s = &eng->ch[eng->locked];
+      eng->channel = eng->locked;
+      *channel = eng->channel;
+
+      if (eng->done)
+        {
+          *dwell_ms = 0;
+          eng->dwell_ms = 0;
+          return;
+        }
+
+      if (!eng->lock_wait)
+        {
+          eng->lock_wait = true;
+          *dwell_ms = eng->cfg.lock_timeout_ms;
+          eng->dwell_ms = *dwell_ms;
+          return;
+        }
+
+      /* Locked on something that never completed */
+
+      esp_sc_decoder_reset(s->dec);
+      s->guides = 0;
+      s->score = 0;
+      eng->locked = 0;
+      eng->lock_wait = false;
+    }
+
+  best = 0;
+  if (eng->cfg.policy == ESP_SC_CHAN_SCORED && !eng->exploit)
+    {
+      best = sc_chan_best(eng);
+    }
+
+  if (best)
+    {
+      eng->channel = best;
+      eng->exploit = true;
+      *dwell_ms = sc_chan_dwell(eng) * 2;
+    }
+  else
+    {
+      eng->sweep = sc_chan_after(eng, eng->sweep);
+      eng->channel = eng->sweep;
+      eng->exploit = false;
+      *dwell_ms = sc_chan_dwell(eng);
+    }
+
+  *channel = eng->channel;
+  eng->dwell_ms = *dwell_ms;
+}
+
+esp_err_t esp_sc_chan_result(const esp_sc_chan_t *eng, uint8_t *channel,
+                             smartconfig_event_got_ssid_pswd_t *result)
+{
+  esp_err_t ret;
+
+  if (!eng->done)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  ret = esp_sc_decoder_result(eng->ch[eng->locked].dec, result);
+  if (ret == ESP_OK && channel)
+    {
+      *channel = eng->locked;
+    }
+
+  return ret;
+}
+
+void esp_sc_chan_get_scores(const esp_sc_chan_t *eng,
+                            uint32_t scores[ESP_SC_CHAN_MAX + 1])
+{
+  int c;
+
+  scores[0] = 0;
+  for (c = 1; c <= ESP_SC_CHAN_MAX; c++)
+    {
+      scores[c] = eng->ch[c].score;
+    }
+}
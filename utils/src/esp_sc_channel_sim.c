@@ -0,0 +1,273 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_sc_channel.h"
+
+/* The phone repeats the guide code for 2 s then the data for 4 s. Only
+ * the guide code matters to the lock, data lengths are drawn at random
+ * from the range of the protocol.
+ */
+
+#define SC_SIM_GUIDE_MS     2000
+#define SC_SIM_ROUND_MS     6000
+#define SC_SIM_SOURCES      5
+
+struct sc_sim_run
+{
+  uint8_t channel;               /* phone channel */
+  int64_t phase_us;              /* phone time at the start */
+  bool airkiss;
+};
+
+static const uint8_t s_phone[6] =
+{
+  0x02, 0x00, 0x00, 0x00, 0x00, 0x01
+};
+
+static uint32_t sc_sim_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static uint16_t sc_sim_phone_len(const esp_sc_chan_sim_t *sim,
+                                 const struct sc_sim_run *run,
+                                 int64_t k, uint32_t *rng)
+{
+  int64_t t = run->phase_us + k * sim->frame_interval_us;
+  uint32_t pos = (t / 1000) % SC_SIM_ROUND_MS;
+
+  if (pos < SC_SIM_GUIDE_MS)
+    {
+      return sim->len_offset + (run->airkiss ? 1 + k % 4 : 515 - k % 4);
+    }
+
+  return sim->len_offset + (run->airkiss ? sc_sim_rand(rng) % 0x200 :
+                            40 + sc_sim_rand(rng) % 384);
+}
+
+/* Frames of the phone and other stations on the channel of one dwell,
+ * fed in time order. Returns the time of the lock or -1.
+ */
+
+static int64_t sc_sim_dwell(const esp_sc_chan_sim_t *sim,
+                            const struct sc_sim_run *run,
+                            esp_sc_chan_t *eng, uint8_t channel,
+                            int64_t start, int64_t end, uint32_t *rng,
+                            uint8_t *locked)
+{
+  uint32_t gap = sim->interference_fps ?
+                 2000000 / sim->interference_fps : 0;
+  int64_t k = (start + sim->frame_interval_us - 1) / sim->frame_interval_us;
+  int64_t t_phone = channel == run->channel ?
+                    k * sim->frame_interval_us : end;
+  int64_t t_intf = gap ? start + sc_sim_rand(rng) % gap : end;
+  esp_sc_decode_state_t state;
+  uint8_t mac[6];
+  uint16_t len;
+  int64_t t;
+
+  memcpy(mac, s_phone, 6);
+  while (t_phone < end || t_intf < end)
+    {
+      if (t_intf < t_phone)
+        {
+          t = t_intf;
+          mac[5] = 2 + sc_sim_rand(rng) % SC_SIM_SOURCES;
+          len = 60 + sc_sim_rand(rng) % 1440;
+          t_intf += 1 + sc_sim_rand(rng) % gap;
+        }
+      else
+        {
+          t = t_phone;
+          t_phone += sim->frame_interval_us;
+          len = sc_sim_phone_len(sim, run, k++, rng);
+          if (sc_sim_rand(rng) % 1000 < sim->loss_permille)
+            {
+              continue;
+            }
+
+          mac[5] = 1;
+        }
+
+      state = esp_sc_chan_feed(eng, channel, mac, 0x01, len);
+      if (state != ESP_SC_DECODE_SEARCHING)
+        {
+          *locked = channel;
+          return t;
+        }
+    }
+
+  return -1;
+}
+
+static void sc_sim_policy(const esp_sc_chan_sim_t *sim,
+                          const struct sc_sim_run *run, esp_sc_chan_t *eng,
+                          uint32_t rng, esp_sc_chan_sim_stat_t *stat,
+                          uint64_t *lock_sum, uint64_t *hop_sum)
+{
+  int64_t timeout = (int64_t)sim->timeout_ms * 1000;
+  int64_t t = 0;
+  int64_t lock;
+  uint32_t dwell_ms;
+  uint32_t hops = 0;
+  uint8_t locked = 0;
+  uint8_t channel;
+  uint8_t next;
+
+  esp_sc_chan_reset(eng);
+  channel = esp_sc_chan_current(eng, &dwell_ms);
+
+  while (t < timeout)
+    {
+      lock = sc_sim_dwell(sim, run, eng, channel, t,
+                          t + (int64_t)dwell_ms * 1000, &rng, &locked);
+      if (lock >= 0)
+        {
+          if (locked != run->channel)
+            {
+              stat->wrong++;
+              return;
+            }
+
+          stat->locked++;
+          *lock_sum += lock / 1000;
+          *hop_sum += hops;
+          if (lock / 1000 > stat->lock_max_ms)
+            {
+              stat->lock_max_ms = lock / 1000;
+            }
+
+          return;
+        }
+
+      t += (int64_t)dwell_ms * 1000;
+      esp_sc_chan_next(eng, &next, &dwell_ms);
+      if (next != channel)
+        {
+          hops++;
+        }
+
+      channel = next;
+    }
+
+  stat->timeouts++;
+}
+
+void esp_sc_chan_sim_default(esp_sc_chan_sim_t *sim)
+{
+  memset(sim, 0, sizeof(*sim));
+  sim->frame_interval_us = 8000;
+  sim->len_offset = 52;
+  sim->loss_permille = 100;
+  sim->interference_fps = 200;
+  sim->timeout_ms = 120000;
+  sim->runs = 200;
+  sim->seed = 1;
+}
+
+esp_err_t esp_sc_chan_sim_run(const esp_sc_chan_config_t *cfg,
+                              const esp_sc_chan_sim_t *sim,
+                              esp_sc_chan_sim_result_t *result)
+{
+  esp_sc_chan_config_t c;
+  esp_sc_chan_t *seq = NULL;
+  esp_sc_chan_t *scored = NULL;
+  struct sc_sim_run run;
+  uint64_t lock_sum[2] =
+  {
+    0, 0
+  };
+
+  uint64_t hop_sum[2] =
+  {
+    0, 0
+  };
+
+  uint8_t channels[ESP_SC_CHAN_MAX];
+  uint32_t nchannels = 0;
+  uint32_t rng;
+  uint32_t i;
+  esp_err_t ret;
+
+  if (cfg == NULL || sim == NULL || result == NULL ||
+      sim->frame_interval_us == 0 || cfg->type == SC_TYPE_ESPTOUCH_V2)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  for (i = 1; i <= ESP_SC_CHAN_MAX; i++)
+    {
+      if (cfg->channel_mask & (1 << i))
+        {
+          channels[nchannels++] = i;
+        }
+    }
+
+  c = *cfg;
+  c.policy = ESP_SC_CHAN_SEQUENTIAL;
+  ret = esp_sc_chan_create(&c, &seq);
+  if (ret == ESP_OK)
+    {
+      c.policy = ESP_SC_CHAN_SCORED;
+      ret = esp_sc_chan_create(&c, &scored);
+    }
+
+  if (ret != ESP_OK)
+    {
+      esp_sc_chan_delete(seq);
+      return ret;
+    }
+
+  memset(result, 0, sizeof(*result));
+  rng = sim->seed ? sim->seed : 1;
+  run.airkiss = cfg->type == SC_TYPE_AIRKISS;
+
+  for (i = 0; i < sim->runs; i++)
+    {
+      run.channel = channels[sc_sim_rand(&rng) % nchannels];
+      run.phase_us = (int64_t)(sc_sim_rand(&rng) % SC_SIM_ROUND_MS) * 1000;
+
+      /* Both policies see the same draws */
+
+      sc_sim_policy(sim, &run, seq, rng, &result->sequential,
+                    &lock_sum[0], &hop_sum[0]);
+      sc_sim_policy(sim, &run, scored, rng, &result->scored,
+                    &lock_sum[1], &hop_sum[1]);
+    }
+
+  if (result->sequential.locked)
+    {
+      result->sequential.lock_avg_ms = lock_sum[0] /
+                                       result->sequential.locked;
+      result->sequential.hops_avg = hop_sum[0] / result->sequential.locked;
+    }
+
+  if (result->scored.locked)
+    {
+      result->scored.lock_avg_ms = lock_sum[1] / result->scored.locked;
+      result->scored.hops_avg = hop_sum[1] / result->scored.locked;
+    }
+
+  esp_sc_chan_delete(seq);
+  esp_sc_chan_delete(scored);
+  return ESP_OK;
+}
@@ -0,0 +1,204 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_sc_channel.h"
+
+static esp_sc_chan_t *s_eng;
+static esp_sc_chan_done_cb_t s_cb;
+static void *s_arg;
+static void *s_lock;
+static esp_timer_handle_t s_timer;
+static smartconfig_event_got_ssid_pswd_t s_result;
+
+static void sc_chan_rx_cb(void *buf, wifi_promiscuous_pkt_type_t type)
+{
+  const wifi_promiscuous_pkt_t *pkt = buf;
+  const uint8_t *hdr = pkt->payload;
+  esp_sc_decode_state_t state;
+  bool hop = false;
+  uint8_t ds;
+
+  if (type != WIFI_PKT_DATA || pkt->rx_ctrl.sig_len < 24)
+    {
+      return;
+    }
+
+  /* SA is addr2, or addr3 when relayed by the AP */
+
+  ds = hdr[1] & 0x03;
+  if (ds == 0x03)
+    {
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_eng)
+    {
+      state = esp_sc_chan_feed(s_eng, pkt->rx_ctrl.channel,
+                               ds == 0x02 ? hdr + 16 : hdr + 10, ds,
+                               pkt->rx_ctrl.sig_len);
+      hop = state != ESP_SC_DECODE_SEARCHING &&
+            (esp_sc_chan_current(s_eng, NULL) != pkt->rx_ctrl.channel ||
+             state == ESP_SC_DECODE_DONE);
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  /* End the dwell now to settle on the locked channel or report */
+
+  if (hop)
+    {
+      esp_timer_stop(s_timer);
+      esp_timer_start_once(s_timer, 0);
+    }
+}
+
+static void sc_chan_timer_cb(void *arg)
+{
+  esp_sc_chan_done_cb_t cb = NULL;
+  uint32_t dwell_ms = 0;
+  uint8_t channel = 0;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_eng == NULL)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return;
+    }
+
+  esp_sc_chan_next(s_eng, &channel, &dwell_ms);
+  if (dwell_ms == 0 &&
+      esp_sc_chan_result(s_eng, &channel, &s_result) == ESP_OK)
+    {
+      cb = s_cb;
+      s_eng = NULL;
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  if (cb)
+    {
+      esp_wifi_set_promiscuous(false);
+      cb(channel, &s_result, s_arg);
+      return;
+    }
+
+  esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+  esp_timer_start_once(s_timer, (uint64_t)dwell_ms * 1000);
+}
+
+esp_err_t esp_sc_chan_start(esp_sc_chan_t *eng, esp_sc_chan_done_cb_t cb,
+                            void *arg)
+{
+  esp_timer_create_args_t args =
+  {
+    .callback = sc_chan_timer_cb,
+    .name = "sc_chan",
+  };
+
+  wifi_promiscuous_filter_t filter =
+  {
+    .filter_mask = WIFI_PROMIS_FILTER_MASK_DATA,
+  };
+
+  uint32_t dwell_ms;
+  uint8_t channel;
+  esp_err_t ret;
+
+  if (eng == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  if (s_timer == NULL)
+    {
+      ret = esp_timer_create(&args, &s_timer);
+      if (ret != ESP_OK)
+        {
+          return ret;
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_eng)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  esp_sc_chan_reset(eng);
+  channel = esp_sc_chan_current(eng, &dwell_ms);
+  s_eng = eng;
+  s_cb = cb;
+  s_arg = arg;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  ret = esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+  if (ret == ESP_OK)
+    {
+      ret = esp_wifi_set_promiscuous_filter(&filter);
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_wifi_set_promiscuous_rx_cb(sc_chan_rx_cb);
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_wifi_set_promiscuous(true);
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_timer_start_once(s_timer, (uint64_t)dwell_ms * 1000);
+    }
+
+  if (ret != ESP_OK)
+    {
+      esp_sc_chan_stop();
+    }
+
+  return ret;
+}
+
+void esp_sc_chan_stop(void)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  s_eng = NULL;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  esp_timer_stop(s_timer);
+  esp_wifi_set_promiscuous(false);
+}
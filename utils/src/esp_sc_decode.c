@@ -0,0 +1,572 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_sc_decode.h"
+
+#define SC_ESPTOUCH_GUIDE  512
+#define SC_ESPTOUCH_EXTRA  40
+#define SC_ESPTOUCH_HEAD   9       /* 5 header bytes and the phone IP */
+#define SC_MAX_DATA        128
+#define SC_WINDOW          6
+#define SC_GUIDE_HITS      2
+
+enum sc_proto
+{
+  SC_PROTO_NONE = 0,
+  SC_PROTO_ESPTOUCH,
+  SC_PROTO_AIRKISS
+};
+
+/* Senders seen while searching, with their last four lengths */
+
+struct sc_source
+{
+  bool used;
+  uint8_t mac[6];
+  uint8_t ds;
+  uint8_t nhist;
+  uint16_t hist[4];
+  uint8_t proto;
+  uint8_t hits;
+  uint16_t base;
+  uint32_t last;
+};
+
+struct esp_sc_decoder
+{
+  smartconfig_type_t type;
+  esp_sc_decode_state_t state;
+  uint32_t tick;
+  struct sc_source src[ESP_SC_DECODE_SOURCES];
+
+  /* Locked sender */
+
+  uint8_t proto;
+  uint8_t mac[6];
+  uint8_t ds;
+  uint16_t base;
+  uint16_t win[SC_WINDOW];
+  uint8_t nwin;
+
+  /* Bytes for ESPTouch, blocks of four for AirKiss */
+
+  uint8_t data[SC_MAX_DATA];
+  uint8_t have[SC_MAX_DATA / 8];
+  uint8_t ngot;
+
+  bool ak_magic;
+  bool ak_prefix;
+  uint8_t ak_total;
+  uint8_t ak_ssid_crc;
+  uint8_t ak_pwd_len;
+
+  smartconfig_event_got_ssid_pswd_t result;
+  esp_sc_decode_stats_t stats;
+};
+
+uint8_t esp_sc_crc8(const uint8_t *data, size_t len)
+{
+  uint8_t crc = 0;
+  int i;
+
+  while (len--)
+    {
+      crc ^= *data++;
+      for (i = 0; i < 8; i++)
+        {
+          crc = (crc & 1) ? (crc >> 1) ^ 0x8c : crc >> 1;
+        }
+    }
+
+  return crc;
+}
+
+static bool sc_test_have(const esp_sc_decoder_t *dec, uint32_t i)
+{
+  return dec->have[i / 8] & (1 << (i % 8));
+}
+
+static void sc_set_have(esp_sc_decoder_t *dec, uint32_t i)
+{
+  if (!sc_test_have(dec, i))
+    {
+      dec->have[i / 8] |= 1 << (i % 8);
+      dec->ngot++;
+    }
+}
+
+static void sc_clear_data(esp_sc_decoder_t *dec)
+{
+  memset(dec->have, 0, sizeof(dec->have));
+  dec->ngot = 0;
+}
+
+static void sc_push(esp_sc_decoder_t *dec, uint16_t v)
+{
+  if (dec->nwin == SC_WINDOW)
+    {
+      memmove(dec->win, dec->win + 1, sizeof(dec->win[0]) * (SC_WINDOW - 1));
+      dec->nwin--;
+    }
+
+  dec->win[dec->nwin++] = v;
+}
+
+static struct sc_source *sc_source(esp_sc_decoder_t *dec,
+                                   const uint8_t sa[6], uint8_t ds)
+{
+  struct sc_source *victim = &dec->src[0];
+  struct sc_source *s;
+  int i;
+
+  for (i = 0; i < ESP_SC_DECODE_SOURCES; i++)
+    {
+      s = &dec->src[i];
+      if (s->used && s->ds == ds && memcmp(s->mac, sa, 6) == 0)
+        {
+          s->last = dec->tick;
+          return s;
+        }
+
+      if (!s->used || (victim->used && s->last < victim->last))
+        {
+          victim = s;
+        }
+    }
+
+  memset(victim, 0, sizeof(*victim));
+  victim->used = true;
+  memcpy(victim->mac, sa, 6);
+  victim->ds = ds;
+  victim->last = dec->tick;
+  return victim;
+}
+
+/* Look for a guide code at the end of the lengths of one sender, lock
+ * on the sender once it was seen SC_GUIDE_HITS times with one offset.
+ */
+
+static void sc_search(esp_sc_decoder_t *dec, struct sc_source *s,
+                      uint16_t len)
+{
+  const uint16_t *h = s->hist;
+  uint8_t proto = SC_PROTO_NONE;
+  uint16_t base = 0;
+
+  if (s->nhist == 4)
+    {
+      memmove(s->hist, s->hist + 1, sizeof(s->hist[0]) * 3);
+      s->nhist--;
+    }
+
+  s->hist[s->nhist++] = len;
+  if (s->nhist < 4)
+    {
+      return;
+    }
+
+  if (dec->type != SC_TYPE_AIRKISS &&
+      h[0] == h[1] + 1 && h[1] == h[2] + 1 && h[2] == h[3] + 1 &&
+      h[3] >= SC_ESPTOUCH_GUIDE)
+    {
+      proto = SC_PROTO_ESPTOUCH;
+      base = h[3] - SC_ESPTOUCH_GUIDE;
+    }
+  else if (dec->type != SC_TYPE_ESPTOUCH &&
+           h[1] == h[0] + 1 && h[2] == h[1] + 1 && h[3] == h[2] + 1 &&
+           h[0] >= 1)
+    {
+      proto = SC_PROTO_AIRKISS;
+      base = h[0] - 1;
+    }
+  else
+    {
+      return;
+    }
+
+  s->nhist = 0;
+  dec->stats.guides++;
+  if (s->proto == proto && s->base == base)
+    {
+      s->hits++;
+    }
+  else
+    {
+      s->proto = proto;
+      s->base = base;
+      s->hits = 1;
+    }
+
+  if (s->hits < SC_GUIDE_HITS)
+    {
+      return;
+    }
+
+  dec->proto = proto;
+  dec->base = base;
+  memcpy(dec->mac, s->mac, 6);
+  dec->ds = s->ds;
+  dec->nwin = 0;
+  sc_clear_data(dec);
+  dec->state = ESP_SC_DECODE_LOCKED;
+}
+
+static void sc_esptouch_complete(esp_sc_decoder_t *dec)
+{
+  const uint8_t *d = dec->data;
+  smartconfig_event_got_ssid_pswd_t *r = &dec->result;
+  uint32_t total = d[0];
+  uint32_t ssid_len;
+  uint8_t x = 0;
+  uint32_t i;
+
+  if (!sc_test_have(dec, 0) || dec->ngot < total + 6)
+    {
+      return;
+    }
+
+  for (i = 0; i < total + 6; i++)
+    {
+      if (!sc_test_have(dec, i))
+        {
+          return;
+        }
+    }
+
+  for (i = 5; i < total + 6; i++)
+    {
+      x ^= d[i];
+    }
+
+  ssid_len = total - SC_ESPTOUCH_HEAD - d[1];
+  if (x != d[4] || ssid_len == 0 || ssid_len > sizeof(r->ssid) ||
+      d[1] >= sizeof(r->password) ||
+      esp_sc_crc8(d + SC_ESPTOUCH_HEAD + d[1], ssid_len) != d[2] ||
+      esp_sc_crc8(d + total, 6) != d[3])
+    {
+      dec->stats.restarts++;
+      sc_clear_data(dec);
+      return;
+    }
+
+  memset(r, 0, sizeof(*r));
+  memcpy(r->password, d + SC_ESPTOUCH_HEAD, d[1]);
+  memcpy(r->ssid, d + SC_ESPTOUCH_HEAD + d[1], ssid_len);
+  memcpy(r->bssid, d + total, 6);
+  memcpy(r->cellphone_ip, d + 5, 4);
+  r->bssid_set = true;
+  r->type = SC_TYPE_ESPTOUCH;
+  dec->state = ESP_SC_DECODE_DONE;
+}
+
+/* Data byte as (crc_hi, data_hi), 256 + index, (crc_lo, data_lo) */
+
+static void sc_esptouch(esp_sc_decoder_t *dec)
+{
+  const uint16_t *w = dec->win + dec->nwin - 3;
+  int a;
+  int s;
+  int b;
+  uint8_t buf[2];
+  uint8_t crc;
+
+  if (dec->nwin < 3)
+    {
+      return;
+    }
+
+  a = w[0] - SC_ESPTOUCH_EXTRA;
+  s = w[1] - SC_ESPTOUCH_EXTRA - 256;
+  b = w[2] - SC_ESPTOUCH_EXTRA;
+  if (a < 0 || a > 255 || b < 0 || b > 255 || s < 0 || s >= SC_MAX_DATA)
+    {
+      return;
+    }
+
+  buf[0] = (a & 0x0f) << 4 | (b & 0x0f);
+  buf[1] = s;
+  crc = (a & 0xf0) | (b >> 4);
+  if (esp_sc_crc8(buf, 2) != crc)
+    {
+      dec->stats.crc_errors++;
+      return;
+    }
+
+  dec->stats.symbols++;
+  dec->nwin = 0;
+  dec->data[s] = buf[0];
+  sc_set_have(dec, s);
+
+  /* The total length is only trusted once decoded, it bounds the rest */
+
+  if (sc_test_have(dec, 0) &&
+      (dec->data[0] < SC_ESPTOUCH_HEAD + 1 ||
+       dec->data[0] + 6 > SC_MAX_DATA))
+    {
+      dec->stats.restarts++;
+      sc_clear_data(dec);
+      return;
+    }
+
+  sc_esptouch_complete(dec);
+}
+
+static void sc_airkiss_complete(esp_sc_decoder_t *dec)
+{
+  smartconfig_event_got_ssid_pswd_t *r = &dec->result;
+  const uint8_t *d = dec->data;
+  uint32_t ssid_len;
+
+  if (!dec->ak_prefix || dec->ngot < (dec->ak_total + 3) / 4)
+    {
+      return;
+    }
+
+  ssid_len = dec->ak_total - dec->ak_pwd_len - 1;
+  if (dec->ak_pwd_len + 1 >= dec->ak_total ||
+      ssid_len > sizeof(r->ssid) ||
+      dec->ak_pwd_len >= sizeof(r->password) ||
+      esp_sc_crc8(d + dec->ak_pwd_len + 1, ssid_len) != dec->ak_ssid_crc)
+    {
+      dec->stats.restarts++;
+      sc_clear_data(dec);
+      return;
+    }
+
+  memset(r, 0, sizeof(*r));
+  memcpy(r->password, d, dec->ak_pwd_len);
+  memcpy(r->ssid, d + dec->ak_pwd_len + 1, ssid_len);
+  r->token = d[dec->ak_pwd_len];
+  r->type = SC_TYPE_AIRKISS;
+  dec->state = ESP_SC_DECODE_DONE;
+}
+
+static void sc_airkiss(esp_sc_decoder_t *dec)
+{
+  const uint16_t *w = dec->win;
+  uint8_t buf[5];
+  uint32_t n = dec->nwin;
+  uint32_t k;
+  uint32_t idx;
+  uint32_t size;
+  uint32_t i;
+
+  /* Magic code 0x0?, 0x1?, 0x2?, 0x3? and prefix code 0x4? to 0x7? */
+
+  if (w[n - 1] < 0x80)
+    {
+      if (n < 4 || w[n - 4] >= 0x80 || w[n - 3] >= 0x80 ||
+          w[n - 2] >= 0x80 || (w[n - 3] >> 4) != (w[n - 4] >> 4) + 1 ||
+          (w[n - 2] >> 4) != (w[n - 4] >> 4) + 2 ||
+          (w[n - 1] >> 4) != (w[n - 4] >> 4) + 3)
+        {
+          return;
+        }
+
+      buf[0] = (w[n - 4] & 0x0f) << 4 | (w[n - 3] & 0x0f);
+      buf[1] = (w[n - 2] & 0x0f) << 4 | (w[n - 1] & 0x0f);
+
+      if (w[n - 4] >> 4 == 0 && buf[0] != 0)
+        {
+          if (!dec->ak_magic || dec->ak_total != buf[0])
+            {
+              sc_clear_data(dec);
+            }
+
+          dec->ak_magic = true;
+          dec->ak_total = buf[0];
+          dec->ak_ssid_crc = buf[1];
+          dec->nwin = 0;
+        }
+      else if (w[n - 4] >> 4 == 4 && esp_sc_crc8(buf, 1) == buf[1])
+        {
+          dec->ak_prefix = true;
+          dec->ak_pwd_len = buf[0];
+          dec->nwin = 0;
+        }
+
+      return;
+    }
+
+  if (w[n - 1] < 0x100 || w[n - 1] >= 0x200 || !dec->ak_magic)
+    {
+      return;
+    }
+
+  /* Sequence: crc header, index header, then the block */
+
+  for (k = 0; k < n && k < 4 && w[n - 1 - k] >= 0x100; k++)
+    {
+    }
+
+  if (n < k + 2 || w[n - k - 2] < 0x80 || w[n - k - 2] >= 0x100 ||
+      w[n - k - 1] < 0x80 || w[n - k - 1] >= 0x100)
+    {
+      return;
+    }
+
+  idx = w[n - k - 1] & 0x7f;
+  if (idx * 4 >= dec->ak_total)
+    {
+      return;
+    }
+
+  size = dec->ak_total - idx * 4;
+  if (size > 4)
+    {
+      size = 4;
+    }
+
+  if (k != size)
+    {
+      return;
+    }
+
+  buf[0] = idx;
+  for (i = 0; i < size; i++)
+    {
+      buf[i + 1] = w[n - size + i] & 0xff;
+    }
+
+  if ((esp_sc_crc8(buf, size + 1) & 0x7f) != (w[n - k - 2] & 0x7f))
+    {
+      dec->stats.crc_errors++;
+      return;
+    }
+
+  dec->stats.symbols++;
+  dec->nwin = 0;
+  memcpy(dec->data + idx * 4, buf + 1, size);
+  sc_set_have(dec, idx);
+  sc_airkiss_complete(dec);
+}
+
+esp_err_t esp_sc_decoder_create(smartconfig_type_t type,
+                                esp_sc_decoder_t **out)
+{
+  esp_sc_decoder_t *dec;
+
+  if (type == SC_TYPE_ESPTOUCH_V2)
+    {
+      return ESP_ERR_NOT_SUPPORTED;
+    }
+
+  if (out == NULL || type > SC_TYPE_ESPTOUCH_V2)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  dec = calloc(1, sizeof(*dec));
+  if (dec == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  dec->type = type;
+  *out = dec;
+  return ESP_OK;
+}
+
+void esp_sc_decoder_delete(esp_sc_decoder_t *dec)
+{
+  free(dec);
+}
+
+void esp_sc_decoder_reset(esp_sc_decoder_t *dec)
+{
+  smartconfig_type_t type = dec->type;
+
+  memset(dec, 0, sizeof(*dec));
+  dec->type = type;
+}
+
+esp_sc_decode_state_t esp_sc_decoder_feed(esp_sc_decoder_t *dec,
+                                          const uint8_t sa[6], uint8_t ds,
+                                          uint16_t len)
+{
+  dec->stats.frames++;
+  dec->tick++;
+
+  if (dec->state == ESP_SC_DECODE_SEARCHING)
+    {
+      sc_search(dec, sc_source(dec, sa, ds), len);
+      return dec->state;
+    }
+
+  if (dec->state == ESP_SC_DECODE_DONE || ds != dec->ds ||
+      memcmp(sa, dec->mac, 6) != 0 || len < dec->base)
+    {
+      return dec->state;
+    }
+
+  dec->stats.locked_frames++;
+  sc_push(dec, len - dec->base);
+
+  if (dec->proto == SC_PROTO_ESPTOUCH)
+    {
+      sc_esptouch(dec);
+    }
+  else
+    {
+      sc_airkiss(dec);
+    }
+
+  return dec->state;
+}
+
+esp_sc_decode_state_t esp_sc_decoder_feed_pkt(esp_sc_decoder_t *dec,
+                                          const wifi_promiscuous_pkt_t *pkt,
+                                          wifi_promiscuous_pkt_type_t type)
+{
+  const uint8_t *hdr = pkt->payload;
+  uint8_t ds;
+
+  if (type != WIFI_PKT_DATA || pkt->rx_ctrl.sig_len < 24)
+    {
+      return dec->state;
+    }
+
+  /* SA is addr2, or addr3 when relayed by the AP */
+
+  ds = hdr[1] & 0x03;
+  if (ds == 0x03)
+    {
+      return dec->state;
+    }
+
+  return esp_sc_decoder_feed(dec, ds == 0x02 ? hdr + 16 : hdr + 10, ds,
+                             pkt->rx_ctrl.sig_len);
+}
+
+esp_err_t esp_sc_decoder_result(const esp_sc_decoder_t *dec,
+                                smartconfig_event_got_ssid_pswd_t *result)
+{
+  if (dec->state != ESP_SC_DECODE_DONE)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  *result = dec->result;
+  return ESP_OK;
+}
+
+void esp_sc_decoder_get_stats(const esp_sc_decoder_t *dec,
+                              esp_sc_decode_stats_t *stats)
+{
+  *stats = dec->stats;
+}
@@ -0,0 +1,411 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_sc_decode.h"
+
+/* The phone repeats the guide code for guide_ms then the data for
+ * data_ms, as the ESPTouch and AirKiss apps do.
+ */
+
+#define SC_SIM_GUIDE_MS     2000
+#define SC_SIM_DATA_MS      4000
+#define SC_SIM_MAX_SYMBOLS  1024
+#define SC_SIM_SOURCES      6
+
+struct sc_sim_stream
+{
+  uint16_t guide[4];
+  uint16_t data[SC_SIM_MAX_SYMBOLS];
+  uint32_t ndata;
+};
+
+struct sc_sim_frame
+{
+  int64_t time_us;
+  uint16_t len;
+  uint8_t src;
+};
+
+static const uint8_t s_phone[6] =
+{
+  0x02, 0x00, 0x00, 0x00, 0x00, 0x01
+};
+
+static uint32_t sc_sim_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static void sc_sim_esptouch_byte(struct sc_sim_stream *st, uint8_t v,
+                                 uint8_t idx)
+{
+  uint8_t buf[2];
+  uint8_t crc;
+
+  buf[0] = v;
+  buf[1] = idx;
+  crc = esp_sc_crc8(buf, 2);
+
+  st->data[st->ndata++] = 40 + ((crc & 0xf0) | (v >> 4));
+  st->data[st->ndata++] = 40 + 256 + idx;
+  st->data[st->ndata++] = 40 + ((crc & 0x0f) << 4 | (v & 0x0f));
+}
+
+static void sc_sim_esptouch(const esp_sc_sim_t *sim,
+                            struct sc_sim_stream *st)
+{
+  uint8_t d[128];
+  size_t pwd_len = strlen(sim->password);
+  size_t ssid_len = strlen(sim->ssid);
+  size_t total = 9 + pwd_len + ssid_len;
+  size_t i;
+
+  d[0] = total;
+  d[1] = pwd_len;
+  d[2] = esp_sc_crc8((const uint8_t *)sim->ssid, ssid_len);
+  d[3] = esp_sc_crc8(sim->bssid, 6);
+  memcpy(d + 5, sim->phone_ip, 4);
+  memcpy(d + 9, sim->password, pwd_len);
+  memcpy(d + 9 + pwd_len, sim->ssid, ssid_len);
+  memcpy(d + total, sim->bssid, 6);
+
+  d[4] = 0;
+  for (i = 5; i < total + 6; i++)
+    {
+      d[4] ^= d[i];
+    }
+
+  for (i = 0; i < 4; i++)
+    {
+      st->guide[i] = 515 - i;
+    }
+
+  st->ndata = 0;
+  for (i = 0; i < total + 6; i++)
+    {
+      sc_sim_esptouch_byte(st, d[i], i);
+    }
+}
+
+static void sc_sim_airkiss_code(struct sc_sim_stream *st, uint8_t prefix,
+                                uint8_t a, uint8_t b)
+{
+  st->data[st->ndata++] = (prefix << 4) | (a >> 4);
+  st->data[st->ndata++] = ((prefix + 1) << 4) | (a & 0x0f);
+  st->data[st->ndata++] = ((prefix + 2) << 4) | (b >> 4);
+  st->data[st->ndata++] = ((prefix + 3) << 4) | (b & 0x0f);
+}
+
+static void sc_sim_airkiss(const esp_sc_sim_t *sim, uint8_t token,
+                           struct sc_sim_stream *st)
+{
+  uint8_t d[128];
+  uint8_t buf[5];
+  size_t pwd_len = strlen(sim->password);
+  size_t ssid_len = strlen(sim->ssid);
+  size_t total = pwd_len + 1 + ssid_len;
+  uint8_t pl = pwd_len;
+  size_t size;
+  size_t idx;
+  size_t i;
+
+  memcpy(d, sim->password, pwd_len);
+  d[pwd_len] = token;
+  memcpy(d + pwd_len + 1, sim->ssid, ssid_len);
+
+  for (i = 0; i < 4; i++)
+    {
+      st->guide[i] = 1 + i;
+    }
+
+  /* Magic and prefix codes are repeated between the sequences */
+
+  st->ndata = 0;
+  for (idx = 0; idx * 4 < total; idx++)
+    {
+      if (idx % 4 == 0)
+        {
+          sc_sim_airkiss_code(st, 0, total,
+                              esp_sc_crc8((const uint8_t *)sim->ssid,
+                                          ssid_len));
+          sc_sim_airkiss_code(st, 4, pl, esp_sc_crc8(&pl, 1));
+        }
+
+      size = total - idx * 4 < 4 ? total - idx * 4 : 4;
+      buf[0] = idx;
+      memcpy(buf + 1, d + idx * 4, size);
+
+      st->data[st->ndata++] = 0x80 | (esp_sc_crc8(buf, size + 1) & 0x7f);
+      st->data[st->ndata++] = 0x80 | idx;
+      for (i = 0; i < size; i++)
+        {
+          st->data[st->ndata++] = 0x100 | d[idx * 4 + i];
+        }
+    }
+}
+
+/* Frames of one run, the phone's and other stations', in time order */
+
+static size_t sc_sim_frames(const esp_sc_sim_t *sim,
+                            const struct sc_sim_stream *st,
+                            uint32_t *rng, struct sc_sim_frame *frames,
+                            size_t max)
+{
+  int64_t end = (int64_t)sim->timeout_ms * 1000;
+  int64_t t_phone = sc_sim_rand(rng) % sim->frame_interval_us;
+  int64_t t_intf = 0;
+  uint32_t gap = sim->interference_fps ?
+                 2000000 / sim->interference_fps : 0;
+  uint32_t g = 0;
+  uint32_t d = 0;
+  uint32_t pos;
+  size_t n = 0;
+
+  if (gap)
+    {
+      t_intf = sc_sim_rand(rng) % gap;
+    }
+
+  while (n + 2 < max && (t_phone < end || (gap && t_intf < end)))
+    {
+      if (gap && t_intf < t_phone)
+        {
+          frames[n].time_us = t_intf;
+          frames[n].len = 60 + sc_sim_rand(rng) % 1440;
+          frames[n].src = 1 + sc_sim_rand(rng) % (SC_SIM_SOURCES - 1);
+          n++;
+          t_intf += 1 + sc_sim_rand(rng) % gap;
+          continue;
+        }
+
+      pos = (t_phone / 1000) % (SC_SIM_GUIDE_MS + SC_SIM_DATA_MS);
+      if (sc_sim_rand(rng) % 1000 >= sim->loss_permille)
+        {
+          frames[n].time_us = t_phone;
+          frames[n].src = 0;
+          frames[n].len = sim->len_offset +
+                          (pos < SC_SIM_GUIDE_MS ? st->guide[g % 4] :
+                           st->data[d % st->ndata]);
+          n++;
+
+          if (sc_sim_rand(rng) % 1000 < sim->noise_permille)
+            {
+              frames[n].time_us = t_phone + 1;
+              frames[n].src = 0;
+              frames[n].len = 60 + sc_sim_rand(rng) % 1440;
+              n++;
+            }
+        }
+
+      if (pos < SC_SIM_GUIDE_MS)
+        {
+          g++;
+        }
+      else
+        {
+          d++;
+        }
+
+      t_phone += sim->frame_interval_us;
+    }
+
+  return n;
+}
+
+static bool sc_sim_check(const esp_sc_sim_t *sim,
+                         const smartconfig_event_got_ssid_pswd_t *r)
+{
+  if (strcmp((const char *)r->ssid, sim->ssid) != 0 ||
+      strcmp((const char *)r->password, sim->password) != 0)
+    {
+      return false;
+    }
+
+  if (sim->type == SC_TYPE_ESPTOUCH)
+    {
+      return memcmp(r->bssid, sim->bssid, 6) == 0 &&
+             memcmp(r->cellphone_ip, sim->phone_ip, 4) == 0;
+    }
+
+  return true;
+}
+
+void esp_sc_sim_default(esp_sc_sim_t *sim)
+{
+  static const uint8_t bssid[6] =
+  {
+    0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56
+  };
+
+  static const uint8_t ip[4] =
+  {
+    192, 168, 1, 100
+  };
+
+  memset(sim, 0, sizeof(*sim));
+  sim->type = SC_TYPE_ESPTOUCH;
+  sim->ssid = "production-line-ap";
+  sim->password = "12345678abcdefgh";
+  memcpy(sim->bssid, bssid, 6);
+  memcpy(sim->phone_ip, ip, 4);
+  sim->frame_interval_us = 8000;
+  sim->len_offset = 52;
+  sim->loss_permille = 100;
+  sim->noise_permille = 20;
+  sim->interference_fps = 200;
+  sim->timeout_ms = 60000;
+  sim->runs = 100;
+  sim->seed = 1;
+}
+
+esp_err_t esp_sc_sim_run(const esp_sc_sim_t *sim,
+                         esp_sc_sim_result_t *result)
+{
+  smartconfig_event_got_ssid_pswd_t got;
+  struct sc_sim_stream *st;
+  struct sc_sim_frame *frames;
+  esp_sc_decoder_t *dec;
+  esp_sc_decode_state_t state;
+  esp_sc_decode_state_t prev;
+  uint8_t mac[6];
+  uint64_t lock_sum = 0;
+  uint64_t decode_sum = 0;
+  uint32_t locked = 0;
+  uint32_t rng;
+  size_t max;
+  size_t n;
+  size_t i;
+  clock_t cpu = 0;
+  clock_t c0;
+  uint32_t run;
+  esp_err_t ret;
+
+  if (sim == NULL || result == NULL || sim->ssid == NULL ||
+      sim->password == NULL || sim->frame_interval_us == 0 ||
+      (sim->type != SC_TYPE_ESPTOUCH && sim->type != SC_TYPE_AIRKISS) ||
+      strlen(sim->ssid) == 0 || strlen(sim->ssid) > 32 ||
+      strlen(sim->password) > 63 ||
+      strlen(sim->ssid) + strlen(sim->password) > 96)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ret = esp_sc_decoder_create(sim->type, &dec);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  max = (size_t)sim->timeout_ms * 1000 / sim->frame_interval_us * 2 +
+        (size_t)sim->timeout_ms * sim->interference_fps / 1000 * 2 + 16;
+  st = malloc(sizeof(*st));
+  frames = malloc(max * sizeof(*frames));
+  if (st == NULL || frames == NULL)
+    {
+      free(st);
+      free(frames);
+      esp_sc_decoder_delete(dec);
+      return ESP_ERR_NO_MEM;
+    }
+
+  memset(result, 0, sizeof(*result));
+  rng = sim->seed ? sim->seed : 1;
+
+  for (run = 0; run < sim->runs; run++)
+    {
+      if (sim->type == SC_TYPE_ESPTOUCH)
+        {
+          sc_sim_esptouch(sim, st);
+        }
+      else
+        {
+          sc_sim_airkiss(sim, sc_sim_rand(&rng), st);
+        }
+
+      n = sc_sim_frames(sim, st, &rng, frames, max);
+      esp_sc_decoder_reset(dec);
+      prev = ESP_SC_DECODE_SEARCHING;
+      state = prev;
+
+      memcpy(mac, s_phone, 6);
+      for (i = 0; i < n && state != ESP_SC_DECODE_DONE; i++)
+        {
+          mac[5] = frames[i].src + 1;
+
+          c0 = clock();
+          state = esp_sc_decoder_feed(dec, mac, 0x01, frames[i].len);
+          cpu += clock() - c0;
+          result->frames++;
+
+          if (state != prev && prev == ESP_SC_DECODE_SEARCHING)
+            {
+              lock_sum += frames[i].time_us / 1000;
+              locked++;
+            }
+
+          prev = state;
+        }
+
+      if (state != ESP_SC_DECODE_DONE)
+        {
+          result->timeouts++;
+          continue;
+        }
+
+      esp_sc_decoder_result(dec, &got);
+      if (!sc_sim_check(sim, &got))
+        {
+          result->wrong++;
+          continue;
+        }
+
+      result->decoded++;
+      decode_sum += frames[i - 1].time_us / 1000;
+      if (frames[i - 1].time_us / 1000 > result->decode_max_ms)
+        {
+          result->decode_max_ms = frames[i - 1].time_us / 1000;
+        }
+    }
+
+  if (locked)
+    {
+      result->lock_avg_ms = lock_sum / locked;
+    }
+
+  if (result->decoded)
+    {
+      result->decode_avg_ms = decode_sum / result->decoded;
+    }
+
+  if (result->frames)
+    {
+      result->ns_per_frame = (uint32_t)((double)cpu * 1e9 / CLOCKS_PER_SEC /
+                                        result->frames);
+    }
+
+  free(st);
+  free(frames);
+  esp_sc_decoder_delete(dec);
+  return ESP_OK;
+}
@@ -0,0 +1,570 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_action_mux.h"
+
+#define MUX_NONE            0xff
+#define MUX_PUBLIC_VENDOR   9    /* Vendor Specific Public Action */
+
+struct action_mux_req
+{
+  bool used;
+  bool in_window;
+  bool sent;
+  uint8_t client;
+  uint8_t channel;
+  uint32_t id;
+  uint32_t dwell_ms;             /* 0 for a frame */
+  uint32_t queued_ms;
+  wifi_action_tx_req_t *frame;   /* NULL for a dwell */
+};
+
+struct esp_wifi_action_mux
+{
+  esp_wifi_action_mux_config_t cfg;
+  esp_wifi_action_mux_stats_t stats;
+  uint32_t seq;
+  uint8_t count;
+  uint8_t home;
+  uint8_t radio;                 /* channel the radio is on, 0 unknown */
+  bool on;
+  uint32_t begun_ms;             /* of the window on */
+  uint8_t tx_out;                /* frame sent, MUX_NONE */
+  bool used[ESP_WIFI_ACTION_MUX_CLIENTS];
+  esp_wifi_action_mux_client_t clients[ESP_WIFI_ACTION_MUX_CLIENTS];
+  struct action_mux_req reqs[ESP_WIFI_ACTION_MUX_QUEUE];
+};
+
+static struct action_mux_req *mux_slot(esp_wifi_action_mux_t *mux,
+                                       uint8_t client, uint8_t channel,
+                                       uint32_t now_ms)
+{
+  struct action_mux_req *r;
+  int i;
+
+  for (i = 0; i < ESP_WIFI_ACTION_MUX_QUEUE; i++)
+    {
+      r = &mux->reqs[i];
+      if (!r->used)
+        {
+          memset(r, 0, sizeof(*r));
+          r->used = true;
+          r->client = client;
+          r->channel = channel;
+          r->queued_ms = now_ms;
+
+          /* 0 is no request */
+
+          if (++mux->seq == 0)
+            {
+              mux->seq = 1;
+            }
+
+          r->id = mux->seq;
+          return r;
+        }
+    }
+
+  return NULL;
+}
+
+static void mux_release(esp_wifi_action_mux_t *mux, struct action_mux_req *r)
+{
+  free(r->frame);
+  r->frame = NULL;
+  r->used = false;
+  mux->count--;
+}
+
+/* Oldest request on channel, any channel with 0, not in the window */
+
+static struct action_mux_req *mux_oldest(const esp_wifi_action_mux_t *mux,
+                                         uint8_t channel, uint32_t now_ms)
+{
+  const struct action_mux_req *o = NULL;
+  const struct action_mux_req *r;
+  int i;
+
+  for (i = 0; i < ESP_WIFI_ACTION_MUX_QUEUE; i++)
+    {
+      r = &mux->reqs[i];
+      if (r->used && !r->in_window &&
+          (channel == 0 || r->channel == channel) &&
+          (o == NULL || now_ms - r->queued_ms > now_ms - o->queued_ms ||
+           (r->queued_ms == o->queued_ms && r->id - o->id > 0x80000000u)))
+        {
+          o = r;
+        }
+    }
+
+  return (struct action_mux_req *)o;
+}
+
+static void mux_done(esp_wifi_action_mux_t *mux,
+                     const struct action_mux_req *r, esp_err_t status,
+                     esp_wifi_action_mux_done_t *done)
+{
+  done->done = NULL;
+  done->ctx = NULL;
+  if (r->client != MUX_NONE && mux->used[r->client])
+    {
+      done->done = mux->clients[r->client].done;
+      done->ctx = mux->clients[r->client].ctx;
+    }
+
+  done->id = r->id;
+  done->status = status;
+}
+
+void esp_wifi_action_mux_default(esp_wifi_action_mux_config_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->ifx = WIFI_IF_STA;
+  cfg->hold_ms = 20;
+  cfg->tx_dwell_ms = 30;
+  cfg->max_merge = ESP_WIFI_ACTION_MUX_QUEUE;
+}
+
+esp_err_t esp_wifi_action_mux_create(const esp_wifi_action_mux_config_t *cfg,
+                                     esp_wifi_action_mux_t **mux)
+{
+  esp_wifi_action_mux_t *m;
+
+  if (cfg == NULL || mux == NULL || cfg->max_merge == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  m = calloc(1, sizeof(*m));
+  if (m == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  m->cfg = *cfg;
+  m->tx_out = MUX_NONE;
+  *mux = m;
+  return ESP_OK;
+}
+
+void esp_wifi_action_mux_delete(esp_wifi_action_mux_t *mux)
+{
+  int i;
+
+  if (mux == NULL)
+    {
+      return;
+    }
+
+  for (i = 0; i < ESP_WIFI_ACTION_MUX_QUEUE; i++)
+    {
+      free(mux->reqs[i].frame);
+    }
+
+  free(mux);
+}
+
+esp_err_t esp_wifi_action_mux_register(esp_wifi_action_mux_t *mux,
+                                       const esp_wifi_action_mux_client_t
+                                       *client, uint8_t *id)
+{
+  int i;
+
+  if (client == NULL || id == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  for (i = 0; i < ESP_WIFI_ACTION_MUX_CLIENTS; i++)
+    {
+      if (!mux->used[i])
+        {
+          mux->used[i] = true;
+          mux->clients[i] = *client;
+          *id = i;
+          return ESP_OK;
+        }
+    }
+
+  return ESP_ERR_NO_MEM;
+}
+
+void esp_wifi_action_mux_unregister(esp_wifi_action_mux_t *mux, uint8_t id)
+{
+  struct action_mux_req *r;
+  int i;
+
+  if (id >= ESP_WIFI_ACTION_MUX_CLIENTS)
+    {
+      return;
+    }
+
+  /* The frame out with the driver stays until its status, orphaned so
+   * that a client taking the id again gets no callback of it
+   */
+
+  for (i = 0; i < ESP_WIFI_ACTION_MUX_QUEUE; i++)
+    {
+      r = &mux->reqs[i];
+      if (!r->used || r->client != id)
+        {
+          continue;
+        }
+
+      if (i == mux->tx_out)
+        {
+          r->client = MUX_NONE;
+        }
+      else
+        {
+          mux_release(mux, r);
+        }
+    }
+
+  mux->used[id] = false;
+}
+
+void esp_wifi_action_mux_set_home(esp_wifi_action_mux_t *mux,
+                                  uint8_t channel)
+{
+  mux->home = channel;
+  if (channel && !mux->on)
+    {
+      mux->radio = channel;
+    }
+}
+
+esp_err_t esp_wifi_action_mux_queue_tx(esp_wifi_action_mux_t *mux,
+                                       uint8_t client, uint8_t channel,
+                                       const uint8_t dest[6],
+                                       const uint8_t *body, size_t len,
+                                       bool no_ack, uint32_t now_ms,
+                                       uint32_t *id)
+{
+  wifi_action_tx_req_t *frame;
+  struct action_mux_req *r;
+
+  if (client >= ESP_WIFI_ACTION_MUX_CLIENTS || !mux->used[client] ||
+      channel == 0 || dest == NULL || body == NULL || len == 0 ||
+      id == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (mux->count == ESP_WIFI_ACTION_MUX_QUEUE)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  frame = malloc(sizeof(*frame) + len);
+  if (frame == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  memset(frame, 0, sizeof(*frame));
+  frame->ifx = mux->cfg.ifx;
+  memcpy(frame->dest_mac, dest, 6);
+  frame->no_ack = no_ack;
+  frame->data_len = len;
+  memcpy(frame->data, body, len);
+
+  r = mux_slot(mux, client, channel, now_ms);
+  r->frame = frame;
+  mux->count++;
+  mux->stats.requests++;
+  *id = r->id;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_action_mux_queue_roc(esp_wifi_action_mux_t *mux,
+                                        uint8_t client, uint8_t channel,
+                                        uint32_t dwell_ms, uint32_t now_ms,
+                                        uint32_t *id)
+{
+  struct action_mux_req *r;
+
+  if (client >= ESP_WIFI_ACTION_MUX_CLIENTS || !mux->used[client] ||
+      channel == 0 || dwell_ms == 0 || id == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (mux->count == ESP_WIFI_ACTION_MUX_QUEUE)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  r = mux_slot(mux, client, channel, now_ms);
+  r->dwell_ms = dwell_ms;
+  mux->count++;
+  mux->stats.requests++;
+  *id = r->id;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_action_mux_cancel(esp_wifi_action_mux_t *mux,
+                                     uint32_t id)
+{
+  struct action_mux_req *r;
+  int i;
+
+  for (i = 0; i < ESP_WIFI_ACTION_MUX_QUEUE; i++)
+    {
+      r = &mux->reqs[i];
+      if (r->used && !r->in_window && r->id == id)
+        {
+          mux_release(mux, r);
+          return ESP_OK;
+        }
+    }
+
+  return ESP_ERR_NOT_FOUND;
+}
+
+uint32_t esp_wifi_action_mux_wait_ms(const esp_wifi_action_mux_t *mux,
+                                     uint32_t now_ms)
+{
+  const struct action_mux_req *o;
+  uint32_t age;
+
+  if (mux->on || mux->count == 0)
+    {
+      return UINT32_MAX;
+    }
+
+  /* Held no longer once full */
+
+  if (mux->count == ESP_WIFI_ACTION_MUX_QUEUE)
+    {
+      return 0;
+    }
+
+  o = mux_oldest(mux, 0, now_ms);
+  age = now_ms - o->queued_ms;
+  return age >= mux->cfg.hold_ms ? 0 : mux->cfg.hold_ms - age;
+}
+
+esp_err_t esp_wifi_action_mux_begin(esp_wifi_action_mux_t *mux,
+                                    uint32_t now_ms,
+                                    esp_wifi_action_mux_window_t *win)
+{
+  struct action_mux_req *r;
+  uint32_t latency;
+  uint8_t channel;
+
+  if (mux->on)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  if (esp_wifi_action_mux_wait_ms(mux, now_ms) != 0)
+    {
+      return ESP_ERR_NOT_FOUND;
+    }
+
+  memset(win, 0, sizeof(*win));
+  channel = mux_oldest(mux, 0, now_ms)->channel;
+  win->ifx = mux->cfg.ifx;
+  win->channel = channel;
+
+  /* The oldest first, as many as merged */
+
+  while (win->requests < mux->cfg.max_merge &&
+         (r = mux_oldest(mux, channel, now_ms)) != NULL)
+    {
+      r->in_window = true;
+      win->requests++;
+      if (r->frame)
+        {
+          win->frames++;
+          if (win->dwell_ms < mux->cfg.tx_dwell_ms)
+            {
+              win->dwell_ms = mux->cfg.tx_dwell_ms;
+            }
+        }
+      else if (win->dwell_ms < r->dwell_ms)
+        {
+          win->dwell_ms = r->dwell_ms;
+        }
+
+      latency = now_ms - r->queued_ms;
+      mux->stats.latency_sum_ms += latency;
+      if (mux->stats.latency_max_ms < latency)
+        {
+          mux->stats.latency_max_ms = latency;
+        }
+    }
+
+  if (mux->radio != channel)
+    {
+      mux->stats.switches++;
+      mux->radio = channel;
+    }
+
+  mux->stats.windows++;
+  mux->begun_ms = now_ms;
+  mux->on = true;
+  return ESP_OK;
+}
+
+wifi_action_tx_req_t *esp_wifi_action_mux_next_tx(esp_wifi_action_mux_t
+                                                  *mux)
+{
+  struct action_mux_req *r;
+  int i;
+
+  if (!mux->on || mux->tx_out != MUX_NONE)
+    {
+      return NULL;
+    }
+
+  for (i = 0; i < ESP_WIFI_ACTION_MUX_QUEUE; i++)
+    {
+      r = &mux->reqs[i];
+      if (r->used && r->in_window && r->frame && !r->sent)
+        {
+          r->sent = true;
+          mux->tx_out = i;
+          return r->frame;
+        }
+    }
+
+  return NULL;
+}
+
+bool esp_wifi_action_mux_tx_done(esp_wifi_action_mux_t *mux, bool ok,
+                                 esp_wifi_action_mux_done_t *done)
+{
+  struct action_mux_req *r;
+
+  if (mux->tx_out == MUX_NONE)
+    {
+      return false;
+    }
+
+  r = &mux->reqs[mux->tx_out];
+  mux->tx_out = MUX_NONE;
+  if (!ok)
+    {
+      mux->stats.tx_failed++;
+    }
+
+  mux_done(mux, r, ok ? ESP_OK : ESP_FAIL, done);
+  mux_release(mux, r);
+  return true;
+}
+
+size_t esp_wifi_action_mux_end(esp_wifi_action_mux_t *mux, uint32_t now_ms,
+                               esp_wifi_action_mux_done_t *done, size_t max)
+{
+  struct action_mux_req *r;
+  esp_err_t status;
+  size_t n = 0;
+  int i;
+
+  if (!mux->on)
+    {
+      return 0;
+    }
+
+  for (i = 0; i < ESP_WIFI_ACTION_MUX_QUEUE; i++)
+    {
+      r = &mux->reqs[i];
+      if (!r->used || !r->in_window)
+        {
+          continue;
+        }
+
+      status = ESP_OK;
+      if (r->frame)
+        {
+          mux->stats.tx_failed++;
+          status = ESP_FAIL;
+        }
+
+      if (n < max)
+        {
+          mux_done(mux, r, status, &done[n++]);
+        }
+
+      mux_release(mux, r);
+    }
+
+  mux->stats.dwell_ms += now_ms - mux->begun_ms;
+  mux->on = false;
+  mux->tx_out = MUX_NONE;
+  if (mux->home && mux->radio != mux->home)
+    {
+      mux->stats.switches++;
+      mux->radio = mux->home;
+    }
+
+  return n;
+}
+
+size_t esp_wifi_action_mux_route(esp_wifi_action_mux_t *mux,
+                                 const uint8_t *body, size_t len,
+                                 esp_wifi_action_mux_client_t *out,
+                                 size_t max)
+{
+  const esp_wifi_action_mux_client_t *c;
+  const uint8_t *oui = NULL;
+  size_t n = 0;
+  int i;
+
+  if (len == 0)
+    {
+      return 0;
+    }
+
+  mux->stats.rx++;
+  if (body[0] == ESP_WIFI_ACTION_CAT_VENDOR && len >= 4)
+    {
+      oui = body + 1;
+    }
+  else if (body[0] == ESP_WIFI_ACTION_CAT_PUBLIC && len >= 5 &&
+           body[1] == MUX_PUBLIC_VENDOR)
+    {
+      oui = body + 2;
+    }
+
+  for (i = 0; i < ESP_WIFI_ACTION_MUX_CLIENTS && n < max; i++)
+    {
+      c = &mux->clients[i];
+      if (mux->used[i] && c->category == body[0] &&
+          (c->any_oui || (oui && memcmp(c->oui, oui, 3) == 0)))
+        {
+          out[n++] = *c;
+        }
+    }
+
+  if (n == 0)
+    {
+      mux->stats.rx_unrouted++;
+    }
+
+  return n;
+}
+
+void esp_wifi_action_mux_get_stats(const esp_wifi_action_mux_t *mux,
+                                   esp_wifi_action_mux_stats_t *stats)
+{
+  *stats = mux->stats;
+}
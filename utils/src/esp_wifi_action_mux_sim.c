@@ -0,0 +1,206 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_action_mux.h"
+
+static const uint8_t g_sim_channels[3] =
+{
+  1, 6, 11
+};
+
+static uint32_t mux_sim_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static uint32_t mux_sim_switches(const esp_wifi_action_mux_t *mux)
+{
+  esp_wifi_action_mux_stats_t st;
+
+  esp_wifi_action_mux_get_stats(mux, &st);
+  return st.switches;
+}
+
+/* Millisecond steps: requests arrive, windows begin and end, a channel
+ * switch keeping the radio busy switch_ms
+ */
+
+static esp_err_t mux_sim_policy(const esp_wifi_action_mux_sim_t *sim,
+                                const esp_wifi_action_mux_config_t *cfg,
+                                uint32_t *requests,
+                                esp_wifi_action_mux_sim_stat_t *stat)
+{
+  static const uint8_t body[8] =
+  {
+    ESP_WIFI_ACTION_CAT_PUBLIC, 9, 0x50, 0x6f, 0x9a, 0x1a, 1, 0
+  };
+
+  esp_wifi_action_mux_done_t done[ESP_WIFI_ACTION_MUX_QUEUE];
+  esp_wifi_action_mux_client_t client;
+  esp_wifi_action_mux_window_t win;
+  esp_wifi_action_mux_stats_t st;
+  esp_wifi_action_mux_t *mux;
+  uint32_t end_ms = sim->seconds * 1000;
+  uint32_t busy_ms = 0;
+  uint32_t rng;
+  uint32_t now_ms;
+  uint32_t switches;
+  uint32_t id;
+  uint8_t cid;
+  uint8_t ch;
+  bool on = false;
+  esp_err_t ret;
+
+  ret = esp_wifi_action_mux_create(cfg, &mux);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  memset(&client, 0, sizeof(client));
+  client.category = ESP_WIFI_ACTION_CAT_PUBLIC;
+  client.any_oui = true;
+  esp_wifi_action_mux_register(mux, &client, &cid);
+  esp_wifi_action_mux_set_home(mux, sim->home_channel);
+  memset(stat, 0, sizeof(*stat));
+  rng = sim->seed ? sim->seed : 1;
+
+  /* Past the end, no more requests and the queue drained */
+
+  for (now_ms = 0;
+       now_ms < end_ms || on ||
+       esp_wifi_action_mux_wait_ms(mux, now_ms) != UINT32_MAX;
+       now_ms++)
+    {
+      if (now_ms < end_ms)
+        {
+          ch = g_sim_channels[mux_sim_rand(&rng) % 3];
+          if (mux_sim_rand(&rng) % 1000 < sim->tx_per_s)
+            {
+              ret = esp_wifi_action_mux_queue_tx(mux, cid, ch, body + 2,
+                                                 body, sizeof(body), false,
+                                                 now_ms, &id);
+              stat->dropped += ret != ESP_OK;
+            }
+
+          if (mux_sim_rand(&rng) % 1000 < sim->roc_per_s)
+            {
+              ret = esp_wifi_action_mux_queue_roc(mux, cid, ch,
+                                                  sim->roc_dwell_ms, now_ms,
+                                                  &id);
+              stat->dropped += ret != ESP_OK;
+            }
+        }
+
+      if (now_ms < busy_ms)
+        {
+          continue;
+        }
+
+      if (on)
+        {
+          switches = mux_sim_switches(mux);
+          esp_wifi_action_mux_end(mux, now_ms, done,
+                                  ESP_WIFI_ACTION_MUX_QUEUE);
+          on = false;
+          busy_ms = now_ms + (mux_sim_switches(mux) - switches) *
+                    sim->switch_ms;
+          if (win.channel != sim->home_channel)
+            {
+              stat->off_home_ms += busy_ms - now_ms;
+            }
+
+          continue;
+        }
+
+      switches = mux_sim_switches(mux);
+      if (esp_wifi_action_mux_begin(mux, now_ms, &win) != ESP_OK)
+        {
+          continue;
+        }
+
+      while (esp_wifi_action_mux_next_tx(mux))
+        {
+          esp_wifi_action_mux_tx_done(mux, true, done);
+        }
+
+      on = true;
+      busy_ms = now_ms + win.dwell_ms +
+                (mux_sim_switches(mux) - switches) * sim->switch_ms;
+      if (win.channel != sim->home_channel)
+        {
+          stat->off_home_ms += busy_ms - now_ms;
+        }
+    }
+
+  esp_wifi_action_mux_get_stats(mux, &st);
+  *requests = st.requests;
+  stat->windows = st.windows;
+  stat->switches = st.switches;
+  stat->latency_avg_ms = st.requests ? st.latency_sum_ms / st.requests : 0;
+  stat->latency_max_ms = st.latency_max_ms;
+  esp_wifi_action_mux_delete(mux);
+  return ESP_OK;
+}
+
+void esp_wifi_action_mux_sim_default(esp_wifi_action_mux_sim_t *sim)
+{
+  memset(sim, 0, sizeof(*sim));
+  sim->seconds = 60;
+  sim->home_channel = 6;
+  sim->tx_per_s = 10;
+  sim->roc_per_s = 2;
+  sim->roc_dwell_ms = 100;
+  sim->switch_ms = 5;
+  sim->seed = 1;
+}
+
+esp_err_t esp_wifi_action_mux_sim_run(const esp_wifi_action_mux_sim_t *sim,
+                                      esp_wifi_action_mux_sim_result_t
+                                      *result)
+{
+  esp_wifi_action_mux_config_t cfg;
+  esp_err_t ret;
+
+  if (sim == NULL || result == NULL || sim->seconds == 0 ||
+      (sim->tx_per_s == 0 && sim->roc_per_s == 0))
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  memset(result, 0, sizeof(*result));
+
+  /* One request per window, as the driver alone, then merged */
+
+  esp_wifi_action_mux_default(&cfg);
+  cfg.hold_ms = 0;
+  cfg.max_merge = 1;
+  ret = mux_sim_policy(sim, &cfg, &result->requests, &result->serial);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  esp_wifi_action_mux_default(&cfg);
+  return mux_sim_policy(sim, &cfg, &result->requests, &result->merged);
+}
@@ -0,0 +1,473 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_action_mux.h"
+
+/* Provided by libnet80211.a */
+
+extern esp_err_t esp_wifi_action_tx_req(uint8_t type, uint8_t channel,
+                                        uint32_t wait_time_ms,
+                                        const wifi_action_tx_req_t *req);
+extern esp_err_t esp_wifi_remain_on_channel(uint8_t ifx, uint8_t type,
+                                            uint8_t channel,
+                                            uint32_t wait_time_ms,
+                                            wifi_action_rx_cb_t rx_cb);
+
+static esp_wifi_action_mux_t *s_mux;
+static esp_wifi_action_mux_window_t s_win;
+static void *s_lock;
+static esp_timer_handle_t s_timer;
+
+static uint32_t action_mux_now_ms(void)
+{
+  return esp_timer_get_time() / 1000;
+}
+
+static void action_mux_call(const esp_wifi_action_mux_done_t *done,
+                            size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (done[i].done)
+        {
+          done[i].done(done[i].ctx, done[i].id, done[i].status);
+        }
+    }
+}
+
+static int action_mux_rx(uint8_t *hdr, uint8_t *payload, size_t len,
+                         uint8_t channel)
+{
+  esp_wifi_action_mux_client_t clients[ESP_WIFI_ACTION_MUX_CLIENTS];
+  size_t n = 0;
+  size_t i;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_mux)
+    {
+      n = esp_wifi_action_mux_route(s_mux, payload, len, clients,
+                                    ESP_WIFI_ACTION_MUX_CLIENTS);
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  for (i = 0; i < n; i++)
+    {
+      if (clients[i].rx)
+        {
+          clients[i].rx(clients[i].ctx, hdr, payload, len, channel);
+        }
+    }
+
+  return 0;
+}
+
+/* Send the next frame of the window, failing those the driver refuses.
+ * Called unlocked: the frame is copied out, as the driver copies it in.
+ */
+
+static void action_mux_send_next(uint8_t channel)
+{
+  esp_wifi_action_mux_done_t done[ESP_WIFI_ACTION_MUX_QUEUE];
+  wifi_action_tx_req_t *frame;
+  wifi_action_tx_req_t *req;
+  size_t n = 0;
+  esp_err_t ret;
+
+  do
+    {
+      req = NULL;
+      g_wifi_osi_funcs._mutex_lock(s_lock);
+      frame = s_mux ? esp_wifi_action_mux_next_tx(s_mux) : NULL;
+      if (frame)
+        {
+          req = malloc(sizeof(*req) + frame->data_len);
+          if (req)
+            {
+              memcpy(req, frame, sizeof(*req) + frame->data_len);
+            }
+        }
+
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      if (frame == NULL)
+        {
+          break;
+        }
+
+      ret = ESP_ERR_NO_MEM;
+      if (req)
+        {
+          req->rx_cb = action_mux_rx;
+          ret = esp_wifi_action_tx_req(WIFI_OFFCHAN_TX_REQ, channel, 0, req);
+          free(req);
+        }
+
+      if (ret != ESP_OK)
+        {
+          g_wifi_osi_funcs._mutex_lock(s_lock);
+          if (s_mux && n < ESP_WIFI_ACTION_MUX_QUEUE &&
+              esp_wifi_action_mux_tx_done(s_mux, false, &done[n]))
+            {
+              n++;
+            }
+
+          g_wifi_osi_funcs._mutex_unlock(s_lock);
+        }
+    }
+  while (ret != ESP_OK);
+
+  action_mux_call(done, n);
+}
+
+/* Put a window on the driver, out of the lock */
+
+static void action_mux_roc(const esp_wifi_action_mux_window_t *win)
+{
+  esp_wifi_action_mux_done_t done[ESP_WIFI_ACTION_MUX_QUEUE];
+  size_t n = 0;
+
+  if (esp_wifi_remain_on_channel(win->ifx, WIFI_ROC_REQ, win->channel,
+                                 win->dwell_ms, action_mux_rx) == ESP_OK)
+    {
+      action_mux_send_next(win->channel);
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_mux)
+    {
+      n = esp_wifi_action_mux_end(s_mux, action_mux_now_ms(), done,
+                                  ESP_WIFI_ACTION_MUX_QUEUE);
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+  action_mux_call(done, n);
+}
+
+/* Begin the next window or hold for it. Called locked, true with win to
+ * put on the driver once unlocked.
+ */
+
+static bool action_mux_kick(esp_wifi_action_mux_window_t *win)
+{
+  uint32_t now_ms = action_mux_now_ms();
+  uint32_t wait_ms;
+
+  wait_ms = esp_wifi_action_mux_wait_ms(s_mux, now_ms);
+  if (wait_ms == UINT32_MAX)
+    {
+      return false;
+    }
+
+  if (wait_ms)
+    {
+      esp_timer_stop(s_timer);
+      esp_timer_start_once(s_timer, (uint64_t)wait_ms * 1000);
+      return false;
+    }
+
+  if (esp_wifi_action_mux_begin(s_mux, now_ms, &s_win) != ESP_OK)
+    {
+      return false;
+    }
+
+  *win = s_win;
+  return true;
+}
+
+static void action_mux_timer_cb(void *arg)
+{
+  esp_wifi_action_mux_window_t win;
+  bool on = false;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_mux)
+    {
+      on = action_mux_kick(&win);
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+  if (on)
+    {
+      action_mux_roc(&win);
+    }
+}
+
+static void action_mux_event_handler(void *arg, esp_event_base_t base,
+                                     int32_t id, void *data)
+{
+  esp_wifi_action_mux_done_t done[ESP_WIFI_ACTION_MUX_QUEUE];
+  const wifi_event_action_tx_status_t *status;
+  const wifi_event_sta_connected_t *conn;
+  esp_wifi_action_mux_window_t win;
+  uint8_t send = 0;
+  bool on = false;
+  size_t n = 0;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_mux == NULL)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return;
+    }
+
+  switch (id)
+    {
+      case WIFI_EVENT_ACTION_TX_STATUS:
+        status = data;
+        if (esp_wifi_action_mux_tx_done(s_mux, status->status == 0,
+                                        &done[n]))
+          {
+            n++;
+            send = s_win.channel;
+          }
+        break;
+
+      case WIFI_EVENT_ROC_DONE:
+        n = esp_wifi_action_mux_end(s_mux, action_mux_now_ms(), done,
+                                    ESP_WIFI_ACTION_MUX_QUEUE);
+        on = action_mux_kick(&win);
+        break;
+
+      case WIFI_EVENT_STA_CONNECTED:
+        conn = data;
+        esp_wifi_action_mux_set_home(s_mux, conn->channel);
+        break;
+
+      case WIFI_EVENT_STA_DISCONNECTED:
+        esp_wifi_action_mux_set_home(s_mux, 0);
+        break;
+
+      default:
+        break;
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+  action_mux_call(done, n);
+  if (send)
+    {
+      action_mux_send_next(send);
+    }
+
+  if (on)
+    {
+      action_mux_roc(&win);
+    }
+}
+
+esp_err_t esp_wifi_action_mux_start(esp_wifi_action_mux_t *mux)
+{
+  esp_timer_create_args_t args =
+  {
+    .callback = action_mux_timer_cb,
+    .name = "wifi_action_mux",
+  };
+
+  wifi_ap_record_t ap;
+  esp_err_t ret;
+
+  if (mux == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  if (s_timer == NULL)
+    {
+      ret = esp_timer_create(&args, &s_timer);
+      if (ret != ESP_OK)
+        {
+          return ret;
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_mux)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  s_mux = mux;
+  if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+    {
+      esp_wifi_action_mux_set_home(mux, ap.primary);
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  ret = esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+                                   action_mux_event_handler, NULL);
+  if (ret != ESP_OK)
+    {
+      esp_wifi_action_mux_stop();
+    }
+
+  return ret;
+}
+
+void esp_wifi_action_mux_stop(void)
+{
+  esp_wifi_action_mux_done_t done[ESP_WIFI_ACTION_MUX_QUEUE];
+  wifi_interface_t ifx = WIFI_IF_STA;
+  size_t n = 0;
+
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  esp_event_handler_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID,
+                               action_mux_event_handler);
+  esp_timer_stop(s_timer);
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_mux)
+    {
+      n = esp_wifi_action_mux_end(s_mux, action_mux_now_ms(), done,
+                                  ESP_WIFI_ACTION_MUX_QUEUE);
+      ifx = s_win.ifx;
+    }
+
+  s_mux = NULL;
+  memset(&s_win, 0, sizeof(s_win));
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  if (n)
+    {
+      esp_wifi_remain_on_channel(ifx, WIFI_ROC_CANCEL, 0, 0, NULL);
+    }
+
+  action_mux_call(done, n);
+}
+
+esp_err_t esp_wifi_action_mux_attach(const esp_wifi_action_mux_client_t
+                                     *client, uint8_t *id)
+{
+  esp_err_t ret = ESP_ERR_INVALID_STATE;
+
+  if (s_lock == NULL)
+    {
+      return ret;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_mux)
+    {
+      ret = esp_wifi_action_mux_register(s_mux, client, id);
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+  return ret;
+}
+
+void esp_wifi_action_mux_detach(uint8_t id)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_mux)
+    {
+      esp_wifi_action_mux_unregister(s_mux, id);
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+esp_err_t esp_wifi_action_mux_send(uint8_t client, uint8_t channel,
+                                   const uint8_t dest[6],
+                                   const uint8_t *body, size_t len,
+                                   bool no_ack, uint32_t *id)
+{
+  esp_wifi_action_mux_window_t win;
+  esp_err_t ret = ESP_ERR_INVALID_STATE;
+  bool on = false;
+
+  if (s_lock == NULL)
+    {
+      return ret;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_mux)
+    {
+      ret = esp_wifi_action_mux_queue_tx(s_mux, client, channel, dest, body,
+                                         len, no_ack, action_mux_now_ms(),
+                                         id);
+      if (ret == ESP_OK)
+        {
+          on = action_mux_kick(&win);
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+  if (on)
+    {
+      action_mux_roc(&win);
+    }
+
+  return ret;
+}
+
+esp_err_t esp_wifi_action_mux_listen(uint8_t client, uint8_t channel,
+                                     uint32_t dwell_ms, uint32_t *id)
+{
+  esp_wifi_action_mux_window_t win;
+  esp_err_t ret = ESP_ERR_INVALID_STATE;
+  bool on = false;
+
+  if (s_lock == NULL)
+    {
+      return ret;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_mux)
+    {
+      ret = esp_wifi_action_mux_queue_roc(s_mux, client, channel, dwell_ms,
+                                          action_mux_now_ms(), id);
+      if (ret == ESP_OK)
+        {
+          on = action_mux_kick(&win);
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+  if (on)
+    {
+      action_mux_roc(&win);
+    }
+
+  return ret;
+}
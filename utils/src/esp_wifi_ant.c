@@ -0,0 +1,370 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_ant.h"
+
+#define ANT_STREAK          2    /* evaluations in a row to switch */
+
+/* One antenna for one peer: the window summing, the last mean */
+
+struct ant_stat
+{
+  int32_t sum;
+  uint16_t n;
+  uint16_t tx;
+  uint16_t fail;
+  bool valid;
+  int16_t mean_x16;
+  uint16_t per_permille;
+  uint32_t at_ms;
+};
+
+struct ant_peer
+{
+  bool used;
+  uint8_t mac[6];
+  uint32_t seen_ms;
+  uint16_t count;                /* frames of the window */
+  uint16_t traffic;              /* of the last window, the weight */
+  struct ant_stat ant[2];
+};
+
+struct esp_wifi_ant
+{
+  esp_wifi_ant_config_t cfg;
+  esp_wifi_ant_stats_t stats;
+  uint8_t cur;
+  uint8_t streak;
+  bool probing;
+  uint32_t window_ms;            /* start of the window */
+  uint32_t probe_ms;             /* start of the last probe */
+  uint32_t probe_wait_ms;        /* to the next, jittered */
+  uint32_t rng;
+  uint32_t switched_ms;
+  struct ant_peer peers[ESP_WIFI_ANT_PEERS];
+};
+
+static struct ant_peer *ant_peer(esp_wifi_ant_t *ant, const uint8_t mac[6],
+                                 uint32_t now_ms)
+{
+  struct ant_peer *lru = &ant->peers[0];
+  struct ant_peer *p;
+  int i;
+
+  for (i = 0; i < ESP_WIFI_ANT_PEERS; i++)
+    {
+      p = &ant->peers[i];
+      if (p->used && memcmp(p->mac, mac, 6) == 0)
+        {
+          p->seen_ms = now_ms;
+          return p;
+        }
+
+      if (lru->used &&
+          (!p->used || now_ms - p->seen_ms > now_ms - lru->seen_ms))
+        {
+          lru = p;
+        }
+    }
+
+  memset(lru, 0, sizeof(*lru));
+  lru->used = true;
+  memcpy(lru->mac, mac, 6);
+  lru->seen_ms = now_ms;
+  return lru;
+}
+
+static void ant_close(const esp_wifi_ant_t *ant, struct ant_stat *s,
+                      uint16_t min, uint32_t now_ms)
+{
+  if (s->n >= min)
+    {
+      s->mean_x16 = s->sum * 16 / s->n;
+      s->per_permille = s->tx >= ant->cfg.min_samples ?
+                        s->fail * 1000 / s->tx : 0;
+      s->valid = true;
+      s->at_ms = now_ms;
+    }
+
+  s->sum = 0;
+  s->n = 0;
+  s->tx = 0;
+  s->fail = 0;
+}
+
+static int32_t ant_score_x16(const esp_wifi_ant_t *ant,
+                             const struct ant_stat *s)
+{
+  return s->mean_x16 -
+         (int32_t)s->per_permille * ant->cfg.per_weight * 16 / 1000;
+}
+
+/* Score of the other antenna above the one in use, dB x 16, averaged
+ * over the peers known on both by their traffic
+ */
+
+static bool ant_gain_x16(const esp_wifi_ant_t *ant, uint32_t now_ms,
+                         int32_t *gain)
+{
+  const struct ant_peer *p;
+  const struct ant_stat *a;
+  const struct ant_stat *b;
+  int64_t sum = 0;
+  uint32_t weight = 0;
+  uint32_t w;
+  int i;
+
+  for (i = 0; i < ESP_WIFI_ANT_PEERS; i++)
+    {
+      p = &ant->peers[i];
+      a = &p->ant[ant->cur];
+      b = &p->ant[!ant->cur];
+      if (!p->used || !a->valid || !b->valid ||
+          now_ms - a->at_ms > ant->cfg.stale_ms ||
+          now_ms - b->at_ms > ant->cfg.stale_ms)
+        {
+          continue;
+        }
+
+      w = p->traffic ? p->traffic : 1;
+      sum += (int64_t)(ant_score_x16(ant, b) - ant_score_x16(ant, a)) * w;
+      weight += w;
+    }
+
+  if (weight == 0)
+    {
+      return false;
+    }
+
+  *gain = sum / weight;
+  return true;
+}
+
+static void ant_evaluate(esp_wifi_ant_t *ant, uint32_t now_ms)
+{
+  int32_t gain;
+
+  if (!ant_gain_x16(ant, now_ms, &gain))
+    {
+      ant->streak = 0;
+      return;
+    }
+
+  ant->stats.evaluations++;
+  if (gain < ant->cfg.hysteresis * 16)
+    {
+      ant->streak = 0;
+      return;
+    }
+
+  if (ant->streak < ANT_STREAK)
+    {
+      ant->streak++;
+    }
+
+  if (ant->streak == ANT_STREAK &&
+      now_ms - ant->switched_ms >= ant->cfg.min_dwell_ms)
+    {
+      ant->cur = !ant->cur;
+      ant->switched_ms = now_ms;
+      ant->streak = 0;
+      ant->stats.switches++;
+    }
+}
+
+/* The probe interval, give or take a quarter, not to beat with a
+ * periodic fade
+ */
+
+static uint32_t ant_probe_wait(esp_wifi_ant_t *ant)
+{
+  uint32_t interval = ant->cfg.probe_interval_ms;
+
+  ant->rng = ant->rng * 1103515245u + 12345u;
+  return interval - interval / 4 +
+         (uint32_t)((uint64_t)(ant->rng >> 16) * (interval / 2) >> 16);
+}
+
+void esp_wifi_ant_default(esp_wifi_ant_config_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->window_ms = 1000;
+  cfg->min_samples = 10;
+  cfg->hysteresis = 4;
+  cfg->per_weight = 10;
+  cfg->min_dwell_ms = 5000;
+  cfg->probe_interval_ms = 10000;
+  cfg->probe_ms = 200;
+  cfg->probe_samples = 3;
+  cfg->stale_ms = 30000;
+  cfg->enabled_ant0 = 0;
+  cfg->enabled_ant1 = 1;
+}
+
+esp_err_t esp_wifi_ant_create(const esp_wifi_ant_config_t *cfg,
+                              uint32_t now_ms, esp_wifi_ant_t **ant)
+{
+  esp_wifi_ant_t *a;
+
+  if (cfg == NULL || ant == NULL || cfg->window_ms == 0 ||
+      cfg->min_samples == 0 ||
+      (cfg->probe_interval_ms &&
+       (cfg->probe_ms == 0 || cfg->probe_samples == 0)))
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  a = calloc(1, sizeof(*a));
+  if (a == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  a->cfg = *cfg;
+  a->window_ms = now_ms;
+  a->probe_ms = now_ms;
+  a->rng = 1;
+  a->probe_wait_ms = cfg->probe_interval_ms ? ant_probe_wait(a) : 0;
+  a->switched_ms = now_ms - cfg->min_dwell_ms;
+  *ant = a;
+  return ESP_OK;
+}
+
+void esp_wifi_ant_delete(esp_wifi_ant_t *ant)
+{
+  free(ant);
+}
+
+void esp_wifi_ant_rx(esp_wifi_ant_t *ant, const uint8_t peer[6],
+                     uint8_t antenna, int8_t rssi, uint32_t now_ms)
+{
+  struct ant_peer *p;
+
+  if (antenna > 1)
+    {
+      return;
+    }
+
+  p = ant_peer(ant, peer, now_ms);
+  p->ant[antenna].sum += rssi;
+  p->ant[antenna].n++;
+  p->count++;
+  ant->stats.rx++;
+}
+
+void esp_wifi_ant_tx(esp_wifi_ant_t *ant, const uint8_t peer[6], bool ok,
+                     uint32_t now_ms)
+{
+  struct ant_stat *s;
+
+  s = &ant_peer(ant, peer, now_ms)->ant[ant->probing ? !ant->cur :
+                                                       ant->cur];
+  s->tx++;
+  s->fail += !ok;
+  ant->stats.tx++;
+}
+
+bool esp_wifi_ant_update(esp_wifi_ant_t *ant, uint32_t now_ms,
+                         wifi_ant_config_t *config)
+{
+  struct ant_peer *p;
+  bool changed = false;
+  uint8_t cur = ant->cur;
+  int i;
+
+  /* The probe over, its samples make the other antenna's mean */
+
+  if (ant->probing && now_ms - ant->probe_ms >= ant->cfg.probe_ms)
+    {
+      for (i = 0; i < ESP_WIFI_ANT_PEERS; i++)
+        {
+          ant_close(ant, &ant->peers[i].ant[!ant->cur],
+                    ant->cfg.probe_samples, now_ms);
+        }
+
+      ant->probing = false;
+      changed = true;
+    }
+
+  if (now_ms - ant->window_ms >= ant->cfg.window_ms)
+    {
+      for (i = 0; i < ESP_WIFI_ANT_PEERS; i++)
+        {
+          p = &ant->peers[i];
+          p->traffic = p->count;
+          p->count = 0;
+          ant_close(ant, &p->ant[ant->cur], ant->cfg.min_samples, now_ms);
+          if (!ant->probing)
+            {
+              ant_close(ant, &p->ant[!ant->cur], ant->cfg.min_samples,
+                        now_ms);
+            }
+        }
+
+      ant->window_ms = now_ms;
+      ant->stats.windows++;
+      if (!ant->probing)
+        {
+          ant_evaluate(ant, now_ms);
+        }
+    }
+
+  if (!ant->probing && ant->cfg.probe_interval_ms &&
+      now_ms - ant->probe_ms >= ant->probe_wait_ms)
+    {
+      ant->probing = true;
+      ant->probe_ms = now_ms;
+      ant->probe_wait_ms = ant_probe_wait(ant);
+      ant->stats.probes++;
+      changed = true;
+    }
+
+  changed |= ant->cur != cur;
+  if (!changed)
+    {
+      return false;
+    }
+
+  esp_wifi_ant_config(ant, config);
+  ant->stats.writes++;
+  return true;
+}
+
+void esp_wifi_ant_config(const esp_wifi_ant_t *ant, wifi_ant_config_t *config)
+{
+  uint8_t use = esp_wifi_ant_current(ant);
+
+  memset(config, 0, sizeof(*config));
+  config->rx_ant_mode = use ? WIFI_ANT_MODE_ANT1 : WIFI_ANT_MODE_ANT0;
+  config->rx_ant_default = use ? WIFI_ANT_ANT1 : WIFI_ANT_ANT0;
+  config->tx_ant_mode = config->rx_ant_mode;
+  config->enabled_ant0 = ant->cfg.enabled_ant0;
+  config->enabled_ant1 = ant->cfg.enabled_ant1;
+}
+
+uint8_t esp_wifi_ant_current(const esp_wifi_ant_t *ant)
+{
+  return ant->probing ? !ant->cur : ant->cur;
+}
+
+void esp_wifi_ant_get_stats(const esp_wifi_ant_t *ant,
+                            esp_wifi_ant_stats_t *stats)
+{
+  *stats = ant->stats;
+}
@@ -0,0 +1,168 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_ant.h"
+
+static const uint8_t g_sim_peer[6] =
+{
+  0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01
+};
+
+static uint32_t ant_sim_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+esp_err_t esp_wifi_ant_replay(const esp_wifi_ant_config_t *cfg,
+                              const esp_wifi_ant_sample_t *trace, size_t n,
+                              esp_wifi_ant_replay_t *result)
+{
+  const esp_wifi_ant_sample_t *s;
+  wifi_ant_config_t config;
+  esp_wifi_ant_stats_t stats;
+  esp_wifi_ant_t *ant;
+  int64_t sum[3] =
+  {
+    0
+  };
+
+  int32_t bucket_sum[2];
+  uint32_t better = 0;
+  uint32_t bucket;
+  uint8_t use;
+  size_t i;
+  size_t j;
+  size_t k;
+  esp_err_t ret;
+
+  if (cfg == NULL || trace == NULL || n == 0 || result == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ret = esp_wifi_ant_create(cfg, trace[0].t_ms, &ant);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  /* A window of the trace at a time, for the better antenna by the
+   * means over it
+   */
+
+  for (i = 0; i < n; i = j)
+    {
+      bucket = (trace[i].t_ms - trace[0].t_ms) / cfg->window_ms;
+      bucket_sum[0] = 0;
+      bucket_sum[1] = 0;
+      for (j = i; j < n && (trace[j].t_ms - trace[0].t_ms) /
+                           cfg->window_ms == bucket; j++)
+        {
+          bucket_sum[0] += trace[j].rssi[0];
+          bucket_sum[1] += trace[j].rssi[1];
+        }
+
+      for (k = i; k < j; k++)
+        {
+          s = &trace[k];
+          esp_wifi_ant_update(ant, s->t_ms, &config);
+          use = esp_wifi_ant_current(ant);
+          esp_wifi_ant_rx(ant, g_sim_peer, use, s->rssi[use], s->t_ms);
+          sum[0] += s->rssi[use];
+          sum[1] += s->rssi[0];
+          sum[2] += s->rssi[0] > s->rssi[1] ? s->rssi[0] : s->rssi[1];
+          better += bucket_sum[use] >= bucket_sum[!use];
+        }
+    }
+
+  esp_wifi_ant_get_stats(ant, &stats);
+  esp_wifi_ant_delete(ant);
+
+  memset(result, 0, sizeof(*result));
+  result->samples = n;
+  result->switches = stats.switches;
+  result->probes = stats.probes;
+  result->writes = stats.writes;
+  result->avg_x10 = sum[0] * 10 / (int64_t)n;
+  result->fixed_x10 = sum[1] * 10 / (int64_t)n;
+  result->best_x10 = sum[2] * 10 / (int64_t)n;
+  result->better_permille = (uint64_t)better * 1000 / n;
+  return ESP_OK;
+}
+
+void esp_wifi_ant_trace_default(esp_wifi_ant_trace_t *trace)
+{
+  memset(trace, 0, sizeof(*trace));
+  trace->seconds = 120;
+  trace->frames_per_s = 20;
+  trace->mean[0] = -62;
+  trace->mean[1] = -64;
+  trace->fade_db = 8;
+  trace->fade_period_ms = 40000;
+  trace->noise_db = 4;
+  trace->seed = 1;
+}
+
+size_t esp_wifi_ant_trace_make(const esp_wifi_ant_trace_t *trace,
+                               esp_wifi_ant_sample_t *samples, size_t max)
+{
+  uint32_t rng = trace->seed ? trace->seed : 1;
+  uint32_t period = trace->fade_period_ms ? trace->fade_period_ms : 1;
+  uint32_t fade = trace->fade_db;
+  uint32_t frames;
+  uint32_t x;
+  int32_t tri;
+  int32_t v;
+  size_t k;
+  int a;
+
+  frames = trace->seconds * trace->frames_per_s;
+  if (frames > max)
+    {
+      frames = max;
+    }
+
+  for (k = 0; k < frames; k++)
+    {
+      samples[k].t_ms = (uint64_t)k * 1000 / trace->frames_per_s;
+
+      /* Triangle from -fade to fade and back over the period */
+
+      x = (uint64_t)(samples[k].t_ms % period) * 4 * fade / period;
+      tri = x < 2 * fade ? (int32_t)x - (int32_t)fade :
+                           3 * (int32_t)fade - (int32_t)x;
+      for (a = 0; a < 2; a++)
+        {
+          v = trace->mean[a] + (a ? -tri : tri);
+          if (trace->noise_db)
+            {
+              v += (int32_t)(ant_sim_rand(&rng) %
+                             (2 * trace->noise_db + 1)) - trace->noise_db;
+            }
+
+          samples[k].rssi[a] = v < -128 ? -128 : v > 0 ? 0 : v;
+        }
+    }
+
+  return frames;
+}
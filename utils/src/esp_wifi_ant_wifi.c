@@ -0,0 +1,166 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_ant.h"
+
+static esp_wifi_ant_t *s_ant;
+static void *s_lock;
+static esp_timer_handle_t s_timer;
+
+static uint32_t ant_now_ms(void)
+{
+  return esp_timer_get_time() / 1000;
+}
+
+static void ant_timer_cb(void *arg)
+{
+  wifi_ant_config_t config;
+  wifi_ap_record_t ap;
+  bool write = false;
+  bool connected;
+
+  /* The RSSI and antenna of the last beacon of the AP */
+
+  connected = esp_wifi_sta_get_ap_info(&ap) == ESP_OK;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_ant)
+    {
+      if (connected && ap.ant <= WIFI_ANT_ANT1)
+        {
+          esp_wifi_ant_rx(s_ant, ap.bssid, ap.ant, ap.rssi, ant_now_ms());
+        }
+
+      write = esp_wifi_ant_update(s_ant, ant_now_ms(), &config);
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  if (write)
+    {
+      esp_wifi_set_ant(&config);
+    }
+}
+
+esp_err_t esp_wifi_ant_start(esp_wifi_ant_t *ant, uint32_t tick_ms)
+{
+  esp_timer_create_args_t args =
+  {
+    .callback = ant_timer_cb,
+    .name = "wifi_ant",
+  };
+
+  wifi_ant_config_t config;
+  esp_err_t ret;
+
+  if (ant == NULL || tick_ms == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  if (s_timer == NULL)
+    {
+      ret = esp_timer_create(&args, &s_timer);
+      if (ret != ESP_OK)
+        {
+          return ret;
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_ant)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  s_ant = ant;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  esp_wifi_ant_config(ant, &config);
+  ret = esp_wifi_set_ant(&config);
+  if (ret == ESP_OK)
+    {
+      ret = esp_timer_start_periodic(s_timer, (uint64_t)tick_ms * 1000);
+    }
+
+  if (ret != ESP_OK)
+    {
+      esp_wifi_ant_stop();
+    }
+
+  return ret;
+}
+
+void esp_wifi_ant_stop(void)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  esp_timer_stop(s_timer);
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  s_ant = NULL;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+void esp_wifi_ant_feed_rx(const uint8_t peer[6], uint8_t antenna,
+                          int8_t rssi)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_ant)
+    {
+      esp_wifi_ant_rx(s_ant, peer, antenna, rssi, ant_now_ms());
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+void esp_wifi_ant_feed_tx(const uint8_t peer[6], bool ok)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_ant)
+    {
+      esp_wifi_ant_tx(s_ant, peer, ok, ant_now_ms());
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
@@ -0,0 +1,344 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_ap_sta.h"
+
+#define AP_STA_MASK         (ESP_WIFI_AP_STA_SLOTS - 1)
+#define AP_STA_SHIFT        27           /* 32 - log2(slots) */
+
+#if ESP_WIFI_AP_STA_SLOTS != 32 || \
+    ESP_WIFI_AP_STA_SLOTS < 3 * ESP_WIFI_AP_STA_MAX
+#  error "ESP_WIFI_AP_STA_SLOTS must be 32, three times the stations"
+#endif
+
+/* slot[] and aid_map[] hold index + 1, 0 when empty */
+
+struct esp_wifi_ap_sta
+{
+  uint8_t count;
+  uint8_t slot[ESP_WIFI_AP_STA_SLOTS];
+  uint8_t aid_map[256];
+
+  uint8_t mac[ESP_WIFI_AP_STA_MAX][6];
+  uint8_t home[ESP_WIFI_AP_STA_MAX];     /* hash slot of the MAC */
+  uint8_t aid[ESP_WIFI_AP_STA_MAX];
+  int8_t rssi[ESP_WIFI_AP_STA_MAX];
+  uint64_t rx_bytes[ESP_WIFI_AP_STA_MAX];
+  uint64_t tx_bytes[ESP_WIFI_AP_STA_MAX];
+  uint32_t rx_packets[ESP_WIFI_AP_STA_MAX];
+  uint32_t tx_packets[ESP_WIFI_AP_STA_MAX];
+  uint32_t connected_s[ESP_WIFI_AP_STA_MAX];
+};
+
+static uint8_t ap_sta_hash(const uint8_t mac[6])
+{
+  uint32_t v;
+
+  /* The OUI is shared by many stations, the NIC bytes carry the entropy */
+
+  v = ((uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 |
+       (uint32_t)mac[4] << 8 | mac[5]) ^ ((uint32_t)mac[0] << 8 | mac[1]);
+  return (v * 0x9e3779b1u) >> AP_STA_SHIFT;
+}
+
+/* Slot holding index i, or of the MAC when i < 0 */
+
+static int ap_sta_slot(const esp_wifi_ap_sta_t *tab, const uint8_t mac[6],
+                       uint8_t home, int i)
+{
+  uint8_t s = home;
+  uint8_t v;
+
+  while ((v = tab->slot[s]) != 0)
+    {
+      if (i >= 0 ? v == i + 1 : memcmp(tab->mac[v - 1], mac, 6) == 0)
+        {
+          return s;
+        }
+
+      s = (s + 1) & AP_STA_MASK;
+    }
+
+  return -1;
+}
+
+/* Empty slot s, moving back the entries of the run behind it that
+ * probed past it
+ */
+
+static void ap_sta_unslot(esp_wifi_ap_sta_t *tab, uint8_t s)
+{
+  uint8_t j = s;
+  uint8_t k;
+
+  for (; ; )
+    {
+      j = (j + 1) & AP_STA_MASK;
+      if (tab->slot[j] == 0)
+        {
+          break;
+        }
+
+      /* Stays when its home lies cyclically in (s, j] */
+
+      k = tab->home[tab->slot[j] - 1];
+      if (((j - k) & AP_STA_MASK) < ((j - s) & AP_STA_MASK))
+        {
+          continue;
+        }
+
+      tab->slot[s] = tab->slot[j];
+      s = j;
+    }
+
+  tab->slot[s] = 0;
+}
+
+esp_err_t esp_wifi_ap_sta_create(esp_wifi_ap_sta_t **tab)
+{
+  esp_wifi_ap_sta_t *t;
+
+  if (tab == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  t = calloc(1, sizeof(*t));
+  if (t == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  *tab = t;
+  return ESP_OK;
+}
+
+void esp_wifi_ap_sta_delete(esp_wifi_ap_sta_t *tab)
+{
+  free(tab);
+}
+
+esp_err_t esp_wifi_ap_sta_add(esp_wifi_ap_sta_t *tab, const uint8_t mac[6],
+                              uint8_t aid, uint32_t now_s)
+{
+  uint8_t home;
+  uint8_t s;
+  int i;
+
+  if (aid == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  home = ap_sta_hash(mac);
+  s = home;
+  while (tab->slot[s] != 0 &&
+         memcmp(tab->mac[tab->slot[s] - 1], mac, 6) != 0)
+    {
+      s = (s + 1) & AP_STA_MASK;
+    }
+
+  if (tab->slot[s] != 0)
+    {
+      /* Associated again */
+
+      i = tab->slot[s] - 1;
+      if (tab->aid_map[tab->aid[i]] == i + 1)
+        {
+          tab->aid_map[tab->aid[i]] = 0;
+        }
+    }
+  else
+    {
+      if (tab->count == ESP_WIFI_AP_STA_MAX)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+
+      i = tab->count++;
+      tab->slot[s] = i + 1;
+      memcpy(tab->mac[i], mac, 6);
+      tab->home[i] = home;
+      tab->rssi[i] = 0;
+      tab->rx_bytes[i] = 0;
+      tab->tx_bytes[i] = 0;
+      tab->rx_packets[i] = 0;
+      tab->tx_packets[i] = 0;
+      tab->connected_s[i] = now_s;
+    }
+
+  tab->aid[i] = aid;
+  tab->aid_map[aid] = i + 1;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_ap_sta_remove(esp_wifi_ap_sta_t *tab,
+                                 const uint8_t mac[6])
+{
+  int s;
+  int i;
+  int last;
+
+  s = ap_sta_slot(tab, mac, ap_sta_hash(mac), -1);
+  if (s < 0)
+    {
+      return ESP_ERR_NOT_FOUND;
+    }
+
+  i = tab->slot[s] - 1;
+  ap_sta_unslot(tab, s);
+  if (tab->aid_map[tab->aid[i]] == i + 1)
+    {
+      tab->aid_map[tab->aid[i]] = 0;
+    }
+
+  /* The last station fills the hole */
+
+  last = --tab->count;
+  if (i != last)
+    {
+      tab->slot[ap_sta_slot(tab, NULL, tab->home[last], last)] = i + 1;
+      if (tab->aid_map[tab->aid[last]] == last + 1)
+        {
+          tab->aid_map[tab->aid[last]] = i + 1;
+        }
+
+      memcpy(tab->mac[i], tab->mac[last], 6);
+      tab->home[i] = tab->home[last];
+      tab->aid[i] = tab->aid[last];
+      tab->rssi[i] = tab->rssi[last];
+      tab->rx_bytes[i] = tab->rx_bytes[last];
+      tab->tx_bytes[i] = tab->tx_bytes[last];
+      tab->rx_packets[i] = tab->rx_packets[last];
+      tab->tx_packets[i] = tab->tx_packets[last];
+      tab->connected_s[i] = tab->connected_s[last];
+    }
+
+  return ESP_OK;
+}
+
+void esp_wifi_ap_sta_flush(esp_wifi_ap_sta_t *tab)
+{
+  memset(tab->slot, 0, sizeof(tab->slot));
+  memset(tab->aid_map, 0, sizeof(tab->aid_map));
+  tab->count = 0;
+}
+
+uint8_t esp_wifi_ap_sta_count(const esp_wifi_ap_sta_t *tab)
+{
+  return tab->count;
+}
+
+int esp_wifi_ap_sta_find(const esp_wifi_ap_sta_t *tab, const uint8_t mac[6])
+{
+  int s = ap_sta_slot(tab, mac, ap_sta_hash(mac), -1);
+
+  return s < 0 ? -1 : tab->slot[s] - 1;
+}
+
+int esp_wifi_ap_sta_find_aid(const esp_wifi_ap_sta_t *tab, uint8_t aid)
+{
+  return tab->aid_map[aid] - 1;
+}
+
+void esp_wifi_ap_sta_rx(esp_wifi_ap_sta_t *tab, int i, uint32_t bytes)
+{
+  if (i >= 0 && i < tab->count)
+    {
+      tab->rx_bytes[i] += bytes;
+      tab->rx_packets[i]++;
+    }
+}
+
+void esp_wifi_ap_sta_tx(esp_wifi_ap_sta_t *tab, int i, uint32_t bytes)
+{
+  if (i >= 0 && i < tab->count)
+    {
+      tab->tx_bytes[i] += bytes;
+      tab->tx_packets[i]++;
+    }
+}
+
+esp_err_t esp_wifi_ap_sta_get(const esp_wifi_ap_sta_t *tab, int i,
+                              esp_wifi_ap_sta_info_t *info)
+{
+  if (i < 0 || i >= tab->count)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  memcpy(info->mac, tab->mac[i], 6);
+  info->aid = tab->aid[i];
+  info->rssi = tab->rssi[i];
+  info->rx_bytes = tab->rx_bytes[i];
+  info->tx_bytes = tab->tx_bytes[i];
+  info->rx_packets = tab->rx_packets[i];
+  info->tx_packets = tab->tx_packets[i];
+  info->connected_s = tab->connected_s[i];
+  return ESP_OK;
+}
+
+uint8_t esp_wifi_ap_sta_sync(esp_wifi_ap_sta_t *tab,
+                             const wifi_sta_list_t *list)
+{
+  uint8_t unknown = 0;
+  int i;
+  int j;
+
+  for (j = 0; j < list->num && j < ESP_WIFI_MAX_CONN_NUM; j++)
+    {
+      i = esp_wifi_ap_sta_find(tab, list->sta[j].mac);
+      if (i < 0)
+        {
+          unknown++;
+          continue;
+        }
+
+      tab->rssi[i] = list->sta[j].rssi;
+    }
+
+  return unknown;
+}
+
+void esp_wifi_ap_sta_event(esp_wifi_ap_sta_t *tab, int32_t id,
+                           const void *data, uint32_t now_s)
+{
+  const wifi_event_ap_staconnected_t *conn;
+  const wifi_event_ap_stadisconnected_t *disc;
+
+  switch (id)
+    {
+      case WIFI_EVENT_AP_STACONNECTED:
+        conn = data;
+        esp_wifi_ap_sta_add(tab, conn->mac, conn->aid, now_s);
+        break;
+
+      case WIFI_EVENT_AP_STADISCONNECTED:
+        disc = data;
+        esp_wifi_ap_sta_remove(tab, disc->mac);
+        break;
+
+      case WIFI_EVENT_AP_STOP:
+        esp_wifi_ap_sta_flush(tab);
+        break;
+
+      default:
+        break;
+    }
+}
@@ -0,0 +1,140 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_wifi_ap_sta.h"
+
+#define AP_STA_BENCH_KEYS   256          /* looked up in turn */
+
+static uint32_t ap_sta_bench_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static uint32_t ap_sta_bench_ns(clock_t cpu, uint32_t lookups)
+{
+  return (uint32_t)((double)cpu * 1e9 / CLOCKS_PER_SEC / lookups);
+}
+
+/* What the application does without the table: copy the list as
+ * esp_wifi_ap_get_sta_list does, then scan it
+ */
+
+static int __attribute__((noinline))
+ap_sta_bench_list(const wifi_sta_list_t *list, const uint8_t mac[6])
+{
+  wifi_sta_list_t copy;
+  int j;
+
+  memcpy(&copy, list, sizeof(copy));
+  for (j = 0; j < copy.num; j++)
+    {
+      if (memcmp(copy.sta[j].mac, mac, 6) == 0)
+        {
+          return j;
+        }
+    }
+
+  return -1;
+}
+
+esp_err_t esp_wifi_ap_sta_bench(uint32_t lookups, uint32_t seed,
+                                esp_wifi_ap_sta_bench_t *result)
+{
+  uint8_t keys[AP_STA_BENCH_KEYS][6];
+  wifi_sta_list_t list;
+  esp_wifi_ap_sta_t *tab;
+  volatile int sink = 0;
+  uint32_t rng = seed ? seed : 1;
+  uint32_t i;
+  uint32_t v;
+  clock_t c0;
+  int j;
+  esp_err_t ret;
+
+  if (result == NULL || lookups == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ret = esp_wifi_ap_sta_create(&tab);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  /* Stations of one vendor, random NIC bytes */
+
+  memset(&list, 0, sizeof(list));
+  for (j = 0; j < ESP_WIFI_AP_STA_MAX; j++)
+    {
+      v = ap_sta_bench_rand(&rng);
+      list.sta[j].mac[0] = 0x24;
+      list.sta[j].mac[1] = 0x0a;
+      list.sta[j].mac[2] = 0xc4;
+      list.sta[j].mac[3] = v >> 16;
+      list.sta[j].mac[4] = v >> 8;
+      list.sta[j].mac[5] = v;
+      list.sta[j].rssi = -40 - (int)(v >> 24) % 40;
+      esp_wifi_ap_sta_add(tab, list.sta[j].mac, j + 1, 0);
+    }
+
+  list.num = ESP_WIFI_AP_STA_MAX;
+
+  memset(result, 0, sizeof(*result));
+  result->lookups = lookups;
+  for (i = 0; i < AP_STA_BENCH_KEYS; i++)
+    {
+      v = ap_sta_bench_rand(&rng);
+      memcpy(keys[i], list.sta[v % ESP_WIFI_AP_STA_MAX].mac, 6);
+      if ((v >> 8) % 8 == 0)
+        {
+          keys[i][5] ^= 0x5a;
+        }
+    }
+
+  for (i = 0; i < lookups; i++)
+    {
+      result->misses += esp_wifi_ap_sta_find(tab,
+                                             keys[i % AP_STA_BENCH_KEYS]) < 0;
+    }
+
+  c0 = clock();
+  for (i = 0; i < lookups; i++)
+    {
+      sink += ap_sta_bench_list(&list, keys[i % AP_STA_BENCH_KEYS]);
+    }
+
+  result->list_ns = ap_sta_bench_ns(clock() - c0, lookups);
+
+  c0 = clock();
+  for (i = 0; i < lookups; i++)
+    {
+      sink += esp_wifi_ap_sta_find(tab, keys[i % AP_STA_BENCH_KEYS]);
+    }
+
+  result->table_ns = ap_sta_bench_ns(clock() - c0, lookups);
+
+  esp_wifi_ap_sta_delete(tab);
+  return ESP_OK;
+}
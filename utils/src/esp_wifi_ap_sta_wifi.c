@@ -0,0 +1,59 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_ap_sta.h"
+
+static uint32_t ap_sta_now_s(void)
+{
+  return esp_timer_get_time() / 1000000;
+}
+
+esp_err_t esp_wifi_ap_sta_refresh(esp_wifi_ap_sta_t *tab)
+{
+  wifi_sta_list_t list;
+  uint16_t aid;
+  esp_err_t ret;
+  int j;
+
+  ret = esp_wifi_ap_get_sta_list(&list);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  if (esp_wifi_ap_sta_sync(tab, &list) == 0)
+    {
+      return ESP_OK;
+    }
+
+  /* Connected before the table, or an event was missed */
+
+  for (j = 0; j < list.num; j++)
+    {
+      if (esp_wifi_ap_sta_find(tab, list.sta[j].mac) < 0 &&
+          esp_wifi_ap_get_sta_aid(list.sta[j].mac, &aid) == ESP_OK)
+        {
+          esp_wifi_ap_sta_add(tab, list.sta[j].mac, aid, ap_sta_now_s());
+        }
+    }
+
+  esp_wifi_ap_sta_sync(tab, &list);
+  return ESP_OK;
+}
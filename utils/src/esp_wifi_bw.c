@@ -0,0 +1,406 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_bw.h"
+
+#define BW_CHANNELS         15   /* 1 to 14, by number */
+#define BW_AFFECTED         5    /* channels off the 40 MHz center */
+#define BW_STREAK           2    /* evaluations in a row to switch */
+
+struct esp_wifi_bw
+{
+  esp_wifi_bw_config_t cfg;
+  esp_wifi_bw_stats_t stats;
+  uint8_t primary;
+  uint8_t secondary;
+  wifi_bandwidth_t bw;
+  bool coex;
+  uint8_t streak;
+  uint32_t window_ms;            /* start of the window */
+  uint32_t switched_ms;
+  uint32_t listen_us[BW_CHANNELS];
+  uint32_t busy_us[BW_CHANNELS];
+  uint16_t known;                /* channels with an occupancy */
+  uint16_t occ[BW_CHANNELS];     /* permille */
+  uint32_t occ_ms[BW_CHANNELS];
+  uint16_t scanned;              /* channels with a BSS count */
+  uint8_t bss[BW_CHANNELS];      /* overlapping, by primary channel */
+  uint32_t bss_ms[BW_CHANNELS];
+};
+
+/* Kbps of the non HT rates, by wifi_phy_rate_t */
+
+static const uint32_t g_bw_legacy_kbps[16] =
+{
+  1000, 2000, 5500, 11000, 0, 2000, 5500, 11000,
+  48000, 24000, 12000, 6000, 54000, 36000, 18000, 9000
+};
+
+/* Kbps of MCS0 to MCS7, one stream, long GI, 20 and 40 MHz */
+
+static const uint32_t g_bw_ht_kbps[2][8] =
+{
+  {
+    6500, 13000, 19500, 26000, 39000, 52000, 58500, 65000
+  },
+  {
+    13500, 27000, 40500, 54000, 81000, 108000, 121500, 135000
+  }
+};
+
+static bool bw_fresh(const esp_wifi_bw_t *bw, uint16_t mask, uint32_t at_ms,
+                     uint8_t channel, uint32_t now_ms)
+{
+  return (mask & (1u << channel)) && now_ms - at_ms <= bw->cfg.stale_ms;
+}
+
+static bool bw_affected(const esp_wifi_bw_t *bw, uint8_t channel)
+{
+  int center = (bw->primary + bw->secondary) / 2;
+
+  return channel != bw->primary && channel >= center - BW_AFFECTED &&
+         channel <= center + BW_AFFECTED;
+}
+
+static void bw_close(esp_wifi_bw_t *bw, uint32_t now_ms)
+{
+  uint32_t o;
+  int ch;
+
+  for (ch = 1; ch < BW_CHANNELS; ch++)
+    {
+      if (bw->listen_us[ch] >= bw->cfg.min_listen_ms * 1000u)
+        {
+          o = (uint64_t)bw->busy_us[ch] * 1000 / bw->listen_us[ch];
+          o = o > 1000 ? 1000 : o;
+          if (bw_fresh(bw, bw->known, bw->occ_ms[ch], ch, now_ms))
+            {
+              o = (bw->occ[ch] * bw->cfg.ewma_percent +
+                   o * (100 - bw->cfg.ewma_percent)) / 100;
+            }
+
+          bw->occ[ch] = o;
+          bw->occ_ms[ch] = now_ms;
+          bw->known |= 1u << ch;
+        }
+
+      bw->listen_us[ch] = 0;
+      bw->busy_us[ch] = 0;
+    }
+}
+
+/* Occupancy of channel, measured or else from the BSSs on it */
+
+static uint32_t bw_occupancy(const esp_wifi_bw_t *bw, uint8_t ch,
+                             uint32_t now_ms)
+{
+  uint32_t o;
+
+  if (bw_fresh(bw, bw->known, bw->occ_ms[ch], ch, now_ms))
+    {
+      return bw->occ[ch];
+    }
+
+  if (bw_fresh(bw, bw->scanned, bw->bss_ms[ch], ch, now_ms))
+    {
+      o = bw->bss[ch] * bw->cfg.obss_percent * 10u;
+      return o > 1000 ? 1000 : o;
+    }
+
+  return 0;
+}
+
+static void bw_evaluate(esp_wifi_bw_t *bw, uint32_t now_ms)
+{
+  uint32_t op = bw_occupancy(bw, bw->primary, now_ms);
+  uint32_t os = bw_occupancy(bw, bw->secondary, now_ms);
+  uint32_t mine;
+  uint32_t other;
+  uint32_t g20;
+  uint32_t g40;
+
+  bw->stats.evaluations++;
+  g20 = (uint64_t)bw->cfg.rate20_kbps * (1000 - op) / 1000;
+  g40 = (uint64_t)bw->cfg.rate40_kbps * (1000 - op - os + op * os / 1000) /
+        1000;
+  mine = bw->bw == WIFI_BW_HT40 ? g40 : g20;
+  other = bw->bw == WIFI_BW_HT40 ? g20 : g40;
+  if ((uint64_t)other * 100 <=
+      (uint64_t)mine * (100 + bw->cfg.hysteresis_percent))
+    {
+      bw->streak = 0;
+      return;
+    }
+
+  if (bw->streak < BW_STREAK)
+    {
+      bw->streak++;
+    }
+
+  if (bw->streak == BW_STREAK &&
+      now_ms - bw->switched_ms >= bw->cfg.min_dwell_ms)
+    {
+      bw->bw = bw->bw == WIFI_BW_HT40 ? WIFI_BW_HT20 : WIFI_BW_HT40;
+      bw->switched_ms = now_ms;
+      bw->streak = 0;
+      bw->stats.switches++;
+    }
+}
+
+void esp_wifi_bw_default(esp_wifi_bw_config_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->window_ms = 5000;
+  cfg->min_listen_ms = 50;
+  cfg->ewma_percent = 30;
+  cfg->rate20_kbps = 65000;
+  cfg->rate40_kbps = 135000;
+  cfg->obss_rssi = -82;
+  cfg->obss_percent = 10;
+  cfg->hysteresis_percent = 10;
+  cfg->min_dwell_ms = 30000;
+  cfg->stale_ms = 120000;
+  cfg->scan_interval_ms = 10000;
+}
+
+esp_err_t esp_wifi_bw_create(const esp_wifi_bw_config_t *cfg,
+                             uint32_t now_ms, esp_wifi_bw_t **bw)
+{
+  esp_wifi_bw_t *b;
+
+  if (cfg == NULL || bw == NULL || cfg->window_ms == 0 ||
+      cfg->rate20_kbps == 0 || cfg->rate40_kbps == 0 ||
+      cfg->ewma_percent > 100)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  b = calloc(1, sizeof(*b));
+  if (b == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  b->cfg = *cfg;
+  b->bw = WIFI_BW_HT20;
+  b->window_ms = now_ms;
+  b->switched_ms = now_ms - cfg->min_dwell_ms;
+  *bw = b;
+  return ESP_OK;
+}
+
+void esp_wifi_bw_delete(esp_wifi_bw_t *bw)
+{
+  free(bw);
+}
+
+void esp_wifi_bw_set_channel(esp_wifi_bw_t *bw, uint8_t primary,
+                             wifi_second_chan_t second)
+{
+  uint8_t secondary = 0;
+
+  if (primary == 0 || primary >= BW_CHANNELS)
+    {
+      primary = 0;
+    }
+  else if (second == WIFI_SECOND_CHAN_ABOVE && primary + 4 < BW_CHANNELS)
+    {
+      secondary = primary + 4;
+    }
+  else if (second == WIFI_SECOND_CHAN_BELOW && primary > 4)
+    {
+      secondary = primary - 4;
+    }
+
+  if (primary == bw->primary && secondary == bw->secondary)
+    {
+      return;
+    }
+
+  bw->primary = primary;
+  bw->secondary = secondary;
+  bw->known = 0;
+  bw->scanned = 0;
+  bw->streak = 0;
+  memset(bw->listen_us, 0, sizeof(bw->listen_us));
+  memset(bw->busy_us, 0, sizeof(bw->busy_us));
+}
+
+uint8_t esp_wifi_bw_secondary(const esp_wifi_bw_t *bw)
+{
+  return bw->secondary;
+}
+
+void esp_wifi_bw_listen(esp_wifi_bw_t *bw, uint8_t channel, uint32_t us)
+{
+  if (channel && channel < BW_CHANNELS)
+    {
+      bw->listen_us[channel] += us;
+    }
+}
+
+void esp_wifi_bw_airtime(esp_wifi_bw_t *bw, uint8_t channel, uint32_t us)
+{
+  if (channel && channel < BW_CHANNELS)
+    {
+      bw->busy_us[channel] += us;
+    }
+}
+
+void esp_wifi_bw_scan(esp_wifi_bw_t *bw, const wifi_ap_record_t *aps,
+                      uint16_t n, uint8_t channel, uint32_t now_ms)
+{
+  uint8_t count[BW_CHANNELS];
+  uint16_t i;
+  int ch;
+
+  if (bw->secondary == 0)
+    {
+      return;
+    }
+
+  memset(count, 0, sizeof(count));
+  for (i = 0; i < n; i++)
+    {
+      ch = aps[i].primary;
+      if (ch && ch < BW_CHANNELS && aps[i].rssi >= bw->cfg.obss_rssi &&
+          bw_affected(bw, ch) && count[ch] < UINT8_MAX)
+        {
+          count[ch]++;
+        }
+    }
+
+  for (ch = 1; ch < BW_CHANNELS; ch++)
+    {
+      if (channel == 0 || channel == ch)
+        {
+          bw->bss[ch] = count[ch];
+          bw->bss_ms[ch] = now_ms;
+          bw->scanned |= 1u << ch;
+        }
+    }
+
+  bw->stats.scans++;
+}
+
+bool esp_wifi_bw_update(esp_wifi_bw_t *bw, uint32_t now_ms,
+                        esp_wifi_bw_decision_t *decision)
+{
+  wifi_bandwidth_t cur = bw->bw;
+  bool coex = false;
+  int ch;
+
+  if (now_ms - bw->window_ms < bw->cfg.window_ms)
+    {
+      return false;
+    }
+
+  bw_close(bw, now_ms);
+  bw->window_ms = now_ms;
+  bw->stats.windows++;
+
+  if (bw->secondary == 0)
+    {
+      bw->bw = WIFI_BW_HT20;
+      bw->streak = 0;
+    }
+  else
+    {
+      bw_evaluate(bw, now_ms);
+      for (ch = 1; ch < BW_CHANNELS && !coex; ch++)
+        {
+          coex = bw_affected(bw, ch) && bw->bss[ch] &&
+                 bw_fresh(bw, bw->scanned, bw->bss_ms[ch], ch, now_ms);
+        }
+    }
+
+  if (bw->bw != cur && bw->secondary == 0)
+    {
+      bw->stats.switches++;
+    }
+
+  if (coex != bw->coex)
+    {
+      bw->coex = coex;
+      bw->stats.coex_toggles++;
+    }
+  else if (bw->bw == cur)
+    {
+      return false;
+    }
+
+  esp_wifi_bw_current(bw, decision);
+  bw->stats.writes++;
+  return true;
+}
+
+void esp_wifi_bw_current(const esp_wifi_bw_t *bw,
+                         esp_wifi_bw_decision_t *decision)
+{
+  decision->bw = bw->bw;
+  decision->coex = bw->coex;
+}
+
+void esp_wifi_bw_get_config(const esp_wifi_bw_t *bw,
+                            esp_wifi_bw_config_t *cfg)
+{
+  *cfg = bw->cfg;
+}
+
+void esp_wifi_bw_get_stats(const esp_wifi_bw_t *bw,
+                           esp_wifi_bw_stats_t *stats)
+{
+  *stats = bw->stats;
+}
+
+uint32_t esp_wifi_bw_frame_us(const wifi_pkt_rx_ctrl_t *rx_ctrl)
+{
+  uint32_t preamble;
+  uint32_t kbps;
+
+  if (rx_ctrl->sig_mode == 0)
+    {
+      kbps = g_bw_legacy_kbps[rx_ctrl->rate & 0x0f];
+      preamble = rx_ctrl->rate < 4 ? 192 : rx_ctrl->rate < 8 ? 96 : 20;
+      if (rx_ctrl->rate > 0x0f)
+        {
+          kbps = 0;
+        }
+    }
+  else if (rx_ctrl->sig_mode == 1 && rx_ctrl->mcs < 32)
+    {
+      kbps = g_bw_ht_kbps[rx_ctrl->cwb][rx_ctrl->mcs % 8] *
+             (rx_ctrl->mcs / 8 + 1);
+      kbps = rx_ctrl->sgi ? kbps * 10 / 9 : kbps;
+      preamble = 36;
+    }
+  else
+    {
+      kbps = 0;
+      preamble = 0;
+    }
+
+  if (kbps == 0)
+    {
+      return 0;
+    }
+
+  return preamble + ((uint32_t)rx_ctrl->sig_len * 8 * 1000 + kbps - 1) /
+                    kbps;
+}
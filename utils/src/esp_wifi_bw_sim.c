@@ -0,0 +1,236 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_wifi_bw.h"
+
+#define SIM_PRIMARY         6
+#define SIM_SECONDARY       10   /* of SIM_PRIMARY, above */
+#define SIM_SCAN_MS         120
+#define SIM_OBSS_RSSI       -70
+#define SIM_RECORDS         8
+
+enum
+{
+  SIM_HT20,
+  SIM_HT40,
+  SIM_ENGINE,
+  SIM_BEST,
+  SIM_POLICIES
+};
+
+static uint32_t bw_sim_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static uint32_t bw_sim_goodput(uint32_t kbps, uint32_t busy_permille)
+{
+  return (uint64_t)kbps * (1000 - busy_permille) / 1000;
+}
+
+/* BSSs on the secondary as a scan of it reports them */
+
+static uint16_t bw_sim_records(const esp_wifi_bw_sample_t *s,
+                               wifi_ap_record_t *aps)
+{
+  uint16_t n = s->obss > SIM_RECORDS ? SIM_RECORDS : s->obss;
+  uint16_t i;
+
+  memset(aps, 0, sizeof(*aps) * n);
+  for (i = 0; i < n; i++)
+    {
+      aps[i].bssid[5] = i + 1;
+      aps[i].primary = SIM_SECONDARY;
+      aps[i].rssi = SIM_OBSS_RSSI;
+    }
+
+  return n;
+}
+
+esp_err_t esp_wifi_bw_replay(const esp_wifi_bw_config_t *cfg,
+                             const esp_wifi_bw_sample_t *trace, size_t n,
+                             esp_wifi_bw_replay_t *result)
+{
+  wifi_ap_record_t aps[SIM_RECORDS];
+  esp_wifi_bw_decision_t decision;
+  esp_wifi_bw_stats_t stats;
+  uint64_t sum[SIM_POLICIES];
+  uint64_t total = 0;
+  uint32_t better = 0;
+  uint32_t g20;
+  uint32_t g40;
+  uint32_t dt;
+  uint32_t in;
+  uint32_t op;
+  uint32_t os;
+  esp_wifi_bw_t *bw;
+  esp_err_t ret;
+  bool scanning = false;
+  size_t i;
+  int p;
+
+  if (cfg == NULL || trace == NULL || result == NULL || n < 2)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ret = esp_wifi_bw_create(cfg, trace[0].t_ms, &bw);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  memset(sum, 0, sizeof(sum));
+  esp_wifi_bw_set_channel(bw, SIM_PRIMARY, WIFI_SECOND_CHAN_ABOVE);
+  for (i = 1; i < n; i++)
+    {
+      dt = trace[i].t_ms - trace[i - 1].t_ms;
+      op = trace[i].busy_permille[0];
+      os = trace[i].busy_permille[1];
+
+      /* Goodput of every policy over the interval, at its bandwidth */
+
+      g20 = bw_sim_goodput(cfg->rate20_kbps, op);
+      g40 = bw_sim_goodput(cfg->rate40_kbps, op + os - op * os / 1000);
+      esp_wifi_bw_current(bw, &decision);
+      sum[SIM_HT20] += (uint64_t)g20 * dt;
+      sum[SIM_HT40] += (uint64_t)g40 * dt;
+      sum[SIM_ENGINE] += (uint64_t)(decision.bw == WIFI_BW_HT40 ? g40 :
+                                    g20) * dt;
+      sum[SIM_BEST] += (uint64_t)(g40 > g20 ? g40 : g20) * dt;
+      better += (decision.bw == WIFI_BW_HT40) == (g40 > g20);
+      total += dt;
+
+      /* The primary is heard throughout, the secondary while scanned */
+
+      esp_wifi_bw_listen(bw, SIM_PRIMARY, dt * 1000);
+      esp_wifi_bw_airtime(bw, SIM_PRIMARY, op * dt);
+      in = cfg->scan_interval_ms ?
+           (trace[i].t_ms - trace[0].t_ms) % cfg->scan_interval_ms :
+           SIM_SCAN_MS;
+      if (in < SIM_SCAN_MS)
+        {
+          esp_wifi_bw_listen(bw, SIM_SECONDARY, dt * 1000);
+          esp_wifi_bw_airtime(bw, SIM_SECONDARY, os * dt);
+          scanning = true;
+        }
+      else if (scanning)
+        {
+          esp_wifi_bw_scan(bw, aps, bw_sim_records(&trace[i], aps),
+                           SIM_SECONDARY, trace[i].t_ms);
+          scanning = false;
+        }
+
+      esp_wifi_bw_update(bw, trace[i].t_ms, &decision);
+    }
+
+  esp_wifi_bw_get_stats(bw, &stats);
+  esp_wifi_bw_delete(bw);
+
+  memset(result, 0, sizeof(*result));
+  result->samples = n;
+  result->switches = stats.switches;
+  result->writes = stats.writes;
+  for (p = 0; p < SIM_POLICIES && total; p++)
+    {
+      sum[p] /= total;
+    }
+
+  result->ht20_kbps = sum[SIM_HT20];
+  result->ht40_kbps = sum[SIM_HT40];
+  result->engine_kbps = sum[SIM_ENGINE];
+  result->best_kbps = sum[SIM_BEST];
+  result->better_permille = (uint64_t)better * 1000 / (n - 1);
+  return ESP_OK;
+}
+
+void esp_wifi_bw_trace_default(esp_wifi_bw_trace_t *trace)
+{
+  memset(trace, 0, sizeof(*trace));
+  trace->seconds = 3600;
+  trace->period_ms = 100;
+  trace->primary_permille = 200;
+  trace->idle_permille = 50;
+  trace->busy_permille = 700;
+  trace->busy_ms = 120000;
+  trace->idle_ms = 180000;
+  trace->obss = 2;
+  trace->noise_permille = 50;
+  trace->seed = 1;
+}
+
+static uint16_t bw_sim_noisy(uint32_t *seed, uint16_t permille,
+                             uint16_t noise)
+{
+  int32_t v = permille;
+
+  if (noise)
+    {
+      v += (int32_t)(bw_sim_rand(seed) % (2u * noise + 1)) - noise;
+    }
+
+  return v < 0 ? 0 : v > 1000 ? 1000 : v;
+}
+
+size_t esp_wifi_bw_trace_make(const esp_wifi_bw_trace_t *trace,
+                              esp_wifi_bw_sample_t *samples, size_t max)
+{
+  uint32_t seed = trace->seed ? trace->seed : 1;
+  uint32_t end = trace->seconds * 1000;
+  uint32_t toggle_ms;
+  uint32_t t;
+  bool busy = false;
+  size_t n = 0;
+
+  if (trace->period_ms == 0)
+    {
+      return 0;
+    }
+
+  toggle_ms = trace->idle_ms / 2 + bw_sim_rand(&seed) % (trace->idle_ms + 1);
+  for (t = 0; t <= end && n < max; t += trace->period_ms)
+    {
+      while (t >= toggle_ms)
+        {
+          busy = !busy;
+          toggle_ms += busy ? trace->busy_ms :
+                       trace->idle_ms / 2 +
+                       bw_sim_rand(&seed) % (trace->idle_ms + 1);
+          if (trace->busy_ms == 0 && trace->idle_ms == 0)
+            {
+              toggle_ms = UINT32_MAX;
+            }
+        }
+
+      samples[n].t_ms = t;
+      samples[n].busy_permille[0] =
+        bw_sim_noisy(&seed, trace->primary_permille, trace->noise_permille);
+      samples[n].busy_permille[1] =
+        bw_sim_noisy(&seed, busy ? trace->busy_permille :
+                     trace->idle_permille, trace->noise_permille);
+      samples[n].obss = trace->obss;
+      n++;
+    }
+
+  return n;
+}
@@ -0,0 +1,282 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_bw.h"
+
+#define BW_SCAN_RECORDS     16
+
+static esp_wifi_bw_t *s_bw;
+static wifi_interface_t s_ifx;
+static uint32_t s_tick_ms;
+static uint32_t s_scan_time_ms;
+static uint32_t s_scan_interval_ms;
+static uint32_t s_scanned_ms;
+static uint8_t s_scanning;       /* channel of our scan, 0 none */
+
+/* Frames fed since the last tick, and on the channel of our scan. Time
+ * is only listened to while they come, without promiscuous RX nothing
+ * would be heard and the channels would read idle.
+ */
+
+static uint32_t s_fed;
+static uint32_t s_fed_scan;
+static void *s_lock;
+static esp_timer_handle_t s_timer;
+static wifi_ap_record_t s_records[BW_SCAN_RECORDS];
+
+static uint32_t bw_now_ms(void)
+{
+  return esp_timer_get_time() / 1000;
+}
+
+static void bw_write(const esp_wifi_bw_decision_t *decision)
+{
+  wifi_ioctl_config_t cfg;
+
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.data.ht2040_coex.enable = decision->coex;
+  esp_wifi_internal_ioctl(WIFI_IOCTL_SET_STA_HT2040_COEX, &cfg);
+  esp_wifi_set_bandwidth(s_ifx, decision->bw);
+}
+
+/* Passive, so that the secondary is only listened to */
+
+static void bw_scan(uint8_t channel)
+{
+  wifi_scan_config_t scan =
+  {
+    .channel = channel,
+    .scan_type = WIFI_SCAN_TYPE_PASSIVE,
+  };
+
+  scan.scan_time.passive = s_scan_time_ms;
+  if (esp_wifi_scan_start(&scan, false) != ESP_OK)
+    {
+      g_wifi_osi_funcs._mutex_lock(s_lock);
+      s_scanning = 0;
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+    }
+}
+
+static void bw_timer_cb(void *arg)
+{
+  esp_wifi_bw_decision_t decision;
+  wifi_ap_record_t ap;
+  bool connected;
+  bool promisc = false;
+  bool write = false;
+  uint8_t scan = 0;
+  uint32_t now = bw_now_ms();
+
+  connected = esp_wifi_sta_get_ap_info(&ap) == ESP_OK;
+  esp_wifi_get_promiscuous(&promisc);
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_bw)
+    {
+      if (connected)
+        {
+          esp_wifi_bw_set_channel(s_bw, ap.primary, ap.second);
+          if (promisc && s_fed)
+            {
+              esp_wifi_bw_listen(s_bw, ap.primary, s_tick_ms * 1000);
+            }
+        }
+      else
+        {
+          esp_wifi_bw_set_channel(s_bw, 0, WIFI_SECOND_CHAN_NONE);
+        }
+
+      if (s_scanning == 0 && esp_wifi_bw_secondary(s_bw) &&
+          now - s_scanned_ms >= s_scan_interval_ms)
+        {
+          scan = esp_wifi_bw_secondary(s_bw);
+          s_scanning = scan;
+          s_scanned_ms = now;
+          s_fed_scan = 0;
+        }
+
+      write = esp_wifi_bw_update(s_bw, now, &decision);
+    }
+
+  s_fed = 0;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  if (scan)
+    {
+      bw_scan(scan);
+    }
+
+  if (write)
+    {
+      bw_write(&decision);
+    }
+}
+
+esp_err_t esp_wifi_bw_start(esp_wifi_bw_t *bw, wifi_interface_t ifx,
+                            uint32_t tick_ms, uint32_t scan_ms)
+{
+  esp_timer_create_args_t args =
+  {
+    .callback = bw_timer_cb,
+    .name = "wifi_bw",
+  };
+
+  esp_wifi_bw_decision_t decision;
+  esp_wifi_bw_config_t cfg;
+  esp_err_t ret;
+
+  if (bw == NULL || tick_ms == 0 || scan_ms == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  if (s_timer == NULL)
+    {
+      ret = esp_timer_create(&args, &s_timer);
+      if (ret != ESP_OK)
+        {
+          return ret;
+        }
+    }
+
+  esp_wifi_bw_get_config(bw, &cfg);
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_bw)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  s_bw = bw;
+  s_ifx = ifx;
+  s_tick_ms = tick_ms;
+  s_scan_time_ms = scan_ms;
+  s_scan_interval_ms = cfg.scan_interval_ms;
+  s_scanned_ms = bw_now_ms() - cfg.scan_interval_ms;
+  s_scanning = 0;
+  s_fed = 0;
+  esp_wifi_bw_current(bw, &decision);
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  bw_write(&decision);
+  ret = esp_timer_start_periodic(s_timer, (uint64_t)tick_ms * 1000);
+  if (ret != ESP_OK)
+    {
+      esp_wifi_bw_stop();
+    }
+
+  return ret;
+}
+
+void esp_wifi_bw_stop(void)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  esp_timer_stop(s_timer);
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  s_bw = NULL;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+void esp_wifi_bw_feed_rx(const wifi_promiscuous_pkt_t *pkt)
+{
+  uint32_t us;
+
+  if (s_lock == NULL || pkt == NULL)
+    {
+      return;
+    }
+
+  us = esp_wifi_bw_frame_us(&pkt->rx_ctrl);
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_bw)
+    {
+      esp_wifi_bw_airtime(s_bw, pkt->rx_ctrl.channel, us);
+      s_fed++;
+      if (s_scanning && pkt->rx_ctrl.channel == s_scanning)
+        {
+          s_fed_scan++;
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+static void bw_scan_done(void)
+{
+  uint16_t n = BW_SCAN_RECORDS;
+
+  if (esp_wifi_scan_get_ap_records(&n, s_records) != ESP_OK)
+    {
+      n = 0;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_bw)
+    {
+      if (s_fed_scan)
+        {
+          esp_wifi_bw_listen(s_bw, s_scanning, s_scan_time_ms * 1000);
+        }
+
+      esp_wifi_bw_scan(s_bw, s_records, n, s_scanning, bw_now_ms());
+    }
+
+  s_scanning = 0;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+void esp_wifi_bw_event_handler(void *arg, esp_event_base_t base,
+                               int32_t id, void *data)
+{
+  if (base != WIFI_EVENT || s_lock == NULL)
+    {
+      return;
+    }
+
+  switch (id)
+    {
+      case WIFI_EVENT_SCAN_DONE:
+        if (s_scanning)
+          {
+            bw_scan_done();
+          }
+        break;
+
+      default:
+        break;
+    }
+}
@@ -0,0 +1,1020 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_ent_cred.h"
+
+#define ENT_PEM_BEGIN       "-----BEGIN "
+#define ENT_PEM_END         "-----END "
+#define ENT_PEM_DASHES      "-----"
+#define ENT_PEM_CERT        "CERTIFICATE"
+#define ENT_PEM_LINE        64
+
+#define DER_INTEGER         0x02
+#define DER_BIT_STRING      0x03
+#define DER_OCTET_STRING    0x04
+#define DER_UTC_TIME        0x17
+#define DER_GEN_TIME        0x18
+#define DER_SEQUENCE        0x30
+#define DER_CTX_0           0xa0
+#define DER_CTX_1           0xa1
+
+struct der
+{
+  const uint8_t *p;
+  const uint8_t *end;
+};
+
+/* Public key of a certificate or private key: the RSA modulus or the EC
+ * point, empty when the key does not tell
+ */
+
+struct ent_pub
+{
+  bool rsa;
+  struct der v;
+};
+
+struct ent_pem
+{
+  const uint8_t *begin;
+  const uint8_t *label;
+  size_t label_len;
+  const uint8_t *body;
+  const uint8_t *body_end;
+  const uint8_t *next;
+  bool proc_type;
+};
+
+static const uint8_t s_b64[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+uint64_t esp_wifi_ent_cred_hash(uint64_t h, const void *data, size_t len)
+{
+  const uint8_t *p = data;
+
+  while (len--)
+    {
+      h ^= *p++;
+      h *= 0x100000001b3ull;
+    }
+
+  return h;
+}
+
+static const uint32_t s_sha256_k[64] =
+{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t sha256_ror(uint32_t x, int n)
+{
+  return x >> n | x << (32 - n);
+}
+
+static void sha256_block(uint32_t h[8], const uint8_t *p)
+{
+  uint32_t w[64];
+  uint32_t a = h[0];
+  uint32_t b = h[1];
+  uint32_t c = h[2];
+  uint32_t d = h[3];
+  uint32_t e = h[4];
+  uint32_t f = h[5];
+  uint32_t g = h[6];
+  uint32_t k = h[7];
+  uint32_t t1;
+  uint32_t t2;
+  int i;
+
+  for (i = 0; i < 16; i++)
+    {
+      w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 |
+             (uint32_t)p[i * 4 + 2] << 8 | p[i * 4 + 3];
+    }
+
+  for (i = 16; i < 64; i++)
+    {
+      w[i] = w[i - 16] + w[i - 7] +
+             (sha256_ror(w[i - 15], 7) ^ sha256_ror(w[i - 15], 18) ^
+              w[i - 15] >> 3) +
+             (sha256_ror(w[i - 2], 17) ^ sha256_ror(w[i - 2], 19) ^
+              w[i - 2] >> 10);
+    }
+
+  for (i = 0; i < 64; i++)
+    {
+      t1 = k + (sha256_ror(e, 6) ^ sha256_ror(e, 11) ^ sha256_ror(e, 25)) +
+           ((e & f) ^ (~e & g)) + s_sha256_k[i] + w[i];
+      t2 = (sha256_ror(a, 2) ^ sha256_ror(a, 13) ^ sha256_ror(a, 22)) +
+           ((a & b) ^ (a & c) ^ (b & c));
+      k = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+  h[5] += f;
+  h[6] += g;
+  h[7] += k;
+}
+
+void esp_wifi_ent_cred_sha256(const void *data, size_t len,
+                              uint8_t digest[32])
+{
+  uint32_t h[8] =
+  {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+
+  const uint8_t *p = data;
+  uint8_t tail[128];
+  uint64_t bits = (uint64_t)len * 8;
+  size_t n;
+  int i;
+
+  for (; len >= 64; p += 64, len -= 64)
+    {
+      sha256_block(h, p);
+    }
+
+  /* Padding: 0x80, zeros, then the bit length big endian */
+
+  memset(tail, 0, sizeof(tail));
+  memcpy(tail, p, len);
+  tail[len] = 0x80;
+  n = len < 56 ? 64 : 128;
+  for (i = 0; i < 8; i++)
+    {
+      tail[n - 1 - i] = (uint8_t)(bits >> (i * 8));
+    }
+
+  sha256_block(h, tail);
+  if (n == 128)
+    {
+      sha256_block(h, tail + 64);
+    }
+
+  for (i = 0; i < 32; i++)
+    {
+      digest[i] = (uint8_t)(h[i / 4] >> (24 - (i % 4) * 8));
+    }
+
+  memset(tail, 0, sizeof(tail));
+}
+
+static bool der_tlv(struct der *d, uint8_t tag, struct der *inner)
+{
+  const uint8_t *p = d->p + 2;
+  size_t len;
+  size_t n;
+  size_t i;
+
+  if (d->end - d->p < 2 || d->p[0] != tag)
+    {
+      return false;
+    }
+
+  len = d->p[1];
+  if (len & 0x80)
+    {
+      n = len & 0x7f;
+      if (n == 0 || n > 3 || (size_t)(d->end - p) < n || p[0] == 0)
+        {
+          return false;
+        }
+
+      len = 0;
+      for (i = 0; i < n; i++)
+        {
+          len = len << 8 | *p++;
+        }
+
+      if (len < 0x80)
+        {
+          return false;
+        }
+    }
+
+  if ((size_t)(d->end - p) < len)
+    {
+      return false;
+    }
+
+  if (inner)
+    {
+      inner->p = p;
+      inner->end = p + len;
+    }
+
+  d->p = p + len;
+  return true;
+}
+
+static bool der_peek(const struct der *d, uint8_t tag)
+{
+  return d->p < d->end && d->p[0] == tag;
+}
+
+/* Positive INTEGER without its sign byte */
+
+static bool der_uint(struct der *d, struct der *v)
+{
+  if (!der_tlv(d, DER_INTEGER, v) || v->p == v->end || (v->p[0] & 0x80))
+    {
+      return false;
+    }
+
+  while (v->end - v->p > 1 && v->p[0] == 0)
+    {
+      v->p++;
+    }
+
+  return true;
+}
+
+static int64_t ent_days(int y, int m, int d)
+{
+  int64_t era;
+  int64_t yoe;
+  int64_t doy;
+  int64_t doe;
+
+  /* Days since 1970-01-01 of a proleptic Gregorian date */
+
+  y -= m <= 2;
+  era = (y >= 0 ? y : y - 399) / 400;
+  yoe = y - era * 400;
+  doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+static bool der_time(struct der *d, int64_t *t)
+{
+  struct der v;
+  int f[6];
+  int digits;
+  int year;
+  int i;
+
+  if (der_tlv(d, DER_UTC_TIME, &v))
+    {
+      digits = 2;
+    }
+  else if (der_tlv(d, DER_GEN_TIME, &v))
+    {
+      digits = 4;
+    }
+  else
+    {
+      return false;
+    }
+
+  if (v.end - v.p != 11 + digits || v.end[-1] != 'Z')
+    {
+      return false;
+    }
+
+  for (i = 0; i < 10 + digits; i++)
+    {
+      if (v.p[i] < '0' || v.p[i] > '9')
+        {
+          return false;
+        }
+    }
+
+  year = 0;
+  for (i = 0; i < digits; i++)
+    {
+      year = year * 10 + v.p[i] - '0';
+    }
+
+  if (digits == 2)
+    {
+      year += year < 50 ? 2000 : 1900;
+    }
+
+  for (i = 0; i < 5; i++)
+    {
+      f[i] = (v.p[digits + i * 2] - '0') * 10 + v.p[digits + i * 2 + 1] - '0';
+    }
+
+  if (f[0] < 1 || f[0] > 12 || f[1] < 1 || f[1] > 31 || f[2] > 23 ||
+      f[3] > 59 || f[4] > 60)
+    {
+      return false;
+    }
+
+  *t = ent_days(year, f[0], f[1]) * 86400 + f[2] * 3600 + f[3] * 60 + f[4];
+  return true;
+}
+
+/* Certificate: tbsCertificate, signatureAlgorithm, signatureValue */
+
+static bool ent_cert(const uint8_t *data, size_t len, int64_t *not_before,
+                     int64_t *not_after, struct ent_pub *pub)
+{
+  struct der d =
+  {
+    data, data + len
+  };
+
+  struct der cert;
+  struct der tbs;
+  struct der validity;
+  struct der spki;
+  struct der bits;
+  struct der rsa;
+  struct der seq;
+
+  if (!der_tlv(&d, DER_SEQUENCE, &cert) || d.p != d.end ||
+      !der_tlv(&cert, DER_SEQUENCE, &tbs) ||
+      !der_tlv(&cert, DER_SEQUENCE, NULL) ||
+      !der_tlv(&cert, DER_BIT_STRING, NULL) || cert.p != cert.end)
+    {
+      return false;
+    }
+
+  if (der_peek(&tbs, DER_CTX_0) && !der_tlv(&tbs, DER_CTX_0, NULL))
+    {
+      return false;
+    }
+
+  if (!der_tlv(&tbs, DER_INTEGER, NULL) ||
+      !der_tlv(&tbs, DER_SEQUENCE, NULL) ||
+      !der_tlv(&tbs, DER_SEQUENCE, NULL) ||
+      !der_tlv(&tbs, DER_SEQUENCE, &validity) ||
+      !der_tlv(&tbs, DER_SEQUENCE, NULL) ||
+      !der_tlv(&tbs, DER_SEQUENCE, &spki))
+    {
+      return false;
+    }
+
+  if (!der_time(&validity, not_before) || !der_time(&validity, not_after) ||
+      validity.p != validity.end)
+    {
+      return false;
+    }
+
+  if (!der_tlv(&spki, DER_SEQUENCE, NULL) ||
+      !der_tlv(&spki, DER_BIT_STRING, &bits) ||
+      bits.end - bits.p < 2 || bits.p[0] != 0)
+    {
+      return false;
+    }
+
+  bits.p++;
+
+  /* RSAPublicKey is a SEQUENCE of modulus and exponent, EC a point */
+
+  rsa = bits;
+  if (der_tlv(&rsa, DER_SEQUENCE, &seq) && der_uint(&seq, &pub->v))
+    {
+      pub->rsa = true;
+    }
+  else
+    {
+      pub->rsa = false;
+      pub->v = bits;
+    }
+
+  return true;
+}
+
+/* PKCS#1 RSAPrivateKey or SEC1 ECPrivateKey */
+
+static bool ent_key_inner(struct der *seq, esp_wifi_ent_key_type_t *type,
+                          struct ent_pub *pub)
+{
+  struct der ver;
+  struct der v;
+  struct der ctx;
+  int i;
+
+  if (!der_tlv(seq, DER_INTEGER, &ver) || ver.end - ver.p != 1)
+    {
+      return false;
+    }
+
+  if (ver.p[0] == 0 && der_uint(seq, &pub->v))
+    {
+      for (i = 0; i < 7; i++)
+        {
+          if (!der_uint(seq, &v))
+            {
+              return false;
+            }
+        }
+
+      pub->rsa = true;
+      *type = ESP_WIFI_ENT_KEY_RSA;
+      return true;
+    }
+
+  if (ver.p[0] != 1 || !der_tlv(seq, DER_OCTET_STRING, NULL))
+    {
+      return false;
+    }
+
+  if (der_peek(seq, DER_CTX_0) && !der_tlv(seq, DER_CTX_0, NULL))
+    {
+      return false;
+    }
+
+  pub->rsa = false;
+  if (der_tlv(seq, DER_CTX_1, &ctx))
+    {
+      if (!der_tlv(&ctx, DER_BIT_STRING, &pub->v) ||
+          pub->v.end - pub->v.p < 2 || pub->v.p[0] != 0)
+        {
+          return false;
+        }
+
+      pub->v.p++;
+    }
+
+  *type = ESP_WIFI_ENT_KEY_EC;
+  return true;
+}
+
+static bool ent_key(const uint8_t *data, size_t len,
+                    esp_wifi_ent_key_type_t *type, struct ent_pub *pub)
+{
+  struct der d =
+  {
+    data, data + len
+  };
+
+  struct der seq;
+  struct der octets;
+  struct der inner;
+  struct der ver;
+  struct der save;
+
+  memset(pub, 0, sizeof(*pub));
+  if (!der_tlv(&d, DER_SEQUENCE, &seq) || d.p != d.end)
+    {
+      return false;
+    }
+
+  /* EncryptedPrivateKeyInfo: algorithm, encrypted data */
+
+  if (der_peek(&seq, DER_SEQUENCE))
+    {
+      *type = ESP_WIFI_ENT_KEY_PKCS8_ENC;
+      return der_tlv(&seq, DER_SEQUENCE, NULL) &&
+             der_tlv(&seq, DER_OCTET_STRING, NULL) && seq.p == seq.end;
+    }
+
+  /* PrivateKeyInfo: version 0, algorithm, key in an OCTET STRING */
+
+  save = seq;
+  if (der_tlv(&seq, DER_INTEGER, &ver) && ver.end - ver.p == 1 &&
+      ver.p[0] == 0 && der_tlv(&seq, DER_SEQUENCE, NULL))
+    {
+      if (!der_tlv(&seq, DER_OCTET_STRING, &octets) ||
+          !der_tlv(&octets, DER_SEQUENCE, &inner) ||
+          !ent_key_inner(&inner, type, pub))
+        {
+          return false;
+        }
+
+      *type = ESP_WIFI_ENT_KEY_PKCS8;
+      return true;
+    }
+
+  seq = save;
+  return ent_key_inner(&seq, type, pub);
+}
+
+static bool ent_pub_match(const struct ent_pub *a, const struct ent_pub *b)
+{
+  return a->rsa == b->rsa && a->v.end - a->v.p == b->v.end - b->v.p &&
+         memcmp(a->v.p, b->v.p, a->v.end - a->v.p) == 0;
+}
+
+static const uint8_t *ent_find(const uint8_t *p, const uint8_t *end,
+                               const char *s, size_t n)
+{
+  while ((size_t)(end - p) >= n)
+    {
+      if (p[0] == (uint8_t)s[0] && memcmp(p, s, n) == 0)
+        {
+          return p;
+        }
+
+      p++;
+    }
+
+  return NULL;
+}
+
+static const uint8_t *ent_eol(const uint8_t *p, const uint8_t *end)
+{
+  while (p < end && *p != '\n')
+    {
+      p++;
+    }
+
+  return p < end ? p + 1 : p;
+}
+
+/* Next PEM block from *pp: 1 found, 0 none left, -1 malformed */
+
+static int ent_pem_next(const uint8_t **pp, const uint8_t *end,
+                        struct ent_pem *pem)
+{
+  const uint8_t *p;
+  const uint8_t *q;
+
+  p = ent_find(*pp, end, ENT_PEM_BEGIN, sizeof(ENT_PEM_BEGIN) - 1);
+  if (p == NULL)
+    {
+      return 0;
+    }
+
+  pem->begin = p;
+  pem->label = p + sizeof(ENT_PEM_BEGIN) - 1;
+  q = ent_find(pem->label, end, ENT_PEM_DASHES, sizeof(ENT_PEM_DASHES) - 1);
+  if (q == NULL)
+    {
+      return -1;
+    }
+
+  pem->label_len = q - pem->label;
+  pem->body = ent_eol(q, end);
+
+  /* END line with the same label */
+
+  p = pem->body;
+  for (; ; )
+    {
+      p = ent_find(p, end, ENT_PEM_END, sizeof(ENT_PEM_END) - 1);
+      if (p == NULL)
+        {
+          return -1;
+        }
+
+      q = p + sizeof(ENT_PEM_END) - 1;
+      if ((size_t)(end - q) >= pem->label_len + 5 &&
+          memcmp(q, pem->label, pem->label_len) == 0 &&
+          memcmp(q + pem->label_len, ENT_PEM_DASHES, 5) == 0)
+        {
+          break;
+        }
+
+      p = q;
+    }
+
+  pem->body_end = p;
+  pem->next = ent_eol(q + pem->label_len, end);
+  pem->proc_type = ent_find(pem->body, p, "Proc-Type:", 10) != NULL;
+  *pp = pem->next;
+  return 1;
+}
+
+static bool ent_pem_is(const struct ent_pem *pem, const char *label)
+{
+  return pem->label_len == strlen(label) &&
+         memcmp(pem->label, label, pem->label_len) == 0;
+}
+
+static int ent_b64_val(uint8_t c)
+{
+  if (c >= 'A' && c <= 'Z')
+    {
+      return c - 'A';
+    }
+
+  if (c >= 'a' && c <= 'z')
+    {
+      return c - 'a' + 26;
+    }
+
+  if (c >= '0' && c <= '9')
+    {
+      return c - '0' + 52;
+    }
+
+  if (c == '+')
+    {
+      return 62;
+    }
+
+  return c == '/' ? 63 : -1;
+}
+
+/* Decode base64 skipping white space, returns the size or -1 */
+
+static int ent_b64_decode(const uint8_t *p, const uint8_t *end, uint8_t *out)
+{
+  uint32_t acc = 0;
+  int bits = 0;
+  int pad = 0;
+  int n = 0;
+  int v;
+
+  for (; p < end; p++)
+    {
+      if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        {
+          continue;
+        }
+
+      if (*p == '=')
+        {
+          pad++;
+          continue;
+        }
+
+      v = ent_b64_val(*p);
+      if (v < 0 || pad)
+        {
+          return -1;
+        }
+
+      acc = (acc << 6 | v) & 0xffffff;
+      bits += 6;
+      if (bits >= 8)
+        {
+          bits -= 8;
+          out[n++] = acc >> bits;
+        }
+    }
+
+  return pad > 2 ? -1 : n;
+}
+
+static size_t ent_b64_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+  size_t n = 0;
+  size_t col = 0;
+  uint32_t v;
+  size_t i;
+  int k;
+
+  for (i = 0; i < len; i += 3)
+    {
+      v = in[i] << 16;
+      if (i + 1 < len)
+        {
+          v |= in[i + 1] << 8;
+        }
+
+      if (i + 2 < len)
+        {
+          v |= in[i + 2];
+        }
+
+      for (k = 0; k < 4; k++)
+        {
+          out[n++] = i + k <= len ? s_b64[(v >> (18 - k * 6)) & 0x3f] : '=';
+        }
+
+      col += 4;
+      if (col == ENT_PEM_LINE || i + 3 >= len)
+        {
+          out[n++] = '\n';
+          col = 0;
+        }
+    }
+
+  return n;
+}
+
+static void ent_blob_init(esp_wifi_ent_blob_t *out, const uint8_t *in,
+                          size_t len)
+{
+  memset(out, 0, sizeof(*out));
+  out->hash = esp_wifi_ent_cred_hash(ESP_WIFI_ENT_CRED_HASH_INIT, in, len);
+  out->in_len = len;
+  out->not_before = INT64_MIN;
+  out->not_after = INT64_MAX;
+}
+
+static void ent_blob_validity(esp_wifi_ent_blob_t *out, int64_t not_before,
+                              int64_t not_after)
+{
+  if (not_before > out->not_before)
+    {
+      out->not_before = not_before;
+    }
+
+  if (not_after < out->not_after)
+    {
+      out->not_after = not_after;
+    }
+}
+
+/* Certificates of a chain, re-encoded as PEM */
+
+static uint8_t *ent_chain_pem(const uint8_t *der, const size_t *off,
+                              uint32_t n, size_t *len)
+{
+  static const char begin[] = "-----BEGIN " ENT_PEM_CERT "-----\n";
+  static const char end[] = "-----END " ENT_PEM_CERT "-----\n";
+  size_t size = 1;
+  size_t b64;
+  uint8_t *out;
+  uint8_t *p;
+  uint32_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      b64 = (off[i + 1] - off[i] + 2) / 3 * 4;
+      size += sizeof(begin) - 1 + b64 + (b64 + ENT_PEM_LINE - 1) /
+              ENT_PEM_LINE + sizeof(end) - 1;
+    }
+
+  out = malloc(size);
+  if (out == NULL)
+    {
+      return NULL;
+    }
+
+  p = out;
+  for (i = 0; i < n; i++)
+    {
+      memcpy(p, begin, sizeof(begin) - 1);
+      p += sizeof(begin) - 1;
+      p += ent_b64_encode(der + off[i], off[i + 1] - off[i], p);
+      memcpy(p, end, sizeof(end) - 1);
+      p += sizeof(end) - 1;
+    }
+
+  *p++ = '\0';
+  *len = p - out;
+  return out;
+}
+
+/* Parse certificates, the first one must carry key when given */
+
+static esp_err_t ent_parse_certs(const uint8_t *in, size_t len,
+                                 esp_wifi_ent_blob_t *out,
+                                 const struct ent_pub *key)
+{
+  size_t off[ESP_WIFI_ENT_CRED_MAX_CERTS + 1];
+  struct ent_pub pub;
+  struct ent_pem pem;
+  const uint8_t *p = in;
+  int64_t not_before;
+  int64_t not_after;
+  esp_err_t ret = ESP_OK;
+  uint8_t *shrunk;
+  uint8_t *der;
+  uint32_t n = 0;
+  uint32_t i;
+  int r;
+  int k;
+
+  if (in == NULL || len == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ent_blob_init(out, in, len);
+
+  der = malloc(len);
+  if (der == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  off[0] = 0;
+  if (in[0] == DER_SEQUENCE)
+    {
+      memcpy(der, in, len);
+      off[++n] = len;
+    }
+  else
+    {
+      while ((r = ent_pem_next(&p, in + len, &pem)) > 0)
+        {
+          if (!ent_pem_is(&pem, ENT_PEM_CERT))
+            {
+              continue;
+            }
+
+          if (n == ESP_WIFI_ENT_CRED_MAX_CERTS)
+            {
+              ret = ESP_ERR_INVALID_SIZE;
+              break;
+            }
+
+          k = ent_b64_decode(pem.body, pem.body_end, der + off[n]);
+          if (k <= 0)
+            {
+              r = -1;
+              break;
+            }
+
+          off[n + 1] = off[n] + k;
+          n++;
+        }
+
+      if (ret == ESP_OK && (r < 0 || n == 0))
+        {
+          ret = ESP_ERR_INVALID_ARG;
+        }
+    }
+
+  for (i = 0; ret == ESP_OK && i < n; i++)
+    {
+      if (!ent_cert(der + off[i], off[i + 1] - off[i], &not_before,
+                    &not_after, &pub))
+        {
+          ret = ESP_ERR_INVALID_ARG;
+          break;
+        }
+
+      if (i == 0 && key && key->v.p && !ent_pub_match(key, &pub))
+        {
+          ret = ESP_ERR_INVALID_STATE;
+          break;
+        }
+
+      ent_blob_validity(out, not_before, not_after);
+    }
+
+  if (ret != ESP_OK)
+    {
+      free(der);
+      return ret;
+    }
+
+  out->ncerts = n;
+  out->der_len = off[n];
+  if (n == 1)
+    {
+      shrunk = realloc(der, off[1]);
+      out->data = shrunk ? shrunk : der;
+      out->len = off[1];
+      return ESP_OK;
+    }
+
+  out->data = ent_chain_pem(der, off, n, &out->len);
+  out->pem = true;
+  free(der);
+  return out->data ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static esp_err_t ent_parse_key(const uint8_t *in, size_t len,
+                               esp_wifi_ent_blob_t *out, struct ent_pub *pub)
+{
+  struct ent_pem pem;
+  const uint8_t *p = in;
+  int k;
+
+  if (in == NULL || len == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ent_blob_init(out, in, len);
+  memset(pub, 0, sizeof(*pub));
+
+  if (in[0] == DER_SEQUENCE)
+    {
+      out->data = malloc(len);
+      if (out->data == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+
+      memcpy(out->data, in, len);
+      out->len = len;
+      out->der_len = len;
+      if (!ent_key(out->data, len, &out->key_type, pub))
+        {
+          esp_wifi_ent_cred_blob_free(out);
+          return ESP_ERR_INVALID_ARG;
+        }
+
+      return ESP_OK;
+    }
+
+  do
+    {
+      if (ent_pem_next(&p, in + len, &pem) <= 0)
+        {
+          return ESP_ERR_INVALID_ARG;
+        }
+    }
+  while (pem.label_len < 11 ||
+         memcmp(pem.label + pem.label_len - 11, "PRIVATE KEY", 11) != 0);
+
+  /* Legacy encryption is only undone by mbedtls, keep the block */
+
+  if (pem.proc_type)
+    {
+      out->len = pem.next - pem.begin + 1;
+      out->data = malloc(out->len);
+      if (out->data == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+
+      memcpy(out->data, pem.begin, out->len - 1);
+      out->data[out->len - 1] = '\0';
+      out->pem = true;
+      out->key_type = ESP_WIFI_ENT_KEY_PEM_ENC;
+      return ESP_OK;
+    }
+
+  out->data = malloc(pem.body_end - pem.body);
+  if (out->data == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  k = ent_b64_decode(pem.body, pem.body_end, out->data);
+  if (k <= 0 || !ent_key(out->data, k, &out->key_type, pub))
+    {
+      esp_wifi_ent_cred_blob_free(out);
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  out->len = k;
+  out->der_len = k;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_ent_cred_parse_certs(const uint8_t *in, size_t len,
+                                        esp_wifi_ent_blob_t *out)
+{
+  return ent_parse_certs(in, len, out, NULL);
+}
+
+esp_err_t esp_wifi_ent_cred_parse_cert_key(const uint8_t *cert,
+                                           size_t cert_len,
+                                           const uint8_t *key,
+                                           size_t key_len,
+                                           esp_wifi_ent_blob_t *cert_out,
+                                           esp_wifi_ent_blob_t *key_out)
+{
+  struct ent_pub pub;
+  esp_err_t ret;
+
+  ret = ent_parse_key(key, key_len, key_out, &pub);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  ret = ent_parse_certs(cert, cert_len, cert_out, &pub);
+  if (ret != ESP_OK)
+    {
+      esp_wifi_ent_cred_blob_free(key_out);
+    }
+
+  return ret;
+}
+
+void esp_wifi_ent_cred_blob_free(esp_wifi_ent_blob_t *blob)
+{
+  /* Wiped, it may hold a private key */
+
+  if (blob->data)
+    {
+      memset(blob->data, 0, blob->len);
+      free(blob->data);
+    }
+
+  memset(blob, 0, sizeof(*blob));
+}
@@ -0,0 +1,152 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_wifi_ent_cred.h"
+
+static uint32_t ent_ns(clock_t cpu, uint32_t cycles)
+{
+  return (uint32_t)((double)cpu * 1e9 / CLOCKS_PER_SEC / cycles);
+}
+
+/* One cycle as the supplicant setup sees it: CA and client certificate
+ * with key parsed from what the application hands over
+ */
+
+static esp_err_t ent_cycle(const uint8_t *ca, size_t ca_len,
+                           const uint8_t *cert, size_t cert_len,
+                           const uint8_t *key, size_t key_len)
+{
+  esp_wifi_ent_blob_t b[3];
+  esp_err_t ret;
+
+  ret = esp_wifi_ent_cred_parse_certs(ca, ca_len, &b[0]);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  ret = esp_wifi_ent_cred_parse_cert_key(cert, cert_len, key, key_len,
+                                         &b[1], &b[2]);
+  esp_wifi_ent_cred_blob_free(&b[0]);
+  if (ret == ESP_OK)
+    {
+      esp_wifi_ent_cred_blob_free(&b[1]);
+      esp_wifi_ent_cred_blob_free(&b[2]);
+    }
+
+  return ret;
+}
+
+esp_err_t esp_wifi_ent_cred_bench(const uint8_t *ca, size_t ca_len,
+                                  const uint8_t *cert, size_t cert_len,
+                                  const uint8_t *key, size_t key_len,
+                                  uint32_t cycles,
+                                  esp_wifi_ent_cred_bench_t *result)
+{
+  esp_wifi_ent_blob_t s[3];
+  uint8_t *copy[2];
+  uint8_t digest[32];
+  uint8_t d[32];
+  volatile uint32_t hits = 0;
+  esp_err_t ret = ESP_OK;
+  clock_t c0;
+  uint32_t i;
+
+  if (result == NULL || cycles == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ret = esp_wifi_ent_cred_parse_certs(ca, ca_len, &s[0]);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  ret = esp_wifi_ent_cred_parse_cert_key(cert, cert_len, key, key_len,
+                                         &s[1], &s[2]);
+  if (ret != ESP_OK)
+    {
+      esp_wifi_ent_cred_blob_free(&s[0]);
+      return ret;
+    }
+
+  copy[0] = malloc(ca_len);
+  copy[1] = malloc(cert_len);
+  if (copy[0] == NULL || copy[1] == NULL)
+    {
+      ret = ESP_ERR_NO_MEM;
+    }
+  else
+    {
+      memcpy(copy[0], ca, ca_len);
+      memcpy(copy[1], cert, cert_len);
+    }
+
+  esp_wifi_ent_cred_sha256(key, key_len, digest);
+
+  memset(result, 0, sizeof(*result));
+  result->cycles = cycles;
+  result->in_bytes = ca_len + cert_len + key_len;
+  result->kept_bytes = s[0].len + s[1].len + s[2].len + ca_len +
+                       cert_len;
+  result->transient_bytes = (ca[0] != 0x30 ? s[0].der_len : 0) +
+                            (cert[0] != 0x30 ? s[1].der_len : 0) +
+                            (key[0] != 0x30 ? s[2].der_len : 0);
+
+  c0 = clock();
+  for (i = 0; i < cycles && ret == ESP_OK; i++)
+    {
+      ret = ent_cycle(ca, ca_len, cert, cert_len, key, key_len);
+    }
+
+  result->reparse_pem_ns = ent_ns(clock() - c0, cycles);
+
+  c0 = clock();
+  for (i = 0; i < cycles && ret == ESP_OK; i++)
+    {
+      ret = ent_cycle(s[0].data, s[0].len, s[1].data, s[1].len,
+                      s[2].data, s[2].len);
+    }
+
+  result->reparse_der_ns = ent_ns(clock() - c0, cycles);
+
+  /* What the store does when handed the same material again */
+
+  c0 = clock();
+  for (i = 0; i < cycles && ret == ESP_OK; i++)
+    {
+      esp_wifi_ent_cred_sha256(key, key_len, d);
+      hits += memcmp(copy[0], ca, ca_len) == 0 &&
+              memcmp(copy[1], cert, cert_len) == 0 &&
+              memcmp(d, digest, sizeof(d)) == 0;
+    }
+
+  result->store_ns = ent_ns(clock() - c0, cycles);
+
+  for (i = 0; i < 3; i++)
+    {
+      esp_wifi_ent_cred_blob_free(&s[i]);
+    }
+
+  free(copy[0]);
+  free(copy[1]);
+
+  return ret;
+}
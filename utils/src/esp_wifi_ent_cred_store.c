@@ -0,0 +1,397 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wpa2.h"
+#include "esp_wifi_ent_cred.h"
+
+/* Every input is kept to skip setting the same bytes again: public
+ * ones as a copy, secret ones as their SHA-256 digest
+ */
+
+struct ent_in
+{
+  uint8_t *data;                 /* NULL when not set */
+  int len;
+};
+
+struct ent_secret
+{
+  uint8_t digest[32];
+  int len;                       /* 0 when not set */
+};
+
+static esp_wifi_ent_blob_t s_ca;
+static esp_wifi_ent_blob_t s_cert;
+static esp_wifi_ent_blob_t s_key;
+static uint8_t *s_passwd;
+static int s_passwd_len;
+static struct ent_in s_ca_in;
+static struct ent_in s_cert_in;
+static struct ent_secret s_key_in;
+static struct ent_in s_identity;
+static struct ent_in s_username;
+static struct ent_secret s_password;
+static esp_wifi_ent_cred_stats_t s_stats;
+
+static void ent_update_sizes(void)
+{
+  s_stats.in_bytes = s_ca.in_len + s_cert.in_len + s_key.in_len;
+  s_stats.kept_bytes = s_ca.len + s_cert.len + s_key.len +
+                       s_ca_in.len + s_cert_in.len;
+}
+
+static bool ent_in_same(const struct ent_in *in, const unsigned char *v,
+                        int len)
+{
+  return in->data && in->len == len && memcmp(in->data, v, len) == 0;
+}
+
+static esp_err_t ent_in_dup(struct ent_in *in, const unsigned char *v,
+                            int len)
+{
+  in->data = malloc(len);
+  if (in->data == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  memcpy(in->data, v, len);
+  in->len = len;
+  return ESP_OK;
+}
+
+static void ent_in_free(struct ent_in *in)
+{
+  free(in->data);
+  in->data = NULL;
+  in->len = 0;
+}
+
+static void ent_secret_make(struct ent_secret *sec, const unsigned char *v,
+                            int len)
+{
+  esp_wifi_ent_cred_sha256(v, len, sec->digest);
+  sec->len = len;
+}
+
+static bool ent_secret_same(const struct ent_secret *a,
+                            const struct ent_secret *b)
+{
+  return a->len != 0 && a->len == b->len &&
+         memcmp(a->digest, b->digest, sizeof(a->digest)) == 0;
+}
+
+static void ent_secret_clear(struct ent_secret *sec)
+{
+  memset(sec, 0, sizeof(*sec));
+}
+
+/* The supplicant keeps the pointer until it is replaced or cleared */
+
+static void ent_passwd_free(uint8_t *passwd, int len)
+{
+  if (passwd)
+    {
+      memset(passwd, 0, len);
+      free(passwd);
+    }
+}
+
+static esp_err_t ent_set_str(struct ent_in *s, const unsigned char *v,
+                             int len,
+                             esp_err_t (*set)(const unsigned char *, int))
+{
+  struct ent_in in;
+  esp_err_t ret;
+
+  if (v == NULL || len <= 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (ent_in_same(s, v, len))
+    {
+      s_stats.hits++;
+      return ESP_OK;
+    }
+
+  ret = ent_in_dup(&in, v, len);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  ret = set(v, len);
+  if (ret != ESP_OK)
+    {
+      ent_in_free(&in);
+      return ret;
+    }
+
+  ent_in_free(s);
+  *s = in;
+  return ESP_OK;
+}
+
+static void ent_clear_str(struct ent_in *s, void (*clear)(void))
+{
+  clear();
+  if (s->data)
+    {
+      s_stats.invalidations++;
+    }
+
+  ent_in_free(s);
+}
+
+esp_err_t esp_wifi_ent_cred_set_ca_cert(const unsigned char *ca_cert,
+                                        int ca_cert_len)
+{
+  esp_wifi_ent_blob_t blob;
+  struct ent_in in;
+  esp_err_t ret;
+
+  if (ca_cert == NULL || ca_cert_len <= 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_ca.data && ent_in_same(&s_ca_in, ca_cert, ca_cert_len))
+    {
+      s_stats.hits++;
+      return ESP_OK;
+    }
+
+  ret = esp_wifi_ent_cred_parse_certs(ca_cert, ca_cert_len, &blob);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  s_stats.parses++;
+
+  ret = ent_in_dup(&in, ca_cert, ca_cert_len);
+  if (ret != ESP_OK)
+    {
+      esp_wifi_ent_cred_blob_free(&blob);
+      return ret;
+    }
+
+  /* The supplicant drops the old pointer before it is freed */
+
+  ret = esp_wifi_sta_wpa2_ent_set_ca_cert(blob.data, blob.len);
+  if (ret != ESP_OK)
+    {
+      esp_wifi_ent_cred_blob_free(&blob);
+      ent_in_free(&in);
+      return ret;
+    }
+
+  esp_wifi_ent_cred_blob_free(&s_ca);
+  ent_in_free(&s_ca_in);
+  s_ca = blob;
+  s_ca_in = in;
+  ent_update_sizes();
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_ent_cred_set_cert_key(const unsigned char *client_cert,
+                                         int client_cert_len,
+                                         const unsigned char *private_key,
+                                         int private_key_len,
+                                         const unsigned char *private_key_passwd,
+                                         int private_key_passwd_len)
+{
+  esp_wifi_ent_blob_t cert;
+  esp_wifi_ent_blob_t key;
+  struct ent_in cert_in;
+  struct ent_secret key_in;
+  uint8_t *passwd = NULL;
+  esp_err_t ret;
+
+  if (client_cert == NULL || client_cert_len <= 0 || private_key == NULL ||
+      private_key_len <= 0 || private_key_passwd_len < 0 ||
+      (private_key_passwd_len && private_key_passwd == NULL))
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ent_secret_make(&key_in, private_key, private_key_len);
+  if (s_cert.data && ent_in_same(&s_cert_in, client_cert, client_cert_len) &&
+      ent_secret_same(&s_key_in, &key_in) &&
+      s_passwd_len == private_key_passwd_len &&
+      (s_passwd_len == 0 ||
+       memcmp(s_passwd, private_key_passwd, s_passwd_len) == 0))
+    {
+      s_stats.hits++;
+      return ESP_OK;
+    }
+
+  ret = esp_wifi_ent_cred_parse_cert_key(client_cert, client_cert_len,
+                                         private_key, private_key_len,
+                                         &cert, &key);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  s_stats.parses++;
+
+  memset(&cert_in, 0, sizeof(cert_in));
+  ret = ent_in_dup(&cert_in, client_cert, client_cert_len);
+  if (ret == ESP_OK && private_key_passwd_len)
+    {
+      passwd = malloc(private_key_passwd_len);
+      ret = passwd ? ESP_OK : ESP_ERR_NO_MEM;
+      if (passwd)
+        {
+          memcpy(passwd, private_key_passwd, private_key_passwd_len);
+        }
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_wifi_sta_wpa2_ent_set_cert_key(cert.data, cert.len,
+                                               key.data, key.len,
+                                               passwd,
+                                               private_key_passwd_len);
+    }
+
+  if (ret != ESP_OK)
+    {
+      esp_wifi_ent_cred_blob_free(&cert);
+      esp_wifi_ent_cred_blob_free(&key);
+      ent_in_free(&cert_in);
+      ent_passwd_free(passwd, private_key_passwd_len);
+      return ret;
+    }
+
+  esp_wifi_ent_cred_blob_free(&s_cert);
+  esp_wifi_ent_cred_blob_free(&s_key);
+  ent_in_free(&s_cert_in);
+  ent_passwd_free(s_passwd, s_passwd_len);
+  s_cert = cert;
+  s_key = key;
+  s_cert_in = cert_in;
+  s_key_in = key_in;
+  s_passwd = passwd;
+  s_passwd_len = private_key_passwd_len;
+  ent_update_sizes();
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_ent_cred_set_identity(const unsigned char *identity,
+                                         int len)
+{
+  return ent_set_str(&s_identity, identity, len,
+                     esp_wifi_sta_wpa2_ent_set_identity);
+}
+
+esp_err_t esp_wifi_ent_cred_set_username(const unsigned char *username,
+                                         int len)
+{
+  return ent_set_str(&s_username, username, len,
+                     esp_wifi_sta_wpa2_ent_set_username);
+}
+
+esp_err_t esp_wifi_ent_cred_set_password(const unsigned char *password,
+                                         int len)
+{
+  struct ent_secret sec;
+  esp_err_t ret;
+
+  if (password == NULL || len <= 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ent_secret_make(&sec, password, len);
+  if (ent_secret_same(&s_password, &sec))
+    {
+      s_stats.hits++;
+      return ESP_OK;
+    }
+
+  ret = esp_wifi_sta_wpa2_ent_set_password(password, len);
+  if (ret == ESP_OK)
+    {
+      s_password = sec;
+    }
+
+  return ret;
+}
+
+void esp_wifi_ent_cred_clear_ca_cert(void)
+{
+  esp_wifi_sta_wpa2_ent_clear_ca_cert();
+  if (s_ca.data)
+    {
+      s_stats.invalidations++;
+    }
+
+  esp_wifi_ent_cred_blob_free(&s_ca);
+  ent_in_free(&s_ca_in);
+  ent_update_sizes();
+}
+
+void esp_wifi_ent_cred_clear_cert_key(void)
+{
+  esp_wifi_sta_wpa2_ent_clear_cert_key();
+  if (s_cert.data)
+    {
+      s_stats.invalidations++;
+    }
+
+  esp_wifi_ent_cred_blob_free(&s_cert);
+  esp_wifi_ent_cred_blob_free(&s_key);
+  ent_in_free(&s_cert_in);
+  ent_secret_clear(&s_key_in);
+  ent_passwd_free(s_passwd, s_passwd_len);
+  s_passwd = NULL;
+  s_passwd_len = 0;
+  ent_update_sizes();
+}
+
+void esp_wifi_ent_cred_clear_identity(void)
+{
+  ent_clear_str(&s_identity, esp_wifi_sta_wpa2_ent_clear_identity);
+}
+
+void esp_wifi_ent_cred_clear_username(void)
+{
+  ent_clear_str(&s_username, esp_wifi_sta_wpa2_ent_clear_username);
+}
+
+void esp_wifi_ent_cred_clear_password(void)
+{
+  esp_wifi_sta_wpa2_ent_clear_password();
+  if (s_password.len)
+    {
+      s_stats.invalidations++;
+    }
+
+  ent_secret_clear(&s_password);
+}
+
+void esp_wifi_ent_cred_get_stats(esp_wifi_ent_cred_stats_t *stats)
+{
+  *stats = s_stats;
+}
@@ -0,0 +1,315 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_ent_pmksa.h"
+
+struct pmksa_entry
+{
+  int64_t expire_s;
+  uint8_t bssid[6];
+  uint8_t ssid_len;
+  uint8_t ssid[32];
+};
+
+struct esp_wifi_ent_pmksa
+{
+  const wifi_osi_funcs_t *osi;
+  void *lock;
+  esp_wifi_ent_pmksa_config_t cfg;
+  esp_wifi_ent_pmksa_stats_t stats;
+  uint8_t n;
+  struct pmksa_entry entries[];
+};
+
+static void pmksa_lock(esp_wifi_ent_pmksa_t *tab)
+{
+  if (tab->lock)
+    {
+      tab->osi->_mutex_lock(tab->lock);
+    }
+}
+
+static void pmksa_unlock(esp_wifi_ent_pmksa_t *tab)
+{
+  if (tab->lock)
+    {
+      tab->osi->_mutex_unlock(tab->lock);
+    }
+}
+
+static void pmksa_drop(esp_wifi_ent_pmksa_t *tab, int i)
+{
+  tab->entries[i] = tab->entries[--tab->n];
+}
+
+static void pmksa_purge(esp_wifi_ent_pmksa_t *tab, int64_t now_s)
+{
+  int i = 0;
+
+  while (i < tab->n)
+    {
+      if (tab->entries[i].expire_s <= now_s)
+        {
+          tab->stats.expired++;
+          pmksa_drop(tab, i);
+        }
+      else
+        {
+          i++;
+        }
+    }
+}
+
+/* Live entry of a BSSID, the table is left as is */
+
+static int pmksa_find(const esp_wifi_ent_pmksa_t *tab,
+                      const uint8_t bssid[6], int64_t now_s)
+{
+  int i;
+
+  for (i = 0; i < tab->n; i++)
+    {
+      if (memcmp(tab->entries[i].bssid, bssid, 6) == 0)
+        {
+          return tab->entries[i].expire_s > now_s ? i : -1;
+        }
+    }
+
+  return -1;
+}
+
+static bool pmksa_ssid_is(const wifi_ap_record_t *ap, const uint8_t *ssid,
+                          uint8_t ssid_len)
+{
+  return strnlen((const char *)ap->ssid, sizeof(ap->ssid) - 1) == ssid_len &&
+         memcmp(ap->ssid, ssid, ssid_len) == 0;
+}
+
+void esp_wifi_ent_pmksa_default(esp_wifi_ent_pmksa_config_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->max_entries = 16;
+  cfg->lifetime_s = 43200;
+  cfg->rssi_margin = 8;
+  cfg->rssi_min = -80;
+}
+
+esp_err_t esp_wifi_ent_pmksa_alloc(const wifi_osi_funcs_t *osi,
+                                   const esp_wifi_ent_pmksa_config_t *cfg,
+                                   esp_wifi_ent_pmksa_t **tab)
+{
+  esp_wifi_ent_pmksa_t *t;
+
+  if (cfg == NULL || tab == NULL || cfg->max_entries == 0 ||
+      cfg->max_entries > ESP_WIFI_ENT_PMKSA_MAX || cfg->lifetime_s == 0 ||
+      cfg->rssi_margin < 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  t = calloc(1, sizeof(*t) + cfg->max_entries * sizeof(t->entries[0]));
+  if (t == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  if (osi)
+    {
+      t->lock = osi->_mutex_create();
+      if (t->lock == NULL)
+        {
+          free(t);
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  t->osi = osi;
+  t->cfg = *cfg;
+  *tab = t;
+  return ESP_OK;
+}
+
+void esp_wifi_ent_pmksa_delete(esp_wifi_ent_pmksa_t *tab)
+{
+  if (tab && tab->lock)
+    {
+      tab->osi->_mutex_delete(tab->lock);
+    }
+
+  free(tab);
+}
+
+void esp_wifi_ent_pmksa_add(esp_wifi_ent_pmksa_t *tab, const uint8_t *ssid,
+                            uint8_t ssid_len, const uint8_t bssid[6],
+                            int64_t now_s)
+{
+  struct pmksa_entry *e;
+  int i;
+  int j;
+
+  if (ssid_len > sizeof(e->ssid))
+    {
+      return;
+    }
+
+  pmksa_lock(tab);
+  pmksa_purge(tab, now_s);
+  i = pmksa_find(tab, bssid, now_s);
+  if (i >= 0)
+    {
+      tab->stats.refreshed++;
+    }
+  else
+    {
+      if (tab->n == tab->cfg.max_entries)
+        {
+          /* As the supplicant, evict the entry closest to expiry */
+
+          i = 0;
+          for (j = 1; j < tab->n; j++)
+            {
+              if (tab->entries[j].expire_s < tab->entries[i].expire_s)
+                {
+                  i = j;
+                }
+            }
+
+          tab->stats.evicted++;
+          pmksa_drop(tab, i);
+        }
+
+      i = tab->n++;
+      tab->stats.added++;
+    }
+
+  e = &tab->entries[i];
+  e->expire_s = now_s + tab->cfg.lifetime_s;
+  memcpy(e->bssid, bssid, 6);
+  e->ssid_len = ssid_len;
+  memcpy(e->ssid, ssid, ssid_len);
+  pmksa_unlock(tab);
+}
+
+void esp_wifi_ent_pmksa_remove(esp_wifi_ent_pmksa_t *tab,
+                               const uint8_t bssid[6])
+{
+  int i;
+
+  pmksa_lock(tab);
+  for (i = 0; i < tab->n; i++)
+    {
+      if (memcmp(tab->entries[i].bssid, bssid, 6) == 0)
+        {
+          tab->stats.dropped++;
+          pmksa_drop(tab, i);
+          break;
+        }
+    }
+
+  pmksa_unlock(tab);
+}
+
+void esp_wifi_ent_pmksa_flush(esp_wifi_ent_pmksa_t *tab)
+{
+  pmksa_lock(tab);
+  tab->stats.dropped += tab->n;
+  tab->n = 0;
+  pmksa_unlock(tab);
+}
+
+void esp_wifi_ent_pmksa_purge(esp_wifi_ent_pmksa_t *tab, int64_t now_s)
+{
+  pmksa_lock(tab);
+  pmksa_purge(tab, now_s);
+  pmksa_unlock(tab);
+}
+
+bool esp_wifi_ent_pmksa_cached(esp_wifi_ent_pmksa_t *tab,
+                               const uint8_t bssid[6], int64_t now_s)
+{
+  bool cached;
+
+  pmksa_lock(tab);
+  cached = pmksa_find(tab, bssid, now_s) >= 0;
+  pmksa_unlock(tab);
+  return cached;
+}
+
+int esp_wifi_ent_pmksa_select(esp_wifi_ent_pmksa_t *tab,
+                              const wifi_ap_record_t *aps, uint16_t n,
+                              const uint8_t *ssid, uint8_t ssid_len,
+                              int64_t now_s, bool *cached)
+{
+  int best = -1;
+  int best_cached = -1;
+  int i;
+
+  pmksa_lock(tab);
+  for (i = 0; i < n; i++)
+    {
+      if (!pmksa_ssid_is(&aps[i], ssid, ssid_len))
+        {
+          continue;
+        }
+
+      if (best < 0 || aps[i].rssi > aps[best].rssi)
+        {
+          best = i;
+        }
+
+      if (aps[i].rssi >= tab->cfg.rssi_min &&
+          (best_cached < 0 || aps[i].rssi > aps[best_cached].rssi) &&
+          pmksa_find(tab, aps[i].bssid, now_s) >= 0)
+        {
+          best_cached = i;
+        }
+    }
+
+  if (best_cached >= 0 &&
+      aps[best_cached].rssi + tab->cfg.rssi_margin >= aps[best].rssi)
+    {
+      tab->stats.picks_cached++;
+      if (aps[best_cached].rssi < aps[best].rssi)
+        {
+          tab->stats.picks_weaker++;
+        }
+
+      best = best_cached;
+    }
+  else if (best >= 0)
+    {
+      tab->stats.picks_strongest++;
+    }
+
+  pmksa_unlock(tab);
+  if (cached)
+    {
+      *cached = best >= 0 && best == best_cached;
+    }
+
+  return best;
+}
+
+void esp_wifi_ent_pmksa_get_stats(esp_wifi_ent_pmksa_t *tab,
+                                  esp_wifi_ent_pmksa_stats_t *stats)
+{
+  pmksa_lock(tab);
+  *stats = tab->stats;
+  pmksa_unlock(tab);
+}
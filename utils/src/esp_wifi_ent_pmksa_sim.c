@@ -0,0 +1,224 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_wifi_ent_pmksa.h"
+
+#define PMKSA_SIM_APS       16
+
+static const uint8_t s_ssid[] = "corp-8021x";
+
+static uint32_t pmksa_sim_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+/* One reconnect of a policy: the supplicant side decides the cost, the
+ * station side only learns from the outcome as the event handler does
+ */
+
+static void pmksa_sim_connect(const esp_wifi_ent_pmksa_sim_t *sim,
+                              esp_wifi_ent_pmksa_t *supp,
+                              esp_wifi_ent_pmksa_t *tab,
+                              const wifi_ap_record_t *aps, int pick,
+                              int best, int64_t now_s, uint32_t *rng,
+                              esp_wifi_ent_pmksa_sim_stat_t *stat,
+                              uint64_t *ms_sum, uint64_t *loss_sum)
+{
+  uint32_t ms;
+
+  if (esp_wifi_ent_pmksa_cached(supp, aps[pick].bssid, now_s))
+    {
+      ms = sim->cached_ms;
+    }
+  else
+    {
+      ms = sim->full_eap_min_ms + pmksa_sim_rand(rng) %
+           (sim->full_eap_max_ms - sim->full_eap_min_ms + 1);
+      stat->full_eaps++;
+    }
+
+  esp_wifi_ent_pmksa_add(supp, s_ssid, sizeof(s_ssid) - 1,
+                         aps[pick].bssid, now_s);
+  if (tab)
+    {
+      esp_wifi_ent_pmksa_add(tab, s_ssid, sizeof(s_ssid) - 1,
+                             aps[pick].bssid, now_s);
+    }
+
+  stat->reconnects++;
+  *ms_sum += ms;
+  *loss_sum += aps[best].rssi - aps[pick].rssi;
+  if (ms > stat->max_ms)
+    {
+      stat->max_ms = ms;
+    }
+}
+
+static void pmksa_sim_finish(esp_wifi_ent_pmksa_sim_stat_t *stat,
+                             uint64_t ms_sum, uint64_t loss_sum)
+{
+  if (stat->reconnects)
+    {
+      stat->avg_ms = ms_sum / stat->reconnects;
+      stat->rssi_loss_x10 = loss_sum * 10 / stat->reconnects;
+    }
+}
+
+void esp_wifi_ent_pmksa_sim_default(esp_wifi_ent_pmksa_sim_t *sim)
+{
+  memset(sim, 0, sizeof(*sim));
+  sim->aps = 4;
+  sim->rssi_spread = 10;
+  sim->rssi_jitter = 6;
+  sim->full_eap_min_ms = 1000;
+  sim->full_eap_max_ms = 3000;
+  sim->cached_ms = 60;
+  sim->reconnect_s = 600;
+  sim->duration_s = 86400;
+  sim->runs = 100;
+  sim->seed = 1;
+}
+
+esp_err_t esp_wifi_ent_pmksa_sim_run(const esp_wifi_ent_pmksa_config_t *cfg,
+                                     const esp_wifi_ent_pmksa_sim_t *sim,
+                                     esp_wifi_ent_pmksa_sim_result_t *result)
+{
+  esp_wifi_ent_pmksa_config_t c;
+  esp_wifi_ent_pmksa_t *supp[2] =
+  {
+    NULL, NULL
+  };
+
+  esp_wifi_ent_pmksa_t *tab = NULL;
+  wifi_ap_record_t aps[PMKSA_SIM_APS];
+  int8_t mean[PMKSA_SIM_APS];
+  uint64_t ms_sum[2] =
+  {
+    0, 0
+  };
+
+  uint64_t loss_sum[2] =
+  {
+    0, 0
+  };
+
+  uint32_t cost_rng[2];
+  uint32_t rng;
+  uint32_t run;
+  int64_t t;
+  esp_err_t ret;
+  int best;
+  int pick;
+  int i;
+
+  if (cfg == NULL || sim == NULL || result == NULL || sim->aps == 0 ||
+      sim->aps > PMKSA_SIM_APS || sim->rssi_spread < 0 ||
+      sim->rssi_jitter < 0 || sim->full_eap_max_ms < sim->full_eap_min_ms ||
+      sim->reconnect_s == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  c = *cfg;
+  c.max_entries = ESP_WIFI_ENT_PMKSA_MAX;
+  ret = esp_wifi_ent_pmksa_alloc(NULL, &c, &supp[0]);
+  if (ret == ESP_OK)
+    {
+      ret = esp_wifi_ent_pmksa_alloc(NULL, &c, &supp[1]);
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_wifi_ent_pmksa_alloc(NULL, cfg, &tab);
+    }
+
+  if (ret != ESP_OK)
+    {
+      esp_wifi_ent_pmksa_delete(supp[0]);
+      esp_wifi_ent_pmksa_delete(supp[1]);
+      return ret;
+    }
+
+  memset(result, 0, sizeof(*result));
+  memset(aps, 0, sizeof(aps));
+  rng = sim->seed ? sim->seed : 1;
+
+  /* Full EAP durations are drawn apart so both policies see the same
+   * scans whatever their outcome
+   */
+
+  cost_rng[0] = rng ^ 0x9e3779b9;
+  cost_rng[1] = cost_rng[0];
+
+  for (run = 0; run < sim->runs; run++)
+    {
+      for (i = 0; i < sim->aps; i++)
+        {
+          aps[i].bssid[0] = 0x02;
+          aps[i].bssid[4] = run;
+          aps[i].bssid[5] = i;
+          memcpy(aps[i].ssid, s_ssid, sizeof(s_ssid));
+          aps[i].primary = 1 + 5 * (i % 3);
+          aps[i].authmode = WIFI_AUTH_WPA2_ENTERPRISE;
+          mean[i] = -50 - pmksa_sim_rand(&rng) % (sim->rssi_spread + 1);
+        }
+
+      esp_wifi_ent_pmksa_flush(supp[0]);
+      esp_wifi_ent_pmksa_flush(supp[1]);
+      esp_wifi_ent_pmksa_flush(tab);
+
+      for (t = 0; t < sim->duration_s; t += sim->reconnect_s)
+        {
+          /* Both policies see the same scan */
+
+          best = 0;
+          for (i = 0; i < sim->aps; i++)
+            {
+              aps[i].rssi = mean[i] - sim->rssi_jitter +
+                            pmksa_sim_rand(&rng) %
+                            (2 * sim->rssi_jitter + 1);
+              if (aps[i].rssi > aps[best].rssi)
+                {
+                  best = i;
+                }
+            }
+
+          pmksa_sim_connect(sim, supp[0], NULL, aps, best, best, t,
+                            &cost_rng[0], &result->strongest, &ms_sum[0],
+                            &loss_sum[0]);
+
+          pick = esp_wifi_ent_pmksa_select(tab, aps, sim->aps, s_ssid,
+                                           sizeof(s_ssid) - 1, t, NULL);
+          pmksa_sim_connect(sim, supp[1], tab, aps, pick, best, t,
+                            &cost_rng[1], &result->cached, &ms_sum[1],
+                            &loss_sum[1]);
+        }
+    }
+
+  pmksa_sim_finish(&result->strongest, ms_sum[0], loss_sum[0]);
+  pmksa_sim_finish(&result->cached, ms_sum[1], loss_sum[1]);
+
+  esp_wifi_ent_pmksa_delete(supp[0]);
+  esp_wifi_ent_pmksa_delete(supp[1]);
+  esp_wifi_ent_pmksa_delete(tab);
+  return ESP_OK;
+}
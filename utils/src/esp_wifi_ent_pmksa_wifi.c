@@ -0,0 +1,127 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_ent_pmksa.h"
+
+static int64_t pmksa_now_s(void)
+{
+  return esp_timer_get_time() / 1000000;
+}
+
+esp_err_t esp_wifi_ent_pmksa_create(const esp_wifi_ent_pmksa_config_t *cfg,
+                                    esp_wifi_ent_pmksa_t **tab)
+{
+  return esp_wifi_ent_pmksa_alloc(&g_wifi_osi_funcs, cfg, tab);
+}
+
+void esp_wifi_ent_pmksa_event_handler(void *arg, esp_event_base_t base,
+                                      int32_t id, void *data)
+{
+  esp_wifi_ent_pmksa_t *tab = arg;
+  const wifi_event_sta_connected_t *conn;
+  const wifi_event_sta_disconnected_t *disc;
+
+  if (base != WIFI_EVENT)
+    {
+      return;
+    }
+
+  switch (id)
+    {
+      case WIFI_EVENT_STA_CONNECTED:
+        conn = data;
+        if (conn->authmode == WIFI_AUTH_WPA2_ENTERPRISE)
+          {
+            esp_wifi_ent_pmksa_add(tab, conn->ssid, conn->ssid_len,
+                                   conn->bssid, pmksa_now_s());
+          }
+        break;
+
+      case WIFI_EVENT_STA_DISCONNECTED:
+
+        /* The AP or the server no longer accepts the PMKSA, or the
+         * supplicant dropped it after a failed handshake
+         */
+
+        disc = data;
+        switch (disc->reason)
+          {
+            case WIFI_REASON_802_1X_AUTH_FAILED:
+            case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+            case WIFI_REASON_HANDSHAKE_TIMEOUT:
+            case WIFI_REASON_MIC_FAILURE:
+            case WIFI_REASON_INVALID_PMKID:
+              esp_wifi_ent_pmksa_remove(tab, disc->bssid);
+              break;
+
+            default:
+              break;
+          }
+        break;
+
+      case WIFI_EVENT_STA_STOP:
+
+        /* The supplicant cache goes with the station */
+
+        esp_wifi_ent_pmksa_flush(tab);
+        break;
+
+      default:
+        break;
+    }
+}
+
+esp_err_t esp_wifi_ent_pmksa_connect(esp_wifi_ent_pmksa_t *tab,
+                                     const wifi_ap_record_t *aps,
+                                     uint16_t n)
+{
+  wifi_config_t cfg;
+  esp_err_t ret;
+  int i;
+
+  ret = esp_wifi_get_config(WIFI_IF_STA, &cfg);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  i = esp_wifi_ent_pmksa_select(tab, aps, n, cfg.sta.ssid,
+                                strnlen((const char *)cfg.sta.ssid,
+                                        sizeof(cfg.sta.ssid)),
+                                pmksa_now_s(), NULL);
+  if (i >= 0)
+    {
+      cfg.sta.bssid_set = true;
+      memcpy(cfg.sta.bssid, aps[i].bssid, 6);
+      cfg.sta.channel = aps[i].primary;
+    }
+  else
+    {
+      cfg.sta.bssid_set = false;
+    }
+
+  ret = esp_wifi_set_config(WIFI_IF_STA, &cfg);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  return esp_wifi_connect();
+}
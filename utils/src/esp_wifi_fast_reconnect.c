@@ -0,0 +1,569 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_fast_reconnect.h"
+
+/* Provided by libwpa_supplicant.a */
+
+extern int pbkdf2_sha1(const char *passphrase, const uint8_t *ssid,
+                       size_t ssid_len, int iterations, uint8_t *buf,
+                       size_t buflen);
+
+#define PMK_ITERATIONS      4096
+
+static esp_fast_reconnect_record_t s_rec;
+static bool s_rec_valid;
+static bool s_rec_dirty;             /* not stored while s_timer derives */
+static void *s_lock;
+static esp_timer_handle_t s_timer;   /* derives the PMK off the event task */
+static uint8_t s_derive_pass[64];    /* passphrase of the connection */
+
+/* Configuration given by the application, used for the full scan
+ * fallback.
+ */
+
+static wifi_sta_config_t s_sta;
+static bool s_fast;
+static bool s_fast_pmk;              /* the cached PMK is tried */
+static uint8_t s_retry;
+static esp_fast_reconnect_stats_t s_stats;
+
+static bool fr_authmode_has_pmk(uint8_t authmode)
+{
+  return authmode == WIFI_AUTH_WPA_PSK ||
+         authmode == WIFI_AUTH_WPA2_PSK ||
+         authmode == WIFI_AUTH_WPA_WPA2_PSK;
+}
+
+static size_t fr_ssid_len(const uint8_t *ssid)
+{
+  size_t len = 0;
+
+  while (len < 32 && ssid[len] != 0)
+    {
+      len++;
+    }
+
+  return len;
+}
+
+static size_t fr_passphrase_len(const uint8_t *password)
+{
+  size_t len = 0;
+
+  while (len < 64 && password[len] != 0)
+    {
+      len++;
+    }
+
+  return len;
+}
+
+static bool fr_ssid_match(const uint8_t *ssid)
+{
+  size_t len = fr_ssid_len(ssid);
+
+  return s_rec_valid && len == s_rec.ssid_len &&
+         memcmp(ssid, s_rec.ssid, len) == 0;
+}
+
+/* The passphrase is NUL terminated unless it uses all 64 bytes, copy it
+ * out so that pbkdf2_sha1 always gets a C string.
+ */
+
+static void fr_passphrase_pmk(const uint8_t *password,
+                              const uint8_t *ssid, size_t ssid_len,
+                              uint8_t out[32])
+{
+  char pass[65];
+  size_t len = fr_passphrase_len(password);
+
+  memcpy(pass, password, len);
+  pass[len] = 0;
+  pbkdf2_sha1(pass, ssid, ssid_len, PMK_ITERATIONS, out, 32);
+  memset(pass, 0, sizeof(pass));
+}
+
+static esp_err_t fr_store(void)
+{
+  nvs_handle_t handle;
+  esp_err_t ret;
+
+  ret = nvs_open(ESP_FAST_RECONNECT_NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  ret = nvs_set_blob(handle, ESP_FAST_RECONNECT_NVS_KEY, &s_rec,
+                     sizeof(s_rec));
+  if (ret == ESP_OK)
+    {
+      ret = nvs_commit(handle);
+    }
+
+  nvs_close(handle);
+  return ret;
+}
+
+/* Called with s_lock held */
+
+static void fr_on_connected(const wifi_event_sta_connected_t *evt)
+{
+  esp_fast_reconnect_record_t rec;
+  bool derive = false;
+  bool fast_pmk = s_fast_pmk;
+  size_t pass_len;
+  esp_err_t ret;
+
+  if (s_fast)
+    {
+      s_stats.fast_success++;
+    }
+
+  s_fast = false;
+  s_fast_pmk = false;
+  s_retry = 0;
+
+  memset(&rec, 0, sizeof(rec));
+  rec.magic = ESP_FAST_RECONNECT_MAGIC;
+  rec.version = ESP_FAST_RECONNECT_VERSION;
+  rec.ssid_len = evt->ssid_len > 32 ? 32 : evt->ssid_len;
+  memcpy(rec.ssid, evt->ssid, rec.ssid_len);
+  memcpy(rec.bssid, evt->bssid, sizeof(rec.bssid));
+  rec.channel = evt->channel;
+  rec.authmode = evt->authmode;
+
+  /* SAE derives a fresh PMK per association, so only the PSK modes get a
+   * cached PMK. A 64 character password already is a hex PSK.
+   *
+   * Nothing but the PMK itself tells which passphrase it came from. A
+   * handshake done with the cached PMK proves it; after one done with
+   * the passphrase, s_timer derives the PMK again and compares. The
+   * record is stored once it is done.
+   */
+
+  pass_len = fr_passphrase_len(s_sta.password);
+  if (fr_authmode_has_pmk(rec.authmode) && pass_len >= 8 && pass_len < 64)
+    {
+      if (fr_ssid_match(rec.ssid) && s_rec.pmk_valid)
+        {
+          memcpy(rec.pmk, s_rec.pmk, sizeof(rec.pmk));
+          rec.pmk_valid = 1;
+        }
+
+      if (!fast_pmk || !rec.pmk_valid)
+        {
+          /* ESP_ERR_INVALID_STATE: a derivation is pending already, it
+           * picks up the passphrase copied here
+           */
+
+          memcpy(s_derive_pass, s_sta.password, sizeof(s_derive_pass));
+          ret = esp_timer_start_once(s_timer, 0);
+          derive = ret == ESP_OK || ret == ESP_ERR_INVALID_STATE;
+        }
+    }
+
+  /* Avoid flash wear when reconnecting to the same AP */
+
+  if (s_rec_valid && memcmp(&rec, &s_rec, sizeof(rec)) == 0)
+    {
+      return;
+    }
+
+  s_rec = rec;
+  s_rec_valid = true;
+  s_rec_dirty = derive;
+  if (!derive)
+    {
+      fr_store();
+    }
+}
+
+/* Runs on the esp_timer task, so that the event task is not held for the
+ * 4096 rounds. A PMK that differs from the cached one replaces it: the
+ * passphrase changed.
+ */
+
+static void fr_pmk_cb(void *arg)
+{
+  esp_fast_reconnect_record_t rec;
+  uint8_t password[64];
+  uint8_t pmk[32];
+  bool valid;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  rec = s_rec;
+  valid = s_rec_valid && fr_authmode_has_pmk(s_rec.authmode);
+  memcpy(password, s_derive_pass, sizeof(password));
+  memset(s_derive_pass, 0, sizeof(s_derive_pass));
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  if (valid)
+    {
+      fr_passphrase_pmk(password, rec.ssid, rec.ssid_len, pmk);
+    }
+
+  memset(password, 0, sizeof(password));
+  if (!valid)
+    {
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_rec_valid && fr_ssid_match(rec.ssid) &&
+      fr_authmode_has_pmk(s_rec.authmode) &&
+      (!s_rec.pmk_valid || memcmp(s_rec.pmk, pmk, sizeof(pmk)) != 0))
+    {
+      memcpy(s_rec.pmk, pmk, sizeof(pmk));
+      s_rec.pmk_valid = 1;
+      s_rec_dirty = true;
+    }
+
+  if (s_rec_dirty)
+    {
+      s_rec_dirty = false;
+      fr_store();
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+  memset(pmk, 0, sizeof(pmk));
+}
+
+/* Called with s_lock held, the configuration to connect with is left in
+ * cfg for after the lock is released.
+ */
+
+static void fr_fallback(wifi_config_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->sta = s_sta;
+  cfg->sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+  cfg->sta.bssid_set = false;
+  cfg->sta.channel = 0;
+
+  s_fast = false;
+  s_fast_pmk = false;
+  s_retry = 0;
+  s_stats.fallbacks++;
+}
+
+static void fr_on_disconnected(const wifi_event_sta_disconnected_t *evt)
+{
+  wifi_config_t cfg;
+  bool fallback = false;
+  bool retry = false;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_fast)
+    {
+      /* A stale PMK shows up as a handshake failure, there is no point in
+       * retrying it. It is dropped from NVS too, so that the next boot
+       * does not try it again.
+       */
+
+      if (evt->reason == WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT ||
+          evt->reason == WIFI_REASON_HANDSHAKE_TIMEOUT ||
+          evt->reason == WIFI_REASON_AUTH_FAIL ||
+          evt->reason == WIFI_REASON_MIC_FAILURE)
+        {
+          if (s_rec.pmk_valid)
+            {
+              s_rec.pmk_valid = 0;
+              memset(s_rec.pmk, 0, sizeof(s_rec.pmk));
+              fr_store();
+            }
+
+          fallback = true;
+        }
+      else if (++s_retry >= ESP_FAST_RECONNECT_MAX_RETRY)
+        {
+          fallback = true;
+        }
+      else
+        {
+          retry = true;
+        }
+
+      if (fallback)
+        {
+          fr_fallback(&cfg);
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  if (fallback && esp_wifi_set_config(WIFI_IF_STA, &cfg) == ESP_OK)
+    {
+      esp_wifi_connect();
+    }
+  else if (retry)
+    {
+      esp_wifi_connect();
+    }
+}
+
+static esp_err_t fr_load(void)
+{
+  nvs_handle_t handle;
+  size_t len = sizeof(s_rec);
+  esp_err_t ret;
+
+  s_rec_valid = false;
+
+  ret = nvs_open(ESP_FAST_RECONNECT_NVS_NAMESPACE, NVS_READONLY, &handle);
+  if (ret == ESP_ERR_NVS_NOT_FOUND)
+    {
+      return ESP_ERR_NOT_FOUND;
+    }
+  else if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  ret = nvs_get_blob(handle, ESP_FAST_RECONNECT_NVS_KEY, &s_rec, &len);
+  nvs_close(handle);
+
+  if (ret == ESP_ERR_NVS_NOT_FOUND)
+    {
+      return ESP_ERR_NOT_FOUND;
+    }
+  else if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  if (len != sizeof(s_rec) ||
+      s_rec.magic != ESP_FAST_RECONNECT_MAGIC ||
+      s_rec.version != ESP_FAST_RECONNECT_VERSION ||
+      s_rec.ssid_len > 32 ||
+      s_rec.channel == 0 || s_rec.channel > 14)
+    {
+      return ESP_ERR_NOT_FOUND;
+    }
+
+  s_rec_valid = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_fast_reconnect_init(void)
+{
+  esp_timer_create_args_t args =
+  {
+    .callback = fr_pmk_cb,
+    .name = "fast_reconn",
+  };
+
+  esp_err_t ret;
+
+  if (s_lock == NULL)
+    {
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  if (s_timer == NULL)
+    {
+      ret = esp_timer_create(&args, &s_timer);
+      if (ret != ESP_OK)
+        {
+          return ret;
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  ret = fr_load();
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+  return ret;
+}
+
+/* Called with s_lock held. A stale PMK, after the passphrase changed,
+ * fails the handshake, which drops it and falls back to the passphrase.
+ */
+
+static esp_err_t fr_prefill(wifi_sta_config_t *sta, bool *pmk)
+{
+  size_t pass_len = fr_passphrase_len(sta->password);
+  int i;
+
+  *pmk = false;
+
+  if (!fr_ssid_match(sta->ssid))
+    {
+      return ESP_ERR_NOT_FOUND;
+    }
+
+  sta->scan_method = WIFI_FAST_SCAN;
+  sta->bssid_set = true;
+  memcpy(sta->bssid, s_rec.bssid, sizeof(sta->bssid));
+  sta->channel = s_rec.channel;
+
+  if (!s_rec.pmk_valid || !fr_authmode_has_pmk(s_rec.authmode) ||
+      pass_len < 8 || pass_len >= 64)
+    {
+      return ESP_OK;
+    }
+
+  *pmk = true;
+  for (i = 0; i < 32; i++)
+    {
+      static const char hex[] = "0123456789abcdef";
+
+      sta->password[i * 2] = hex[s_rec.pmk[i] >> 4];
+      sta->password[i * 2 + 1] = hex[s_rec.pmk[i] & 0xf];
+    }
+
+  return ESP_OK;
+}
+
+esp_err_t esp_fast_reconnect_prefill(wifi_sta_config_t *sta)
+{
+  esp_err_t ret;
+  bool pmk;
+
+  if (sta == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  ret = fr_prefill(sta, &pmk);
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+  return ret;
+}
+
+esp_err_t esp_fast_reconnect_connect(const wifi_sta_config_t *sta)
+{
+  wifi_config_t cfg;
+  esp_err_t ret;
+
+  if (sta == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.sta = *sta;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  s_sta = *sta;
+  s_retry = 0;
+  s_fast = fr_prefill(&cfg.sta, &s_fast_pmk) == ESP_OK;
+  if (s_fast)
+    {
+      s_stats.fast_attempts++;
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  ret = esp_wifi_set_config(WIFI_IF_STA, &cfg);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  return esp_wifi_connect();
+}
+
+void esp_fast_reconnect_event_handler(void *arg, esp_event_base_t base,
+                                      int32_t id, void *data)
+{
+  if (base != WIFI_EVENT || data == NULL || s_lock == NULL)
+    {
+      return;
+    }
+
+  switch (id)
+    {
+      case WIFI_EVENT_STA_CONNECTED:
+        g_wifi_osi_funcs._mutex_lock(s_lock);
+        fr_on_connected(data);
+        g_wifi_osi_funcs._mutex_unlock(s_lock);
+        break;
+
+      case WIFI_EVENT_STA_DISCONNECTED:
+        fr_on_disconnected(data);
+        break;
+
+      default:
+        break;
+    }
+}
+
+esp_err_t esp_fast_reconnect_erase(void)
+{
+  nvs_handle_t handle;
+  esp_err_t ret;
+
+  if (s_lock == NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  memset(&s_rec, 0, sizeof(s_rec));
+  s_rec_valid = false;
+  s_rec_dirty = false;
+
+  ret = nvs_open(ESP_FAST_RECONNECT_NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (ret == ESP_OK)
+    {
+      ret = nvs_erase_key(handle, ESP_FAST_RECONNECT_NVS_KEY);
+      if (ret == ESP_OK)
+        {
+          ret = nvs_commit(handle);
+        }
+
+      nvs_close(handle);
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+  return ret == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : ret;
+}
+
+esp_err_t esp_fast_reconnect_get_stats(esp_fast_reconnect_stats_t *stats)
+{
+  if (stats == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  *stats = s_stats;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+  return ESP_OK;
+}
@@ -0,0 +1,125 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_wifi_fast_reconnect.h"
+
+static uint32_t fr_sim_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static void fr_sim_add(esp_fast_reconnect_sim_stat_t *stat, uint64_t *sum,
+                       uint32_t ms)
+{
+  *sum += ms;
+  if (stat->min_ms == 0 || ms < stat->min_ms)
+    {
+      stat->min_ms = ms;
+    }
+
+  if (ms > stat->max_ms)
+    {
+      stat->max_ms = ms;
+    }
+}
+
+void esp_fast_reconnect_sim_default(esp_fast_reconnect_sim_t *sim)
+{
+  memset(sim, 0, sizeof(*sim));
+  sim->boots = 1000;
+  sim->channels = 13;
+  sim->dwell_ms = 120;
+  sim->pbkdf2_ms = 400;
+  sim->connect_ms = 60;
+  sim->moved_permille = 20;
+  sim->rekey_permille = 10;
+  sim->seed = 1;
+}
+
+esp_err_t esp_fast_reconnect_sim_run(const esp_fast_reconnect_sim_t *sim,
+                                     esp_fast_reconnect_sim_result_t *result)
+{
+  uint64_t sum[2] =
+  {
+    0, 0
+  };
+
+  uint32_t rng;
+  uint32_t full;
+  uint32_t ms;
+  uint32_t i;
+  bool record = false;
+  bool moved;
+  bool rekey;
+
+  if (sim == NULL || result == NULL || sim->boots == 0 ||
+      sim->channels == 0 || sim->moved_permille > 1000 ||
+      sim->rekey_permille > 1000)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  memset(result, 0, sizeof(*result));
+  rng = sim->seed ? sim->seed : 1;
+  full = sim->channels * sim->dwell_ms + sim->pbkdf2_ms + sim->connect_ms;
+
+  for (i = 0; i < sim->boots; i++)
+    {
+      moved = fr_sim_rand(&rng) % 1000 < sim->moved_permille;
+      rekey = fr_sim_rand(&rng) % 1000 < sim->rekey_permille;
+
+      fr_sim_add(&result->baseline, &sum[0], full);
+
+      /* The fallback connects with the passphrase as given, so the
+       * supplicant runs PBKDF2 again. After a new passphrase the PMK of
+       * the record fails the handshake of the first fast attempt.
+       */
+
+      if (!record)
+        {
+          ms = full;
+          record = true;
+        }
+      else if (moved)
+        {
+          ms = ESP_FAST_RECONNECT_MAX_RETRY * sim->dwell_ms + full;
+          result->fallbacks++;
+        }
+      else if (rekey)
+        {
+          ms = sim->dwell_ms + sim->connect_ms + full;
+          result->fallbacks++;
+        }
+      else
+        {
+          ms = sim->dwell_ms + sim->connect_ms;
+          result->pmk_hits++;
+          result->fast_success++;
+        }
+
+      fr_sim_add(&result->cached, &sum[1], ms);
+    }
+
+  result->baseline.avg_ms = sum[0] / sim->boots;
+  result->cached.avg_ms = sum[1] / sim->boots;
+  return ESP_OK;
+}
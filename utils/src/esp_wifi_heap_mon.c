@@ -0,0 +1,549 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_heap_mon.h"
+
+struct heap_mon_block
+{
+  void *ptr;
+  uint32_t size;
+  uint32_t cb;
+};
+
+static wifi_osi_funcs_t *s_osi;
+static wifi_osi_funcs_t s_orig;
+static esp_wifi_heap_mon_config_t s_cfg;
+static void *s_mux;
+static esp_timer_handle_t s_timer;
+
+/* Open addressing with linear probing, deletions shift the following
+ * entries back so that no tombstones are left behind.
+ */
+
+static struct heap_mon_block *s_table;
+static uint32_t s_mask;
+static uint32_t s_used;
+
+static esp_wifi_heap_snapshot_t s_mon;
+static esp_wifi_heap_phase_t s_scan_return;
+
+static uint32_t heap_mon_slot(const void *ptr)
+{
+  return (uint32_t)(((uintptr_t)ptr >> 3) * 2654435761u) & s_mask;
+}
+
+static void heap_mon_add(esp_wifi_heap_cb_t cb, void *ptr, size_t size)
+{
+  esp_wifi_heap_cb_stats_t *st = &s_mon.cb[cb];
+  esp_wifi_heap_phase_stats_t *ph;
+  uint32_t tmp;
+  uint32_t i;
+
+  tmp = s_osi->_wifi_int_disable(s_mux);
+
+  if (ptr == NULL)
+    {
+      st->fails++;
+      s_osi->_wifi_int_restore(s_mux, tmp);
+      return;
+    }
+
+  st->allocs++;
+
+  /* Keep a quarter of the table free for short probe sequences */
+
+  if (s_used >= s_mask - s_mask / 4)
+    {
+      s_mon.untracked++;
+      s_osi->_wifi_int_restore(s_mux, tmp);
+      return;
+    }
+
+  for (i = heap_mon_slot(ptr); s_table[i].ptr != NULL; i = (i + 1) & s_mask)
+    {
+    }
+
+  s_table[i].ptr = ptr;
+  s_table[i].size = size;
+  s_table[i].cb = cb;
+  s_used++;
+
+  st->live_bytes += size;
+  st->live_count++;
+  if (st->live_bytes > st->peak_bytes)
+    {
+      st->peak_bytes = st->live_bytes;
+    }
+
+  s_mon.live_bytes += size;
+  if (s_mon.live_bytes > s_mon.peak_bytes)
+    {
+      s_mon.peak_bytes = s_mon.live_bytes;
+    }
+
+  ph = &s_mon.phase[s_mon.cur_phase];
+  if (s_mon.live_bytes > ph->peak_bytes)
+    {
+      ph->peak_bytes = s_mon.live_bytes;
+    }
+
+  s_osi->_wifi_int_restore(s_mux, tmp);
+}
+
+static bool heap_mon_remove(void *ptr, struct heap_mon_block *out)
+{
+  esp_wifi_heap_cb_stats_t *st;
+  uint32_t tmp;
+  uint32_t i;
+  uint32_t j;
+  uint32_t k;
+
+  tmp = s_osi->_wifi_int_disable(s_mux);
+
+  for (i = heap_mon_slot(ptr); s_table[i].ptr != ptr; i = (i + 1) & s_mask)
+    {
+      if (s_table[i].ptr == NULL)
+        {
+          s_osi->_wifi_int_restore(s_mux, tmp);
+          return false;
+        }
+    }
+
+  *out = s_table[i];
+  st = &s_mon.cb[out->cb];
+  st->live_bytes -= out->size;
+  st->live_count--;
+  s_mon.live_bytes -= out->size;
+  s_used--;
+
+  /* Move back the entries whose probe sequence crosses the hole */
+
+  for (j = (i + 1) & s_mask; s_table[j].ptr != NULL; j = (j + 1) & s_mask)
+    {
+      k = heap_mon_slot(s_table[j].ptr);
+      if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j))
+        {
+          s_table[i] = s_table[j];
+          i = j;
+        }
+    }
+
+  s_table[i].ptr = NULL;
+
+  s_osi->_wifi_int_restore(s_mux, tmp);
+  return true;
+}
+
+static void *heap_mon_realloc(esp_wifi_heap_cb_t cb,
+                              void *(*fn)(void *, size_t),
+                              void *ptr, size_t size)
+{
+  struct heap_mon_block old;
+  bool tracked = false;
+  void *p;
+
+  /* Untrack first, the block may be handed out again once moved */
+
+  if (ptr != NULL)
+    {
+      tracked = heap_mon_remove(ptr, &old);
+    }
+
+  p = fn(ptr, size);
+  if (p == NULL && size != 0)
+    {
+      if (tracked)
+        {
+          heap_mon_add(old.cb, ptr, old.size);
+        }
+
+      heap_mon_add(cb, NULL, size);
+      return NULL;
+    }
+
+  if (p != NULL)
+    {
+      heap_mon_add(cb, p, size);
+    }
+
+  return p;
+}
+
+static void *heap_mon_malloc(unsigned int size)
+{
+  void *p = s_orig._malloc(size);
+
+  heap_mon_add(ESP_WIFI_HEAP_MALLOC, p, size);
+  return p;
+}
+
+static void heap_mon_free(void *p)
+{
+  struct heap_mon_block old;
+
+  if (p != NULL)
+    {
+      heap_mon_remove(p, &old);
+    }
+
+  s_orig._free(p);
+}
+
+static void *heap_mon_malloc_internal(size_t size)
+{
+  void *p = s_orig._malloc_internal(size);
+
+  heap_mon_add(ESP_WIFI_HEAP_MALLOC_INTERNAL, p, size);
+  return p;
+}
+
+static void *heap_mon_zalloc_internal(size_t size)
+{
+  void *p = s_orig._zalloc_internal(size);
+
+  heap_mon_add(ESP_WIFI_HEAP_MALLOC_INTERNAL, p, size);
+  return p;
+}
+
+static void *heap_mon_calloc_internal(size_t n, size_t size)
+{
+  void *p = s_orig._calloc_internal(n, size);
+
+  heap_mon_add(ESP_WIFI_HEAP_CALLOC_INTERNAL, p, n * size);
+  return p;
+}
+
+static void *heap_mon_realloc_internal(void *ptr, size_t size)
+{
+  return heap_mon_realloc(ESP_WIFI_HEAP_REALLOC_INTERNAL,
+                          s_orig._realloc_internal, ptr, size);
+}
+
+static void *heap_mon_wifi_malloc(size_t size)
+{
+  void *p = s_orig._wifi_malloc(size);
+
+  heap_mon_add(ESP_WIFI_HEAP_WIFI_MALLOC, p, size);
+  return p;
+}
+
+static void *heap_mon_wifi_zalloc(size_t size)
+{
+  void *p = s_orig._wifi_zalloc(size);
+
+  heap_mon_add(ESP_WIFI_HEAP_WIFI_MALLOC, p, size);
+  return p;
+}
+
+static void *heap_mon_wifi_calloc(size_t n, size_t size)
+{
+  void *p = s_orig._wifi_calloc(n, size);
+
+  heap_mon_add(ESP_WIFI_HEAP_WIFI_CALLOC, p, n * size);
+  return p;
+}
+
+static void *heap_mon_wifi_realloc(void *ptr, size_t size)
+{
+  return heap_mon_realloc(ESP_WIFI_HEAP_WIFI_REALLOC,
+                          s_orig._wifi_realloc, ptr, size);
+}
+
+static void heap_mon_timer_cb(void *arg)
+{
+  esp_wifi_heap_mon_sample();
+}
+
+static void heap_mon_reset_phase(esp_wifi_heap_phase_stats_t *ph)
+{
+  ph->peak_bytes = s_mon.live_bytes;
+  ph->min_free = UINT32_MAX;
+  ph->min_largest = UINT32_MAX;
+  ph->max_frag_permille = 0;
+}
+
+void esp_wifi_heap_mon_default(esp_wifi_heap_mon_config_t *cfg)
+{
+  cfg->table_size = 1024;
+  cfg->sample_period_ms = 1000;
+  cfg->largest_free_block = NULL;
+}
+
+esp_err_t esp_wifi_heap_mon_install(wifi_osi_funcs_t *osi,
+                                    const esp_wifi_heap_mon_config_t *cfg)
+{
+  esp_timer_create_args_t args =
+  {
+    .callback = heap_mon_timer_cb,
+    .name = "wifi_heap_mon",
+  };
+
+  esp_err_t ret;
+  int i;
+
+  if (cfg == NULL || cfg->table_size < 16 ||
+      (cfg->table_size & (cfg->table_size - 1)) != 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_osi != NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  if (osi == NULL)
+    {
+      osi = &g_wifi_osi_funcs;
+    }
+
+  s_table = osi->_malloc(cfg->table_size * sizeof(*s_table));
+  s_mux = osi->_spin_lock_create();
+  if (s_table == NULL || s_mux == NULL)
+    {
+      osi->_free(s_table);
+      s_table = NULL;
+      if (s_mux)
+        {
+          osi->_spin_lock_delete(s_mux);
+          s_mux = NULL;
+        }
+
+      return ESP_ERR_NO_MEM;
+    }
+
+  memset(s_table, 0, cfg->table_size * sizeof(*s_table));
+  s_mask = cfg->table_size - 1;
+  s_used = 0;
+  s_cfg = *cfg;
+
+  memset(&s_mon, 0, sizeof(s_mon));
+  for (i = 0; i < ESP_WIFI_HEAP_PHASE_MAX; i++)
+    {
+      heap_mon_reset_phase(&s_mon.phase[i]);
+    }
+
+  s_mon.phase[ESP_WIFI_HEAP_PHASE_IDLE].entries = 1;
+
+  s_orig = *osi;
+  s_osi = osi;
+
+  osi->_malloc = heap_mon_malloc;
+  osi->_free = heap_mon_free;
+  osi->_malloc_internal = heap_mon_malloc_internal;
+  osi->_zalloc_internal = heap_mon_zalloc_internal;
+  osi->_calloc_internal = heap_mon_calloc_internal;
+  osi->_realloc_internal = heap_mon_realloc_internal;
+  osi->_wifi_malloc = heap_mon_wifi_malloc;
+  osi->_wifi_zalloc = heap_mon_wifi_zalloc;
+  osi->_wifi_calloc = heap_mon_wifi_calloc;
+  osi->_wifi_realloc = heap_mon_wifi_realloc;
+
+  esp_wifi_heap_mon_sample();
+
+  if (cfg->sample_period_ms == 0)
+    {
+      return ESP_OK;
+    }
+
+  ret = esp_timer_create(&args, &s_timer);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  return esp_timer_start_periodic(s_timer,
+                                  (uint64_t)cfg->sample_period_ms * 1000);
+}
+
+void esp_wifi_heap_mon_sample(void)
+{
+  esp_wifi_heap_phase_stats_t *ph;
+  uint32_t free_heap;
+  uint32_t largest = 0;
+  uint32_t frag = 0;
+  uint32_t tmp;
+
+  if (s_osi == NULL)
+    {
+      return;
+    }
+
+  free_heap = s_orig._get_free_heap_size();
+  if (s_cfg.largest_free_block)
+    {
+      largest = s_cfg.largest_free_block();
+      if (free_heap != 0 && largest <= free_heap)
+        {
+          frag = 1000 - (uint32_t)((uint64_t)largest * 1000 / free_heap);
+        }
+    }
+
+  tmp = s_osi->_wifi_int_disable(s_mux);
+
+  s_mon.free_heap = free_heap;
+  s_mon.largest_free = largest;
+  s_mon.frag_permille = frag;
+
+  ph = &s_mon.phase[s_mon.cur_phase];
+  if (free_heap < ph->min_free)
+    {
+      ph->min_free = free_heap;
+    }
+
+  if (s_cfg.largest_free_block && largest < ph->min_largest)
+    {
+      ph->min_largest = largest;
+    }
+
+  if (frag > ph->max_frag_permille)
+    {
+      ph->max_frag_permille = frag;
+    }
+
+  s_osi->_wifi_int_restore(s_mux, tmp);
+}
+
+void esp_wifi_heap_mon_set_phase(esp_wifi_heap_phase_t phase)
+{
+  uint32_t tmp;
+
+  if (s_osi == NULL || phase >= ESP_WIFI_HEAP_PHASE_MAX)
+    {
+      return;
+    }
+
+  tmp = s_osi->_wifi_int_disable(s_mux);
+
+  if (phase == ESP_WIFI_HEAP_PHASE_SCAN &&
+      s_mon.cur_phase != ESP_WIFI_HEAP_PHASE_SCAN)
+    {
+      s_scan_return = s_mon.cur_phase;
+    }
+
+  if (phase != s_mon.cur_phase)
+    {
+      s_mon.cur_phase = phase;
+      s_mon.phase[phase].entries++;
+      if (s_mon.live_bytes > s_mon.phase[phase].peak_bytes)
+        {
+          s_mon.phase[phase].peak_bytes = s_mon.live_bytes;
+        }
+    }
+
+  s_osi->_wifi_int_restore(s_mux, tmp);
+
+  esp_wifi_heap_mon_sample();
+}
+
+void esp_wifi_heap_mon_event_handler(void *arg, esp_event_base_t base,
+                                     int32_t id, void *data)
+{
+  switch (id)
+    {
+      case WIFI_EVENT_SCAN_DONE:
+        if (s_mon.cur_phase == ESP_WIFI_HEAP_PHASE_SCAN)
+          {
+            esp_wifi_heap_mon_set_phase(s_scan_return);
+          }
+        break;
+
+      case WIFI_EVENT_STA_START:
+      case WIFI_EVENT_STA_DISCONNECTED:
+        esp_wifi_heap_mon_set_phase(ESP_WIFI_HEAP_PHASE_CONNECT);
+        break;
+
+      case WIFI_EVENT_STA_CONNECTED:
+        esp_wifi_heap_mon_set_phase(ESP_WIFI_HEAP_PHASE_CONNECTED);
+        break;
+
+      case WIFI_EVENT_AP_START:
+        esp_wifi_heap_mon_set_phase(ESP_WIFI_HEAP_PHASE_AP);
+        break;
+
+      case WIFI_EVENT_STA_STOP:
+      case WIFI_EVENT_AP_STOP:
+        esp_wifi_heap_mon_set_phase(ESP_WIFI_HEAP_PHASE_IDLE);
+        break;
+
+      default:
+        break;
+    }
+}
+
+esp_err_t esp_wifi_heap_mon_snapshot(esp_wifi_heap_snapshot_t *snap)
+{
+  uint32_t tmp;
+  int i;
+
+  if (s_osi == NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  esp_wifi_heap_mon_sample();
+
+  tmp = s_osi->_wifi_int_disable(s_mux);
+  *snap = s_mon;
+  s_osi->_wifi_int_restore(s_mux, tmp);
+
+  /* Phases never sampled report 0 */
+
+  for (i = 0; i < ESP_WIFI_HEAP_PHASE_MAX; i++)
+    {
+      if (snap->phase[i].min_free == UINT32_MAX)
+        {
+          snap->phase[i].min_free = 0;
+        }
+
+      if (snap->phase[i].min_largest == UINT32_MAX)
+        {
+          snap->phase[i].min_largest = 0;
+        }
+    }
+
+  return ESP_OK;
+}
+
+void esp_wifi_heap_mon_reset_peaks(void)
+{
+  uint32_t tmp;
+  int i;
+
+  if (s_osi == NULL)
+    {
+      return;
+    }
+
+  tmp = s_osi->_wifi_int_disable(s_mux);
+
+  s_mon.peak_bytes = s_mon.live_bytes;
+  for (i = 0; i < ESP_WIFI_HEAP_CB_MAX; i++)
+    {
+      s_mon.cb[i].peak_bytes = s_mon.cb[i].live_bytes;
+    }
+
+  for (i = 0; i < ESP_WIFI_HEAP_PHASE_MAX; i++)
+    {
+      heap_mon_reset_phase(&s_mon.phase[i]);
+    }
+
+  s_osi->_wifi_int_restore(s_mux, tmp);
+}
@@ -0,0 +1,233 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_idle.h"
+
+#define IDLE_NODES          (ESP_WIFI_IDLE_AID_MAX + 1)
+
+/* A client is its AID, 0 ends a list. Tick cur is the next swept, it
+ * starts at cur_ms, and a client is filed at or before the tick its
+ * timeout ends in: the sweep of that tick expires it or files it again.
+ */
+
+struct esp_wifi_idle
+{
+  esp_wifi_idle_config_t cfg;
+  uint32_t cur;
+  uint32_t cur_ms;
+  uint16_t count;
+  uint8_t head[ESP_WIFI_IDLE_SLOTS];
+  uint8_t slot[IDLE_NODES];
+  uint8_t next[IDLE_NODES];
+  uint8_t prev[IDLE_NODES];
+  uint32_t last_ms[IDLE_NODES];
+  uint32_t timeout_ms[IDLE_NODES];       /* 0 when not tracked */
+};
+
+static void idle_link(esp_wifi_idle_t *idle, uint8_t aid, uint8_t s)
+{
+  idle->slot[aid] = s;
+  idle->prev[aid] = 0;
+  idle->next[aid] = idle->head[s];
+  if (idle->head[s])
+    {
+      idle->prev[idle->head[s]] = aid;
+    }
+
+  idle->head[s] = aid;
+}
+
+static void idle_unlink(esp_wifi_idle_t *idle, uint8_t aid)
+{
+  if (idle->prev[aid])
+    {
+      idle->next[idle->prev[aid]] = idle->next[aid];
+    }
+  else
+    {
+      idle->head[idle->slot[aid]] = idle->next[aid];
+    }
+
+  if (idle->next[aid])
+    {
+      idle->prev[idle->next[aid]] = idle->prev[aid];
+    }
+}
+
+/* File by the tick the timeout ends in, relative to the cursor so that
+ * the wrap of the millisecond clock does no harm
+ */
+
+static void idle_file(esp_wifi_idle_t *idle, uint8_t aid)
+{
+  uint32_t ahead = idle->last_ms[aid] + idle->timeout_ms[aid] -
+                   idle->cur_ms;
+
+  if ((int32_t)ahead < 0)
+    {
+      ahead = 0;
+    }
+
+  idle_link(idle, aid,
+            (idle->cur + ahead / idle->cfg.tick_ms) % ESP_WIFI_IDLE_SLOTS);
+}
+
+void esp_wifi_idle_default(esp_wifi_idle_config_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->tick_ms = 1000;
+  cfg->timeout_s = 300;
+}
+
+esp_err_t esp_wifi_idle_create(const esp_wifi_idle_config_t *cfg,
+                               uint32_t now_ms, esp_wifi_idle_t **idle)
+{
+  esp_wifi_idle_t *t;
+
+  if (cfg == NULL || idle == NULL || cfg->tick_ms == 0 ||
+      cfg->timeout_s == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  t = calloc(1, sizeof(*t));
+  if (t == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  t->cfg = *cfg;
+  t->cur_ms = now_ms;
+  *idle = t;
+  return ESP_OK;
+}
+
+void esp_wifi_idle_delete(esp_wifi_idle_t *idle)
+{
+  free(idle);
+}
+
+esp_err_t esp_wifi_idle_add(esp_wifi_idle_t *idle, uint16_t aid,
+                            uint32_t timeout_s, uint32_t now_ms)
+{
+  if (aid == 0 || aid > ESP_WIFI_IDLE_AID_MAX)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  /* Filed again, a shorter timeout may end before its tick */
+
+  if (idle->timeout_ms[aid])
+    {
+      idle_unlink(idle, aid);
+    }
+  else
+    {
+      idle->count++;
+    }
+
+  idle->timeout_ms[aid] = (timeout_s ? timeout_s : idle->cfg.timeout_s) *
+                          1000;
+  idle->last_ms[aid] = now_ms;
+  idle_file(idle, aid);
+  return ESP_OK;
+}
+
+void esp_wifi_idle_remove(esp_wifi_idle_t *idle, uint16_t aid)
+{
+  if (aid == 0 || aid > ESP_WIFI_IDLE_AID_MAX || !idle->timeout_ms[aid])
+    {
+      return;
+    }
+
+  idle_unlink(idle, aid);
+  idle->timeout_ms[aid] = 0;
+  idle->count--;
+}
+
+void esp_wifi_idle_touch(esp_wifi_idle_t *idle, uint16_t aid,
+                         uint32_t now_ms)
+{
+  if (aid <= ESP_WIFI_IDLE_AID_MAX && idle->timeout_ms[aid])
+    {
+      idle->last_ms[aid] = now_ms;
+    }
+}
+
+size_t esp_wifi_idle_sweep(esp_wifi_idle_t *idle, uint32_t now_ms,
+                           uint16_t *aids, size_t max)
+{
+  size_t n = 0;
+  uint8_t s;
+  uint8_t a;
+  uint8_t h;
+
+  /* A tick is swept once over, every timeout in it has ended */
+
+  while (now_ms - idle->cur_ms >= idle->cfg.tick_ms &&
+         (int32_t)(now_ms - idle->cur_ms) > 0)
+    {
+      s = idle->cur % ESP_WIFI_IDLE_SLOTS;
+      h = idle->head[s];
+      idle->head[s] = 0;
+      while (h)
+        {
+          a = h;
+          h = idle->next[a];
+          if ((int32_t)(now_ms - idle->last_ms[a] -
+                        idle->timeout_ms[a]) < 0)
+            {
+              idle_file(idle, a);
+              continue;
+            }
+
+          if (n == max)
+            {
+              /* The rest of the tick goes to the next sweep */
+
+              idle_link(idle, a, s);
+              continue;
+            }
+
+          idle->timeout_ms[a] = 0;
+          idle->count--;
+          aids[n++] = a;
+        }
+
+      if (idle->head[s] && n == max)
+        {
+          break;
+        }
+
+      idle->cur++;
+      idle->cur_ms += idle->cfg.tick_ms;
+    }
+
+  return n;
+}
+
+uint16_t esp_wifi_idle_count(const esp_wifi_idle_t *idle)
+{
+  return idle->count;
+}
+
+uint32_t esp_wifi_idle_tick_ms(const esp_wifi_idle_t *idle)
+{
+  return idle->cfg.tick_ms;
+}
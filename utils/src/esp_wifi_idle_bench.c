@@ -0,0 +1,247 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_wifi_idle.h"
+
+#define IDLE_BENCH_NODES    (ESP_WIFI_IDLE_AID_MAX + 1)
+
+/* One timer per station, a list sorted by deadline as esp_timer keeps
+ * its alarms: a restart unlinks the timer and inserts it again from the
+ * head
+ */
+
+struct idle_bench_timers
+{
+  uint8_t head;
+  uint8_t next[IDLE_BENCH_NODES];
+  uint8_t prev[IDLE_BENCH_NODES];
+  bool armed[IDLE_BENCH_NODES];
+  uint32_t alarm_ms[IDLE_BENCH_NODES];
+  uint32_t timeout_ms[IDLE_BENCH_NODES];
+};
+
+static uint32_t idle_bench_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static void idle_bench_unlink(struct idle_bench_timers *t, uint8_t a)
+{
+  if (t->prev[a])
+    {
+      t->next[t->prev[a]] = t->next[a];
+    }
+  else
+    {
+      t->head = t->next[a];
+    }
+
+  if (t->next[a])
+    {
+      t->prev[t->next[a]] = t->prev[a];
+    }
+
+  t->armed[a] = false;
+}
+
+static void __attribute__((noinline))
+idle_bench_restart(struct idle_bench_timers *t, uint8_t a, uint32_t now_ms)
+{
+  uint8_t p = 0;
+  uint8_t n;
+
+  if (t->armed[a])
+    {
+      idle_bench_unlink(t, a);
+    }
+
+  t->alarm_ms[a] = now_ms + t->timeout_ms[a];
+  for (n = t->head; n && t->alarm_ms[n] <= t->alarm_ms[a]; n = t->next[n])
+    {
+      p = n;
+    }
+
+  t->prev[a] = p;
+  t->next[a] = n;
+  if (p)
+    {
+      t->next[p] = a;
+    }
+  else
+    {
+      t->head = a;
+    }
+
+  if (n)
+    {
+      t->prev[n] = a;
+    }
+
+  t->armed[a] = true;
+}
+
+static uint32_t idle_bench_fire(struct idle_bench_timers *t,
+                                uint32_t now_ms)
+{
+  uint32_t fired = 0;
+
+  while (t->head && t->alarm_ms[t->head] <= now_ms)
+    {
+      idle_bench_unlink(t, t->head);
+      fired++;
+    }
+
+  return fired;
+}
+
+static uint32_t idle_bench_ns(clock_t cpu, uint32_t n)
+{
+  return (uint32_t)((double)cpu * 1e9 / CLOCKS_PER_SEC / n);
+}
+
+/* Station of touch k, the silent ones left out in the second half */
+
+static uint8_t idle_bench_station(uint32_t *rng, uint16_t stations,
+                                  bool second_half)
+{
+  uint8_t a;
+
+  do
+    {
+      a = idle_bench_rand(rng) % stations + 1;
+    }
+  while (second_half && a % 8 == 0);
+
+  return a;
+}
+
+esp_err_t esp_wifi_idle_bench(uint16_t stations, uint32_t seconds,
+                              uint32_t touches_per_s, uint32_t seed,
+                              esp_wifi_idle_bench_t *result)
+{
+  static struct idle_bench_timers timers;
+  uint16_t aids[ESP_WIFI_IDLE_AID_MAX];
+  esp_wifi_idle_config_t cfg;
+  esp_wifi_idle_t *idle[2];
+  uint32_t touches;
+  uint32_t sweep_ms;
+  uint32_t now_ms;
+  uint32_t rng;
+  uint32_t k;
+  clock_t cpu[2];
+  clock_t c0;
+  uint8_t a;
+  int run;
+  esp_err_t ret;
+
+  if (result == NULL || stations == 0 ||
+      stations > ESP_WIFI_IDLE_AID_MAX || touches_per_s == 0 ||
+      seconds == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  esp_wifi_idle_default(&cfg);
+  memset(result, 0, sizeof(*result));
+  memset(&timers, 0, sizeof(timers));
+  touches = touches_per_s * seconds;
+  result->stations = stations;
+  result->touches = touches;
+
+  /* Swept every tick, then touched alone */
+
+  for (run = 0; run < 2; run++)
+    {
+      ret = esp_wifi_idle_create(&cfg, 0, &idle[run]);
+      if (ret != ESP_OK)
+        {
+          if (run)
+            {
+              esp_wifi_idle_delete(idle[0]);
+            }
+
+          return ret;
+        }
+
+      rng = seed ? seed : 1;
+      for (a = 1; a <= stations; a++)
+        {
+          esp_wifi_idle_add(idle[run], a,
+                            60 + idle_bench_rand(&rng) % 241, 0);
+        }
+
+      sweep_ms = cfg.tick_ms;
+      c0 = clock();
+      for (k = 0; k < touches; k++)
+        {
+          now_ms = (uint64_t)k * 1000 / touches_per_s;
+          if (run == 0 && now_ms >= sweep_ms)
+            {
+              sweep_ms += cfg.tick_ms;
+              result->expired += esp_wifi_idle_sweep(idle[0], now_ms, aids,
+                                                     ESP_WIFI_IDLE_AID_MAX);
+            }
+
+          a = idle_bench_station(&rng, stations, k >= touches / 2);
+          esp_wifi_idle_touch(idle[run], a, now_ms);
+        }
+
+      cpu[run] = clock() - c0;
+    }
+
+  result->expired += esp_wifi_idle_sweep(idle[0], seconds * 1000, aids,
+                                         ESP_WIFI_IDLE_AID_MAX);
+  result->wheel_ns = idle_bench_ns(cpu[0], touches);
+  result->touch_ns = idle_bench_ns(cpu[1], touches);
+
+  /* The same traffic on the timers */
+
+  rng = seed ? seed : 1;
+  for (a = 1; a <= stations; a++)
+    {
+      timers.timeout_ms[a] = (60 + idle_bench_rand(&rng) % 241) * 1000;
+      idle_bench_restart(&timers, a, 0);
+    }
+
+  c0 = clock();
+  for (k = 0; k < touches; k++)
+    {
+      now_ms = (uint64_t)k * 1000 / touches_per_s;
+      result->timer_expired += idle_bench_fire(&timers, now_ms);
+      a = idle_bench_station(&rng, stations, k >= touches / 2);
+      if (timers.timeout_ms[a] && !timers.armed[a])
+        {
+          continue;
+        }
+
+      idle_bench_restart(&timers, a, now_ms);
+    }
+
+  result->restart_ns = idle_bench_ns(clock() - c0, touches);
+  result->timer_expired += idle_bench_fire(&timers, seconds * 1000);
+
+  esp_wifi_idle_delete(idle[0]);
+  esp_wifi_idle_delete(idle[1]);
+  return ESP_OK;
+}
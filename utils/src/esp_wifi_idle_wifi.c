@@ -0,0 +1,198 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_idle.h"
+
+#define IDLE_BATCH          16           /* AIDs expired per sweep call */
+
+static esp_wifi_idle_t *s_idle;
+static esp_wifi_idle_cb_t s_cb;
+static void *s_arg;
+static void *s_lock;
+static esp_timer_handle_t s_timer;
+
+static uint32_t idle_now_ms(void)
+{
+  return esp_timer_get_time() / 1000;
+}
+
+static void idle_timer_cb(void *arg)
+{
+  uint16_t aids[IDLE_BATCH];
+  esp_wifi_idle_cb_t cb;
+  void *cb_arg;
+  size_t n;
+  size_t i;
+
+  do
+    {
+      n = 0;
+      g_wifi_osi_funcs._mutex_lock(s_lock);
+      if (s_idle)
+        {
+          n = esp_wifi_idle_sweep(s_idle, idle_now_ms(), aids, IDLE_BATCH);
+        }
+
+      cb = s_cb;
+      cb_arg = s_arg;
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+      for (i = 0; i < n; i++)
+        {
+          esp_wifi_deauth_sta(aids[i]);
+          if (cb)
+            {
+              cb(cb_arg, aids[i]);
+            }
+        }
+    }
+  while (n == IDLE_BATCH);
+}
+
+static void idle_event_handler(void *arg, esp_event_base_t base,
+                               int32_t id, void *data)
+{
+  const wifi_event_ap_staconnected_t *conn;
+  const wifi_event_ap_stadisconnected_t *disc;
+  uint16_t aid;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_idle == NULL)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return;
+    }
+
+  switch (id)
+    {
+      case WIFI_EVENT_AP_STACONNECTED:
+        conn = data;
+        esp_wifi_idle_add(s_idle, conn->aid, 0, idle_now_ms());
+        break;
+
+      case WIFI_EVENT_AP_STADISCONNECTED:
+        disc = data;
+        esp_wifi_idle_remove(s_idle, disc->aid);
+        break;
+
+      case WIFI_EVENT_AP_STOP:
+        for (aid = 1; aid <= ESP_WIFI_IDLE_AID_MAX; aid++)
+          {
+            esp_wifi_idle_remove(s_idle, aid);
+          }
+        break;
+
+      default:
+        break;
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+esp_err_t esp_wifi_idle_start(esp_wifi_idle_t *idle, esp_wifi_idle_cb_t cb,
+                              void *arg)
+{
+  esp_timer_create_args_t args =
+  {
+    .callback = idle_timer_cb,
+    .name = "wifi_idle",
+  };
+
+  esp_err_t ret;
+
+  if (idle == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  if (s_timer == NULL)
+    {
+      ret = esp_timer_create(&args, &s_timer);
+      if (ret != ESP_OK)
+        {
+          return ret;
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_idle)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  s_idle = idle;
+  s_cb = cb;
+  s_arg = arg;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  ret = esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+                                   idle_event_handler, NULL);
+  if (ret == ESP_OK)
+    {
+      ret = esp_timer_start_periodic(s_timer,
+                                     (uint64_t)esp_wifi_idle_tick_ms(idle) *
+                                     1000);
+    }
+
+  if (ret != ESP_OK)
+    {
+      esp_wifi_idle_stop();
+    }
+
+  return ret;
+}
+
+void esp_wifi_idle_stop(void)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  esp_event_handler_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID,
+                               idle_event_handler);
+  esp_timer_stop(s_timer);
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  s_idle = NULL;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+void esp_wifi_idle_touch_now(uint16_t aid)
+{
+  esp_wifi_idle_t *idle = s_idle;
+
+  /* Not locked, a touch stores one word */
+
+  if (idle)
+    {
+      esp_wifi_idle_touch(idle, aid, idle_now_ms());
+    }
+}
@@ -0,0 +1,206 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_wifi_ie_filter.h"
+
+#define IE_BENCH_APS_MAX    255
+#define IE_BENCH_IES        3            /* WMM, WPS, Espressif */
+#define IE_BENCH_IE_MAX     (2 + 64)
+#define IE_BENCH_BI_US      102400       /* beacon interval, 100 TU */
+
+static const uint8_t s_oui_ms[3] =
+{
+  0x00, 0x50, 0xf2
+};
+
+static const uint8_t s_oui_esp[3] =
+{
+  0x18, 0xfe, 0x34
+};
+
+struct ie_bench_ap
+{
+  uint8_t bssid[6];
+  uint8_t ie[IE_BENCH_IES][IE_BENCH_IE_MAX];
+};
+
+/* What the application keeps of every AP */
+
+struct ie_bench_sink
+{
+  uint32_t calls;
+  uint8_t ie[IE_BENCH_APS_MAX][IE_BENCH_IES][IE_BENCH_IE_MAX];
+};
+
+static uint32_t ie_bench_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static void ie_bench_ie(uint8_t *ie, const uint8_t oui[3], uint8_t type,
+                        uint8_t len, uint32_t fill)
+{
+  int i;
+
+  ie[0] = WIFI_VENDOR_IE_ELEMENT_ID;
+  ie[1] = 4 + len;
+  memcpy(ie + 2, oui, 3);
+  ie[5] = type;
+  for (i = 0; i < len; i++)
+    {
+      ie[6 + i] = fill >> (i % 4 * 8);
+    }
+}
+
+/* Interest of the application, as the allowlist */
+
+static bool ie_bench_wanted(const vendor_ie_data_t *ie)
+{
+  return memcmp(ie->vendor_oui, s_oui_esp, 3) == 0 ||
+         (memcmp(ie->vendor_oui, s_oui_ms, 3) == 0 &&
+          ie->vendor_oui_type == 4);
+}
+
+static void __attribute__((noinline))
+ie_bench_cb(struct ie_bench_sink *sink, uint32_t ap, int slot,
+            const vendor_ie_data_t *ie)
+{
+  memcpy(sink->ie[ap][slot], ie, 2 + ie->length);
+  sink->calls++;
+}
+
+static uint32_t ie_bench_ns(clock_t cpu, uint32_t n)
+{
+  return (uint32_t)((double)cpu * 1e9 / CLOCKS_PER_SEC / n);
+}
+
+esp_err_t esp_wifi_ie_filter_bench(uint32_t aps, uint32_t seconds,
+                                   esp_wifi_ie_filter_bench_t *result)
+{
+  static struct ie_bench_sink sink;
+  esp_wifi_ie_filter_config_t cfg;
+  esp_wifi_ie_filter_stats_t stats;
+  esp_wifi_ie_filter_t *filter;
+  const vendor_ie_data_t *ie;
+  struct ie_bench_ap *ap;
+  uint32_t beacons;
+  uint32_t rng = 1;
+  uint32_t now_ms;
+  uint32_t b;
+  uint32_t a;
+  uint32_t v;
+  clock_t cpu[2];
+  clock_t c0;
+  int run;
+  int i;
+  esp_err_t ret;
+
+  if (result == NULL || aps == 0 || aps > IE_BENCH_APS_MAX ||
+      seconds == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ap = calloc(aps, sizeof(*ap));
+  if (ap == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  esp_wifi_ie_filter_default(&cfg);
+  ret = esp_wifi_ie_filter_create(&cfg, &filter);
+  if (ret != ESP_OK)
+    {
+      free(ap);
+      return ret;
+    }
+
+  esp_wifi_ie_filter_allow(filter, s_oui_ms, 4);
+  esp_wifi_ie_filter_allow(filter, s_oui_esp, ESP_WIFI_IE_FILTER_ANY_TYPE);
+
+  beacons = (uint64_t)seconds * 1000000 / IE_BENCH_BI_US;
+  memset(result, 0, sizeof(*result));
+  result->ies = beacons * aps * IE_BENCH_IES;
+
+  /* Every IE to the callback, then the filter in front */
+
+  for (run = 0; run < 2; run++)
+    {
+      for (a = 0; a < aps; a++)
+        {
+          v = ie_bench_rand(&rng);
+          ap[a].bssid[0] = 0x24;
+          ap[a].bssid[1] = 0x0a;
+          ap[a].bssid[2] = 0xc4;
+          ap[a].bssid[3] = v >> 16;
+          ap[a].bssid[4] = v >> 8;
+          ap[a].bssid[5] = v;
+          ie_bench_ie(ap[a].ie[0], s_oui_ms, 2, 20, 0x03a40000);
+          ie_bench_ie(ap[a].ie[1], s_oui_ms, 4, 40, v);
+          ie_bench_ie(ap[a].ie[2], s_oui_esp, 1, 32, v ^ 0x5a5a5a5a);
+        }
+
+      memset(&sink, 0, sizeof(sink));
+      c0 = clock();
+      for (b = 0; b < beacons; b++)
+        {
+          now_ms = (uint64_t)b * IE_BENCH_BI_US / 1000;
+          for (a = 0; a < aps; a++)
+            {
+              /* The counter at the end of the Espressif payload */
+
+              if (b % (a % 4 == 0 ? 2 : 20) == 0)
+                {
+                  ap[a].ie[2][6 + 31] = b;
+                  ap[a].ie[2][6 + 30] = b >> 8;
+                }
+
+              for (i = 0; i < IE_BENCH_IES; i++)
+                {
+                  ie = (const vendor_ie_data_t *)ap[a].ie[i];
+                  if (run == 0 ? ie_bench_wanted(ie) :
+                      esp_wifi_ie_filter_check(filter, ap[a].bssid, ie,
+                                               now_ms) <
+                      ESP_WIFI_IE_FILTER_UNCHANGED)
+                    {
+                      ie_bench_cb(&sink, a, i, ie);
+                    }
+                }
+            }
+        }
+
+      cpu[run] = clock() - c0;
+    }
+
+  esp_wifi_ie_filter_get_stats(filter, &stats);
+  result->passed = stats.passed;
+  result->unchanged = stats.unchanged;
+  result->not_allowed = stats.not_allowed;
+  result->direct_ns = ie_bench_ns(cpu[0], result->ies);
+  result->filtered_ns = ie_bench_ns(cpu[1], result->ies);
+
+  esp_wifi_ie_filter_delete(filter);
+  free(ap);
+  return ESP_OK;
+}
@@ -0,0 +1,99 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_ie_filter.h"
+
+static esp_wifi_ie_filter_t *s_filter;
+static esp_wifi_ie_filter_cb_t s_cb;
+static void *s_ctx;
+static void *s_lock;
+
+static void ie_filter_vendor_cb(void *ctx, wifi_vendor_ie_type_t type,
+                                const uint8_t sa[6],
+                                const vendor_ie_data_t *vnd_ie, int rssi)
+{
+  esp_wifi_ie_filter_verdict_t verdict = ESP_WIFI_IE_FILTER_UNCHANGED;
+  esp_wifi_ie_filter_cb_t cb = NULL;
+  void *cb_ctx = NULL;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_filter)
+    {
+      verdict = esp_wifi_ie_filter_check(s_filter, sa, vnd_ie,
+                                         esp_timer_get_time() / 1000);
+      cb = s_cb;
+      cb_ctx = s_ctx;
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  if (verdict < ESP_WIFI_IE_FILTER_UNCHANGED && cb)
+    {
+      cb(cb_ctx, type, sa, vnd_ie, rssi);
+    }
+}
+
+esp_err_t esp_wifi_ie_filter_start(esp_wifi_ie_filter_t *filter,
+                                   esp_wifi_ie_filter_cb_t cb, void *ctx)
+{
+  esp_err_t ret;
+
+  if (filter == NULL || cb == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  s_filter = filter;
+  s_cb = cb;
+  s_ctx = ctx;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  ret = esp_wifi_set_vendor_ie_cb(ie_filter_vendor_cb, NULL);
+  if (ret != ESP_OK)
+    {
+      esp_wifi_ie_filter_stop();
+    }
+
+  return ret;
+}
+
+void esp_wifi_ie_filter_stop(void)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  esp_wifi_set_vendor_ie_cb(NULL, NULL);
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  s_filter = NULL;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
@@ -0,0 +1,489 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_smartconfig.h"
+#include "esp_wifi_lazy.h"
+
+struct lazy_subsys
+{
+  esp_wifi_lazy_ops_t ops;
+  bool registered;
+  bool active;
+  uint32_t refcnt;
+  int64_t last_use;
+  uint32_t footprint;
+  uint32_t init_count;
+  uint32_t deinit_count;
+};
+
+static struct lazy_subsys s_subsys[ESP_WIFI_LAZY_MAX];
+static void *s_lock;
+
+/* Heap taken by subsystems brought up from within another init, so
+ * that a dependency is not accounted twice.
+ */
+
+static uint32_t s_nested;
+static esp_timer_handle_t s_sweep_timer;
+
+/* Interfaces started, each holding a reference on the supplicant */
+
+#define LAZY_STA            (1u << 0)
+#define LAZY_AP             (1u << 1)
+
+static uint32_t s_started;
+static bool s_handler;
+
+static const int32_t g_lazy_events[4] =
+{
+  WIFI_EVENT_STA_START, WIFI_EVENT_STA_STOP,
+  WIFI_EVENT_AP_START, WIFI_EVENT_AP_STOP
+};
+
+static esp_err_t lazy_acquire_locked(esp_wifi_lazy_subsys_t id);
+static esp_err_t lazy_release_locked(esp_wifi_lazy_subsys_t id);
+
+static void lazy_lock(void)
+{
+  if (s_lock)
+    {
+      g_wifi_osi_funcs._mutex_lock(s_lock);
+    }
+}
+
+static void lazy_unlock(void)
+{
+  if (s_lock)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+    }
+}
+
+static esp_err_t lazy_supplicant_init(void *arg)
+{
+  return esp_supplicant_init();
+}
+
+static esp_err_t lazy_supplicant_deinit(void *arg)
+{
+  return esp_supplicant_deinit();
+}
+
+/* WPA2-enterprise runs inside the supplicant, the callbacks below are
+ * only called with s_lock held.
+ */
+
+static esp_err_t lazy_wpa2_ent_init(void *arg)
+{
+  esp_err_t ret;
+
+  ret = lazy_acquire_locked(ESP_WIFI_LAZY_SUPPLICANT);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  ret = esp_wifi_sta_wpa2_ent_enable();
+  if (ret != ESP_OK)
+    {
+      lazy_release_locked(ESP_WIFI_LAZY_SUPPLICANT);
+    }
+
+  return ret;
+}
+
+static esp_err_t lazy_wpa2_ent_deinit(void *arg)
+{
+  esp_err_t ret;
+
+  ret = esp_wifi_sta_wpa2_ent_disable();
+  lazy_release_locked(ESP_WIFI_LAZY_SUPPLICANT);
+  return ret;
+}
+
+static esp_err_t lazy_wapi_init(void *arg)
+{
+  return esp_wifi_internal_wapi_init();
+}
+
+static esp_err_t lazy_wapi_deinit(void *arg)
+{
+  return esp_wifi_internal_wapi_deinit();
+}
+
+static esp_err_t lazy_smartconfig_init(void *arg)
+{
+  return esp_smartconfig_start(arg);
+}
+
+static esp_err_t lazy_smartconfig_deinit(void *arg)
+{
+  return esp_smartconfig_stop();
+}
+
+static void lazy_teardown_locked(struct lazy_subsys *ss)
+{
+  ss->ops.deinit(ss->ops.arg);
+  ss->active = false;
+  ss->deinit_count++;
+}
+
+static esp_err_t lazy_acquire_locked(esp_wifi_lazy_subsys_t id)
+{
+  struct lazy_subsys *ss = &s_subsys[id];
+  uint32_t outer = s_nested;
+  uint32_t before;
+  uint32_t after;
+  uint32_t delta;
+  esp_err_t ret;
+
+  if (!ss->registered)
+    {
+      return ESP_ERR_NOT_SUPPORTED;
+    }
+
+  if (!ss->active)
+    {
+      s_nested = 0;
+      before = esp_get_free_heap_size();
+      ret = ss->ops.init(ss->ops.arg);
+      after = esp_get_free_heap_size();
+      delta = before > after ? before - after : 0;
+
+      if (ret != ESP_OK)
+        {
+          s_nested = outer;
+          return ret;
+        }
+
+      ss->footprint = delta > s_nested ? delta - s_nested : 0;
+      s_nested = outer + delta;
+      ss->active = true;
+      ss->init_count++;
+    }
+
+  ss->refcnt++;
+  ss->last_use = esp_timer_get_time();
+  return ESP_OK;
+}
+
+static esp_err_t lazy_release_locked(esp_wifi_lazy_subsys_t id)
+{
+  struct lazy_subsys *ss = &s_subsys[id];
+
+  if (!ss->active || ss->refcnt == 0)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  ss->last_use = esp_timer_get_time();
+  if (--ss->refcnt == 0 && ss->ops.idle_timeout_ms == 0)
+    {
+      lazy_teardown_locked(ss);
+    }
+
+  return ESP_OK;
+}
+
+static void lazy_sweep_cb(void *arg)
+{
+  esp_wifi_lazy_sweep();
+}
+
+/* A WPA station or softAP needs the supplicant for as long as it runs,
+ * whatever the references of the application.
+ */
+
+static void lazy_event_handler(void *arg, esp_event_base_t base,
+                               int32_t id, void *data)
+{
+  uint32_t ifx = (id == WIFI_EVENT_STA_START ||
+                  id == WIFI_EVENT_STA_STOP) ? LAZY_STA : LAZY_AP;
+  bool start = id == WIFI_EVENT_STA_START || id == WIFI_EVENT_AP_START;
+
+  lazy_lock();
+  if (start && !(s_started & ifx))
+    {
+      if (lazy_acquire_locked(ESP_WIFI_LAZY_SUPPLICANT) == ESP_OK)
+        {
+          s_started |= ifx;
+        }
+    }
+  else if (!start && (s_started & ifx))
+    {
+      lazy_release_locked(ESP_WIFI_LAZY_SUPPLICANT);
+      s_started &= ~ifx;
+    }
+
+  lazy_unlock();
+}
+
+esp_err_t esp_wifi_lazy_init(uint32_t sweep_period_ms)
+{
+  const esp_wifi_lazy_ops_t supplicant =
+  {
+    lazy_supplicant_init, lazy_supplicant_deinit, NULL,
+    ESP_WIFI_LAZY_IDLE_TIMEOUT_MS
+  };
+
+  const esp_wifi_lazy_ops_t wpa2_ent =
+  {
+    lazy_wpa2_ent_init, lazy_wpa2_ent_deinit, NULL,
+    ESP_WIFI_LAZY_IDLE_TIMEOUT_MS
+  };
+
+  const esp_wifi_lazy_ops_t wapi =
+  {
+    lazy_wapi_init, lazy_wapi_deinit, NULL,
+    ESP_WIFI_LAZY_IDLE_TIMEOUT_MS
+  };
+
+  esp_timer_create_args_t args =
+  {
+    .callback = lazy_sweep_cb,
+    .name = "wifi_lazy",
+  };
+
+  esp_err_t ret;
+  int i;
+
+  if (s_lock == NULL)
+    {
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  esp_wifi_lazy_register(ESP_WIFI_LAZY_SUPPLICANT, &supplicant);
+  esp_wifi_lazy_register(ESP_WIFI_LAZY_WPA2_ENT, &wpa2_ent);
+  esp_wifi_lazy_register(ESP_WIFI_LAZY_WAPI, &wapi);
+
+  for (i = 0; i < 4 && !s_handler; i++)
+    {
+      ret = esp_event_handler_register(WIFI_EVENT, g_lazy_events[i],
+                                       lazy_event_handler, NULL);
+      if (ret != ESP_OK)
+        {
+          while (i-- > 0)
+            {
+              esp_event_handler_unregister(WIFI_EVENT, g_lazy_events[i],
+                                           lazy_event_handler);
+            }
+
+          return ret;
+        }
+    }
+
+  s_handler = true;
+
+  if (sweep_period_ms == 0 || s_sweep_timer != NULL)
+    {
+      return ESP_OK;
+    }
+
+  ret = esp_timer_create(&args, &s_sweep_timer);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  return esp_timer_start_periodic(s_sweep_timer,
+                                  (uint64_t)sweep_period_ms * 1000);
+}
+
+void esp_wifi_lazy_deinit(void)
+{
+  int i;
+
+  for (i = 0; i < 4 && s_handler; i++)
+    {
+      esp_event_handler_unregister(WIFI_EVENT, g_lazy_events[i],
+                                   lazy_event_handler);
+    }
+
+  s_handler = false;
+
+  if (s_sweep_timer)
+    {
+      esp_timer_stop(s_sweep_timer);
+      esp_timer_delete(s_sweep_timer);
+      s_sweep_timer = NULL;
+    }
+
+  lazy_lock();
+
+  /* Dependents have a higher id than what they depend on */
+
+  for (i = ESP_WIFI_LAZY_MAX - 1; i >= 0; i--)
+    {
+      if (s_subsys[i].active)
+        {
+          s_subsys[i].refcnt = 0;
+          lazy_teardown_locked(&s_subsys[i]);
+        }
+    }
+
+  s_started = 0;
+
+  lazy_unlock();
+
+  if (s_lock)
+    {
+      g_wifi_osi_funcs._mutex_delete(s_lock);
+      s_lock = NULL;
+    }
+}
+
+esp_err_t esp_wifi_lazy_register(esp_wifi_lazy_subsys_t id,
+                                 const esp_wifi_lazy_ops_t *ops)
+{
+  esp_err_t ret = ESP_OK;
+
+  if (id >= ESP_WIFI_LAZY_MAX || ops == NULL ||
+      ops->init == NULL || ops->deinit == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  lazy_lock();
+
+  if (s_subsys[id].active)
+    {
+      ret = ESP_ERR_INVALID_STATE;
+    }
+  else
+    {
+      s_subsys[id].ops = *ops;
+      s_subsys[id].registered = true;
+    }
+
+  lazy_unlock();
+  return ret;
+}
+
+esp_err_t esp_wifi_lazy_register_smartconfig(
+                const smartconfig_start_config_t *config)
+{
+  esp_wifi_lazy_ops_t ops =
+  {
+    lazy_smartconfig_init, lazy_smartconfig_deinit, (void *)config, 0
+  };
+
+  return esp_wifi_lazy_register(ESP_WIFI_LAZY_SMARTCONFIG, &ops);
+}
+
+esp_err_t esp_wifi_lazy_acquire(esp_wifi_lazy_subsys_t id)
+{
+  esp_err_t ret;
+
+  if (id >= ESP_WIFI_LAZY_MAX)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  lazy_lock();
+  ret = lazy_acquire_locked(id);
+  lazy_unlock();
+
+  return ret;
+}
+
+esp_err_t esp_wifi_lazy_release(esp_wifi_lazy_subsys_t id)
+{
+  esp_err_t ret;
+
+  if (id >= ESP_WIFI_LAZY_MAX)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  lazy_lock();
+  ret = lazy_release_locked(id);
+  lazy_unlock();
+
+  return ret;
+}
+
+void esp_wifi_lazy_sweep(void)
+{
+  int64_t now = esp_timer_get_time();
+  struct lazy_subsys *ss;
+  int i;
+
+  lazy_lock();
+
+  /* Dependents go down before what they depend on */
+
+  for (i = ESP_WIFI_LAZY_MAX - 1; i >= 0; i--)
+    {
+      ss = &s_subsys[i];
+      if (ss->active && ss->refcnt == 0 &&
+          now - ss->last_use >= (int64_t)ss->ops.idle_timeout_ms * 1000)
+        {
+          lazy_teardown_locked(ss);
+        }
+    }
+
+  lazy_unlock();
+}
+
+esp_err_t esp_wifi_lazy_get_stats(esp_wifi_lazy_subsys_t id,
+                                  esp_wifi_lazy_stats_t *stats)
+{
+  struct lazy_subsys *ss;
+
+  if (id >= ESP_WIFI_LAZY_MAX || stats == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  lazy_lock();
+
+  ss = &s_subsys[id];
+  stats->registered = ss->registered;
+  stats->active = ss->active;
+  stats->refcnt = ss->refcnt;
+  stats->footprint = ss->footprint;
+  stats->saved = ss->active ? 0 : ss->footprint;
+  stats->init_count = ss->init_count;
+  stats->deinit_count = ss->deinit_count;
+
+  lazy_unlock();
+  return ESP_OK;
+}
+
+uint32_t esp_wifi_lazy_get_saved(void)
+{
+  uint32_t saved = 0;
+  int i;
+
+  lazy_lock();
+
+  for (i = 0; i < ESP_WIFI_LAZY_MAX; i++)
+    {
+      if (!s_subsys[i].active)
+        {
+          saved += s_subsys[i].footprint;
+        }
+    }
+
+  lazy_unlock();
+  return saved;
+}
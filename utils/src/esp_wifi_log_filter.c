@@ -0,0 +1,296 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi_log_filter.h"
+
+#define LOG_FILTER_FNV_OFFSET  2166136261u
+#define LOG_FILTER_FNV_PRIME   16777619u
+
+struct log_filter_tag
+{
+  uint32_t hash;
+  uint32_t level;
+};
+
+static wifi_osi_funcs_t *s_osi;
+static void (*s_log_writev)(uint32_t level, const char *tag,
+                            const char *format, va_list args);
+
+static esp_wifi_log_filter_config_t s_cfg;
+static esp_wifi_log_filter_stats_t s_stats;
+
+static struct log_filter_tag s_tags[ESP_WIFI_LOG_FILTER_MAX_TAGS];
+static volatile uint32_t s_ntags;
+
+/* Most verbose level of the default and the tags, checked first */
+
+static volatile uint32_t s_max_level;
+
+/* Token bucket, in thousandths of a message. Messages come from any
+ * task, and the libraries log with interrupts disabled too.
+ */
+
+static void *s_mux;
+static uint32_t s_tokens;
+static uint32_t s_last_ms;
+
+static uint32_t log_filter_hash(const char *tag)
+{
+  uint32_t h = LOG_FILTER_FNV_OFFSET;
+
+  while (*tag)
+    {
+      h ^= (uint8_t)*tag++;
+      h *= LOG_FILTER_FNV_PRIME;
+    }
+
+  return h;
+}
+
+static bool log_filter_rate(void)
+{
+  uint32_t now = s_osi->_log_timestamp();
+  uint32_t cap = s_cfg.burst * 1000;
+  uint32_t elapsed;
+  uint32_t tmp;
+  bool pass = false;
+
+  tmp = s_osi->_wifi_int_disable(s_mux);
+
+  /* A task preempted between its timestamp and the lock comes late */
+
+  elapsed = (int32_t)(now - s_last_ms) > 0 ? now - s_last_ms : 0;
+  s_last_ms += elapsed;
+  if (elapsed > cap / s_cfg.rate_per_sec)
+    {
+      s_tokens = cap;
+    }
+  else
+    {
+      s_tokens += elapsed * s_cfg.rate_per_sec;
+      if (s_tokens > cap)
+        {
+          s_tokens = cap;
+        }
+    }
+
+  if (s_tokens >= 1000)
+    {
+      s_tokens -= 1000;
+      pass = true;
+    }
+
+  s_osi->_wifi_int_restore(s_mux, tmp);
+  return pass;
+}
+
+/* Return true if the message must be passed on */
+
+static bool log_filter_pass(uint32_t level, const char *tag)
+{
+  uint32_t limit = s_cfg.level;
+  uint32_t hash;
+  uint32_t n = s_ntags;
+  uint32_t i;
+
+  if (level > s_max_level)
+    {
+      s_stats.dropped_level++;
+      return false;
+    }
+
+  if (n != 0 && tag != NULL)
+    {
+      hash = log_filter_hash(tag);
+      for (i = 0; i < n; i++)
+        {
+          if (s_tags[i].hash == hash)
+            {
+              limit = s_tags[i].level;
+              break;
+            }
+        }
+
+      if (level > limit)
+        {
+          if (i < n)
+            {
+              s_stats.dropped_tag++;
+            }
+          else
+            {
+              s_stats.dropped_level++;
+            }
+
+          return false;
+        }
+    }
+  else if (level > limit)
+    {
+      s_stats.dropped_level++;
+      return false;
+    }
+
+  if (s_cfg.rate_per_sec != 0 && level >= s_cfg.rate_level &&
+      !log_filter_rate())
+    {
+      s_stats.dropped_rate++;
+      return false;
+    }
+
+  s_stats.passed++;
+  return true;
+}
+
+static void log_filter_writev(uint32_t level, const char *tag,
+                              const char *format, va_list args)
+{
+  if (log_filter_pass(level, tag))
+    {
+      s_log_writev(level, tag, format, args);
+    }
+}
+
+static void log_filter_write(uint32_t level, const char *tag,
+                             const char *format, ...)
+{
+  va_list args;
+
+  if (!log_filter_pass(level, tag))
+    {
+      return;
+    }
+
+  va_start(args, format);
+  s_log_writev(level, tag, format, args);
+  va_end(args);
+}
+
+static void log_filter_update_max(void)
+{
+  uint32_t max = s_cfg.level;
+  uint32_t i;
+
+  for (i = 0; i < s_ntags; i++)
+    {
+      if (s_tags[i].level > max)
+        {
+          max = s_tags[i].level;
+        }
+    }
+
+  s_max_level = max;
+}
+
+void esp_wifi_log_filter_default(esp_wifi_log_filter_config_t *cfg)
+{
+  cfg->level = WIFI_LOG_INFO;
+  cfg->rate_level = WIFI_LOG_DEBUG;
+  cfg->rate_per_sec = 20;
+  cfg->burst = 20;
+}
+
+esp_err_t esp_wifi_log_filter_hook(wifi_osi_funcs_t *osi,
+                                   const esp_wifi_log_filter_config_t *cfg)
+{
+  if (osi == NULL || cfg == NULL || cfg->level > WIFI_LOG_VERBOSE ||
+      (cfg->rate_per_sec != 0 && cfg->burst == 0))
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_osi != NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  s_mux = osi->_spin_lock_create();
+  if (s_mux == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  s_cfg = *cfg;
+  s_tokens = cfg->burst * 1000;
+  s_last_ms = osi->_log_timestamp();
+  log_filter_update_max();
+
+  s_log_writev = osi->_log_writev;
+  s_osi = osi;
+  osi->_log_writev = log_filter_writev;
+  osi->_log_write = log_filter_write;
+
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_log_filter_set_tag(const char *tag,
+                                      wifi_log_level_t level)
+{
+  uint32_t hash;
+  uint32_t i;
+
+  if (tag == NULL || level > WIFI_LOG_VERBOSE)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  hash = log_filter_hash(tag);
+  for (i = 0; i < s_ntags; i++)
+    {
+      if (s_tags[i].hash == hash)
+        {
+          break;
+        }
+    }
+
+  if (i == ESP_WIFI_LOG_FILTER_MAX_TAGS)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  /* Entries are filled before they are counted, the hook reads them
+   * without locking.
+   */
+
+  s_tags[i].level = level;
+  s_tags[i].hash = hash;
+  if (i == s_ntags)
+    {
+      s_ntags = i + 1;
+    }
+
+  log_filter_update_max();
+  return ESP_OK;
+}
+
+wifi_log_level_t esp_wifi_log_filter_get_level(void)
+{
+  return (wifi_log_level_t)s_max_level;
+}
+
+void esp_wifi_log_filter_get_stats(esp_wifi_log_filter_stats_t *stats)
+{
+  *stats = s_stats;
+}
+
+void esp_wifi_log_filter_reset_stats(void)
+{
+  memset(&s_stats, 0, sizeof(s_stats));
+}
@@ -0,0 +1,191 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi_log_filter.h"
+
+#define LOG_BENCH_MESSAGES  4096     /* drawn, replayed in turn */
+#define LOG_BENCH_FORMAT    "%s: seq %u len %u rssi %d ch %u ts %u\n"
+
+static const char *const g_log_bench_tags[6] =
+{
+  "wifi", "pp", "net80211", "phy", "rtc", "coex"
+};
+
+struct log_bench_msg
+{
+  uint8_t level;
+  uint8_t tag;
+  uint16_t len;
+  int8_t rssi;
+  uint8_t channel;
+};
+
+static wifi_osi_funcs_t s_log_bench_osi;
+static struct log_bench_msg s_log_bench_msgs[LOG_BENCH_MESSAGES];
+static uint32_t s_log_bench_ms;
+static uint32_t s_log_bench_sum;
+static uint32_t s_log_bench_lock;
+
+static uint32_t log_bench_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static uint32_t log_bench_ns(clock_t cpu, uint32_t ops)
+{
+  return (uint32_t)((double)cpu * 1e9 / CLOCKS_PER_SEC / ops);
+}
+
+/* What the ESP-IDF sink does up to the UART */
+
+static void log_bench_writev(uint32_t level, const char *tag,
+                             const char *format, va_list args)
+{
+  char line[128];
+  int n;
+
+  n = vsnprintf(line, sizeof(line), format, args);
+  s_log_bench_sum += n + (uint8_t)line[0];
+}
+
+static void log_bench_write(uint32_t level, const char *tag,
+                            const char *format, ...)
+{
+  va_list args;
+
+  va_start(args, format);
+  log_bench_writev(level, tag, format, args);
+  va_end(args);
+}
+
+static uint32_t log_bench_timestamp(void)
+{
+  return s_log_bench_ms;
+}
+
+static void *log_bench_spin_lock_create(void)
+{
+  return &s_log_bench_lock;
+}
+
+static uint32_t log_bench_int_disable(void *mux)
+{
+  return 0;
+}
+
+static void log_bench_int_restore(void *mux, uint32_t tmp)
+{
+}
+
+static void log_bench_fill(void)
+{
+  struct log_bench_msg *m;
+  uint32_t rng = 1;
+  uint32_t r;
+  uint32_t i;
+
+  for (i = 0; i < LOG_BENCH_MESSAGES; i++)
+    {
+      m = &s_log_bench_msgs[i];
+      r = log_bench_rand(&rng) % 100;
+      m->level = r < 5 ? WIFI_LOG_WARNING : r < 20 ? WIFI_LOG_INFO :
+                 r < 70 ? WIFI_LOG_DEBUG : WIFI_LOG_VERBOSE;
+      m->tag = log_bench_rand(&rng) % 6;
+      m->len = log_bench_rand(&rng) % 1600;
+      m->rssi = -30 - (int)(log_bench_rand(&rng) % 60);
+      m->channel = 1 + log_bench_rand(&rng) % 13;
+    }
+}
+
+esp_err_t esp_wifi_log_filter_bench(uint32_t messages, uint32_t per_sec,
+                                    esp_wifi_log_filter_bench_t *result)
+{
+  esp_wifi_log_filter_config_t cfg;
+  const struct log_bench_msg *m;
+  const char *tag;
+  uint32_t i;
+  clock_t c0;
+  esp_err_t ret;
+
+  if (messages == 0 || per_sec == 0 || result == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  memset(&s_log_bench_osi, 0, sizeof(s_log_bench_osi));
+  s_log_bench_osi._log_write = log_bench_write;
+  s_log_bench_osi._log_writev = log_bench_writev;
+  s_log_bench_osi._log_timestamp = log_bench_timestamp;
+  s_log_bench_osi._spin_lock_create = log_bench_spin_lock_create;
+  s_log_bench_osi._wifi_int_disable = log_bench_int_disable;
+  s_log_bench_osi._wifi_int_restore = log_bench_int_restore;
+
+  esp_wifi_log_filter_default(&cfg);
+  ret = esp_wifi_log_filter_hook(&s_log_bench_osi, &cfg);
+  if (ret == ESP_OK)
+    {
+      ret = esp_wifi_log_filter_set_tag("pp", WIFI_LOG_DEBUG);
+    }
+
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  log_bench_fill();
+  memset(result, 0, sizeof(*result));
+  result->messages = messages;
+
+  c0 = clock();
+  for (i = 0; i < messages; i++)
+    {
+      m = &s_log_bench_msgs[i % LOG_BENCH_MESSAGES];
+      tag = g_log_bench_tags[m->tag];
+      s_log_bench_ms = (uint64_t)i * 1000 / per_sec;
+      log_bench_write(m->level, tag, LOG_BENCH_FORMAT, tag, i, m->len,
+                      m->rssi, m->channel, s_log_bench_ms);
+    }
+
+  result->unfiltered_ns = log_bench_ns(clock() - c0, messages);
+
+  esp_wifi_log_filter_reset_stats();
+  c0 = clock();
+  for (i = 0; i < messages; i++)
+    {
+      m = &s_log_bench_msgs[i % LOG_BENCH_MESSAGES];
+      tag = g_log_bench_tags[m->tag];
+      s_log_bench_ms = (uint64_t)i * 1000 / per_sec;
+      s_log_bench_osi._log_write(m->level, tag, LOG_BENCH_FORMAT, tag, i,
+                                 m->len, m->rssi, m->channel,
+                                 s_log_bench_ms);
+    }
+
+  result->filtered_ns = log_bench_ns(clock() - c0, messages);
+
+  esp_wifi_log_filter_get_stats(&result->stats);
+  result->passed = result->stats.passed;
+  return ESP_OK;
+}
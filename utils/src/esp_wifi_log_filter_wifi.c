@@ -0,0 +1,30 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_log_filter.h"
+
+esp_err_t esp_wifi_log_filter_install(wifi_osi_funcs_t *osi,
+                                      const esp_wifi_log_filter_config_t *cfg)
+{
+  return esp_wifi_log_filter_hook(osi ? osi : &g_wifi_osi_funcs, cfg);
+}
+
+esp_err_t esp_wifi_log_filter_sync(void)
+{
+  return esp_wifi_internal_set_log_level(esp_wifi_log_filter_get_level());
+}
@@ -0,0 +1,493 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_nbr.h"
+
+/* Action categories and codes, IEEE 802.11-2016 9.6 */
+
+#define NBR_CAT_RM          5
+#define NBR_RM_NR_REQ       4
+#define NBR_RM_NR_RESP      5
+#define NBR_CAT_WNM         10
+#define NBR_WNM_BTM_REQ     7
+#define NBR_WNM_BTM_RESP    8
+
+#define NBR_EID_SSID        0
+#define NBR_EID_NR          52
+#define NBR_NR_FIXED        13
+#define NBR_SUB_PREF        3
+#define NBR_SUB_TERM        4
+#define NBR_TERM_LEN        10
+
+struct nbr_slot
+{
+  esp_wifi_nbr_t nbr;
+  int64_t expire_ms;
+};
+
+struct esp_wifi_nbr_cache
+{
+  uint32_t lifetime_ms;
+  uint8_t n;
+  struct nbr_slot slots[ESP_WIFI_NBR_MAX];
+};
+
+static size_t nbr_element_len(const esp_wifi_nbr_t *nbr)
+{
+  return 2 + NBR_NR_FIXED + (nbr->preference ? 3 : 0);
+}
+
+static uint8_t *nbr_put_element(uint8_t *p, const esp_wifi_nbr_t *nbr)
+{
+  *p++ = NBR_EID_NR;
+  *p++ = nbr_element_len(nbr) - 2;
+  memcpy(p, nbr->bssid, 6);
+  p += 6;
+  *p++ = nbr->bssid_info;
+  *p++ = nbr->bssid_info >> 8;
+  *p++ = nbr->bssid_info >> 16;
+  *p++ = nbr->bssid_info >> 24;
+  *p++ = nbr->op_class;
+  *p++ = nbr->channel;
+  *p++ = nbr->phy_type;
+  if (nbr->preference)
+    {
+      *p++ = NBR_SUB_PREF;
+      *p++ = 1;
+      *p++ = nbr->preference;
+    }
+
+  return p;
+}
+
+/* One neighbor report element body, subelements other than the
+ * candidate preference are skipped
+ */
+
+static bool nbr_get_element(const uint8_t *p, size_t len,
+                            esp_wifi_nbr_t *nbr)
+{
+  size_t off = NBR_NR_FIXED;
+
+  if (len < NBR_NR_FIXED)
+    {
+      return false;
+    }
+
+  memset(nbr, 0, sizeof(*nbr));
+  memcpy(nbr->bssid, p, 6);
+  nbr->bssid_info = p[6] | p[7] << 8 | p[8] << 16 | (uint32_t)p[9] << 24;
+  nbr->op_class = p[10];
+  nbr->channel = p[11];
+  nbr->phy_type = p[12];
+
+  while (off + 2 <= len)
+    {
+      if (off + 2 + p[off + 1] > len)
+        {
+          return false;
+        }
+
+      if (p[off] == NBR_SUB_PREF && p[off + 1] >= 1)
+        {
+          nbr->preference = p[off + 2];
+        }
+
+      off += 2 + p[off + 1];
+    }
+
+  return off == len;
+}
+
+/* Neighbor report elements up to the end of the body */
+
+static bool nbr_get_list(const uint8_t *p, size_t len, esp_wifi_nbr_t *nbrs,
+                         uint8_t room, uint8_t *n)
+{
+  size_t off = 0;
+
+  *n = 0;
+  while (off + 2 <= len)
+    {
+      if (off + 2 + p[off + 1] > len)
+        {
+          return false;
+        }
+
+      if (p[off] == NBR_EID_NR && *n < room)
+        {
+          if (!nbr_get_element(p + off + 2, p[off + 1], &nbrs[*n]))
+            {
+              return false;
+            }
+
+          (*n)++;
+        }
+
+      off += 2 + p[off + 1];
+    }
+
+  return off == len;
+}
+
+esp_err_t esp_wifi_nbr_build_request(uint8_t token, const uint8_t *ssid,
+                                     uint8_t ssid_len, uint8_t *buf,
+                                     size_t size, size_t *len)
+{
+  size_t need = 3 + (ssid ? 2 + ssid_len : 0);
+
+  if (need > size || ssid_len > 32)
+    {
+      return ESP_ERR_INVALID_SIZE;
+    }
+
+  buf[0] = NBR_CAT_RM;
+  buf[1] = NBR_RM_NR_REQ;
+  buf[2] = token;
+  if (ssid)
+    {
+      buf[3] = NBR_EID_SSID;
+      buf[4] = ssid_len;
+      memcpy(buf + 5, ssid, ssid_len);
+    }
+
+  *len = need;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_nbr_build_report(uint8_t token,
+                                    const esp_wifi_nbr_t *nbrs, uint8_t n,
+                                    uint8_t *buf, size_t size, size_t *len)
+{
+  size_t need = 3;
+  uint8_t *p;
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      need += nbr_element_len(&nbrs[i]);
+    }
+
+  if (need > size)
+    {
+      return ESP_ERR_INVALID_SIZE;
+    }
+
+  buf[0] = NBR_CAT_RM;
+  buf[1] = NBR_RM_NR_RESP;
+  buf[2] = token;
+  p = buf + 3;
+  for (i = 0; i < n; i++)
+    {
+      p = nbr_put_element(p, &nbrs[i]);
+    }
+
+  *len = need;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_nbr_parse_report(const uint8_t *body, size_t len,
+                                    uint8_t *token, esp_wifi_nbr_t *nbrs,
+                                    uint8_t *n)
+{
+  if (len < 3 || body[0] != NBR_CAT_RM || body[1] != NBR_RM_NR_RESP)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  *token = body[2];
+  return nbr_get_list(body + 3, len - 3, nbrs, *n, n) ? ESP_OK :
+         ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_wifi_btm_build_request(const esp_wifi_btm_req_t *req,
+                                     uint8_t *buf, size_t size,
+                                     size_t *len)
+{
+  size_t need = 7;
+  uint8_t *p;
+  int i;
+
+  if (req->mode & ESP_WIFI_BTM_BSS_TERM_INCL)
+    {
+      need += 2 + NBR_TERM_LEN;
+    }
+
+  if (req->mode & ESP_WIFI_BTM_ESS_DISASSOC)
+    {
+      need += 1;
+    }
+
+  for (i = 0; i < req->ncands; i++)
+    {
+      need += nbr_element_len(&req->cands[i]);
+    }
+
+  if (need > size)
+    {
+      return ESP_ERR_INVALID_SIZE;
+    }
+
+  p = buf;
+  *p++ = NBR_CAT_WNM;
+  *p++ = NBR_WNM_BTM_REQ;
+  *p++ = req->token;
+  *p++ = req->mode | (req->ncands ? ESP_WIFI_BTM_PREF_CAND_LIST : 0);
+  *p++ = req->disassoc_timer;
+  *p++ = req->disassoc_timer >> 8;
+  *p++ = req->validity;
+
+  /* Termination TSF and duration are left zero, an empty session URL */
+
+  if (req->mode & ESP_WIFI_BTM_BSS_TERM_INCL)
+    {
+      *p++ = NBR_SUB_TERM;
+      *p++ = NBR_TERM_LEN;
+      memset(p, 0, NBR_TERM_LEN);
+      p += NBR_TERM_LEN;
+    }
+
+  if (req->mode & ESP_WIFI_BTM_ESS_DISASSOC)
+    {
+      *p++ = 0;
+    }
+
+  for (i = 0; i < req->ncands; i++)
+    {
+      p = nbr_put_element(p, &req->cands[i]);
+    }
+
+  *len = need;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_btm_parse_request(const uint8_t *body, size_t len,
+                                     esp_wifi_btm_req_t *req)
+{
+  size_t off = 7;
+
+  if (len < 7 || body[0] != NBR_CAT_WNM || body[1] != NBR_WNM_BTM_REQ)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  memset(req, 0, sizeof(*req));
+  req->token = body[2];
+  req->mode = body[3];
+  req->disassoc_timer = body[4] | body[5] << 8;
+  req->validity = body[6];
+
+  if (req->mode & ESP_WIFI_BTM_BSS_TERM_INCL)
+    {
+      if (off + 2 > len || body[off] != NBR_SUB_TERM ||
+          off + 2 + body[off + 1] > len)
+        {
+          return ESP_ERR_INVALID_ARG;
+        }
+
+      off += 2 + body[off + 1];
+    }
+
+  if (req->mode & ESP_WIFI_BTM_ESS_DISASSOC)
+    {
+      if (off + 1 > len || off + 1 + body[off] > len)
+        {
+          return ESP_ERR_INVALID_ARG;
+        }
+
+      off += 1 + body[off];
+    }
+
+  if (off > len)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (!(req->mode & ESP_WIFI_BTM_PREF_CAND_LIST))
+    {
+      return ESP_OK;
+    }
+
+  return nbr_get_list(body + off, len - off, req->cands, ESP_WIFI_NBR_MAX,
+                      &req->ncands) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_wifi_btm_build_response(uint8_t token, uint8_t status,
+                                      const uint8_t *target, uint8_t *buf,
+                                      size_t size, size_t *len)
+{
+  size_t need = 5 + (status == ESP_WIFI_BTM_ACCEPT && target ? 6 : 0);
+
+  if (need > size)
+    {
+      return ESP_ERR_INVALID_SIZE;
+    }
+
+  buf[0] = NBR_CAT_WNM;
+  buf[1] = NBR_WNM_BTM_RESP;
+  buf[2] = token;
+  buf[3] = status;
+  buf[4] = 0;
+  if (need > 5)
+    {
+      memcpy(buf + 5, target, 6);
+    }
+
+  *len = need;
+  return ESP_OK;
+}
+
+int esp_wifi_btm_select(const esp_wifi_btm_req_t *req,
+                        const uint8_t *current)
+{
+  int best = -1;
+  int i;
+
+  for (i = 0; i < req->ncands; i++)
+    {
+      if (req->cands[i].preference == 0 ||
+          (current && memcmp(req->cands[i].bssid, current, 6) == 0))
+        {
+          continue;
+        }
+
+      if (best < 0 || req->cands[i].preference > req->cands[best].preference)
+        {
+          best = i;
+        }
+    }
+
+  return best;
+}
+
+esp_err_t esp_wifi_nbr_cache_create(uint32_t lifetime_ms,
+                                    esp_wifi_nbr_cache_t **cache)
+{
+  esp_wifi_nbr_cache_t *c;
+
+  if (cache == NULL || lifetime_ms == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  c = calloc(1, sizeof(*c));
+  if (c == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  c->lifetime_ms = lifetime_ms;
+  *cache = c;
+  return ESP_OK;
+}
+
+void esp_wifi_nbr_cache_delete(esp_wifi_nbr_cache_t *cache)
+{
+  free(cache);
+}
+
+void esp_wifi_nbr_cache_add(esp_wifi_nbr_cache_t *cache,
+                            const esp_wifi_nbr_t *nbrs, uint8_t n,
+                            int64_t now_ms)
+{
+  struct nbr_slot *slot;
+  int i;
+  int j;
+
+  for (i = 0; i < n; i++)
+    {
+      slot = NULL;
+      for (j = 0; j < cache->n; j++)
+        {
+          if (memcmp(cache->slots[j].nbr.bssid, nbrs[i].bssid, 6) == 0)
+            {
+              slot = &cache->slots[j];
+              break;
+            }
+        }
+
+      if (slot == NULL && cache->n < ESP_WIFI_NBR_MAX)
+        {
+          slot = &cache->slots[cache->n++];
+        }
+      else if (slot == NULL)
+        {
+          slot = &cache->slots[0];
+          for (j = 1; j < cache->n; j++)
+            {
+              if (cache->slots[j].expire_ms < slot->expire_ms)
+                {
+                  slot = &cache->slots[j];
+                }
+            }
+        }
+
+      slot->nbr = nbrs[i];
+      slot->expire_ms = now_ms + cache->lifetime_ms;
+    }
+}
+
+void esp_wifi_nbr_cache_flush(esp_wifi_nbr_cache_t *cache)
+{
+  cache->n = 0;
+}
+
+uint16_t esp_wifi_nbr_cache_channels(esp_wifi_nbr_cache_t *cache,
+                                     int64_t now_ms)
+{
+  uint16_t mask = 0;
+  int i;
+
+  for (i = 0; i < cache->n; i++)
+    {
+      if (cache->slots[i].expire_ms > now_ms &&
+          cache->slots[i].nbr.channel >= 1 &&
+          cache->slots[i].nbr.channel <= 14)
+        {
+          mask |= 1 << cache->slots[i].nbr.channel;
+        }
+    }
+
+  return mask;
+}
+
+void esp_wifi_nbr_cache_get(esp_wifi_nbr_cache_t *cache, int64_t now_ms,
+                            esp_wifi_nbr_t *nbrs, uint8_t *n)
+{
+  uint8_t count = 0;
+  int i;
+
+  for (i = 0; i < cache->n && count < *n; i++)
+    {
+      if (cache->slots[i].expire_ms > now_ms)
+        {
+          nbrs[count++] = cache->slots[i].nbr;
+        }
+    }
+
+  *n = count;
+}
+
+void esp_wifi_nbr_default(esp_wifi_nbr_config_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->lifetime_ms = 10 * 60 * 1000;
+  cfg->request_wait_ms = 100;
+  cfg->roam = true;
+}
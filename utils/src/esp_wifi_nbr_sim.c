@@ -0,0 +1,302 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_wifi_nbr.h"
+
+/* The APs sit on a square grid, the best AP of a roam is the one
+ * nearest to the station other than the serving AP. A targeted scan
+ * finds every AP on the channels it covers.
+ */
+
+#define NBR_SIM_FRAME_MAX   512
+#define NBR_SIM_OP_CLASS    81           /* 2.4 GHz, 20 MHz */
+#define NBR_SIM_PHY_HT      7
+
+struct nbr_sim_ap
+{
+  int64_t x_cm;
+  int64_t y_cm;
+  uint8_t channel;
+};
+
+static uint32_t nbr_sim_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static uint32_t nbr_sim_channels(uint16_t mask)
+{
+  uint32_t n = 0;
+
+  for (; mask; mask &= mask - 1)
+    {
+      n++;
+    }
+
+  return n;
+}
+
+static uint64_t nbr_sim_dist2(const struct nbr_sim_ap *a, int64_t x_cm,
+                              int64_t y_cm)
+{
+  return (uint64_t)((a->x_cm - x_cm) * (a->x_cm - x_cm) +
+                    (a->y_cm - y_cm) * (a->y_cm - y_cm));
+}
+
+static void nbr_sim_entry(int i, const struct nbr_sim_ap *ap,
+                          uint8_t preference, esp_wifi_nbr_t *nbr)
+{
+  memset(nbr, 0, sizeof(*nbr));
+  nbr->bssid[0] = 0x02;
+  nbr->bssid[5] = i;
+  nbr->bssid_info = 0x8f;                 /* reachable, security, key
+                                           * scope, HT
+                                           */
+  nbr->op_class = NBR_SIM_OP_CLASS;
+  nbr->channel = ap->channel;
+  nbr->phy_type = NBR_SIM_PHY_HT;
+  nbr->preference = preference;
+}
+
+static void nbr_sim_stat(esp_wifi_nbr_sim_stat_t *stat, uint64_t scan_ms,
+                         uint32_t best, uint32_t roams)
+{
+  stat->scan_avg_ms = scan_ms / roams;
+  stat->best_permille = (uint64_t)best * 1000 / roams;
+}
+
+void esp_wifi_nbr_sim_default(esp_wifi_nbr_sim_t *sim)
+{
+  memset(sim, 0, sizeof(*sim));
+  sim->aps = 16;
+  sim->spacing_cm = 2500;
+  sim->channel_mask = 0x3ffe;
+  sim->full_scan_ch_ms = 120;
+  sim->scan_ch_ms = 30;
+  sim->report_radius_cm = 4000;
+  sim->btm_hit_permille = 900;
+  sim->roams = 1000;
+  sim->seed = 1;
+}
+
+esp_err_t esp_wifi_nbr_sim_run(const esp_wifi_nbr_sim_t *sim,
+                               esp_wifi_nbr_sim_result_t *result)
+{
+  struct nbr_sim_ap aps[ESP_WIFI_NBR_MAX];
+  esp_wifi_nbr_t nbrs[ESP_WIFI_NBR_MAX];
+  uint8_t frame[NBR_SIM_FRAME_MAX];
+  esp_wifi_nbr_cache_t *cache;
+  esp_wifi_btm_req_t req;
+  uint64_t scan_ms[3] =
+  {
+    0
+  };
+
+  uint32_t best_hits[3] =
+  {
+    0
+  };
+
+  uint64_t report_bytes = 0;
+  uint64_t btm_bytes = 0;
+  uint32_t rng;
+  uint32_t full_ms;
+  uint32_t cols;
+  uint32_t r;
+  uint16_t mask;
+  uint16_t chans;
+  int64_t x_cm;
+  int64_t y_cm;
+  size_t len;
+  uint8_t token;
+  uint8_t n;
+  int serving;
+  int best;
+  int second;
+  int pick;
+  int i;
+  esp_err_t ret;
+
+  if (sim == NULL || result == NULL || sim->aps < 3 ||
+      sim->aps > ESP_WIFI_NBR_MAX || sim->spacing_cm == 0 ||
+      (sim->channel_mask & 0x7ffe) == 0 || sim->roams == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ret = esp_wifi_nbr_cache_create(1000, &cache);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  memset(result, 0, sizeof(*result));
+  rng = sim->seed ? sim->seed : 1;
+  mask = sim->channel_mask & 0x7ffe;
+  full_ms = nbr_sim_channels(mask) * sim->full_scan_ch_ms;
+
+  cols = 1;
+  while (cols * cols < sim->aps)
+    {
+      cols++;
+    }
+
+  for (i = 0; i < sim->aps; i++)
+    {
+      aps[i].x_cm = (int64_t)(i % cols) * sim->spacing_cm;
+      aps[i].y_cm = (int64_t)(i / cols) * sim->spacing_cm;
+      do
+        {
+          aps[i].channel = 1 + nbr_sim_rand(&rng) % 14;
+        }
+      while (!(mask & (1 << aps[i].channel)));
+    }
+
+  for (r = 0; r < sim->roams; r++)
+    {
+      /* The station leaves the serving AP from a random point of its
+       * cell
+       */
+
+      serving = nbr_sim_rand(&rng) % sim->aps;
+      x_cm = aps[serving].x_cm +
+             (int64_t)(nbr_sim_rand(&rng) % sim->spacing_cm) -
+             sim->spacing_cm / 2;
+      y_cm = aps[serving].y_cm +
+             (int64_t)(nbr_sim_rand(&rng) % sim->spacing_cm) -
+             sim->spacing_cm / 2;
+
+      best = -1;
+      second = -1;
+      for (i = 0; i < sim->aps; i++)
+        {
+          if (i == serving)
+            {
+              continue;
+            }
+
+          if (best < 0 || nbr_sim_dist2(&aps[i], x_cm, y_cm) <
+                          nbr_sim_dist2(&aps[best], x_cm, y_cm))
+            {
+              second = best;
+              best = i;
+            }
+          else if (second < 0 || nbr_sim_dist2(&aps[i], x_cm, y_cm) <
+                                 nbr_sim_dist2(&aps[second], x_cm, y_cm))
+            {
+              second = i;
+            }
+        }
+
+      /* Every channel of the mask */
+
+      scan_ms[0] += full_ms;
+      best_hits[0]++;
+
+      /* The channels of the serving AP's report */
+
+      n = 0;
+      for (i = 0; i < sim->aps; i++)
+        {
+          if (i != serving &&
+              nbr_sim_dist2(&aps[i], aps[serving].x_cm, aps[serving].y_cm)
+              <= (uint64_t)sim->report_radius_cm * sim->report_radius_cm)
+            {
+              nbr_sim_entry(i, &aps[i], 0, &nbrs[n++]);
+            }
+        }
+
+      esp_wifi_nbr_build_report(r & 0xff, nbrs, n, frame, sizeof(frame),
+                                &len);
+      report_bytes += len;
+      n = ESP_WIFI_NBR_MAX;
+      esp_wifi_nbr_cache_flush(cache);
+      if (esp_wifi_nbr_parse_report(frame, len, &token, nbrs, &n) ==
+          ESP_OK)
+        {
+          esp_wifi_nbr_cache_add(cache, nbrs, n, 0);
+        }
+
+      chans = esp_wifi_nbr_cache_channels(cache, 0);
+      if (chans == 0)
+        {
+          result->report.fallbacks++;
+          scan_ms[1] += full_ms;
+          best_hits[1]++;
+        }
+      else
+        {
+          scan_ms[1] += nbr_sim_channels(chans) * sim->scan_ch_ms;
+          best_hits[1] += (chans & (1 << aps[best].channel)) != 0;
+        }
+
+      /* The candidates of a BTM Request, the AP misjudges the best now
+       * and then
+       */
+
+      memset(&req, 0, sizeof(req));
+      req.token = r & 0xff;
+      req.mode = ESP_WIFI_BTM_PREF_CAND_LIST |
+                 ESP_WIFI_BTM_DISASSOC_IMMINENT;
+      req.disassoc_timer = 10;
+      req.validity = 100;
+      req.ncands = 2;
+      if (nbr_sim_rand(&rng) % 1000 < sim->btm_hit_permille)
+        {
+          nbr_sim_entry(best, &aps[best], 255, &req.cands[0]);
+          nbr_sim_entry(second, &aps[second], 128, &req.cands[1]);
+        }
+      else
+        {
+          nbr_sim_entry(second, &aps[second], 255, &req.cands[0]);
+          nbr_sim_entry(best, &aps[best], 128, &req.cands[1]);
+        }
+
+      esp_wifi_btm_build_request(&req, frame, sizeof(frame), &len);
+      btm_bytes += len;
+      pick = -1;
+      if (esp_wifi_btm_parse_request(frame, len, &req) == ESP_OK)
+        {
+          pick = esp_wifi_btm_select(&req, NULL);
+        }
+
+      if (pick < 0)
+        {
+          result->btm.fallbacks++;
+          scan_ms[2] += full_ms;
+          best_hits[2]++;
+        }
+      else
+        {
+          best_hits[2] += req.cands[pick].bssid[5] == best;
+        }
+    }
+
+  nbr_sim_stat(&result->full, scan_ms[0], best_hits[0], sim->roams);
+  nbr_sim_stat(&result->report, scan_ms[1], best_hits[1], sim->roams);
+  nbr_sim_stat(&result->btm, scan_ms[2], best_hits[2], sim->roams);
+  result->report_bytes = report_bytes / sim->roams;
+  result->btm_bytes = btm_bytes / sim->roams;
+
+  esp_wifi_nbr_cache_delete(cache);
+  return ESP_OK;
+}
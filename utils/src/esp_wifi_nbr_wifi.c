@@ -0,0 +1,541 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_roam.h"
+#include "esp_wifi_nbr.h"
+
+#define NBR_FRAME_MAX       64
+#define NBR_HDR_LEN         24
+#define NBR_FCS_LEN         4
+#define NBR_CAT_RM          5
+#define NBR_RM_NR_RESP      5
+#define NBR_CAT_WNM         10
+#define NBR_WNM_BTM_REQ     7
+
+/* Moving to a BTM candidate */
+
+#define NBR_MOVE_NONE       0
+#define NBR_MOVE_LEAVING    1   /* disconnect issued */
+#define NBR_MOVE_JOINING    2   /* connect to the candidate issued */
+
+/* Provided by libnet80211.a */
+
+extern esp_err_t esp_wifi_action_tx_req(uint8_t type, uint8_t channel,
+                                        uint32_t wait_time_ms,
+                                        const wifi_action_tx_req_t *req);
+
+static esp_wifi_nbr_config_t s_cfg;
+static esp_wifi_nbr_cache_t *s_cache;
+static esp_wifi_nbr_stats_t s_stats;
+static void *s_lock;
+static esp_timer_handle_t s_timer;
+static bool s_running;
+static bool s_connected;
+static uint8_t s_mac[6];
+static uint8_t s_bssid[6];
+static uint8_t s_channel;
+static uint8_t s_ssid[32];
+static uint8_t s_ssid_len;
+static uint8_t s_token;
+static uint8_t s_move;
+static bool s_btm_pending;
+
+/* Parsed in the WiFi task, too large for its stack */
+
+static esp_wifi_btm_req_t s_btm;
+static esp_wifi_nbr_t s_nbrs[ESP_WIFI_NBR_MAX];
+
+static int64_t nbr_now_ms(void)
+{
+  return esp_timer_get_time() / 1000;
+}
+
+static esp_err_t nbr_send(const uint8_t *bssid, uint8_t channel,
+                          const uint8_t *body, size_t len, uint32_t wait_ms)
+{
+  wifi_action_tx_req_t *req;
+  esp_err_t ret;
+
+  req = malloc(sizeof(*req) + len);
+  if (req == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  memset(req, 0, sizeof(*req));
+  req->ifx = WIFI_IF_STA;
+  memcpy(req->dest_mac, bssid, 6);
+  req->data_len = len;
+  memcpy(req->data, body, len);
+
+  ret = esp_wifi_action_tx_req(WIFI_OFFCHAN_TX_REQ, channel, wait_ms, req);
+  free(req);
+  return ret;
+}
+
+static void nbr_feed_roam(const esp_wifi_nbr_t *nbrs, uint8_t n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      esp_wifi_roam_report_neighbor(nbrs[i].bssid, nbrs[i].channel);
+    }
+}
+
+static void nbr_rx_cb(void *buf, wifi_promiscuous_pkt_type_t type)
+{
+  const wifi_promiscuous_pkt_t *pkt = buf;
+  const uint8_t *hdr = pkt->payload;
+  const uint8_t *body = hdr + NBR_HDR_LEN;
+  size_t len;
+  uint8_t token;
+  uint8_t n = ESP_WIFI_NBR_MAX;
+  bool btm = false;
+
+  /* Unprotected action frames from the AP to the station only */
+
+  if (type != WIFI_PKT_MGMT ||
+      pkt->rx_ctrl.sig_len < NBR_HDR_LEN + NBR_FCS_LEN + 3 ||
+      hdr[0] != 0xd0 || (hdr[1] & 0x40) != 0)
+    {
+      return;
+    }
+
+  len = pkt->rx_ctrl.sig_len - NBR_HDR_LEN - NBR_FCS_LEN;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (!s_running || !s_connected || memcmp(hdr + 4, s_mac, 6) != 0 ||
+      memcmp(hdr + 10, s_bssid, 6) != 0)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return;
+    }
+
+  switch (body[0])
+    {
+      case NBR_CAT_RM:
+        if (body[1] != NBR_RM_NR_RESP)
+          {
+            break;
+          }
+
+        if (esp_wifi_nbr_parse_report(body, len, &token, s_nbrs, &n) !=
+            ESP_OK)
+          {
+            s_stats.malformed++;
+            break;
+          }
+
+        s_stats.reports++;
+        s_stats.neighbors += n;
+        esp_wifi_nbr_cache_add(s_cache, s_nbrs, n, nbr_now_ms());
+        if (s_cfg.roam)
+          {
+            nbr_feed_roam(s_nbrs, n);
+          }
+        break;
+
+      case NBR_CAT_WNM:
+        if (body[1] != NBR_WNM_BTM_REQ || s_btm_pending ||
+            s_move != NBR_MOVE_NONE)
+          {
+            break;
+          }
+
+        if (esp_wifi_btm_parse_request(body, len, &s_btm) != ESP_OK)
+          {
+            s_stats.malformed++;
+            break;
+          }
+
+        s_stats.btm_requests++;
+        esp_wifi_nbr_cache_add(s_cache, s_btm.cands, s_btm.ncands,
+                               nbr_now_ms());
+        if (s_cfg.roam)
+          {
+            nbr_feed_roam(s_btm.cands, s_btm.ncands);
+          }
+
+        s_btm_pending = true;
+        btm = true;
+        break;
+
+      default:
+        break;
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  /* Answered from the timer task, the WiFi task must not send */
+
+  if (btm)
+    {
+      esp_timer_start_once(s_timer, 0);
+    }
+}
+
+static void nbr_timer_cb(void *arg)
+{
+  uint8_t body[NBR_FRAME_MAX];
+  esp_wifi_nbr_t target;
+  wifi_config_t cfg;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t status;
+  size_t len;
+  int i;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (!s_running || !s_btm_pending)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return;
+    }
+
+  s_btm_pending = false;
+  i = esp_wifi_btm_select(&s_btm, s_bssid);
+  status = i < 0 ? ESP_WIFI_BTM_REJECT_NO_CAND : ESP_WIFI_BTM_ACCEPT;
+  if (i >= 0)
+    {
+      target = s_btm.cands[i];
+      s_stats.btm_accepted++;
+      s_move = NBR_MOVE_LEAVING;
+    }
+  else
+    {
+      s_stats.btm_rejected++;
+    }
+
+  esp_wifi_btm_build_response(s_btm.token, status,
+                               i >= 0 ? target.bssid : NULL, body,
+                               sizeof(body), &len);
+  memcpy(bssid, s_bssid, 6);
+  channel = s_channel;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  nbr_send(bssid, channel, body, len, 0);
+  if (status != ESP_WIFI_BTM_ACCEPT)
+    {
+      return;
+    }
+
+  /* Connected again from the disconnect event */
+
+  if (esp_wifi_get_config(WIFI_IF_STA, &cfg) == ESP_OK)
+    {
+      cfg.sta.bssid_set = true;
+      memcpy(cfg.sta.bssid, target.bssid, 6);
+      cfg.sta.channel = target.channel;
+      esp_wifi_set_config(WIFI_IF_STA, &cfg);
+    }
+
+  if (esp_wifi_disconnect() != ESP_OK)
+    {
+      g_wifi_osi_funcs._mutex_lock(s_lock);
+      s_move = NBR_MOVE_JOINING;
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      esp_wifi_connect();
+    }
+}
+
+static void nbr_restore_config(void)
+{
+  wifi_config_t cfg;
+
+  if (esp_wifi_get_config(WIFI_IF_STA, &cfg) == ESP_OK)
+    {
+      cfg.sta.bssid_set = false;
+      cfg.sta.channel = 0;
+      esp_wifi_set_config(WIFI_IF_STA, &cfg);
+    }
+}
+
+void esp_wifi_nbr_event_handler(void *arg, esp_event_base_t base,
+                                int32_t id, void *data)
+{
+  const wifi_event_sta_connected_t *conn;
+  uint8_t move;
+  bool request;
+
+  if (base != WIFI_EVENT || s_lock == NULL)
+    {
+      return;
+    }
+
+  switch (id)
+    {
+      case WIFI_EVENT_STA_CONNECTED:
+        conn = data;
+        g_wifi_osi_funcs._mutex_lock(s_lock);
+        if (s_cache && (conn->ssid_len != s_ssid_len ||
+                        memcmp(conn->ssid, s_ssid, s_ssid_len) != 0))
+          {
+            esp_wifi_nbr_cache_flush(s_cache);
+          }
+
+        memcpy(s_ssid, conn->ssid, conn->ssid_len);
+        s_ssid_len = conn->ssid_len;
+        memcpy(s_bssid, conn->bssid, 6);
+        s_channel = conn->channel;
+        s_connected = true;
+        s_move = NBR_MOVE_NONE;
+        request = s_running;
+        g_wifi_osi_funcs._mutex_unlock(s_lock);
+        if (request)
+          {
+            esp_wifi_nbr_request();
+          }
+        break;
+
+      case WIFI_EVENT_STA_DISCONNECTED:
+        g_wifi_osi_funcs._mutex_lock(s_lock);
+        s_connected = false;
+        s_btm_pending = false;
+        move = s_move;
+        s_move = move == NBR_MOVE_LEAVING ? NBR_MOVE_JOINING :
+                 NBR_MOVE_NONE;
+        g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+        /* A candidate that fails is given up for the configured AP */
+
+        if (move == NBR_MOVE_JOINING)
+          {
+            nbr_restore_config();
+          }
+
+        if (move != NBR_MOVE_NONE)
+          {
+            esp_wifi_connect();
+          }
+        break;
+
+      default:
+        break;
+    }
+}
+
+esp_err_t esp_wifi_nbr_request(void)
+{
+  uint8_t body[NBR_FRAME_MAX];
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t wait_ms;
+  size_t len;
+  esp_err_t ret;
+
+  if (s_lock == NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (!s_running || !s_connected)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  /* Token 0 stands for unsolicited reports */
+
+  if (++s_token == 0)
+    {
+      s_token = 1;
+    }
+
+  esp_wifi_nbr_build_request(s_token, s_ssid, s_ssid_len, body,
+                             sizeof(body), &len);
+  memcpy(bssid, s_bssid, 6);
+  channel = s_channel;
+  wait_ms = s_cfg.request_wait_ms;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  ret = nbr_send(bssid, channel, body, len, wait_ms);
+  if (ret == ESP_OK)
+    {
+      g_wifi_osi_funcs._mutex_lock(s_lock);
+      s_stats.requests++;
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+    }
+
+  return ret;
+}
+
+bool esp_wifi_nbr_in_progress(void)
+{
+  return s_move != NBR_MOVE_NONE;
+}
+
+void esp_wifi_nbr_get(esp_wifi_nbr_t *nbrs, uint8_t *n)
+{
+  if (s_lock == NULL)
+    {
+      *n = 0;
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_cache)
+    {
+      esp_wifi_nbr_cache_get(s_cache, nbr_now_ms(), nbrs, n);
+    }
+  else
+    {
+      *n = 0;
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+void esp_wifi_nbr_get_stats(esp_wifi_nbr_stats_t *stats)
+{
+  if (s_lock == NULL)
+    {
+      memset(stats, 0, sizeof(*stats));
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  *stats = s_stats;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+esp_err_t esp_wifi_nbr_start(const esp_wifi_nbr_config_t *cfg)
+{
+  esp_timer_create_args_t args =
+  {
+    .callback = nbr_timer_cb,
+    .name = "wifi_nbr",
+  };
+
+  wifi_promiscuous_filter_t filter =
+  {
+    .filter_mask = WIFI_PROMIS_FILTER_MASK_MGMT,
+  };
+
+  esp_wifi_nbr_cache_t *cache;
+  wifi_config_t sta;
+  esp_err_t ret;
+
+  if (cfg == NULL || cfg->lifetime_ms == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  if (s_timer == NULL)
+    {
+      ret = esp_timer_create(&args, &s_timer);
+      if (ret != ESP_OK)
+        {
+          return ret;
+        }
+    }
+
+  ret = esp_wifi_nbr_cache_create(cfg->lifetime_ms, &cache);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_running)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      esp_wifi_nbr_cache_delete(cache);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  s_cfg = *cfg;
+  s_cache = cache;
+  s_btm_pending = false;
+  s_move = NBR_MOVE_NONE;
+  memset(&s_stats, 0, sizeof(s_stats));
+  s_running = true;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  /* The capabilities are advertised from the next association on */
+
+  ret = esp_wifi_get_config(WIFI_IF_STA, &sta);
+  if (ret == ESP_OK)
+    {
+      sta.sta.rm_enabled = 1;
+      sta.sta.btm_enabled = 1;
+      ret = esp_wifi_set_config(WIFI_IF_STA, &sta);
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_wifi_get_mac(WIFI_IF_STA, s_mac);
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_wifi_set_promiscuous_filter(&filter);
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_wifi_set_promiscuous_rx_cb(nbr_rx_cb);
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_wifi_set_promiscuous(true);
+    }
+
+  if (ret != ESP_OK)
+    {
+      esp_wifi_nbr_stop();
+    }
+
+  return ret;
+}
+
+void esp_wifi_nbr_stop(void)
+{
+  esp_wifi_nbr_cache_t *cache;
+
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  s_running = false;
+  s_btm_pending = false;
+  s_move = NBR_MOVE_NONE;
+  cache = s_cache;
+  s_cache = NULL;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  esp_timer_stop(s_timer);
+  esp_wifi_set_promiscuous(false);
+  esp_wifi_nbr_cache_delete(cache);
+}
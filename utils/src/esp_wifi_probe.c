@@ -0,0 +1,320 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_probe.h"
+
+#define PROBE_SHIFT         28           /* 32 - log2(sets) */
+#define PROBE_TOKEN         1000         /* a probe, in bucket units */
+#define PROBE_WINDOW_MS     1000
+#define PROBE_FC_REQ        0x40         /* management, probe request */
+#define PROBE_HDR_LEN       24
+
+#if ESP_WIFI_PROBE_SETS != 16
+#  error "PROBE_SHIFT assumes 16 sets"
+#endif
+
+struct probe_sender
+{
+  uint8_t mac[6];
+  int8_t rssi;
+  bool used;
+  uint32_t last_ms;
+  uint32_t tokens;               /* PROBE_TOKEN per probe */
+  uint32_t probes;
+  uint32_t limited;
+  uint32_t wildcard;
+};
+
+struct esp_wifi_probe
+{
+  esp_wifi_probe_config_t cfg;
+  esp_wifi_probe_stats_t stats;
+  bool suppress;
+  uint32_t win_ms;               /* start of the second counted */
+  uint32_t win_probes;
+  struct probe_sender set[ESP_WIFI_PROBE_SETS][ESP_WIFI_PROBE_WAYS];
+};
+
+static uint8_t probe_hash(const uint8_t mac[6])
+{
+  uint32_t v;
+
+  /* As esp_wifi_ap_sta, the NIC bytes carry the entropy */
+
+  v = ((uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 |
+       (uint32_t)mac[4] << 8 | mac[5]) ^ ((uint32_t)mac[0] << 8 | mac[1]);
+  return (v * 0x9e3779b1u) >> PROBE_SHIFT;
+}
+
+static struct probe_sender *probe_find(const esp_wifi_probe_t *probe,
+                                       const uint8_t mac[6])
+{
+  const struct probe_sender *ways = probe->set[probe_hash(mac)];
+  int w;
+
+  for (w = 0; w < ESP_WIFI_PROBE_WAYS; w++)
+    {
+      if (ways[w].used && memcmp(ways[w].mac, mac, 6) == 0)
+        {
+          return (struct probe_sender *)&ways[w];
+        }
+    }
+
+  return NULL;
+}
+
+static uint32_t probe_tokens(const esp_wifi_probe_t *probe,
+                             const struct probe_sender *s, uint32_t now_ms)
+{
+  uint32_t cap = (uint32_t)probe->cfg.burst * PROBE_TOKEN;
+  uint32_t elapsed = now_ms - s->last_ms;
+
+  /* rate probes per second is rate units per ms */
+
+  if (elapsed >= cap / probe->cfg.rate)
+    {
+      return cap;
+    }
+
+  elapsed *= probe->cfg.rate;
+  return s->tokens + elapsed > cap ? cap : s->tokens + elapsed;
+}
+
+/* The sender of mac. A new one takes the way whose bucket is the
+ * fullest: a sender forgotten comes back with a full bucket, so a
+ * quiet sender is forgotten at no cost and one in debt stays limited
+ * however many others pass by.
+ */
+
+static struct probe_sender *probe_lookup(esp_wifi_probe_t *probe,
+                                         const uint8_t mac[6],
+                                         uint32_t now_ms)
+{
+  struct probe_sender *ways = probe->set[probe_hash(mac)];
+  struct probe_sender *s = NULL;
+  uint32_t best = 0;
+  uint32_t tokens;
+  int w;
+
+  for (w = 0; w < ESP_WIFI_PROBE_WAYS; w++)
+    {
+      if (!ways[w].used)
+        {
+          s = &ways[w];
+          best = UINT32_MAX;
+          continue;
+        }
+
+      if (memcmp(ways[w].mac, mac, 6) == 0)
+        {
+          return &ways[w];
+        }
+
+      tokens = probe_tokens(probe, &ways[w], now_ms);
+      if (s == NULL || tokens > best)
+        {
+          s = &ways[w];
+          best = tokens;
+        }
+    }
+
+  if (s->used)
+    {
+      probe->stats.evictions++;
+    }
+
+  memset(s, 0, sizeof(*s));
+  memcpy(s->mac, mac, 6);
+  s->used = true;
+  s->last_ms = now_ms;
+  s->tokens = (uint32_t)probe->cfg.burst * PROBE_TOKEN;
+  return s;
+}
+
+static void probe_refill(const esp_wifi_probe_t *probe,
+                         struct probe_sender *s, uint32_t now_ms)
+{
+  s->tokens = probe_tokens(probe, s, now_ms);
+  s->last_ms = now_ms;
+}
+
+static void probe_window(esp_wifi_probe_t *probe, uint32_t now_ms)
+{
+  uint32_t elapsed = now_ms - probe->win_ms;
+  uint32_t pps;
+
+  if (elapsed < PROBE_WINDOW_MS)
+    {
+      return;
+    }
+
+  pps = (uint64_t)probe->win_probes * 1000 / elapsed;
+  if (!probe->suppress && pps > probe->cfg.flood_pps)
+    {
+      probe->suppress = true;
+      probe->stats.floods++;
+    }
+  else if (probe->suppress && pps < probe->cfg.calm_pps)
+    {
+      probe->suppress = false;
+    }
+
+  probe->win_ms = now_ms;
+  probe->win_probes = 0;
+}
+
+void esp_wifi_probe_default(esp_wifi_probe_config_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->rate = 2;
+  cfg->burst = 4;
+  cfg->flood_pps = 200;
+  cfg->calm_pps = 100;
+}
+
+esp_err_t esp_wifi_probe_create(const esp_wifi_probe_config_t *cfg,
+                                esp_wifi_probe_t **probe)
+{
+  esp_wifi_probe_t *p;
+
+  if (cfg == NULL || probe == NULL || cfg->rate == 0 || cfg->burst == 0 ||
+      cfg->calm_pps >= cfg->flood_pps)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  p = calloc(1, sizeof(*p));
+  if (p == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  p->cfg = *cfg;
+  *probe = p;
+  return ESP_OK;
+}
+
+void esp_wifi_probe_delete(esp_wifi_probe_t *probe)
+{
+  free(probe);
+}
+
+esp_err_t esp_wifi_probe_parse(const uint8_t *frame, size_t len,
+                               uint8_t mac[6], bool *wildcard)
+{
+  if (len < 2 || frame[0] != PROBE_FC_REQ)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  /* The SSID element comes first */
+
+  if (len < PROBE_HDR_LEN + 2)
+    {
+      return ESP_ERR_INVALID_SIZE;
+    }
+
+  if (frame[PROBE_HDR_LEN] != 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  memcpy(mac, frame + 10, 6);
+  *wildcard = frame[PROBE_HDR_LEN + 1] == 0;
+  return ESP_OK;
+}
+
+esp_wifi_probe_verdict_t esp_wifi_probe_rx(esp_wifi_probe_t *probe,
+                                           const uint8_t mac[6],
+                                           int8_t rssi, bool wildcard,
+                                           uint32_t now_ms)
+{
+  struct probe_sender *s;
+
+  if (probe->stats.probes == 0)
+    {
+      probe->win_ms = now_ms;
+    }
+
+  probe_window(probe, now_ms);
+  probe->win_probes++;
+  probe->stats.probes++;
+  probe->stats.wildcard += wildcard;
+
+  s = probe_lookup(probe, mac, now_ms);
+  probe_refill(probe, s, now_ms);
+  s->rssi = rssi;
+  s->probes++;
+  s->wildcard += wildcard;
+
+  /* A suppressed probe goes unanswered, it does not take a token */
+
+  if (wildcard && probe->suppress)
+    {
+      probe->stats.suppressed++;
+      return ESP_WIFI_PROBE_SUPPRESSED;
+    }
+
+  if (s->tokens < PROBE_TOKEN)
+    {
+      s->limited++;
+      probe->stats.limited++;
+      return ESP_WIFI_PROBE_LIMITED;
+    }
+
+  s->tokens -= PROBE_TOKEN;
+  probe->stats.passed++;
+  return ESP_WIFI_PROBE_PASS;
+}
+
+bool esp_wifi_probe_tick(esp_wifi_probe_t *probe, uint32_t now_ms)
+{
+  if (probe->stats.probes != 0)
+    {
+      probe_window(probe, now_ms);
+    }
+
+  return probe->suppress;
+}
+
+esp_err_t esp_wifi_probe_get_sender(const esp_wifi_probe_t *probe,
+                                    const uint8_t mac[6],
+                                    esp_wifi_probe_sender_t *sender)
+{
+  const struct probe_sender *s = probe_find(probe, mac);
+
+  if (s == NULL)
+    {
+      return ESP_ERR_NOT_FOUND;
+    }
+
+  memcpy(sender->mac, s->mac, 6);
+  sender->rssi = s->rssi;
+  sender->last_ms = s->last_ms;
+  sender->probes = s->probes;
+  sender->limited = s->limited;
+  sender->wildcard = s->wildcard;
+  return ESP_OK;
+}
+
+void esp_wifi_probe_get_stats(const esp_wifi_probe_t *probe,
+                              esp_wifi_probe_stats_t *stats)
+{
+  *stats = probe->stats;
+}
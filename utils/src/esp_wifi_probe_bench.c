@@ -0,0 +1,190 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_wifi_probe.h"
+
+#define PROBE_BENCH_SENDERS (4 * ESP_WIFI_PROBE_SETS * ESP_WIFI_PROBE_WAYS)
+#define PROBE_BENCH_HEAVY   (PROBE_BENCH_SENDERS / 8)
+#define PROBE_BENCH_LEN     48           /* header, SSID, rates, FCS */
+#define PROBE_BENCH_WILD    0x8000       /* in a replayed probe */
+
+/* Probe request of a sender, wildcard or for "expo" */
+
+static uint8_t s_frames[PROBE_BENCH_SENDERS][2][PROBE_BENCH_LEN];
+
+static uint32_t probe_bench_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static void probe_bench_frame(uint8_t *f, uint32_t v, bool wildcard)
+{
+  static const uint8_t rates[] =
+  {
+    0x01, 0x08, 0x82, 0x84, 0x8b, 0x96, 0x0c, 0x12, 0x18, 0x24
+  };
+
+  uint8_t *p;
+
+  memset(f, 0, PROBE_BENCH_LEN);
+  f[0] = 0x40;
+  memset(f + 4, 0xff, 6);
+  f[10] = 0x02;                  /* locally administered, randomized */
+  f[11] = v >> 24;
+  f[12] = v >> 16;
+  f[13] = v >> 8;
+  f[14] = v;
+  f[15] = v >> 5;
+  memset(f + 16, 0xff, 6);
+
+  p = f + 24;
+  *p++ = 0;
+  if (!wildcard)
+    {
+      *p++ = 4;
+      memcpy(p, "expo", 4);
+      p += 4;
+    }
+  else
+    {
+      *p++ = 0;
+    }
+
+  memcpy(p, rates, sizeof(rates));
+}
+
+static uint32_t probe_bench_ns(clock_t cpu, uint32_t probes)
+{
+  return (uint32_t)((double)cpu * 1e9 / CLOCKS_PER_SEC / probes);
+}
+
+esp_err_t esp_wifi_probe_bench(uint32_t pps, uint32_t seconds,
+                               uint32_t seed,
+                               esp_wifi_probe_bench_t *result)
+{
+  esp_wifi_probe_config_t cfg;
+  esp_wifi_probe_stats_t stats;
+  esp_wifi_probe_t *probe;
+  volatile uint32_t sink = 0;
+  uint32_t rng = seed ? seed : 1;
+  uint16_t *replay;
+  uint32_t probes;
+  uint32_t now_ms;
+  uint32_t tick_ms;
+  uint32_t k;
+  uint32_t v;
+  const uint8_t *f;
+  uint8_t mac[6];
+  bool wildcard;
+  clock_t c0;
+  int s;
+  esp_err_t ret;
+
+  if (result == NULL || pps == 0 || seconds == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  probes = pps * seconds;
+  replay = malloc(probes * sizeof(*replay));
+  if (replay == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  esp_wifi_probe_default(&cfg);
+  ret = esp_wifi_probe_create(&cfg, &probe);
+  if (ret != ESP_OK)
+    {
+      free(replay);
+      return ret;
+    }
+
+  for (s = 0; s < PROBE_BENCH_SENDERS; s++)
+    {
+      v = probe_bench_rand(&rng);
+      probe_bench_frame(s_frames[s][0], v, false);
+      probe_bench_frame(s_frames[s][1], v, true);
+    }
+
+  for (k = 0; k < probes; k++)
+    {
+      v = probe_bench_rand(&rng);
+      s = (v & 1) ? (v >> 1) % PROBE_BENCH_HEAVY :
+                    (v >> 1) % PROBE_BENCH_SENDERS;
+      replay[k] = s | ((v >> 16) % 4 != 0 ? PROBE_BENCH_WILD : 0);
+    }
+
+  memset(result, 0, sizeof(*result));
+  result->probes = probes;
+
+  c0 = clock();
+  for (k = 0; k < probes; k++)
+    {
+      f = s_frames[replay[k] & ~PROBE_BENCH_WILD]
+                  [!!(replay[k] & PROBE_BENCH_WILD)];
+      esp_wifi_probe_parse(f, PROBE_BENCH_LEN, mac, &wildcard);
+      sink += mac[5] + wildcard;
+    }
+
+  result->parse_ns_per_probe = probe_bench_ns(clock() - c0, probes);
+
+  /* Ticked when a second ends, as by the timer of the target */
+
+  tick_ms = 1000;
+  c0 = clock();
+  for (k = 0; k < probes; k++)
+    {
+      now_ms = (uint64_t)k * 1000 / pps;
+      if (now_ms >= tick_ms)
+        {
+          if (esp_wifi_probe_tick(probe, now_ms))
+            {
+              result->suppressed_ms += 1000;
+            }
+
+          tick_ms += 1000;
+        }
+
+      f = s_frames[replay[k] & ~PROBE_BENCH_WILD]
+                  [!!(replay[k] & PROBE_BENCH_WILD)];
+      if (esp_wifi_probe_parse(f, PROBE_BENCH_LEN, mac,
+                               &wildcard) == ESP_OK)
+        {
+          esp_wifi_probe_rx(probe, mac, -60, wildcard, now_ms);
+        }
+    }
+
+  result->ns_per_probe = probe_bench_ns(clock() - c0, probes);
+
+  esp_wifi_probe_get_stats(probe, &stats);
+  result->passed = stats.passed;
+  result->limited = stats.limited;
+  result->suppressed = stats.suppressed;
+  result->evictions = stats.evictions;
+
+  esp_wifi_probe_delete(probe);
+  free(replay);
+  return ESP_OK;
+}
@@ -0,0 +1,255 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_probe.h"
+
+#define PROBE_TICK_US       1000000
+
+/* For the event masks, as esp_bit_defs.h */
+
+#ifndef BIT
+#  define BIT(nr)           (1UL << (nr))
+#endif
+
+static esp_wifi_probe_t *s_probe;
+static esp_wifi_probe_cb_t s_cb;
+static void *s_arg;
+static void *s_lock;
+static esp_timer_handle_t s_timer;
+static bool s_promisc;
+static bool s_hidden;
+static bool s_keep;              /* hiding off or left to the application */
+
+/* Event mask before start */
+
+static uint32_t s_mask = WIFI_EVENT_MASK_AP_PROBEREQRECVED;
+
+static uint32_t probe_now_ms(void)
+{
+  return esp_timer_get_time() / 1000;
+}
+
+static void probe_feed(const uint8_t mac[6], int8_t rssi, bool wildcard)
+{
+  esp_wifi_probe_verdict_t verdict = ESP_WIFI_PROBE_LIMITED;
+  esp_wifi_probe_cb_t cb = NULL;
+  void *arg = NULL;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_probe)
+    {
+      verdict = esp_wifi_probe_rx(s_probe, mac, rssi, wildcard,
+                                  probe_now_ms());
+      cb = s_cb;
+      arg = s_arg;
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  if (verdict == ESP_WIFI_PROBE_PASS && cb)
+    {
+      cb(arg, mac, rssi, wildcard);
+    }
+}
+
+static void probe_rx_cb(void *buf, wifi_promiscuous_pkt_type_t type)
+{
+  const wifi_promiscuous_pkt_t *pkt = buf;
+  uint8_t mac[6];
+  bool wildcard;
+
+  if (type != WIFI_PKT_MGMT ||
+      esp_wifi_probe_parse(pkt->payload, pkt->rx_ctrl.sig_len, mac,
+                           &wildcard) != ESP_OK)
+    {
+      return;
+    }
+
+  probe_feed(mac, pkt->rx_ctrl.rssi, wildcard);
+}
+
+static void probe_event_handler(void *arg, esp_event_base_t base,
+                                int32_t id, void *data)
+{
+  const wifi_event_ap_probe_req_rx_t *req = data;
+
+  probe_feed(req->mac, req->rssi, false);
+}
+
+/* The driver answers wildcard probes unless the SSID is hidden */
+
+static void probe_hide(bool hide)
+{
+  wifi_config_t conf;
+
+  if (s_keep || hide == s_hidden ||
+      esp_wifi_get_config(WIFI_IF_AP, &conf) != ESP_OK)
+    {
+      return;
+    }
+
+  conf.ap.ssid_hidden = hide;
+  if (esp_wifi_set_config(WIFI_IF_AP, &conf) == ESP_OK)
+    {
+      s_hidden = hide;
+    }
+}
+
+static void probe_timer_cb(void *arg)
+{
+  bool suppress = false;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_probe)
+    {
+      suppress = esp_wifi_probe_tick(s_probe, probe_now_ms());
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  probe_hide(suppress);
+}
+
+esp_err_t esp_wifi_probe_start(esp_wifi_probe_t *probe, bool promisc,
+                               bool hide, esp_wifi_probe_cb_t cb,
+                               void *arg)
+{
+  esp_timer_create_args_t args =
+  {
+    .callback = probe_timer_cb,
+    .name = "wifi_probe",
+  };
+
+  wifi_promiscuous_filter_t filter =
+  {
+    .filter_mask = WIFI_PROMIS_FILTER_MASK_MGMT,
+  };
+
+  wifi_config_t conf;
+  esp_err_t ret;
+
+  if (probe == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  if (s_timer == NULL)
+    {
+      ret = esp_timer_create(&args, &s_timer);
+      if (ret != ESP_OK)
+        {
+          return ret;
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_probe)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  s_probe = probe;
+  s_cb = cb;
+  s_arg = arg;
+  s_promisc = promisc;
+  s_hidden = false;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  s_keep = !hide || esp_wifi_get_config(WIFI_IF_AP, &conf) != ESP_OK ||
+           conf.ap.ssid_hidden;
+
+  if (promisc)
+    {
+      ret = esp_wifi_set_promiscuous_filter(&filter);
+      if (ret == ESP_OK)
+        {
+          ret = esp_wifi_set_promiscuous_rx_cb(probe_rx_cb);
+        }
+
+      if (ret == ESP_OK)
+        {
+          ret = esp_wifi_set_promiscuous(true);
+        }
+    }
+  else
+    {
+      ret = esp_wifi_get_event_mask(&s_mask);
+      if (ret == ESP_OK)
+        {
+          ret = esp_event_handler_register(WIFI_EVENT,
+                                           WIFI_EVENT_AP_PROBEREQRECVED,
+                                           probe_event_handler, NULL);
+        }
+
+      if (ret == ESP_OK)
+        {
+          ret = esp_wifi_set_event_mask(s_mask &
+                                        ~WIFI_EVENT_MASK_AP_PROBEREQRECVED);
+        }
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_timer_start_periodic(s_timer, PROBE_TICK_US);
+    }
+
+  if (ret != ESP_OK)
+    {
+      esp_wifi_probe_stop();
+    }
+
+  return ret;
+}
+
+void esp_wifi_probe_stop(void)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  s_probe = NULL;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  esp_timer_stop(s_timer);
+  if (s_promisc)
+    {
+      esp_wifi_set_promiscuous(false);
+    }
+  else
+    {
+      esp_wifi_set_event_mask(s_mask);
+      esp_event_handler_unregister(WIFI_EVENT, WIFI_EVENT_AP_PROBEREQRECVED,
+                                   probe_event_handler);
+    }
+
+  probe_hide(false);
+}
@@ -0,0 +1,379 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+
+#include "esp_wifi_ps_sim.h"
+
+/* Frames held by the AP while the station sleeps. Only the aggregate is
+ * needed since all of them are flushed together on the next wake up.
+ */
+
+struct ps_sim_backlog
+{
+  uint32_t count;
+  uint32_t bytes;
+  uint64_t arrival_sum;
+  uint64_t first_arrival;
+};
+
+struct ps_sim
+{
+  const esp_ps_sim_ap_t *ap;
+  const esp_ps_sim_policy_t *policy;
+  esp_ps_sim_result_t *res;
+
+  uint64_t on_start;
+  uint64_t on_end;
+  bool on;
+  uint64_t last_tx;
+
+  struct ps_sim_backlog ucast;
+  struct ps_sim_backlog group;
+
+  uint64_t rx_latency_sum;
+  uint64_t tx_latency_sum;
+  uint32_t tx_count;
+};
+
+static uint32_t ps_sim_airtime(const struct ps_sim *sim, uint32_t bytes)
+{
+  return (uint32_t)((uint64_t)bytes * 8 * 1000 / sim->ap->phy_rate_kbps);
+}
+
+static bool ps_sim_awake(const struct ps_sim *sim, uint64_t t)
+{
+  return sim->policy->ps == WIFI_PS_NONE ||
+         (sim->on && t >= sim->on_start && t < sim->on_end);
+}
+
+/* Keep the radio on over [start, end), merging with the current awake
+ * window when they overlap.
+ */
+
+static void ps_sim_radio_on(struct ps_sim *sim, uint64_t start, uint64_t end)
+{
+  if (sim->on && start <= sim->on_end)
+    {
+      if (end > sim->on_end)
+        {
+          sim->on_end = end;
+        }
+
+      return;
+    }
+
+  if (sim->on)
+    {
+      sim->res->radio_on_us += sim->on_end - sim->on_start;
+    }
+
+  sim->on = true;
+  sim->on_start = start;
+  sim->on_end = end;
+  sim->res->wakes++;
+}
+
+static void ps_sim_deliver(struct ps_sim *sim, struct ps_sim_backlog *bl,
+                           uint64_t t)
+{
+  uint64_t done;
+  uint64_t latency;
+
+  if (bl->count == 0)
+    {
+      return;
+    }
+
+  done = t + ps_sim_airtime(sim, bl->bytes);
+  latency = done - bl->first_arrival;
+
+  sim->rx_latency_sum += bl->count * done - bl->arrival_sum;
+  if (latency > sim->res->rx_latency_max_us)
+    {
+      sim->res->rx_latency_max_us = (uint32_t)latency;
+    }
+
+  sim->res->rx_count += bl->count;
+  ps_sim_radio_on(sim, t, done + sim->policy->sleep_delay_us);
+  memset(bl, 0, sizeof(*bl));
+}
+
+static void ps_sim_queue(struct ps_sim_backlog *bl,
+                         const esp_ps_sim_pkt_t *pkt)
+{
+  if (bl->count == 0)
+    {
+      bl->first_arrival = pkt->time_us;
+    }
+
+  bl->count++;
+  bl->bytes += pkt->len;
+  bl->arrival_sum += pkt->time_us;
+}
+
+static void ps_sim_tx(struct ps_sim *sim, uint64_t t, uint32_t len,
+                      bool data)
+{
+  uint64_t start = t;
+  uint32_t air = ps_sim_airtime(sim, len);
+
+  /* Waking up for TX costs the same as waking up for a beacon */
+
+  if (!ps_sim_awake(sim, t))
+    {
+      start = t + sim->policy->wake_ahead_us;
+    }
+
+  ps_sim_radio_on(sim, t, start + air + sim->policy->sleep_delay_us);
+  sim->res->tx_us += air;
+  sim->last_tx = t;
+
+  if (data)
+    {
+      sim->tx_latency_sum += start + air - t;
+      sim->tx_count++;
+    }
+
+  /* The frame carries PM=0, so the AP flushes what it holds */
+
+  ps_sim_deliver(sim, &sim->ucast, start + air);
+}
+
+static void ps_sim_beacon(struct ps_sim *sim, uint64_t tbtt, uint64_t idx)
+{
+  const esp_ps_sim_policy_t *policy = sim->policy;
+  uint32_t every;
+  uint64_t t;
+  bool dtim = idx % sim->ap->dtim_period == 0;
+
+  if (policy->ps == WIFI_PS_NONE)
+    {
+      return;
+    }
+
+  if (policy->keep_alive_us != 0 &&
+      tbtt - sim->last_tx >= policy->keep_alive_us)
+    {
+      sim->res->keep_alives++;
+      ps_sim_tx(sim, tbtt, 0, false);
+    }
+
+  if (policy->ps == WIFI_PS_MIN_MODEM)
+    {
+      every = sim->ap->dtim_period;
+    }
+  else
+    {
+      every = policy->listen_interval ? policy->listen_interval : 3;
+    }
+
+  if (idx % every != 0 && !ps_sim_awake(sim, tbtt))
+    {
+      return;
+    }
+
+  t = tbtt + sim->ap->beacon_rx_us;
+  ps_sim_radio_on(sim, tbtt > policy->wake_ahead_us ?
+                  tbtt - policy->wake_ahead_us : 0, t);
+
+  if (dtim)
+    {
+      ps_sim_deliver(sim, &sim->group, t);
+    }
+
+  if (sim->ucast.count != 0)
+    {
+      ps_sim_deliver(sim, &sim->ucast, t + sim->ap->ps_poll_us);
+    }
+}
+
+static void ps_sim_pkt(struct ps_sim *sim, const esp_ps_sim_pkt_t *pkt)
+{
+  switch (pkt->dir)
+    {
+      case ESP_PS_SIM_TX:
+        ps_sim_tx(sim, pkt->time_us, pkt->len, true);
+        break;
+
+      case ESP_PS_SIM_RX:
+        ps_sim_queue(&sim->ucast, pkt);
+        if (ps_sim_awake(sim, pkt->time_us))
+          {
+            ps_sim_deliver(sim, &sim->ucast, pkt->time_us);
+          }
+        break;
+
+      default:
+        ps_sim_queue(&sim->group, pkt);
+        if (ps_sim_awake(sim, pkt->time_us))
+          {
+            ps_sim_deliver(sim, &sim->group, pkt->time_us);
+          }
+        break;
+    }
+}
+
+void esp_ps_sim_default(esp_ps_sim_ap_t *ap, esp_ps_sim_power_t *power)
+{
+  if (ap)
+    {
+      ap->beacon_interval = 100;
+      ap->dtim_period = 1;
+      ap->phy_rate_kbps = 54000;
+      ap->beacon_rx_us = 2000;
+      ap->ps_poll_us = 300;
+    }
+
+  if (power)
+    {
+      power->rx_ua = 100000;
+      power->tx_ua = 190000;
+      power->sleep_ua = 800;
+      power->voltage_mv = 3300;
+    }
+}
+
+esp_err_t esp_ps_sim_run(const esp_ps_sim_ap_t *ap,
+                         const esp_ps_sim_power_t *power,
+                         const esp_ps_sim_policy_t *policy,
+                         const esp_ps_sim_pkt_t *pkts, size_t npkts,
+                         esp_ps_sim_result_t *result)
+{
+  struct ps_sim sim;
+  uint64_t period;
+  uint64_t tbtt;
+  uint64_t idx;
+  uint64_t end;
+  uint64_t charge;
+  size_t i;
+
+  if (ap == NULL || power == NULL || policy == NULL || result == NULL ||
+      (pkts == NULL && npkts != 0) || ap->beacon_interval == 0 ||
+      ap->dtim_period == 0 || ap->phy_rate_kbps == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  for (i = 1; i < npkts; i++)
+    {
+      if (pkts[i].time_us < pkts[i - 1].time_us)
+        {
+          return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+  memset(result, 0, sizeof(*result));
+  memset(&sim, 0, sizeof(sim));
+  sim.ap = ap;
+  sim.policy = policy;
+  sim.res = result;
+
+  period = (uint64_t)ap->beacon_interval * ESP_PS_SIM_TU_US;
+  end = npkts ? pkts[npkts - 1].time_us : 0;
+
+  /* Run long enough for the last buffered frame to be delivered */
+
+  end += period * ((policy->listen_interval ? policy->listen_interval : 3) +
+                   ap->dtim_period + 1);
+
+  tbtt = period;
+  idx = 1;
+  for (i = 0; i < npkts; i++)
+    {
+      while (tbtt <= pkts[i].time_us)
+        {
+          ps_sim_beacon(&sim, tbtt, idx++);
+          tbtt += period;
+        }
+
+      ps_sim_pkt(&sim, &pkts[i]);
+    }
+
+  while (tbtt <= end)
+    {
+      ps_sim_beacon(&sim, tbtt, idx++);
+      tbtt += period;
+    }
+
+  result->duration_us = end;
+  if (policy->ps == WIFI_PS_NONE)
+    {
+      result->radio_on_us = end;
+      result->wakes = 1;
+    }
+  else if (sim.on)
+    {
+      result->radio_on_us += sim.on_end - sim.on_start;
+    }
+
+  if (result->radio_on_us > end)
+    {
+      result->radio_on_us = end;
+    }
+
+  if (result->rx_count)
+    {
+      result->rx_latency_avg_us =
+        (uint32_t)(sim.rx_latency_sum / result->rx_count);
+    }
+
+  if (sim.tx_count)
+    {
+      result->tx_latency_avg_us =
+        (uint32_t)(sim.tx_latency_sum / sim.tx_count);
+    }
+
+  /* uA * us * mV = 1e-15 J */
+
+  charge = result->radio_on_us * power->rx_ua +
+           result->tx_us * (power->tx_ua > power->rx_ua ?
+                            power->tx_ua - power->rx_ua : 0) +
+           (end - result->radio_on_us) * power->sleep_ua;
+  result->energy_uj = charge / 1000 * power->voltage_mv / 1000000;
+  result->avg_current_ua = end ? (uint32_t)(charge / end) : 0;
+
+  return ESP_OK;
+}
+
+size_t esp_ps_sim_pareto(esp_ps_sim_result_t *results, size_t n)
+{
+  size_t count = 0;
+  size_t i;
+  size_t j;
+
+  for (i = 0; i < n; i++)
+    {
+      results[i].pareto = true;
+
+      for (j = 0; j < n; j++)
+        {
+          if (j != i &&
+              results[j].energy_uj <= results[i].energy_uj &&
+              results[j].rx_latency_avg_us <= results[i].rx_latency_avg_us &&
+              (results[j].energy_uj < results[i].energy_uj ||
+               results[j].rx_latency_avg_us < results[i].rx_latency_avg_us))
+            {
+              results[i].pareto = false;
+              break;
+            }
+        }
+
+      if (results[i].pareto)
+        {
+          count++;
+        }
+    }
+
+  return count;
+}
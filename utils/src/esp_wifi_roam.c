@@ -0,0 +1,571 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_roam.h"
+
+/* RSSI is filtered in 1/16 dB, the trend in 1/16 dB per second. A trend
+ * never moves the projection by more than ROAM_TREND_CAP dB.
+ */
+
+#define ROAM_TREND_CAP      10
+
+/* Every ROAM_EXPLORE_EVERY scan sweeps the channel mask, to find APs the
+ * neighbor list does not know yet
+ */
+
+#define ROAM_EXPLORE_EVERY  4
+
+enum roam_state
+{
+  ROAM_IDLE = 0,                 /* above the soft threshold */
+  ROAM_SCANNING,
+  ROAM_ROAMING,
+};
+
+struct roam_track
+{
+  int32_t rssi_x16;
+  int32_t trend_x16;
+  int64_t seen_ms;
+};
+
+struct roam_nb
+{
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t load;
+  bool heard;                    /* seen in a scan, not only reported */
+  struct roam_track t;
+  int64_t fail_ms;               /* last failed roam to it */
+};
+
+struct esp_wifi_roam
+{
+  esp_wifi_roam_config_t cfg;
+  esp_wifi_roam_stats_t stats;
+  enum roam_state state;
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  bool connected;
+  bool link_valid;
+  uint8_t bssid[6];
+  uint8_t channel;
+  struct roam_track link;
+  int64_t next_scan_ms;
+  int64_t roam_ms;
+  int64_t hold_ms;               /* soft roams allowed from */
+  uint8_t target[6];
+  uint8_t last_channel;
+  uint8_t sweep_channel;
+  uint8_t scan_count;
+  uint8_t n;
+  struct roam_nb nb[ESP_WIFI_ROAM_MAX_NEIGHBORS];
+};
+
+static void roam_track_update(struct roam_track *t, bool fresh, int8_t rssi,
+                              int64_t now_ms)
+{
+  int32_t prev = t->rssi_x16;
+  int64_t dt = now_ms - t->seen_ms;
+
+  if (!fresh)
+    {
+      t->rssi_x16 = rssi * 16;
+      t->trend_x16 = 0;
+    }
+  else
+    {
+      t->rssi_x16 += (rssi * 16 - t->rssi_x16) / 4;
+      if (dt > 0)
+        {
+          t->trend_x16 += ((t->rssi_x16 - prev) * 1000 / dt -
+                           t->trend_x16) / 4;
+        }
+    }
+
+  t->seen_ms = now_ms;
+}
+
+/* Projected RSSI in 1/16 dB */
+
+static int32_t roam_project(const esp_wifi_roam_t *eng,
+                            const struct roam_track *t)
+{
+  int32_t d = (int64_t)t->trend_x16 * eng->cfg.horizon_ms / 1000;
+
+  if (d > ROAM_TREND_CAP * 16)
+    {
+      d = ROAM_TREND_CAP * 16;
+    }
+  else if (d < -ROAM_TREND_CAP * 16)
+    {
+      d = -ROAM_TREND_CAP * 16;
+    }
+
+  return t->rssi_x16 + d;
+}
+
+static int32_t roam_score(const esp_wifi_roam_t *eng,
+                          const struct roam_nb *nb, int64_t now_ms)
+{
+  int32_t s = roam_project(eng, &nb->t);
+
+  s -= nb->load * eng->cfg.load_weight * 16 / 255;
+  if (eng->cfg.pmksa &&
+      esp_wifi_ent_pmksa_cached(eng->cfg.pmksa, nb->bssid, now_ms / 1000))
+    {
+      s += eng->cfg.pmksa_bonus * 16;
+    }
+
+  return s;
+}
+
+static bool roam_usable(const esp_wifi_roam_t *eng, const struct roam_nb *nb,
+                        int64_t now_ms)
+{
+  return nb->heard && now_ms - nb->t.seen_ms <= eng->cfg.stale_ms &&
+         (nb->fail_ms == 0 || now_ms - nb->fail_ms >= eng->cfg.hold_ms) &&
+         memcmp(nb->bssid, eng->bssid, 6) != 0;
+}
+
+static struct roam_nb *roam_find(esp_wifi_roam_t *eng, const uint8_t *bssid)
+{
+  int i;
+
+  for (i = 0; i < eng->n; i++)
+    {
+      if (memcmp(eng->nb[i].bssid, bssid, 6) == 0)
+        {
+          return &eng->nb[i];
+        }
+    }
+
+  return NULL;
+}
+
+/* Slot for a new neighbor, the one seen longest ago makes room */
+
+static struct roam_nb *roam_alloc(esp_wifi_roam_t *eng)
+{
+  struct roam_nb *old;
+  int i;
+
+  if (eng->n < ESP_WIFI_ROAM_MAX_NEIGHBORS)
+    {
+      old = &eng->nb[eng->n++];
+      memset(old, 0, sizeof(*old));
+      return old;
+    }
+
+  /* Reported neighbors never heard go first */
+
+  old = &eng->nb[0];
+  for (i = 1; i < eng->n; i++)
+    {
+      if (eng->nb[i].heard < old->heard ||
+          (eng->nb[i].heard == old->heard &&
+           eng->nb[i].t.seen_ms < old->t.seen_ms))
+        {
+          old = &eng->nb[i];
+        }
+    }
+
+  return old;
+}
+
+static uint8_t roam_pick_channel(uint16_t mask, uint8_t *last)
+{
+  int ch;
+  int i;
+
+  for (i = 1; i <= 14; i++)
+    {
+      ch = (*last + i - 1) % 14 + 1;
+      if (mask & (1 << ch))
+        {
+          *last = ch;
+          return ch;
+        }
+    }
+
+  return 0;
+}
+
+static uint8_t roam_next_channel(esp_wifi_roam_t *eng, int64_t now_ms)
+{
+  uint16_t mask = 0;
+  int i;
+
+  for (i = 0; i < eng->n; i++)
+    {
+      if (memcmp(eng->nb[i].bssid, eng->bssid, 6) != 0 &&
+          (eng->nb[i].fail_ms == 0 ||
+           now_ms - eng->nb[i].fail_ms >= eng->cfg.hold_ms))
+        {
+          mask |= 1 << eng->nb[i].channel;
+        }
+    }
+
+  if (mask == 0 || ++eng->scan_count % ROAM_EXPLORE_EVERY == 0)
+    {
+      return roam_pick_channel(eng->cfg.channel_mask, &eng->sweep_channel);
+    }
+
+  return roam_pick_channel(mask, &eng->last_channel);
+}
+
+void esp_wifi_roam_default(esp_wifi_roam_config_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->soft_threshold = -70;
+  cfg->hard_threshold = -80;
+  cfg->hysteresis = 6;
+  cfg->channel_mask = 0x3ffe;
+  cfg->scan_interval_ms = 500;
+  cfg->scan_time_ms = 30;
+  cfg->stale_ms = 3000;
+  cfg->horizon_ms = 2000;
+  cfg->load_weight = 10;
+  cfg->pmksa_bonus = 5;
+  cfg->roam_timeout_ms = 1000;
+  cfg->hold_ms = 5000;
+}
+
+esp_err_t esp_wifi_roam_create(const esp_wifi_roam_config_t *cfg,
+                               esp_wifi_roam_t **eng)
+{
+  esp_wifi_roam_t *e;
+
+  if (cfg == NULL || eng == NULL ||
+      cfg->hard_threshold > cfg->soft_threshold ||
+      (cfg->channel_mask & 0x7ffe) == 0 || cfg->scan_interval_ms == 0 ||
+      cfg->roam_timeout_ms == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  e = calloc(1, sizeof(*e));
+  if (e == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  e->cfg = *cfg;
+  e->cfg.channel_mask &= 0x7ffe;
+  *eng = e;
+  return ESP_OK;
+}
+
+void esp_wifi_roam_delete(esp_wifi_roam_t *eng)
+{
+  free(eng);
+}
+
+void esp_wifi_roam_get_config(esp_wifi_roam_t *eng,
+                              esp_wifi_roam_config_t *cfg)
+{
+  *cfg = eng->cfg;
+}
+
+void esp_wifi_roam_connected(esp_wifi_roam_t *eng, const uint8_t *ssid,
+                             uint8_t ssid_len, const uint8_t bssid[6],
+                             uint8_t channel, int64_t now_ms)
+{
+  uint32_t gap;
+
+  if (ssid_len > sizeof(eng->ssid))
+    {
+      ssid_len = sizeof(eng->ssid);
+    }
+
+  if (ssid_len != eng->ssid_len || memcmp(ssid, eng->ssid, ssid_len))
+    {
+      memcpy(eng->ssid, ssid, ssid_len);
+      eng->ssid_len = ssid_len;
+      eng->n = 0;
+    }
+
+  if (eng->state == ROAM_ROAMING)
+    {
+      gap = now_ms - eng->roam_ms;
+      eng->stats.last_gap_ms = gap;
+      if (gap > eng->stats.max_gap_ms)
+        {
+          eng->stats.max_gap_ms = gap;
+        }
+
+      eng->hold_ms = now_ms + eng->cfg.hold_ms;
+    }
+
+  eng->state = ROAM_IDLE;
+  eng->connected = true;
+  eng->link_valid = false;
+  memcpy(eng->bssid, bssid, 6);
+  eng->channel = channel;
+}
+
+void esp_wifi_roam_disconnected(esp_wifi_roam_t *eng, int64_t now_ms)
+{
+  eng->connected = false;
+  eng->link_valid = false;
+  if (eng->state != ROAM_ROAMING)
+    {
+      eng->state = ROAM_IDLE;
+    }
+}
+
+void esp_wifi_roam_rssi(esp_wifi_roam_t *eng, int8_t rssi, int64_t now_ms)
+{
+  if (!eng->connected)
+    {
+      return;
+    }
+
+  roam_track_update(&eng->link, eng->link_valid, rssi, now_ms);
+  eng->link_valid = true;
+}
+
+void esp_wifi_roam_scan_done(esp_wifi_roam_t *eng,
+                             const wifi_ap_record_t *aps, uint16_t n,
+                             int64_t now_ms)
+{
+  struct roam_nb *nb;
+  bool fresh;
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (strnlen((const char *)aps[i].ssid, sizeof(aps[i].ssid) - 1) !=
+          eng->ssid_len ||
+          memcmp(aps[i].ssid, eng->ssid, eng->ssid_len) != 0)
+        {
+          continue;
+        }
+
+      if (memcmp(aps[i].bssid, eng->bssid, 6) == 0 && eng->connected)
+        {
+          roam_track_update(&eng->link, eng->link_valid, aps[i].rssi,
+                            now_ms);
+          eng->link_valid = true;
+          continue;
+        }
+
+      nb = roam_find(eng, aps[i].bssid);
+      fresh = nb && nb->heard && now_ms - nb->t.seen_ms <= eng->cfg.stale_ms;
+      if (nb == NULL)
+        {
+          nb = roam_alloc(eng);
+          memset(nb, 0, sizeof(*nb));
+          memcpy(nb->bssid, aps[i].bssid, 6);
+        }
+
+      nb->channel = aps[i].primary;
+      nb->heard = true;
+      roam_track_update(&nb->t, fresh, aps[i].rssi, now_ms);
+    }
+}
+
+void esp_wifi_roam_add_neighbor(esp_wifi_roam_t *eng, const uint8_t bssid[6],
+                                uint8_t channel, int64_t now_ms)
+{
+  struct roam_nb *nb;
+
+  if (channel < 1 || channel > 14)
+    {
+      return;
+    }
+
+  nb = roam_find(eng, bssid);
+  if (nb == NULL)
+    {
+      /* A report does not push out a neighbor actually heard */
+
+      nb = roam_alloc(eng);
+      if (nb->heard)
+        {
+          return;
+        }
+
+      memset(nb, 0, sizeof(*nb));
+      memcpy(nb->bssid, bssid, 6);
+      nb->t.seen_ms = now_ms;
+    }
+
+  nb->channel = channel;
+}
+
+void esp_wifi_roam_set_load(esp_wifi_roam_t *eng, const uint8_t bssid[6],
+                            uint8_t load)
+{
+  struct roam_nb *nb = roam_find(eng, bssid);
+
+  if (nb)
+    {
+      nb->load = load;
+    }
+}
+
+bool esp_wifi_roam_next(esp_wifi_roam_t *eng, int64_t now_ms,
+                        esp_wifi_roam_action_t *act)
+{
+  struct roam_nb *best = NULL;
+  int32_t link;
+  int32_t score;
+  int32_t best_score = 0;
+  bool hard;
+  int i;
+
+  memset(act, 0, sizeof(*act));
+
+  if (eng->state == ROAM_ROAMING)
+    {
+      if (now_ms - eng->roam_ms < eng->cfg.roam_timeout_ms)
+        {
+          return true;
+        }
+
+      best = roam_find(eng, eng->target);
+      if (best)
+        {
+          best->fail_ms = now_ms;
+        }
+
+      eng->stats.failures++;
+      eng->state = ROAM_IDLE;
+      eng->hold_ms = now_ms + eng->cfg.hold_ms;
+      act->type = ESP_WIFI_ROAM_RECONNECT;
+      return false;
+    }
+
+  if (!eng->connected || !eng->link_valid ||
+      eng->link.rssi_x16 >= eng->cfg.soft_threshold * 16)
+    {
+      eng->state = ROAM_IDLE;
+      return false;
+    }
+
+  if (eng->state == ROAM_IDLE)
+    {
+      eng->state = ROAM_SCANNING;
+      eng->next_scan_ms = now_ms;
+    }
+
+  for (i = 0; i < eng->n; i++)
+    {
+      if (!roam_usable(eng, &eng->nb[i], now_ms))
+        {
+          continue;
+        }
+
+      score = roam_score(eng, &eng->nb[i], now_ms);
+      if (best == NULL || score > best_score)
+        {
+          best = &eng->nb[i];
+          best_score = score;
+        }
+    }
+
+  link = roam_project(eng, &eng->link);
+  hard = eng->link.rssi_x16 < eng->cfg.hard_threshold * 16;
+  if (best &&
+      ((hard && best_score > link) ||
+       (now_ms >= eng->hold_ms &&
+        best_score >= link + eng->cfg.hysteresis * 16)))
+    {
+      act->type = ESP_WIFI_ROAM_CONNECT;
+      act->channel = best->channel;
+      memcpy(act->bssid, best->bssid, 6);
+      memcpy(eng->target, best->bssid, 6);
+      eng->state = ROAM_ROAMING;
+      eng->roam_ms = now_ms;
+      eng->stats.roams++;
+      if (best_score < link + eng->cfg.hysteresis * 16)
+        {
+          eng->stats.hard_roams++;
+        }
+
+      return true;
+    }
+
+  if (now_ms >= eng->next_scan_ms)
+    {
+      act->type = ESP_WIFI_ROAM_SCAN;
+      act->channel = roam_next_channel(eng, now_ms);
+      eng->next_scan_ms = now_ms + (hard ? eng->cfg.scan_interval_ms / 2 :
+                                    eng->cfg.scan_interval_ms);
+      eng->stats.scans++;
+    }
+
+  return true;
+}
+
+void esp_wifi_roam_get_candidates(esp_wifi_roam_t *eng, int64_t now_ms,
+                                  esp_wifi_roam_candidate_t *cands,
+                                  uint8_t *n)
+{
+  esp_wifi_roam_candidate_t c;
+  struct roam_nb *nb;
+  uint8_t count = 0;
+  int i;
+  int j;
+
+  for (i = 0; i < eng->n; i++)
+    {
+      nb = &eng->nb[i];
+      if (!nb->heard)
+        {
+          continue;
+        }
+
+      memcpy(c.bssid, nb->bssid, 6);
+      c.channel = nb->channel;
+      c.load = nb->load;
+      c.rssi = nb->t.rssi_x16 / 16;
+      c.trend_x10 = nb->t.trend_x16 * 10 / 16;
+      c.score = roam_score(eng, nb, now_ms) / 16;
+      c.age_ms = now_ms - nb->t.seen_ms;
+
+      /* Insertion by score, the worst falls off a full array */
+
+      for (j = count; j > 0 && cands[j - 1].score < c.score; j--)
+        {
+          if (j < *n)
+            {
+              cands[j] = cands[j - 1];
+            }
+        }
+
+      if (j < *n)
+        {
+          cands[j] = c;
+          if (count < *n)
+            {
+              count++;
+            }
+        }
+    }
+
+  *n = count;
+}
+
+void esp_wifi_roam_get_stats(esp_wifi_roam_t *eng,
+                             esp_wifi_roam_stats_t *stats)
+{
+  *stats = eng->stats;
+}
@@ -0,0 +1,525 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_wifi_roam.h"
+
+/* The station walks along the row of APs and back. RSSI is -30 dBm at
+ * 1 m less the path loss, plus a slow shadowing walk per AP and a fast
+ * +/- 2 dB jitter per reading.
+ */
+
+#define ROAM_SIM_APS        16
+#define ROAM_SIM_STEP_MS    10
+#define ROAM_SIM_SAMPLE_MS  100
+#define ROAM_SIM_REF_DBM    (-30)
+#define ROAM_SIM_PER_LOW    (-75)        /* no loss above */
+#define ROAM_SIM_PER_HIGH   (-90)        /* all lost below */
+#define ROAM_SIM_DETECT     (-90)        /* weakest AP a scan finds */
+#define ROAM_SIM_BEACON_MS  6000         /* beacon timeout */
+
+enum roam_sim_pending
+{
+  ROAM_SIM_NONE = 0,
+  ROAM_SIM_SCAN,                 /* one channel, engine */
+  ROAM_SIM_FULL_SCAN,
+  ROAM_SIM_CONNECT,
+};
+
+struct roam_sim_sta
+{
+  esp_wifi_roam_t *eng;          /* NULL for the baseline */
+  int cur;                       /* AP index, -1 when down, -2 before
+                                  * the first connect
+                                  */
+  enum roam_sim_pending pending;
+  int target;                    /* AP or channel of the pending work */
+  int64_t busy_ms;               /* off channel or down until */
+  int64_t gap_ms;                /* link down since */
+  int64_t weak_ms;               /* below the beacon threshold since */
+  bool armed;                    /* baseline threshold event */
+  bool roaming;                  /* engine connect pending */
+  uint32_t rng;
+  uint64_t sent;                 /* packets, times 1000 */
+  uint64_t lost;
+  uint64_t gap_sum;
+  esp_wifi_roam_sim_stat_t *stat;
+};
+
+static const uint8_t s_ssid[] = "roam-sim";
+
+static uint32_t roam_sim_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+/* 100 log10(v), within 0.1 dB */
+
+static int32_t roam_sim_log10_x100(uint64_t v)
+{
+  int64_t f;
+  int64_t l2;
+  int msb = 0;
+
+  if (v < 2)
+    {
+      return 0;
+    }
+
+  while ((v >> (msb + 1)) != 0)
+    {
+      msb++;
+    }
+
+  /* log2(1 + f) ~ f (1.3466 - 0.3466 f), f in Q16 */
+
+  f = (int64_t)(((v - (1ull << msb)) << 16) >> msb);
+  l2 = ((int64_t)msb << 16) + f * (88252 - 22715 * f / 65536) / 65536;
+  return l2 * 30103 / 65536000;
+}
+
+static int roam_sim_rssi(const esp_wifi_roam_sim_t *sim, int64_t x_cm,
+                         int i, const int8_t *shadow)
+{
+  int64_t dx = x_cm - (int64_t)i * sim->spacing_cm;
+  uint64_t d2 = dx * dx + (uint64_t)sim->offset_cm * sim->offset_cm;
+
+  /* 10 log10(d in m) = 5 log10(d^2 in cm^2) - 20 */
+
+  return ROAM_SIM_REF_DBM + shadow[i] -
+         (int)((roam_sim_log10_x100(d2 + 1) / 2 - 200) *
+               sim->path_loss_x10 / 100);
+}
+
+static uint32_t roam_sim_per(int rssi)
+{
+  if (rssi >= ROAM_SIM_PER_LOW)
+    {
+      return 0;
+    }
+
+  if (rssi <= ROAM_SIM_PER_HIGH)
+    {
+      return 1000;
+    }
+
+  return (ROAM_SIM_PER_LOW - rssi) * 1000 /
+         (ROAM_SIM_PER_LOW - ROAM_SIM_PER_HIGH);
+}
+
+static int roam_sim_jitter(uint32_t *rng)
+{
+  return (int)(roam_sim_rand(rng) % 5) - 2;
+}
+
+static void roam_sim_record(const esp_wifi_roam_sim_t *sim,
+                            wifi_ap_record_t *ap, int i, int rssi)
+{
+  static const uint8_t channels[3] =
+  {
+    1, 6, 11
+  };
+
+  memset(ap, 0, sizeof(*ap));
+  ap->bssid[0] = 0x02;
+  ap->bssid[5] = i;
+  memcpy(ap->ssid, s_ssid, sizeof(s_ssid));
+  ap->primary = channels[i % 3];
+  ap->rssi = rssi;
+  ap->authmode = WIFI_AUTH_WPA2_PSK;
+}
+
+static void roam_sim_up(const esp_wifi_roam_sim_t *sim,
+                        struct roam_sim_sta *sta, int i, int64_t t)
+{
+  wifi_ap_record_t ap;
+  uint32_t gap = t - sta->gap_ms;
+
+  if (sta->cur != -2)
+    {
+      sta->stat->handoffs++;
+      sta->gap_sum += gap;
+      if (gap > sta->stat->gap_max_ms)
+        {
+          sta->stat->gap_max_ms = gap;
+        }
+    }
+
+  sta->cur = i;
+  sta->weak_ms = -1;
+  sta->armed = false;
+  sta->roaming = false;
+
+  if (sta->eng)
+    {
+      roam_sim_record(sim, &ap, i, 0);
+      esp_wifi_roam_connected(sta->eng, s_ssid, sizeof(s_ssid) - 1,
+                              ap.bssid, ap.primary, t);
+    }
+}
+
+static void roam_sim_down(struct roam_sim_sta *sta, int64_t t)
+{
+  sta->cur = -1;
+  sta->gap_ms = t;
+  if (sta->eng)
+    {
+      esp_wifi_roam_disconnected(sta->eng, t);
+    }
+}
+
+static void roam_sim_busy(struct roam_sim_sta *sta,
+                          enum roam_sim_pending pending, int target,
+                          int64_t until)
+{
+  sta->pending = pending;
+  sta->target = target;
+  sta->busy_ms = until;
+}
+
+/* Off-channel or connect work that ended */
+
+static void roam_sim_finish(const esp_wifi_roam_sim_t *sim,
+                            struct roam_sim_sta *sta, const int *rssi,
+                            int64_t t)
+{
+  wifi_ap_record_t aps[ROAM_SIM_APS];
+  uint16_t n = 0;
+  int best = -1;
+  int r;
+  int i;
+
+  switch (sta->pending)
+    {
+      case ROAM_SIM_SCAN:
+        for (i = 0; i < sim->aps; i++)
+          {
+            r = rssi[i] + roam_sim_jitter(&sta->rng);
+            roam_sim_record(sim, &aps[n], i, r);
+            if (aps[n].primary == sta->target && r > ROAM_SIM_DETECT)
+              {
+                n++;
+              }
+          }
+
+        esp_wifi_roam_scan_done(sta->eng, aps, n, t);
+        break;
+
+      case ROAM_SIM_FULL_SCAN:
+        for (i = 0; i < sim->aps; i++)
+          {
+            r = rssi[i] + roam_sim_jitter(&sta->rng);
+            roam_sim_record(sim, &aps[n++], i, r);
+            if (r > ROAM_SIM_DETECT && (best < 0 || r > aps[best].rssi))
+              {
+                best = i;
+              }
+          }
+
+        if (sta->eng)
+          {
+            esp_wifi_roam_scan_done(sta->eng, aps, n, t);
+          }
+
+        if (best >= 0)
+          {
+            roam_sim_busy(sta, ROAM_SIM_CONNECT, best, t + sim->connect_ms);
+            return;
+          }
+
+        roam_sim_busy(sta, ROAM_SIM_FULL_SCAN, 0, t + sim->full_scan_ms);
+        return;
+
+      case ROAM_SIM_CONNECT:
+
+        /* A failed candidate is left to the roam timeout of the engine */
+
+        if (rssi[sta->target] > ROAM_SIM_DETECT + 2)
+          {
+            roam_sim_up(sim, sta, sta->target, t);
+          }
+        break;
+
+      default:
+        break;
+    }
+
+  sta->pending = ROAM_SIM_NONE;
+}
+
+static void roam_sim_sample(const esp_wifi_roam_sim_t *sim,
+                            const esp_wifi_roam_config_t *cfg,
+                            struct roam_sim_sta *sta, int reading,
+                            int64_t t)
+{
+  esp_wifi_roam_action_t act;
+
+  if (sta->eng == NULL)
+    {
+      if (sta->cur < 0)
+        {
+          return;
+        }
+
+      if (reading >= cfg->soft_threshold)
+        {
+          sta->armed = true;
+        }
+      else if (sta->armed)
+        {
+          roam_sim_down(sta, t);
+          roam_sim_busy(sta, ROAM_SIM_FULL_SCAN, 0, t + sim->full_scan_ms);
+        }
+
+      return;
+    }
+
+  if (sta->cur >= 0)
+    {
+      esp_wifi_roam_rssi(sta->eng, reading, t);
+    }
+
+  esp_wifi_roam_next(sta->eng, t, &act);
+  switch (act.type)
+    {
+      case ESP_WIFI_ROAM_SCAN:
+        sta->stat->scans++;
+        roam_sim_busy(sta, ROAM_SIM_SCAN, act.channel,
+                      t + cfg->scan_time_ms);
+        break;
+
+      case ESP_WIFI_ROAM_CONNECT:
+        sta->roaming = true;
+        roam_sim_down(sta, t);
+        roam_sim_busy(sta, ROAM_SIM_CONNECT, act.bssid[5],
+                      t + sim->connect_ms);
+        break;
+
+      case ESP_WIFI_ROAM_RECONNECT:
+        sta->roaming = false;
+        roam_sim_busy(sta, ROAM_SIM_FULL_SCAN, 0, t + sim->full_scan_ms);
+        break;
+
+      default:
+        break;
+    }
+}
+
+static void roam_sim_step(const esp_wifi_roam_sim_t *sim,
+                          const esp_wifi_roam_config_t *cfg,
+                          struct roam_sim_sta *sta, const int *rssi,
+                          int reading, bool sample, int64_t t)
+{
+  uint64_t sent = (uint64_t)sim->pps * ROAM_SIM_STEP_MS;
+
+  sta->sent += sent;
+  if (t < sta->busy_ms)
+    {
+      sta->lost += sent;
+      return;
+    }
+
+  if (sta->pending != ROAM_SIM_NONE)
+    {
+      roam_sim_finish(sim, sta, rssi, t);
+      if (t < sta->busy_ms)
+        {
+          sta->lost += sent;
+          return;
+        }
+    }
+
+  if (sta->cur < 0)
+    {
+      sta->lost += sent;
+      if (!sta->roaming)
+        {
+          roam_sim_busy(sta, ROAM_SIM_FULL_SCAN, 0, t + sim->full_scan_ms);
+        }
+      else if (sample)
+        {
+          roam_sim_sample(sim, cfg, sta, reading, t);
+        }
+
+      return;
+    }
+
+  sta->lost += sent * roam_sim_per(rssi[sta->cur]) / 1000;
+  if (rssi[sta->cur] > ROAM_SIM_PER_HIGH)
+    {
+      sta->weak_ms = -1;
+    }
+  else if (sta->weak_ms < 0)
+    {
+      sta->weak_ms = t;
+    }
+  else if (t - sta->weak_ms >= ROAM_SIM_BEACON_MS)
+    {
+      roam_sim_down(sta, t);
+      return;
+    }
+
+  if (sample)
+    {
+      roam_sim_sample(sim, cfg, sta, reading, t);
+    }
+}
+
+void esp_wifi_roam_sim_default(esp_wifi_roam_sim_t *sim)
+{
+  memset(sim, 0, sizeof(*sim));
+  sim->aps = 4;
+  sim->spacing_cm = 3000;
+  sim->offset_cm = 300;
+  sim->speed_cm_s = 120;
+  sim->path_loss_x10 = 35;
+  sim->shadow_db = 4;
+  sim->pps = 50;
+  sim->full_scan_ms = 1560;
+  sim->connect_ms = 60;
+  sim->runs = 100;
+  sim->seed = 1;
+}
+
+esp_err_t esp_wifi_roam_sim_run(const esp_wifi_roam_config_t *cfg,
+                                const esp_wifi_roam_sim_t *sim,
+                                esp_wifi_roam_sim_result_t *result)
+{
+  struct roam_sim_sta sta[2];
+  esp_wifi_roam_t *eng;
+  int8_t shadow[ROAM_SIM_APS];
+  int rssi[ROAM_SIM_APS];
+  int64_t length;
+  int64_t duration;
+  int64_t x;
+  int64_t t;
+  uint32_t rng;
+  uint32_t run;
+  int reading;
+  esp_err_t ret;
+  int p;
+  int i;
+
+  if (cfg == NULL || sim == NULL || result == NULL || sim->aps < 2 ||
+      sim->aps > ROAM_SIM_APS || sim->spacing_cm == 0 ||
+      sim->speed_cm_s == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  ret = esp_wifi_roam_create(cfg, &eng);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  memset(result, 0, sizeof(*result));
+  memset(sta, 0, sizeof(sta));
+  sta[0].stat = &result->baseline;
+  sta[1].stat = &result->engine;
+  rng = sim->seed ? sim->seed : 1;
+  length = (int64_t)(sim->aps - 1) * sim->spacing_cm;
+  duration = 2 * length * 1000 / sim->speed_cm_s;
+
+  for (run = 0; run < sim->runs; run++)
+    {
+      for (i = 0; i < sim->aps; i++)
+        {
+          shadow[i] = 0;
+        }
+
+      /* A fresh engine per walk, both stations start on the first AP */
+
+      esp_wifi_roam_delete(eng);
+      ret = esp_wifi_roam_create(cfg, &eng);
+      if (ret != ESP_OK)
+        {
+          return ret;
+        }
+
+      for (p = 0; p < 2; p++)
+        {
+          sta[p].eng = p ? eng : NULL;
+          sta[p].pending = ROAM_SIM_NONE;
+          sta[p].busy_ms = 0;
+          sta[p].roaming = false;
+          sta[p].rng = rng ^ (0x9e3779b9 * (p + 1));
+          sta[p].cur = -2;
+          roam_sim_up(sim, &sta[p], 0, 0);
+        }
+
+      for (t = 0; t < duration; t += ROAM_SIM_STEP_MS)
+        {
+          x = t * sim->speed_cm_s / 1000;
+          if (x > length)
+            {
+              x = 2 * length - x;
+            }
+
+          if (t % ROAM_SIM_SAMPLE_MS == 0)
+            {
+              for (i = 0; i < sim->aps; i++)
+                {
+                  shadow[i] += (int)(roam_sim_rand(&rng) % 3) - 1;
+                  if (shadow[i] > sim->shadow_db)
+                    {
+                      shadow[i] = sim->shadow_db;
+                    }
+                  else if (shadow[i] < -sim->shadow_db)
+                    {
+                      shadow[i] = -sim->shadow_db;
+                    }
+                }
+            }
+
+          for (i = 0; i < sim->aps; i++)
+            {
+              rssi[i] = roam_sim_rssi(sim, x, i, shadow);
+            }
+
+          /* Both stations read the same jitter on their own AP */
+
+          reading = roam_sim_jitter(&rng);
+          for (p = 0; p < 2; p++)
+            {
+              roam_sim_step(sim, cfg, &sta[p], rssi,
+                            sta[p].cur >= 0 ? rssi[sta[p].cur] + reading : 0,
+                            t % ROAM_SIM_SAMPLE_MS == 0, t);
+            }
+        }
+    }
+
+  for (p = 0; p < 2; p++)
+    {
+      if (sta[p].stat->handoffs)
+        {
+          sta[p].stat->gap_avg_ms = sta[p].gap_sum / sta[p].stat->handoffs;
+        }
+
+      if (sta[p].sent)
+        {
+          sta[p].stat->lost_permille = sta[p].lost * 1000 / sta[p].sent;
+        }
+    }
+
+  esp_wifi_roam_delete(eng);
+  return ESP_OK;
+}
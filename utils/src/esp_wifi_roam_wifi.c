@@ -0,0 +1,344 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_roam.h"
+
+#define ROAM_SCAN_RECORDS   16
+
+static esp_wifi_roam_t *s_eng;
+static esp_wifi_roam_config_t s_cfg;
+static void *s_lock;
+static esp_timer_handle_t s_timer;
+static bool s_ticking;
+static bool s_scanning;
+static bool s_roaming;
+static wifi_ap_record_t s_records[ROAM_SCAN_RECORDS];
+
+static int64_t roam_now_ms(void)
+{
+  return esp_timer_get_time() / 1000;
+}
+
+static void roam_tick_start(void)
+{
+  if (!s_ticking &&
+      esp_timer_start_periodic(s_timer,
+                               (uint64_t)s_cfg.scan_interval_ms * 500) ==
+      ESP_OK)
+    {
+      s_ticking = true;
+    }
+}
+
+static void roam_tick_stop(void)
+{
+  if (s_ticking)
+    {
+      esp_timer_stop(s_timer);
+      s_ticking = false;
+    }
+}
+
+static void roam_scan(uint8_t channel)
+{
+  wifi_config_t cfg;
+  wifi_scan_config_t scan =
+  {
+    .channel = channel,
+    .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+  };
+
+  /* Probe for the SSID only, so that the channel time ends early */
+
+  if (esp_wifi_get_config(WIFI_IF_STA, &cfg) == ESP_OK)
+    {
+      scan.ssid = cfg.sta.ssid;
+    }
+
+  scan.scan_time.active.min = s_cfg.scan_time_ms / 2;
+  scan.scan_time.active.max = s_cfg.scan_time_ms;
+  if (esp_wifi_scan_start(&scan, false) != ESP_OK)
+    {
+      g_wifi_osi_funcs._mutex_lock(s_lock);
+      s_scanning = false;
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+    }
+}
+
+static void roam_connect(const uint8_t bssid[6], uint8_t channel)
+{
+  wifi_config_t cfg;
+
+  /* Connected again from the disconnect event */
+
+  if (esp_wifi_get_config(WIFI_IF_STA, &cfg) == ESP_OK)
+    {
+      cfg.sta.bssid_set = bssid != NULL;
+      if (bssid)
+        {
+          memcpy(cfg.sta.bssid, bssid, 6);
+        }
+
+      cfg.sta.channel = channel;
+      esp_wifi_set_config(WIFI_IF_STA, &cfg);
+    }
+
+  if (esp_wifi_disconnect() != ESP_OK)
+    {
+      esp_wifi_connect();
+    }
+}
+
+static void roam_act(const esp_wifi_roam_action_t *act)
+{
+  switch (act->type)
+    {
+      case ESP_WIFI_ROAM_SCAN:
+        roam_scan(act->channel);
+        break;
+
+      case ESP_WIFI_ROAM_CONNECT:
+        roam_connect(act->bssid, act->channel);
+        break;
+
+      case ESP_WIFI_ROAM_RECONNECT:
+        roam_connect(NULL, 0);
+        break;
+
+      default:
+        break;
+    }
+}
+
+static void roam_timer_cb(void *arg)
+{
+  esp_wifi_roam_action_t act;
+  wifi_ap_record_t ap;
+  bool rssi;
+  bool busy;
+
+  rssi = esp_wifi_sta_get_ap_info(&ap) == ESP_OK;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_eng == NULL)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return;
+    }
+
+  if (rssi)
+    {
+      esp_wifi_roam_rssi(s_eng, ap.rssi, roam_now_ms());
+    }
+
+  busy = esp_wifi_roam_next(s_eng, roam_now_ms(), &act);
+  if (act.type == ESP_WIFI_ROAM_SCAN && s_scanning)
+    {
+      act.type = ESP_WIFI_ROAM_NONE;
+    }
+
+  s_scanning |= act.type == ESP_WIFI_ROAM_SCAN;
+  s_roaming = act.type == ESP_WIFI_ROAM_CONNECT ||
+              act.type == ESP_WIFI_ROAM_RECONNECT ||
+              (s_roaming && busy);
+  if (!busy && !s_roaming)
+    {
+      roam_tick_stop();
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  roam_act(&act);
+  if (!busy && act.type == ESP_WIFI_ROAM_NONE)
+    {
+      esp_wifi_set_rssi_threshold(s_cfg.soft_threshold);
+    }
+}
+
+static void roam_scan_done(void)
+{
+  uint16_t n = ROAM_SCAN_RECORDS;
+
+  if (esp_wifi_scan_get_ap_records(&n, s_records) != ESP_OK)
+    {
+      n = 0;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_eng)
+    {
+      esp_wifi_roam_scan_done(s_eng, s_records, n, roam_now_ms());
+    }
+
+  s_scanning = false;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+void esp_wifi_roam_event_handler(void *arg, esp_event_base_t base,
+                                 int32_t id, void *data)
+{
+  const wifi_event_sta_connected_t *conn;
+  const wifi_event_bss_rssi_low_t *low;
+  bool reconnect = false;
+
+  if (base != WIFI_EVENT || s_lock == NULL)
+    {
+      return;
+    }
+
+  switch (id)
+    {
+      case WIFI_EVENT_STA_CONNECTED:
+        conn = data;
+        g_wifi_osi_funcs._mutex_lock(s_lock);
+        if (s_eng)
+          {
+            esp_wifi_roam_connected(s_eng, conn->ssid, conn->ssid_len,
+                                    conn->bssid, conn->channel,
+                                    roam_now_ms());
+          }
+
+        s_roaming = false;
+        g_wifi_osi_funcs._mutex_unlock(s_lock);
+        esp_wifi_set_rssi_threshold(s_cfg.soft_threshold);
+        break;
+
+      case WIFI_EVENT_STA_DISCONNECTED:
+        g_wifi_osi_funcs._mutex_lock(s_lock);
+        if (s_eng)
+          {
+            esp_wifi_roam_disconnected(s_eng, roam_now_ms());
+          }
+
+        reconnect = s_roaming;
+        g_wifi_osi_funcs._mutex_unlock(s_lock);
+        if (reconnect)
+          {
+            esp_wifi_connect();
+          }
+        break;
+
+      case WIFI_EVENT_STA_BSS_RSSI_LOW:
+        low = data;
+        g_wifi_osi_funcs._mutex_lock(s_lock);
+        if (s_eng)
+          {
+            esp_wifi_roam_rssi(s_eng, low->rssi, roam_now_ms());
+            roam_tick_start();
+          }
+
+        g_wifi_osi_funcs._mutex_unlock(s_lock);
+        break;
+
+      case WIFI_EVENT_SCAN_DONE:
+        if (s_scanning)
+          {
+            roam_scan_done();
+          }
+        break;
+
+      default:
+        break;
+    }
+}
+
+void esp_wifi_roam_report_neighbor(const uint8_t bssid[6], uint8_t channel)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_eng)
+    {
+      esp_wifi_roam_add_neighbor(s_eng, bssid, channel, roam_now_ms());
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+bool esp_wifi_roam_in_progress(void)
+{
+  return s_roaming;
+}
+
+esp_err_t esp_wifi_roam_start(esp_wifi_roam_t *eng)
+{
+  esp_timer_create_args_t args =
+  {
+    .callback = roam_timer_cb,
+    .name = "wifi_roam",
+  };
+
+  esp_err_t ret;
+
+  if (eng == NULL)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if (s_lock == NULL)
+    {
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  if (s_timer == NULL)
+    {
+      ret = esp_timer_create(&args, &s_timer);
+      if (ret != ESP_OK)
+        {
+          return ret;
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_eng)
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  s_eng = eng;
+  esp_wifi_roam_get_config(eng, &s_cfg);
+  s_scanning = false;
+  s_roaming = false;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  return ESP_OK;
+}
+
+void esp_wifi_roam_stop(void)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  s_eng = NULL;
+  s_roaming = false;
+  roam_tick_stop();
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
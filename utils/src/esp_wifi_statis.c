@@ -0,0 +1,565 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_statis.h"
+
+#define STATIS_MAX_COLS   16
+#define STATIS_COL_NONE   (-1)
+#define STATIS_COL_TYPE   (-2)
+
+#define STATIS_WORDS(s)   (sizeof(s) / sizeof(uint32_t))
+#define STATIS_OFF(m)     (offsetof(esp_wifi_statis_counters_t, m) / \
+                           sizeof(uint32_t))
+
+enum statis_section
+{
+  STATIS_SEC_BUFFER = 0,
+  STATIS_SEC_LMAC_TX,
+  STATIS_SEC_LMAC_RX,
+  STATIS_SEC_HW_RX,
+  STATIS_SEC_HW,
+  STATIS_SEC_DIAG,
+  STATIS_SEC_PS,
+  STATIS_SEC_MAX
+};
+
+struct statis_section_desc
+{
+  const char *title;
+  uint32_t module;
+};
+
+struct statis_field
+{
+  uint8_t section;
+  const char *name;
+  uint16_t off;
+};
+
+/* Section lines and column names as printed by libpp,
+ * esf_buf_statis_dump and dbg_lmac_*_statis_dump
+ */
+
+static const struct statis_section_desc s_sections[STATIS_SEC_MAX] =
+{
+  { "BUFFER:",     WIFI_STATIS_BUFFER },
+  { "LMAC TX:",    WIFI_STATIS_RXTX },
+  { "LMAC RX:",    WIFI_STATIS_RXTX },
+  { "HW RX:",      WIFI_STATIS_RXTX },
+  { "Hardware:",   WIFI_STATIS_HW },
+  { "DIAG:",       WIFI_STATIS_DIAG },
+  { "Power save:", WIFI_STATIS_PS },
+};
+
+/* BUFFER offsets are those of buf[0], moved to the row of the type given
+ * by the first column.
+ */
+
+static const struct statis_field s_fields[] =
+{
+  { STATIS_SEC_BUFFER,  "max",         STATIS_OFF(buf[0].max) },
+  { STATIS_SEC_BUFFER,  "alloc",       STATIS_OFF(buf[0].alloc) },
+  { STATIS_SEC_BUFFER,  "total_alloc", STATIS_OFF(buf[0].total_alloc) },
+  { STATIS_SEC_BUFFER,  "total_free",  STATIS_OFF(buf[0].total_free) },
+  { STATIS_SEC_BUFFER,  "fail_fc",     STATIS_OFF(buf[0].fail_fc) },
+  { STATIS_SEC_BUFFER,  "fail_oom",    STATIS_OFF(buf[0].fail_oom) },
+
+  { STATIS_SEC_LMAC_TX, "tx_all",      STATIS_OFF(rxtx.tx_all) },
+  { STATIS_SEC_LMAC_TX, "src",         STATIS_OFF(rxtx.tx_src) },
+  { STATIS_SEC_LMAC_TX, "lrc",         STATIS_OFF(rxtx.tx_lrc) },
+  { STATIS_SEC_LMAC_TX, "to",          STATIS_OFF(rxtx.tx_to) },
+  { STATIS_SEC_LMAC_TX, "age",         STATIS_OFF(rxtx.tx_age) },
+  { STATIS_SEC_LMAC_RX, "mdpu",        STATIS_OFF(rxtx.rx_mpdu) },
+  { STATIS_SEC_LMAC_RX, "ampdu",       STATIS_OFF(rxtx.rx_ampdu) },
+  { STATIS_SEC_LMAC_RX, "frag",        STATIS_OFF(rxtx.rx_frag) },
+  { STATIS_SEC_LMAC_RX, "ctrl",        STATIS_OFF(rxtx.rx_ctrl) },
+  { STATIS_SEC_LMAC_RX, "mgmt",        STATIS_OFF(rxtx.rx_mgmt) },
+  { STATIS_SEC_HW_RX,   "rx_end",      STATIS_OFF(rxtx.hw_rx_end) },
+  { STATIS_SEC_HW_RX,   "rx_suc",      STATIS_OFF(rxtx.hw_rx_suc) },
+  { STATIS_SEC_HW_RX,   "full#1",      STATIS_OFF(rxtx.hw_rx_full1) },
+  { STATIS_SEC_HW_RX,   "full#2",      STATIS_OFF(rxtx.hw_rx_full2) },
+
+  { STATIS_SEC_HW,      "rxcckerr",    STATIS_OFF(hw.rxcckerr) },
+  { STATIS_SEC_HW,      "rxbufbk",     STATIS_OFF(hw.rxbufbk) },
+  { STATIS_SEC_HW,      "fifofull",    STATIS_OFF(hw.fifofull) },
+  { STATIS_SEC_HW,      "rx_fcs",      STATIS_OFF(hw.rx_fcs) },
+  { STATIS_SEC_HW,      "rx_abort",    STATIS_OFF(hw.rx_abort) },
+  { STATIS_SEC_HW,      "rxsf",        STATIS_OFF(hw.rxsf) },
+  { STATIS_SEC_HW,      "rx_agc",      STATIS_OFF(hw.rx_agc) },
+  { STATIS_SEC_HW,      "ofdmerr",     STATIS_OFF(hw.ofdmerr) },
+  { STATIS_SEC_HW,      "rx_oth",      STATIS_OFF(hw.rx_oth) },
+  { STATIS_SEC_HW,      "afull",       STATIS_OFF(hw.afull) },
+  { STATIS_SEC_HW,      "rifs_int",    STATIS_OFF(hw.rifs_int) },
+  { STATIS_SEC_HW,      "cts_int",     STATIS_OFF(hw.cts_int) },
+  { STATIS_SEC_HW,      "rts_int",     STATIS_OFF(hw.rts_int) },
+  { STATIS_SEC_HW,      "ack_int",     STATIS_OFF(hw.ack_int) },
+  { STATIS_SEC_HW,      "samebm",      STATIS_OFF(hw.samebm) },
+  { STATIS_SEC_HW,      "tkiperr",     STATIS_OFF(hw.tkiperr) },
+  { STATIS_SEC_HW,      "hoperr",      STATIS_OFF(hw.hoperr) },
+  { STATIS_SEC_HW,      "blockerr",    STATIS_OFF(hw.blockerr) },
+  { STATIS_SEC_HW,      "panic",       STATIS_OFF(hw.panic) },
+  { STATIS_SEC_HW,      "txhung",      STATIS_OFF(hw.txhung) },
+  { STATIS_SEC_HW,      "trigger",     STATIS_OFF(hw.trigger) },
+  { STATIS_SEC_HW,      "trcts",       STATIS_OFF(hw.trcts) },
+  { STATIS_SEC_HW,      "track",       STATIS_OFF(hw.track) },
+  { STATIS_SEC_HW,      "txcts",       STATIS_OFF(hw.txcts) },
+  { STATIS_SEC_HW,      "txrts",       STATIS_OFF(hw.txrts) },
+
+  { STATIS_SEC_DIAG,    "diagsel",     STATIS_OFF(diag.diagsel) },
+
+  { STATIS_SEC_PS,      "sleep",       STATIS_OFF(ps.sleep) },
+  { STATIS_SEC_PS,      "wake",        STATIS_OFF(ps.wake) },
+  { STATIS_SEC_PS,      "sleept",      STATIS_OFF(ps.sleept) },
+  { STATIS_SEC_PS,      "waket",       STATIS_OFF(ps.waket) },
+  { STATIS_SEC_PS,      "totalt",      STATIS_OFF(ps.totalt) },
+  { STATIS_SEC_PS,      "percent",     STATIS_OFF(ps.percent_x100) },
+  { STATIS_SEC_PS,      "tbtt",        STATIS_OFF(ps.tbtt) },
+  { STATIS_SEC_PS,      "beacon",      STATIS_OFF(ps.beacon) },
+  { STATIS_SEC_PS,      "timset",      STATIS_OFF(ps.timset) },
+  { STATIS_SEC_PS,      "dtimset",     STATIS_OFF(ps.dtimset) },
+  { STATIS_SEC_PS,      "tbttdrm",     STATIS_OFF(ps.tbttdrm) },
+  { STATIS_SEC_PS,      "actto",       STATIS_OFF(ps.actto) },
+  { STATIS_SEC_PS,      "txwake",      STATIS_OFF(ps.txwake) },
+  { STATIS_SEC_PS,      "null0",       STATIS_OFF(ps.null0) },
+  { STATIS_SEC_PS,      "null1",       STATIS_OFF(ps.null1) },
+  { STATIS_SEC_PS,      "bcndly",      STATIS_OFF(ps.bcndly) },
+};
+
+/* Parser state of the running capture. Column names are resolved once
+ * per header row, value rows then go straight to their field.
+ */
+
+struct statis_capture
+{
+  void *task;
+  esp_wifi_statis_snapshot_t *snap;
+  int section;
+  int ncols;
+  int16_t col[STATIS_MAX_COLS];
+};
+
+static wifi_osi_funcs_t *s_osi;
+static void (*s_log_writev)(uint32_t level, const char *tag,
+                            const char *format, va_list args);
+
+static void *s_cap_lock;
+static void *s_lock;
+static struct statis_capture s_cap;
+static esp_wifi_statis_snapshot_t s_work;
+
+static esp_wifi_statis_snapshot_t s_latest;
+static esp_wifi_statis_snapshot_t s_prev;
+static uint32_t s_count;
+
+static esp_timer_handle_t s_timer;
+static uint32_t s_timer_modules;
+
+/* Conversions of a format, only those used by the dumps are accepted */
+
+static int statis_conversions(const char *fmt, char *conv)
+{
+  int n = 0;
+
+  while ((fmt = strchr(fmt, '%')) != NULL)
+    {
+      fmt++;
+      if (*fmt == '%')
+        {
+          fmt++;
+          continue;
+        }
+
+      while (*fmt == '-' || *fmt == '.' || (*fmt >= '0' && *fmt <= '9'))
+        {
+          fmt++;
+        }
+
+      if (strchr("sdufx", *fmt) == NULL || *fmt == '\0' ||
+          n == STATIS_MAX_COLS)
+        {
+          return -1;
+        }
+
+      conv[n++] = *fmt++;
+    }
+
+  return n;
+}
+
+static int statis_find_section(const char *fmt)
+{
+  int i;
+
+  while (*fmt == ' ')
+    {
+      fmt++;
+    }
+
+  for (i = 0; i < STATIS_SEC_MAX; i++)
+    {
+      if (strcmp(fmt, s_sections[i].title) == 0)
+        {
+          return i;
+        }
+    }
+
+  return -1;
+}
+
+static int16_t statis_resolve(int section, int col, const char *name)
+{
+  size_t i;
+
+  if (name == NULL)
+    {
+      return STATIS_COL_NONE;
+    }
+
+  if (section == STATIS_SEC_BUFFER && col == 0)
+    {
+      return STATIS_COL_TYPE;
+    }
+
+  if (section == STATIS_SEC_DIAG && strncmp(name, "diag", 4) == 0 &&
+      name[4] >= '0' && name[4] <= '9')
+    {
+      i = strtoul(name + 4, NULL, 10);
+      if (i >= 13)
+        {
+          return STATIS_COL_NONE;
+        }
+
+      return STATIS_OFF(diag.diag[i]);
+    }
+
+  for (i = 0; i < sizeof(s_fields) / sizeof(s_fields[0]); i++)
+    {
+      if (s_fields[i].section == section &&
+          strcmp(s_fields[i].name, name) == 0)
+        {
+          return s_fields[i].off;
+        }
+    }
+
+  return STATIS_COL_NONE;
+}
+
+static void statis_values(struct statis_capture *cap, const char *conv,
+                          va_list args)
+{
+  esp_wifi_statis_snapshot_t *snap = cap->snap;
+  uint32_t *words = (uint32_t *)&snap->c;
+  uint32_t base = 0;
+  uint32_t v;
+  int i;
+
+  for (i = 0; i < cap->ncols; i++)
+    {
+      if (conv[i] == 'f')
+        {
+          v = (uint32_t)(va_arg(args, double) * 100 + 0.5);
+        }
+      else
+        {
+          v = va_arg(args, unsigned int);
+        }
+
+      if (cap->col[i] == STATIS_COL_TYPE)
+        {
+          if (v >= ESP_WIFI_STATIS_BUF_TYPES)
+            {
+              snap->unknown += cap->ncols - 1;
+              return;
+            }
+
+          base = v * STATIS_WORDS(esp_wifi_statis_buf_t);
+        }
+      else if (cap->col[i] == STATIS_COL_NONE)
+        {
+          snap->unknown++;
+        }
+      else
+        {
+          words[base + cap->col[i]] = v;
+        }
+    }
+
+  snap->modules |= s_sections[cap->section].module;
+}
+
+/* Take a log call of the dump, return false to pass it on */
+
+static bool statis_consume(struct statis_capture *cap, const char *fmt,
+                           va_list args)
+{
+  char conv[STATIS_MAX_COLS];
+  va_list ap;
+  int n;
+  int i;
+
+  n = statis_conversions(fmt, conv);
+  if (n < 0)
+    {
+      return false;
+    }
+
+  if (n == 0)
+    {
+      cap->section = statis_find_section(fmt);
+      cap->ncols = 0;
+      return cap->section >= 0;
+    }
+
+  if (cap->section < 0)
+    {
+      return false;
+    }
+
+  for (i = 0; i < n && conv[i] == 's'; i++)
+    {
+    }
+
+  va_copy(ap, args);
+
+  if (i == n)
+    {
+      for (i = 0; i < n; i++)
+        {
+          cap->col[i] = statis_resolve(cap->section, i,
+                                       va_arg(ap, const char *));
+        }
+
+      cap->ncols = n;
+    }
+  else if (n == cap->ncols && memchr(conv, 's', n) == NULL)
+    {
+      statis_values(cap, conv, ap);
+    }
+  else
+    {
+      n = 0;
+    }
+
+  va_end(ap);
+  return n != 0;
+}
+
+static void statis_log_writev(uint32_t level, const char *tag,
+                              const char *format, va_list args)
+{
+  if (s_cap.task != NULL && format != NULL &&
+      s_cap.task == s_osi->_task_get_current_task() &&
+      statis_consume(&s_cap, format, args))
+    {
+      return;
+    }
+
+  s_log_writev(level, tag, format, args);
+}
+
+static void statis_log_write(uint32_t level, const char *tag,
+                             const char *format, ...)
+{
+  va_list args;
+
+  va_start(args, format);
+  statis_log_writev(level, tag, format, args);
+  va_end(args);
+}
+
+static void statis_timer_cb(void *arg)
+{
+  esp_wifi_statis_snapshot(s_timer_modules, NULL);
+}
+
+esp_err_t esp_wifi_statis_install(wifi_osi_funcs_t *osi)
+{
+  if (s_osi != NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  if (osi == NULL)
+    {
+      osi = &g_wifi_osi_funcs;
+    }
+
+  s_cap_lock = osi->_mutex_create();
+  s_lock = osi->_mutex_create();
+  if (s_cap_lock == NULL || s_lock == NULL)
+    {
+      if (s_cap_lock)
+        {
+          osi->_mutex_delete(s_cap_lock);
+          s_cap_lock = NULL;
+        }
+
+      if (s_lock)
+        {
+          osi->_mutex_delete(s_lock);
+          s_lock = NULL;
+        }
+
+      return ESP_ERR_NO_MEM;
+    }
+
+  s_log_writev = osi->_log_writev;
+  osi->_log_writev = statis_log_writev;
+  osi->_log_write = statis_log_write;
+  s_osi = osi;
+
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_statis_snapshot(uint32_t modules,
+                                   esp_wifi_statis_snapshot_t *out)
+{
+  esp_err_t ret;
+
+  if (s_osi == NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  s_osi->_mutex_lock(s_cap_lock);
+
+  memset(&s_work, 0, sizeof(s_work));
+  s_cap.snap = &s_work;
+  s_cap.section = -1;
+  s_cap.ncols = 0;
+  s_cap.task = s_osi->_task_get_current_task();
+
+  /* The dump logs from the calling task before returning */
+
+  s_work.time_us = esp_timer_get_time();
+  ret = esp_wifi_statis_dump(modules);
+
+  s_cap.task = NULL;
+
+  if (ret == ESP_OK && s_work.modules == 0)
+    {
+      ret = ESP_ERR_NOT_FOUND;
+    }
+
+  if (ret == ESP_OK)
+    {
+      s_osi->_mutex_lock(s_lock);
+      s_prev = s_latest;
+      s_latest = s_work;
+      s_count++;
+      s_osi->_mutex_unlock(s_lock);
+
+      if (out)
+        {
+          *out = s_work;
+        }
+    }
+
+  s_osi->_mutex_unlock(s_cap_lock);
+
+  return ret;
+}
+
+esp_err_t esp_wifi_statis_start(uint32_t modules, uint32_t period_ms)
+{
+  esp_timer_create_args_t args =
+  {
+    .callback = statis_timer_cb,
+    .name = "wifi_statis",
+  };
+
+  esp_err_t ret;
+
+  if (s_osi == NULL)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  if (s_timer == NULL)
+    {
+      ret = esp_timer_create(&args, &s_timer);
+      if (ret != ESP_OK)
+        {
+          return ret;
+        }
+    }
+  else
+    {
+      esp_timer_stop(s_timer);
+    }
+
+  if (period_ms == 0)
+    {
+      return ESP_OK;
+    }
+
+  s_timer_modules = modules;
+  return esp_timer_start_periodic(s_timer, (uint64_t)period_ms * 1000);
+}
+
+esp_err_t esp_wifi_statis_get(esp_wifi_statis_snapshot_t *latest,
+                              esp_wifi_statis_snapshot_t *delta)
+{
+  const uint32_t *cur;
+  const uint32_t *old;
+  uint32_t *d;
+  uint32_t count;
+  size_t i;
+
+  if (s_osi == NULL)
+    {
+      return ESP_ERR_NOT_FOUND;
+    }
+
+  s_osi->_mutex_lock(s_lock);
+
+  count = s_count;
+  if (latest && count > 0)
+    {
+      *latest = s_latest;
+    }
+
+  if (delta && count > 1)
+    {
+      cur = (const uint32_t *)&s_latest.c;
+      old = (const uint32_t *)&s_prev.c;
+      d = (uint32_t *)&delta->c;
+
+      for (i = 0; i < STATIS_WORDS(esp_wifi_statis_counters_t); i++)
+        {
+          d[i] = cur[i] - old[i];
+        }
+
+      delta->time_us = s_latest.time_us - s_prev.time_us;
+      delta->modules = s_latest.modules & s_prev.modules;
+      delta->unknown = s_latest.unknown;
+    }
+
+  s_osi->_mutex_unlock(s_lock);
+
+  if (count == 0 || (delta && count < 2))
+    {
+      return ESP_ERR_NOT_FOUND;
+    }
+
+  return ESP_OK;
+}
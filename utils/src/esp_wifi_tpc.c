@@ -0,0 +1,261 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_wifi_tpc.h"
+
+struct esp_wifi_tpc
+{
+  esp_wifi_tpc_config_t cfg;
+  esp_wifi_tpc_stats_t stats;
+  uint8_t cur;                   /* index of the level */
+  bool rssi_known;
+  bool burst;
+  int16_t rssi_x16;              /* mean */
+  uint16_t streak;               /* failures in a row */
+  uint16_t sent;                 /* of the window */
+  uint16_t failed;
+  uint32_t window_ms;            /* start of the window */
+  uint32_t raised_ms;            /* last step up */
+};
+
+/* Margin left at level i, 0.25 dB, the path loss taken as symmetric */
+
+static bool tpc_margin_ok(const esp_wifi_tpc_t *tpc, uint8_t i)
+{
+  int32_t margin;
+
+  if (!tpc->rssi_known)
+    {
+      return true;
+    }
+
+  margin = tpc->rssi_x16 / 4 + tpc->cfg.levels[i] -
+           tpc->cfg.peer_dbm * 4 - tpc->cfg.sensitivity_dbm * 4;
+  return margin >= tpc->cfg.margin_db * 4;
+}
+
+void esp_wifi_tpc_default(esp_wifi_tpc_radio_t radio,
+                          esp_wifi_tpc_config_t *cfg)
+{
+  /* The values esp_wifi_set_max_tx_power keeps as they are */
+
+  static const int16_t wifi[] =
+  {
+    8, 20, 28, 34, 44, 52, 56, 60, 66, 72, 80
+  };
+
+  int i;
+
+  memset(cfg, 0, sizeof(*cfg));
+  if (radio == ESP_WIFI_TPC_BLE)
+    {
+      for (i = 0; i < 8; i++)
+        {
+          cfg->levels[i] = (-12 + 3 * i) * 4;
+        }
+
+      cfg->n_levels = 8;
+      cfg->sensitivity_dbm = -94;
+      cfg->peer_dbm = 0;
+    }
+  else
+    {
+      memcpy(cfg->levels, wifi, sizeof(wifi));
+      cfg->n_levels = sizeof(wifi) / sizeof(wifi[0]);
+      cfg->sensitivity_dbm = -80;
+      cfg->peer_dbm = 20;
+    }
+
+  cfg->target_per_permille = 100;
+  cfg->window_ms = 1000;
+  cfg->min_frames = 10;
+  cfg->loss_burst = 4;
+  cfg->hold_ms = 10000;
+  cfg->margin_db = 10;
+}
+
+esp_err_t esp_wifi_tpc_create(const esp_wifi_tpc_config_t *cfg,
+                              uint32_t now_ms, esp_wifi_tpc_t **tpc)
+{
+  esp_wifi_tpc_t *t;
+  int i;
+
+  if (cfg == NULL || tpc == NULL || cfg->n_levels == 0 ||
+      cfg->n_levels > ESP_WIFI_TPC_LEVELS || cfg->window_ms == 0 ||
+      cfg->target_per_permille > 1000)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  for (i = 1; i < cfg->n_levels; i++)
+    {
+      if (cfg->levels[i] <= cfg->levels[i - 1])
+        {
+          return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+  t = calloc(1, sizeof(*t));
+  if (t == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  t->cfg = *cfg;
+  t->cur = cfg->n_levels - 1;
+  t->window_ms = now_ms;
+  t->raised_ms = now_ms - cfg->hold_ms;
+  *tpc = t;
+  return ESP_OK;
+}
+
+void esp_wifi_tpc_delete(esp_wifi_tpc_t *tpc)
+{
+  free(tpc);
+}
+
+void esp_wifi_tpc_rssi(esp_wifi_tpc_t *tpc, int8_t rssi)
+{
+  if (!tpc->rssi_known)
+    {
+      tpc->rssi_x16 = rssi * 16;
+      tpc->rssi_known = true;
+      return;
+    }
+
+  tpc->rssi_x16 = (tpc->rssi_x16 * 7 + rssi * 16) / 8;
+}
+
+void esp_wifi_tpc_tx(esp_wifi_tpc_t *tpc, uint16_t sent, uint16_t failed)
+{
+  if (failed > sent)
+    {
+      failed = sent;
+    }
+
+  tpc->sent = sent > UINT16_MAX - tpc->sent ? UINT16_MAX : tpc->sent + sent;
+  tpc->failed = failed > UINT16_MAX - tpc->failed ? UINT16_MAX :
+                tpc->failed + failed;
+  tpc->stats.sent += sent;
+  tpc->stats.failed += failed;
+
+  if (sent == 0)
+    {
+      return;
+    }
+
+  if (failed < sent)
+    {
+      tpc->streak = 0;
+      return;
+    }
+
+  tpc->streak = failed > UINT16_MAX - tpc->streak ? UINT16_MAX :
+                tpc->streak + failed;
+  if (tpc->cfg.loss_burst && tpc->streak >= tpc->cfg.loss_burst)
+    {
+      tpc->burst = true;
+    }
+}
+
+bool esp_wifi_tpc_update(esp_wifi_tpc_t *tpc, uint32_t now_ms,
+                         int16_t *level)
+{
+  uint8_t top = tpc->cfg.n_levels - 1;
+  uint8_t cur = tpc->cur;
+  uint32_t per;
+
+  /* A burst brings the top level back and starts a new window on it */
+
+  if (tpc->burst)
+    {
+      tpc->burst = false;
+      tpc->streak = 0;
+      tpc->sent = 0;
+      tpc->failed = 0;
+      tpc->window_ms = now_ms;
+      if (tpc->cur != top)
+        {
+          tpc->cur = top;
+          tpc->raised_ms = now_ms;
+          tpc->stats.recoveries++;
+        }
+    }
+  else if (now_ms - tpc->window_ms >= tpc->cfg.window_ms)
+    {
+      if (tpc->sent >= tpc->cfg.min_frames && tpc->sent)
+        {
+          per = (uint32_t)tpc->failed * 1000 / tpc->sent;
+          tpc->stats.windows++;
+          if (per > tpc->cfg.target_per_permille)
+            {
+              if (tpc->cur < top)
+                {
+                  tpc->cur++;
+                  tpc->raised_ms = now_ms;
+                  tpc->stats.ups++;
+                }
+            }
+          else if (per * 2 <= tpc->cfg.target_per_permille &&
+                   tpc->cur > 0 &&
+                   now_ms - tpc->raised_ms >= tpc->cfg.hold_ms)
+            {
+              if (tpc_margin_ok(tpc, tpc->cur - 1))
+                {
+                  tpc->cur--;
+                  tpc->stats.downs++;
+                }
+              else
+                {
+                  tpc->stats.held++;
+                }
+            }
+        }
+
+      tpc->sent = 0;
+      tpc->failed = 0;
+      tpc->window_ms = now_ms;
+    }
+
+  if (tpc->cur == cur)
+    {
+      return false;
+    }
+
+  *level = tpc->cfg.levels[tpc->cur];
+  tpc->stats.writes++;
+  return true;
+}
+
+int16_t esp_wifi_tpc_level(const esp_wifi_tpc_t *tpc)
+{
+  return tpc->cfg.levels[tpc->cur];
+}
+
+void esp_wifi_tpc_get_config(const esp_wifi_tpc_t *tpc,
+                             esp_wifi_tpc_config_t *cfg)
+{
+  *cfg = tpc->cfg;
+}
+
+void esp_wifi_tpc_get_stats(const esp_wifi_tpc_t *tpc,
+                            esp_wifi_tpc_stats_t *stats)
+{
+  *stats = tpc->stats;
+}
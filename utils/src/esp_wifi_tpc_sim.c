@@ -0,0 +1,271 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_wifi_tpc.h"
+
+#define SIM_SLOPE_X10       30   /* from 50% to 0 and 100% delivery */
+
+enum
+{
+  SIM_FIXED,
+  SIM_TPC,
+  SIM_POLICIES
+};
+
+struct sim_acc
+{
+  uint32_t failed;
+  int64_t power_x10;
+  int64_t interference_x10;
+};
+
+/* dB x 10 to add to the larger of two powers that many dB x 10 apart */
+
+static const uint8_t g_sim_db_add[] =
+{
+  30, 25, 21, 18, 15, 12, 10, 8, 6, 5, 4, 3, 3, 2, 2, 1, 1, 1, 1
+};
+
+static uint32_t tpc_sim_rand(uint32_t *state)
+{
+  /* xorshift32 */
+
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+/* Sum of two powers, dBm x 10, within 0.3 dB */
+
+static int32_t tpc_sim_add(int32_t a, int32_t b)
+{
+  int32_t hi = a > b ? a : b;
+  int32_t d = (a > b ? a - b : b - a) / 10;
+
+  if (d >= (int32_t)sizeof(g_sim_db_add))
+    {
+      return hi;
+    }
+
+  return hi + g_sim_db_add[d];
+}
+
+static int32_t tpc_sim_permille(int32_t sinr_x10, uint8_t snr50)
+{
+  int32_t p;
+
+  p = 500 + (sinr_x10 - snr50 * 10) * 500 / SIM_SLOPE_X10;
+  return p < 0 ? 0 : p > 1000 ? 1000 : p;
+}
+
+void esp_wifi_tpc_sim_default(esp_wifi_tpc_sim_t *sim)
+{
+  memset(sim, 0, sizeof(*sim));
+  sim->seconds = 60;
+  sim->links = 6;
+  sim->slots_per_s = 100;
+  sim->duty_percent = 30;
+  sim->loss_min = 55;
+  sim->loss_max = 80;
+  sim->coupling_min = 80;
+  sim->coupling_max = 105;
+  sim->noise_dbm = -95;
+  sim->snr50 = 12;
+  sim->noise_db = 2;
+  sim->seed = 1;
+}
+
+static void tpc_sim_delete(esp_wifi_tpc_t **tpc, uint8_t n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (tpc[i])
+        {
+          esp_wifi_tpc_delete(tpc[i]);
+        }
+    }
+}
+
+esp_err_t esp_wifi_tpc_sim_run(const esp_wifi_tpc_sim_t *sim,
+                               esp_wifi_tpc_sim_result_t *result)
+{
+  esp_wifi_tpc_t *tpc[ESP_WIFI_TPC_SIM_LINKS];
+  uint8_t coupling[ESP_WIFI_TPC_SIM_LINKS][ESP_WIFI_TPC_SIM_LINKS];
+  int32_t power_x10[SIM_POLICIES][ESP_WIFI_TPC_SIM_LINKS];
+  int32_t loss_x10[ESP_WIFI_TPC_SIM_LINKS];
+  struct sim_acc acc[SIM_POLICIES];
+  esp_wifi_tpc_sim_stat_t *stat;
+  esp_wifi_tpc_config_t cfg;
+  esp_wifi_tpc_stats_t stats;
+  uint32_t active;
+  uint32_t rng;
+  uint32_t steps;
+  uint32_t now;
+  uint32_t k;
+  int32_t in_x10;
+  int32_t rssi;
+  int32_t u;
+  int16_t level;
+  esp_err_t ret = ESP_OK;
+  int i;
+  int j;
+  int p;
+
+  if (sim == NULL || result == NULL || sim->seconds == 0 ||
+      sim->links == 0 || sim->links > ESP_WIFI_TPC_SIM_LINKS ||
+      sim->slots_per_s == 0 || sim->loss_min > sim->loss_max ||
+      sim->coupling_min > sim->coupling_max)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  esp_wifi_tpc_default(ESP_WIFI_TPC_WIFI, &cfg);
+  cfg.sensitivity_dbm = sim->noise_dbm + sim->snr50;
+
+  memset(tpc, 0, sizeof(tpc));
+  for (i = 0; i < sim->links && ret == ESP_OK; i++)
+    {
+      ret = esp_wifi_tpc_create(&cfg, 0, &tpc[i]);
+    }
+
+  if (ret != ESP_OK)
+    {
+      tpc_sim_delete(tpc, sim->links);
+      return ret;
+    }
+
+  rng = sim->seed ? sim->seed : 1;
+  for (i = 0; i < sim->links; i++)
+    {
+      loss_x10[i] = sim->loss_min * 10;
+      if (sim->links > 1)
+        {
+          loss_x10[i] += (sim->loss_max - sim->loss_min) * 10 * i /
+                         (sim->links - 1);
+        }
+
+      for (j = 0; j < sim->links; j++)
+        {
+          coupling[i][j] = sim->coupling_min +
+                           tpc_sim_rand(&rng) %
+                           (sim->coupling_max - sim->coupling_min + 1);
+        }
+
+      power_x10[SIM_FIXED][i] = cfg.levels[cfg.n_levels - 1] * 10 / 4;
+      power_x10[SIM_TPC][i] = esp_wifi_tpc_level(tpc[i]) * 10 / 4;
+    }
+
+  memset(acc, 0, sizeof(acc));
+  memset(result, 0, sizeof(*result));
+  steps = sim->seconds * sim->slots_per_s;
+  for (k = 0; k < steps; k++)
+    {
+      now = (uint64_t)k * 1000 / sim->slots_per_s;
+
+      /* The senders of the slot, the same for both policies */
+
+      active = 0;
+      for (i = 0; i < sim->links; i++)
+        {
+          if (tpc_sim_rand(&rng) % 100 < sim->duty_percent)
+            {
+              active |= 1u << i;
+            }
+        }
+
+      for (i = 0; i < sim->links; i++)
+        {
+          if (!(active & (1u << i)))
+            {
+              continue;
+            }
+
+          u = tpc_sim_rand(&rng) % 1000;
+          result->frames++;
+          for (p = 0; p < SIM_POLICIES; p++)
+            {
+              in_x10 = sim->noise_dbm * 10;
+              for (j = 0; j < sim->links; j++)
+                {
+                  if (j != i && (active & (1u << j)))
+                    {
+                      in_x10 = tpc_sim_add(in_x10, power_x10[p][j] -
+                                                   coupling[j][i] * 10);
+                    }
+                }
+
+              acc[p].power_x10 += power_x10[p][i];
+              acc[p].interference_x10 += in_x10;
+              if (u >= tpc_sim_permille(power_x10[p][i] - loss_x10[i] -
+                                        in_x10, sim->snr50))
+                {
+                  acc[p].failed++;
+                  if (p == SIM_TPC)
+                    {
+                      esp_wifi_tpc_tx(tpc[i], 1, 1);
+                    }
+                }
+              else if (p == SIM_TPC)
+                {
+                  esp_wifi_tpc_tx(tpc[i], 1, 0);
+                }
+            }
+
+          /* The peer answers at peer_dbm, heard with some noise */
+
+          rssi = cfg.peer_dbm - loss_x10[i] / 10;
+          if (sim->noise_db)
+            {
+              rssi += (int32_t)(tpc_sim_rand(&rng) %
+                                (2 * sim->noise_db + 1)) - sim->noise_db;
+            }
+
+          esp_wifi_tpc_rssi(tpc[i], rssi < -128 ? -128 : rssi);
+        }
+
+      for (i = 0; i < sim->links; i++)
+        {
+          if (esp_wifi_tpc_update(tpc[i], now, &level))
+            {
+              power_x10[SIM_TPC][i] = level * 10 / 4;
+            }
+        }
+    }
+
+  for (p = 0; p < SIM_POLICIES && result->frames; p++)
+    {
+      stat = p == SIM_FIXED ? &result->fixed : &result->tpc;
+      stat->per_permille = (uint64_t)acc[p].failed * 1000 / result->frames;
+      stat->power_x10 = acc[p].power_x10 / (int64_t)result->frames;
+      stat->interference_x10 = acc[p].interference_x10 /
+                               (int64_t)result->frames;
+    }
+
+  for (i = 0; i < sim->links; i++)
+    {
+      esp_wifi_tpc_get_stats(tpc[i], &stats);
+      result->downs += stats.downs;
+      result->ups += stats.ups;
+      result->recoveries += stats.recoveries;
+    }
+
+  tpc_sim_delete(tpc, sim->links);
+  return ESP_OK;
+}
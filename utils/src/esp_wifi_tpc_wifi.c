@@ -0,0 +1,353 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#if CONFIG_BT_ENABLED
+#include "esp_bt.h"
+#endif
+#include "esp_wifi_tpc.h"
+
+/* The range of esp_wifi_set_max_tx_power, capped as the PHY init data */
+
+#define TPC_WIFI_MIN        8
+#define TPC_WIFI_MAX        LIMIT(CONFIG_ESP32_PHY_MAX_TX_POWER * 4, 8, 84)
+
+#if CONFIG_BT_ENABLED
+#if CONFIG_IDF_TARGET_ESP32
+#define TPC_BLE_TOP         ESP_PWR_LVL_P9
+#else
+#define TPC_BLE_TOP         ESP_PWR_LVL_P18
+#endif
+#endif
+
+#define TPC_BLE_CONNS       9    /* ESP_BLE_PWR_TYPE_CONN_HDL0 to 8 */
+
+static esp_wifi_tpc_t *s_tpc[ESP_WIFI_TPC_RADIOS];
+static bool s_stale[ESP_WIFI_TPC_RADIOS];    /* last write failed */
+static int s_ble_conn = -1;
+static void *s_lock;
+static esp_timer_handle_t s_timer;
+
+static uint32_t tpc_now_ms(void)
+{
+  return esp_timer_get_time() / 1000;
+}
+
+#if CONFIG_BT_ENABLED
+/* esp_power_level_t counts 3 dB steps, -12 dBm at ESP_PWR_LVL_N12 */
+
+static int tpc_ble_level(int16_t level)
+{
+  int steps;
+
+  if ((level + 48) % 12)
+    {
+      return -1;
+    }
+
+  steps = ESP_PWR_LVL_N12 + (level + 48) / 12;
+  return steps < 0 || steps > TPC_BLE_TOP ? -1 : steps;
+}
+#endif
+
+static bool tpc_valid(esp_wifi_tpc_radio_t radio, const esp_wifi_tpc_t *tpc)
+{
+  esp_wifi_tpc_config_t cfg;
+#if CONFIG_BT_ENABLED
+  int i;
+#endif
+
+  esp_wifi_tpc_get_config(tpc, &cfg);
+  if (radio == ESP_WIFI_TPC_WIFI)
+    {
+      return cfg.levels[0] >= TPC_WIFI_MIN &&
+             cfg.levels[cfg.n_levels - 1] <= TPC_WIFI_MAX;
+    }
+
+#if CONFIG_BT_ENABLED
+  for (i = 0; i < cfg.n_levels; i++)
+    {
+      if (tpc_ble_level(cfg.levels[i]) < 0)
+        {
+          return false;
+        }
+    }
+#endif
+
+  return true;
+}
+
+/* The default power type only applies to the connections to come, the
+ * one of the link is written as well.
+ */
+
+static esp_err_t tpc_write(esp_wifi_tpc_radio_t radio, int16_t level,
+                           int conn)
+{
+  esp_err_t ret = ESP_ERR_NOT_SUPPORTED;
+
+  if (radio == ESP_WIFI_TPC_WIFI)
+    {
+      return esp_wifi_set_max_tx_power(level);
+    }
+
+#if CONFIG_BT_ENABLED
+  ret = esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_DEFAULT,
+                             tpc_ble_level(level));
+  if (ret == ESP_OK && conn >= 0)
+    {
+      ret = esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_CONN_HDL0 + conn,
+                                 tpc_ble_level(level));
+    }
+
+#if CONFIG_BT_CLASSIC_ENABLED
+  if (ret == ESP_OK)
+    {
+      ret = esp_bredr_tx_power_set(tpc_ble_level(level),
+                                   tpc_ble_level(level));
+    }
+#endif
+#endif
+
+  return ret;
+}
+
+static void tpc_timer_cb(void *arg)
+{
+  int16_t level[ESP_WIFI_TPC_RADIOS];
+  bool write[ESP_WIFI_TPC_RADIOS];
+  esp_err_t ret[ESP_WIFI_TPC_RADIOS];
+  wifi_ap_record_t ap;
+  bool connected;
+  int conn;
+  int r;
+
+  /* The RSSI of the last beacon of the AP, sent at about its level */
+
+  connected = esp_wifi_sta_get_ap_info(&ap) == ESP_OK;
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_tpc[ESP_WIFI_TPC_WIFI] && connected)
+    {
+      esp_wifi_tpc_rssi(s_tpc[ESP_WIFI_TPC_WIFI], ap.rssi);
+    }
+
+  /* A level that failed to be written is tried again until it is */
+
+  for (r = 0; r < ESP_WIFI_TPC_RADIOS; r++)
+    {
+      write[r] = s_tpc[r] &&
+                 esp_wifi_tpc_update(s_tpc[r], tpc_now_ms(), &level[r]);
+      if (s_tpc[r] && !write[r] && s_stale[r])
+        {
+          level[r] = esp_wifi_tpc_level(s_tpc[r]);
+          write[r] = true;
+        }
+    }
+
+  conn = s_ble_conn;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  for (r = 0; r < ESP_WIFI_TPC_RADIOS; r++)
+    {
+      ret[r] = write[r] ? tpc_write(r, level[r], conn) : ESP_OK;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  for (r = 0; r < ESP_WIFI_TPC_RADIOS; r++)
+    {
+      if (write[r])
+        {
+          s_stale[r] = ret[r] != ESP_OK;
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+esp_err_t esp_wifi_tpc_start(esp_wifi_tpc_t *wifi, esp_wifi_tpc_t *ble,
+                             uint32_t tick_ms)
+{
+  esp_timer_create_args_t args =
+  {
+    .callback = tpc_timer_cb,
+    .name = "wifi_tpc",
+  };
+
+  esp_err_t ret = ESP_OK;
+  int conn;
+  int r;
+
+  if ((wifi == NULL && ble == NULL) || tick_ms == 0 ||
+      (wifi && !tpc_valid(ESP_WIFI_TPC_WIFI, wifi)) ||
+      (ble && !tpc_valid(ESP_WIFI_TPC_BLE, ble)))
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+#if !CONFIG_BT_ENABLED
+  if (ble)
+    {
+      return ESP_ERR_NOT_SUPPORTED;
+    }
+#endif
+
+  if (s_lock == NULL)
+    {
+      s_lock = g_wifi_osi_funcs._mutex_create();
+      if (s_lock == NULL)
+        {
+          return ESP_ERR_NO_MEM;
+        }
+    }
+
+  if (s_timer == NULL)
+    {
+      ret = esp_timer_create(&args, &s_timer);
+      if (ret != ESP_OK)
+        {
+          return ret;
+        }
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_tpc[ESP_WIFI_TPC_WIFI] || s_tpc[ESP_WIFI_TPC_BLE])
+    {
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+  s_tpc[ESP_WIFI_TPC_WIFI] = wifi;
+  s_tpc[ESP_WIFI_TPC_BLE] = ble;
+  memset(s_stale, 0, sizeof(s_stale));
+  conn = s_ble_conn;
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  /* The engines start at their top level */
+
+  for (r = 0; r < ESP_WIFI_TPC_RADIOS && ret == ESP_OK; r++)
+    {
+      if (s_tpc[r])
+        {
+          ret = tpc_write(r, esp_wifi_tpc_level(s_tpc[r]), conn);
+        }
+    }
+
+  if (ret == ESP_OK)
+    {
+      ret = esp_timer_start_periodic(s_timer, (uint64_t)tick_ms * 1000);
+    }
+
+  if (ret != ESP_OK)
+    {
+      esp_wifi_tpc_stop();
+    }
+
+  return ret;
+}
+
+void esp_wifi_tpc_stop(void)
+{
+  if (s_lock == NULL)
+    {
+      return;
+    }
+
+  esp_timer_stop(s_timer);
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  memset(s_tpc, 0, sizeof(s_tpc));
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+esp_err_t esp_wifi_tpc_ble_conn(int handle)
+{
+  esp_wifi_tpc_t *ble;
+  int16_t level = 0;
+  esp_err_t ret = ESP_OK;
+
+  if (handle < -1 || handle >= TPC_BLE_CONNS)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+#if !CONFIG_BT_ENABLED
+  return ESP_ERR_NOT_SUPPORTED;
+#endif
+
+  if (s_lock == NULL)
+    {
+      s_ble_conn = handle;
+      return ESP_OK;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  s_ble_conn = handle;
+  ble = s_tpc[ESP_WIFI_TPC_BLE];
+  if (ble)
+    {
+      level = esp_wifi_tpc_level(ble);
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+
+  /* The new link starts at the level of the engine */
+
+  if (ble && handle >= 0)
+    {
+      ret = tpc_write(ESP_WIFI_TPC_BLE, level, handle);
+      g_wifi_osi_funcs._mutex_lock(s_lock);
+      s_stale[ESP_WIFI_TPC_BLE] = ret != ESP_OK;
+      g_wifi_osi_funcs._mutex_unlock(s_lock);
+    }
+
+  return ret;
+}
+
+void esp_wifi_tpc_feed_tx(esp_wifi_tpc_radio_t radio, bool ok)
+{
+  if (s_lock == NULL || radio >= ESP_WIFI_TPC_RADIOS)
+    {
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_tpc[radio])
+    {
+      esp_wifi_tpc_tx(s_tpc[radio], 1, !ok);
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
+
+void esp_wifi_tpc_feed_rssi(esp_wifi_tpc_radio_t radio, int8_t rssi)
+{
+  if (s_lock == NULL || radio >= ESP_WIFI_TPC_RADIOS)
+    {
+      return;
+    }
+
+  g_wifi_osi_funcs._mutex_lock(s_lock);
+  if (s_tpc[radio])
+    {
+      esp_wifi_tpc_rssi(s_tpc[radio], rssi);
+    }
+
+  g_wifi_osi_funcs._mutex_unlock(s_lock);
+}
@@ -0,0 +1,385 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "esp_wifi_vie.h"
+
+/* As WIFI_SOFTAP_BEACON_MAX_LEN of esp_wifi.h */
+
+#ifdef CONFIG_ESP32_WIFI_SOFTAP_BEACON_MAX_LEN
+#  define VIE_BEACON_MAX_LEN  CONFIG_ESP32_WIFI_SOFTAP_BEACON_MAX_LEN
+#else
+#  define VIE_BEACON_MAX_LEN  752
+#endif
+
+#define VIE_TYPE_MASK       ((1 << ESP_WIFI_VIE_TYPES) - 1)
+#define VIE_BEACON          ESP_WIFI_VIE_BIT(WIFI_VND_IE_TYPE_BEACON)
+
+/* The IEs of a frame type back to back in index order, as they go in the
+ * frame: off[i] is where IE i starts, or would start when not set
+ */
+
+struct vie_block
+{
+  uint8_t set;                   /* bit per index */
+  uint8_t dirty;                 /* to be pushed, set or removed */
+  uint16_t len;
+  uint16_t off[ESP_WIFI_VIE_SLOTS];
+  uint8_t buf[ESP_WIFI_VIE_SLOTS * (2 + 255)];
+};
+
+struct esp_wifi_vie
+{
+  esp_wifi_vie_config_t cfg;
+  esp_wifi_vie_stats_t stats;
+  struct vie_block blocks[ESP_WIFI_VIE_TYPES];
+};
+
+/* Count the bytes that differ while copying, without a branch per byte:
+ * a range holding the same bytes leaves the IE clean
+ */
+
+static uint32_t vie_write(uint8_t *dst, const uint8_t *src, size_t len)
+{
+  uint32_t changed = 0;
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    {
+      changed += dst[i] != src[i];
+      dst[i] = src[i];
+    }
+
+  return changed;
+}
+
+static bool vie_args_ok(uint8_t mask, wifi_vendor_ie_id_t idx)
+{
+  return mask != 0 && (mask & ~VIE_TYPE_MASK) == 0 &&
+         (unsigned)idx < ESP_WIFI_VIE_SLOTS;
+}
+
+static uint16_t vie_ie_len(const struct vie_block *blk,
+                           wifi_vendor_ie_id_t idx)
+{
+  return (blk->set & (1 << idx)) ? 2 + blk->buf[blk->off[idx] + 1] : 0;
+}
+
+/* Make IE idx take len bytes, moving the IEs behind it */
+
+static void vie_resize(struct vie_block *blk, wifi_vendor_ie_id_t idx,
+                       uint16_t len)
+{
+  uint16_t old = vie_ie_len(blk, idx);
+  uint16_t end = blk->off[idx] + old;
+  int i;
+
+  if (len == old)
+    {
+      return;
+    }
+
+  memmove(blk->buf + blk->off[idx] + len, blk->buf + end, blk->len - end);
+  for (i = idx + 1; i < ESP_WIFI_VIE_SLOTS; i++)
+    {
+      blk->off[i] += len - old;
+    }
+
+  blk->len += len - old;
+}
+
+/* Beacon with IE idx taking ie_len bytes */
+
+static bool vie_beacon_fits(const esp_wifi_vie_t *vie,
+                            wifi_vendor_ie_id_t idx, uint16_t ie_len)
+{
+  const struct vie_block *blk = &vie->blocks[WIFI_VND_IE_TYPE_BEACON];
+
+  return vie->cfg.beacon_base_len + blk->len - vie_ie_len(blk, idx) +
+         ie_len <= vie->cfg.beacon_max_len;
+}
+
+void esp_wifi_vie_default(esp_wifi_vie_config_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->beacon_max_len = VIE_BEACON_MAX_LEN;
+  cfg->beacon_base_len = 220;
+}
+
+esp_err_t esp_wifi_vie_create(const esp_wifi_vie_config_t *cfg,
+                              esp_wifi_vie_t **vie)
+{
+  esp_wifi_vie_t *v;
+
+  if (cfg == NULL || vie == NULL ||
+      cfg->beacon_base_len >= cfg->beacon_max_len)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  v = calloc(1, sizeof(*v));
+  if (v == NULL)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+
+  v->cfg = *cfg;
+  *vie = v;
+  return ESP_OK;
+}
+
+void esp_wifi_vie_delete(esp_wifi_vie_t *vie)
+{
+  free(vie);
+}
+
+esp_err_t esp_wifi_vie_set(esp_wifi_vie_t *vie, uint8_t mask,
+                           wifi_vendor_ie_id_t idx, const uint8_t oui[3],
+                           uint8_t oui_type, const uint8_t *payload,
+                           uint8_t len)
+{
+  uint8_t hdr[ESP_WIFI_VIE_HDR_LEN];
+  struct vie_block *blk;
+  uint32_t changed = 0;
+  uint32_t n;
+  uint8_t *ie;
+  int t;
+
+  if (!vie_args_ok(mask, idx) || len > ESP_WIFI_VIE_PAYLOAD_MAX ||
+      (len && payload == NULL))
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  if ((mask & VIE_BEACON) &&
+      !vie_beacon_fits(vie, idx, ESP_WIFI_VIE_HDR_LEN + len))
+    {
+      return ESP_ERR_INVALID_SIZE;
+    }
+
+  hdr[0] = WIFI_VENDOR_IE_ELEMENT_ID;
+  hdr[1] = 4 + len;
+  memcpy(hdr + 2, oui, 3);
+  hdr[5] = oui_type;
+
+  vie->stats.sets++;
+  for (t = 0; t < ESP_WIFI_VIE_TYPES; t++)
+    {
+      if (!(mask & ESP_WIFI_VIE_BIT(t)))
+        {
+          continue;
+        }
+
+      blk = &vie->blocks[t];
+      vie_resize(blk, idx, sizeof(hdr) + len);
+      ie = blk->buf + blk->off[idx];
+      n = vie_write(ie, hdr, sizeof(hdr)) +
+          vie_write(ie + sizeof(hdr), payload, len);
+      if (n || !(blk->set & (1 << idx)))
+        {
+          blk->set |= 1 << idx;
+          blk->dirty |= 1 << idx;
+          changed += n;
+        }
+    }
+
+  vie->stats.bytes_written += changed;
+  if (changed == 0)
+    {
+      vie->stats.unchanged++;
+    }
+
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_vie_patch(esp_wifi_vie_t *vie, uint8_t mask,
+                             wifi_vendor_ie_id_t idx, uint8_t off,
+                             const uint8_t *data, uint8_t len)
+{
+  struct vie_block *blk;
+  uint32_t changed = 0;
+  uint32_t n;
+  uint8_t *ie;
+  uint8_t cur;
+  int t;
+
+  if (!vie_args_ok(mask, idx) || (len && data == NULL) ||
+      off + len > ESP_WIFI_VIE_PAYLOAD_MAX)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  /* Checked for every type before any is written */
+
+  for (t = 0; t < ESP_WIFI_VIE_TYPES; t++)
+    {
+      if (!(mask & ESP_WIFI_VIE_BIT(t)))
+        {
+          continue;
+        }
+
+      blk = &vie->blocks[t];
+      if (!(blk->set & (1 << idx)))
+        {
+          return ESP_ERR_INVALID_STATE;
+        }
+
+      /* No hole in the payload */
+
+      cur = vie_ie_len(blk, idx) - ESP_WIFI_VIE_HDR_LEN;
+      if (off > cur)
+        {
+          return ESP_ERR_INVALID_ARG;
+        }
+
+      if (t == WIFI_VND_IE_TYPE_BEACON && off + len > cur &&
+          !vie_beacon_fits(vie, idx, ESP_WIFI_VIE_HDR_LEN + off + len))
+        {
+          return ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+  vie->stats.sets++;
+  for (t = 0; t < ESP_WIFI_VIE_TYPES; t++)
+    {
+      if (!(mask & ESP_WIFI_VIE_BIT(t)))
+        {
+          continue;
+        }
+
+      blk = &vie->blocks[t];
+      n = 0;
+      cur = vie_ie_len(blk, idx) - ESP_WIFI_VIE_HDR_LEN;
+      if (off + len > cur)
+        {
+          vie_resize(blk, idx, ESP_WIFI_VIE_HDR_LEN + off + len);
+          blk->buf[blk->off[idx] + 1] = 4 + off + len;
+          n++;
+        }
+
+      ie = blk->buf + blk->off[idx];
+      n += vie_write(ie + ESP_WIFI_VIE_HDR_LEN + off, data, len);
+      if (n)
+        {
+          blk->dirty |= 1 << idx;
+          changed += n;
+        }
+    }
+
+  vie->stats.bytes_written += changed;
+  if (changed == 0)
+    {
+      vie->stats.unchanged++;
+    }
+
+  return ESP_OK;
+}
+
+void esp_wifi_vie_clear(esp_wifi_vie_t *vie, uint8_t mask,
+                        wifi_vendor_ie_id_t idx)
+{
+  struct vie_block *blk;
+  int t;
+
+  if (!vie_args_ok(mask, idx))
+    {
+      return;
+    }
+
+  for (t = 0; t < ESP_WIFI_VIE_TYPES; t++)
+    {
+      blk = &vie->blocks[t];
+      if ((mask & ESP_WIFI_VIE_BIT(t)) && (blk->set & (1 << idx)))
+        {
+          vie_resize(blk, idx, 0);
+          blk->set &= ~(1 << idx);
+          blk->dirty |= 1 << idx;
+        }
+    }
+}
+
+const uint8_t *esp_wifi_vie_get(const esp_wifi_vie_t *vie,
+                                wifi_vendor_ie_type_t type,
+                                wifi_vendor_ie_id_t idx)
+{
+  const struct vie_block *blk;
+
+  if ((unsigned)type >= ESP_WIFI_VIE_TYPES ||
+      (unsigned)idx >= ESP_WIFI_VIE_SLOTS)
+    {
+      return NULL;
+    }
+
+  blk = &vie->blocks[type];
+  return (blk->set & (1 << idx)) ? blk->buf + blk->off[idx] : NULL;
+}
+
+const uint8_t *esp_wifi_vie_block(const esp_wifi_vie_t *vie,
+                                  wifi_vendor_ie_type_t type,
+                                  uint16_t *len)
+{
+  if ((unsigned)type >= ESP_WIFI_VIE_TYPES)
+    {
+      *len = 0;
+      return NULL;
+    }
+
+  *len = vie->blocks[type].len;
+  return vie->blocks[type].buf;
+}
+
+esp_err_t esp_wifi_vie_flush(esp_wifi_vie_t *vie, esp_wifi_vie_push_t push,
+                             void *arg)
+{
+  struct vie_block *blk;
+  esp_err_t first = ESP_OK;
+  esp_err_t ret;
+  int t;
+  int i;
+
+  for (t = 0; t < ESP_WIFI_VIE_TYPES; t++)
+    {
+      blk = &vie->blocks[t];
+      for (i = 0; blk->dirty && i < ESP_WIFI_VIE_SLOTS; i++)
+        {
+          if (!(blk->dirty & (1 << i)))
+            {
+              continue;
+            }
+
+          ret = push(arg, t, i, esp_wifi_vie_get(vie, t, i));
+          if (ret != ESP_OK)
+            {
+              first = first != ESP_OK ? first : ret;
+              continue;
+            }
+
+          blk->dirty &= ~(1 << i);
+          vie->stats.pushes++;
+        }
+    }
+
+  return first;
+}
+
+void esp_wifi_vie_get_stats(const esp_wifi_vie_t *vie,
+                            esp_wifi_vie_stats_t *stats)
+{
+  *stats = vie->stats;
+}
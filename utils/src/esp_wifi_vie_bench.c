@@ -0,0 +1,241 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_wifi_vie.h"
+
+#define VIE_BENCH_STATIC    64           /* static bytes of the dynamic IE */
+#define VIE_BENCH_SEQ       4
+#define VIE_BENCH_TOKEN     16
+#define VIE_BENCH_DYN_LEN   (VIE_BENCH_STATIC + VIE_BENCH_SEQ + \
+                             VIE_BENCH_TOKEN)
+#define VIE_BENCH_FIX_LEN   32           /* payload of the static IE */
+#define VIE_BENCH_FRAME_MAX 1024
+
+/* What the driver does with a pushed IE, short of the frame rebuild */
+
+struct vie_bench_sink
+{
+  uint32_t pushes;
+  uint16_t len;
+  uint8_t ie[ESP_WIFI_VIE_TYPES][ESP_WIFI_VIE_SLOTS][2 + 255];
+};
+
+static const uint8_t s_oui[3] =
+{
+  0x18, 0xfe, 0x34
+};
+
+static esp_err_t __attribute__((noinline))
+vie_bench_push(void *arg, wifi_vendor_ie_type_t type,
+               wifi_vendor_ie_id_t idx, const uint8_t *ie)
+{
+  struct vie_bench_sink *sink = arg;
+
+  if (ie)
+    {
+      memcpy(sink->ie[type][idx], ie, 2 + ie[1]);
+    }
+
+  sink->pushes++;
+  return ESP_OK;
+}
+
+static uint32_t vie_bench_ns(clock_t cpu, uint32_t rotations)
+{
+  return (uint32_t)((double)cpu * 1e9 / CLOCKS_PER_SEC / rotations);
+}
+
+static void vie_bench_token(uint32_t r, uint8_t *seq, uint8_t *token)
+{
+  uint32_t x = r * 2654435761u + 1;
+  int i;
+
+  seq[0] = r >> 24;
+  seq[1] = r >> 16;
+  seq[2] = r >> 8;
+  seq[3] = r;
+  for (i = 0; i < VIE_BENCH_TOKEN; i++)
+    {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      token[i] = x;
+    }
+}
+
+/* The dynamic IE serialized from its fields */
+
+static uint8_t *vie_bench_dyn(uint8_t *p, const uint8_t *fixed,
+                              const uint8_t *seq, const uint8_t *token)
+{
+  *p++ = WIFI_VENDOR_IE_ELEMENT_ID;
+  *p++ = 4 + VIE_BENCH_DYN_LEN;
+  memcpy(p, s_oui, 3);
+  p[3] = 1;
+  p += 4;
+  memcpy(p, fixed, VIE_BENCH_STATIC);
+  p += VIE_BENCH_STATIC;
+  memcpy(p, seq, VIE_BENCH_SEQ);
+  p += VIE_BENCH_SEQ;
+  memcpy(p, token, VIE_BENCH_TOKEN);
+  return p + VIE_BENCH_TOKEN;
+}
+
+static uint8_t *vie_bench_fix(uint8_t *p, const uint8_t *fixed)
+{
+  *p++ = WIFI_VENDOR_IE_ELEMENT_ID;
+  *p++ = 4 + VIE_BENCH_FIX_LEN;
+  memcpy(p, s_oui, 3);
+  p[3] = 2;
+  p += 4;
+  memcpy(p, fixed, VIE_BENCH_FIX_LEN);
+  return p + VIE_BENCH_FIX_LEN;
+}
+
+esp_err_t esp_wifi_vie_bench(uint32_t rotations,
+                             esp_wifi_vie_bench_t *result)
+{
+  static struct vie_bench_sink sink;
+  uint8_t fixed[VIE_BENCH_STATIC];
+  uint8_t dyn[VIE_BENCH_SEQ + VIE_BENCH_TOKEN];
+  uint8_t ie[2][2 + 255];
+  uint8_t frame[VIE_BENCH_FRAME_MAX];
+  uint8_t base[VIE_BENCH_FRAME_MAX];
+  esp_wifi_vie_config_t cfg;
+  esp_wifi_vie_stats_t stats;
+  esp_wifi_vie_t *vie;
+  volatile uint32_t out = 0;
+  uint64_t bytes = 0;
+  uint32_t pushes;
+  uint16_t len;
+  const uint8_t *v;
+  uint8_t *p;
+  uint32_t r;
+  clock_t c0;
+  int t;
+  int i;
+  esp_err_t ret;
+
+  if (result == NULL || rotations == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  esp_wifi_vie_default(&cfg);
+  ret = esp_wifi_vie_create(&cfg, &vie);
+  if (ret != ESP_OK)
+    {
+      return ret;
+    }
+
+  memset(result, 0, sizeof(*result));
+  memset(&sink, 0, sizeof(sink));
+  result->rotations = rotations;
+  for (i = 0; i < VIE_BENCH_STATIC; i++)
+    {
+      fixed[i] = i * 7;
+    }
+
+  for (i = 0; i < cfg.beacon_base_len; i++)
+    {
+      base[i] = i;
+    }
+
+  /* Every IE serialized again and pushed to both frame types */
+
+  c0 = clock();
+  for (r = 0; r < rotations; r++)
+    {
+      vie_bench_token(r, dyn, dyn + VIE_BENCH_SEQ);
+      vie_bench_dyn(ie[0], fixed, dyn, dyn + VIE_BENCH_SEQ);
+      vie_bench_fix(ie[1], fixed);
+      for (t = 0; t < ESP_WIFI_VIE_TYPES; t++)
+        {
+          if (!(ESP_WIFI_VIE_AP_FRAMES & ESP_WIFI_VIE_BIT(t)))
+            {
+              continue;
+            }
+
+          for (i = 0; i < ESP_WIFI_VIE_SLOTS; i++)
+            {
+              vie_bench_push(&sink, t, i, ie[i]);
+              bytes += 2 + ie[i][1];
+            }
+        }
+    }
+
+  result->rebuild_ns = vie_bench_ns(clock() - c0, rotations);
+  result->rebuild_pushes_x100 = (uint64_t)sink.pushes * 100 / rotations;
+  result->rebuild_bytes = bytes / rotations;
+
+  /* Sequence number and token patched in place */
+
+  vie_bench_token(0, dyn, dyn + VIE_BENCH_SEQ);
+  vie_bench_dyn(ie[0], fixed, dyn, dyn + VIE_BENCH_SEQ);
+  esp_wifi_vie_set(vie, ESP_WIFI_VIE_AP_FRAMES, WIFI_VND_IE_ID_0, s_oui, 1,
+                   ie[0] + ESP_WIFI_VIE_HDR_LEN, VIE_BENCH_DYN_LEN);
+  esp_wifi_vie_set(vie, ESP_WIFI_VIE_AP_FRAMES, WIFI_VND_IE_ID_1, s_oui, 2,
+                   fixed, VIE_BENCH_FIX_LEN);
+  esp_wifi_vie_flush(vie, vie_bench_push, &sink);
+  esp_wifi_vie_get_stats(vie, &stats);
+  bytes = stats.bytes_written;
+  pushes = sink.pushes;
+
+  c0 = clock();
+  for (r = 0; r < rotations; r++)
+    {
+      vie_bench_token(r, dyn, dyn + VIE_BENCH_SEQ);
+      esp_wifi_vie_patch(vie, ESP_WIFI_VIE_AP_FRAMES, WIFI_VND_IE_ID_0,
+                         VIE_BENCH_STATIC, dyn, sizeof(dyn));
+      esp_wifi_vie_flush(vie, vie_bench_push, &sink);
+    }
+
+  result->patch_ns = vie_bench_ns(clock() - c0, rotations);
+  esp_wifi_vie_get_stats(vie, &stats);
+  result->patch_pushes_x100 = (uint64_t)(sink.pushes - pushes) * 100 /
+                              rotations;
+  result->patch_bytes = (stats.bytes_written - bytes) / rotations;
+
+  /* Beacon: fixed part and vendor IEs, as of the last rotation */
+
+  c0 = clock();
+  for (r = 0; r < rotations; r++)
+    {
+      memcpy(frame, base, cfg.beacon_base_len);
+      p = vie_bench_dyn(frame + cfg.beacon_base_len, fixed, dyn,
+                        dyn + VIE_BENCH_SEQ);
+      p = vie_bench_fix(p, fixed);
+      out += p[-1];
+    }
+
+  result->beacon_rebuild_ns = vie_bench_ns(clock() - c0, rotations);
+
+  c0 = clock();
+  for (r = 0; r < rotations; r++)
+    {
+      memcpy(frame, base, cfg.beacon_base_len);
+      v = esp_wifi_vie_block(vie, WIFI_VND_IE_TYPE_BEACON, &len);
+      memcpy(frame + cfg.beacon_base_len, v, len);
+      out += frame[cfg.beacon_base_len + len - 1];
+    }
+
+  result->beacon_copy_ns = vie_bench_ns(clock() - c0, rotations);
+
+  esp_wifi_vie_delete(vie);
+  return ESP_OK;
+}
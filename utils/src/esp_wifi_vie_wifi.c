@@ -0,0 +1,33 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#include "esp_wifi_vie.h"
+
+static esp_err_t vie_push(void *arg, wifi_vendor_ie_type_t type,
+                          wifi_vendor_ie_id_t idx, const uint8_t *ie)
+{
+  /* An IE set again replaces the one at idx, one rebuild per push */
+
+  return esp_wifi_set_vendor_ie(ie != NULL, type, idx, ie);
+}
+
+esp_err_t esp_wifi_vie_commit(esp_wifi_vie_t *vie)
+{
+  return esp_wifi_vie_flush(vie, vie_push, NULL);
+}
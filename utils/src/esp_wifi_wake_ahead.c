@@ -0,0 +1,331 @@
+// Copyright 2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_wifi_wake_ahead.h"
+
+#if SOC_WIFI_HW_TSF
+#include "espidf_wifi.h"
+#include "esp_wifi.h"
+#endif
+
+/* Quantile estimation uses the P-square algorithm (Jain and Chlamtac,
+ * 1985), five markers and no sample storage.
+ */
+
+static void wa_p2_init(esp_wake_ahead_ctrl_t *ctrl)
+{
+  float q = ctrl->q;
+  int i;
+
+  for (i = 0; i < 5; i++)
+    {
+      ctrl->pos[i] = i + 1;
+    }
+
+  ctrl->desired[0] = 1;
+  ctrl->desired[1] = 1 + 2 * q;
+  ctrl->desired[2] = 1 + 4 * q;
+  ctrl->desired[3] = 3 + 2 * q;
+  ctrl->desired[4] = 5;
+
+  ctrl->inc[0] = 0;
+  ctrl->inc[1] = q / 2;
+  ctrl->inc[2] = q;
+  ctrl->inc[3] = (1 + q) / 2;
+  ctrl->inc[4] = 1;
+}
+
+static float wa_p2_parabolic(const esp_wake_ahead_ctrl_t *ctrl, int i,
+                             float d)
+{
+  const float *h = ctrl->height;
+  const float *n = ctrl->pos;
+
+  return h[i] + d / (n[i + 1] - n[i - 1]) *
+         ((n[i] - n[i - 1] + d) * (h[i + 1] - h[i]) / (n[i + 1] - n[i]) +
+          (n[i + 1] - n[i] - d) * (h[i] - h[i - 1]) / (n[i] - n[i - 1]));
+}
+
+static void wa_p2_add(esp_wake_ahead_ctrl_t *ctrl, float x)
+{
+  float *h = ctrl->height;
+  float *n = ctrl->pos;
+  float d;
+  float hp;
+  float tmp;
+  int k;
+  int i;
+  int j;
+
+  if (ctrl->count < 5)
+    {
+      /* Insertion sort of the first five samples */
+
+      for (j = ctrl->count; j > 0 && h[j - 1] > x; j--)
+        {
+          h[j] = h[j - 1];
+        }
+
+      h[j] = x;
+      ctrl->count++;
+      return;
+    }
+
+  ctrl->count++;
+
+  if (x < h[0])
+    {
+      h[0] = x;
+      k = 0;
+    }
+  else if (x >= h[4])
+    {
+      h[4] = x;
+      k = 3;
+    }
+  else
+    {
+      for (k = 0; k < 3 && x >= h[k + 1]; k++)
+        {
+        }
+    }
+
+  for (i = k + 1; i < 5; i++)
+    {
+      n[i] += 1;
+    }
+
+  for (i = 0; i < 5; i++)
+    {
+      ctrl->desired[i] += ctrl->inc[i];
+    }
+
+  for (i = 1; i < 4; i++)
+    {
+      d = ctrl->desired[i] - n[i];
+      if ((d >= 1 && n[i + 1] - n[i] > 1) ||
+          (d <= -1 && n[i - 1] - n[i] < -1))
+        {
+          d = d > 0 ? 1 : -1;
+          hp = wa_p2_parabolic(ctrl, i, d);
+          if (h[i - 1] < hp && hp < h[i + 1])
+            {
+              h[i] = hp;
+            }
+          else
+            {
+              j = i + (int)d;
+              tmp = h[i] + d * (h[j] - h[i]) / (n[j] - n[i]);
+              h[i] = tmp;
+            }
+
+          n[i] += d;
+        }
+    }
+}
+
+static uint32_t wa_clamp(const esp_wake_ahead_config_t *cfg, float v)
+{
+  if (v < (float)cfg->min_us)
+    {
+      return cfg->min_us;
+    }
+
+  if (v > (float)cfg->max_us)
+    {
+      return cfg->max_us;
+    }
+
+  return (uint32_t)v;
+}
+
+void esp_wake_ahead_default(esp_wake_ahead_config_t *cfg)
+{
+  cfg->min_us = 500;
+  cfg->max_us = 10000;
+  cfg->guard_us = 200;
+  cfg->target_miss_ppm = 10000;
+  cfg->update_every = 8;
+  cfg->miss_window = 200;
+  cfg->miss_step_us = 250;
+}
+
+esp_err_t esp_wake_ahead_init(esp_wake_ahead_ctrl_t *ctrl,
+                              const esp_wake_ahead_config_t *cfg)
+{
+  if (ctrl == NULL || cfg == NULL || cfg->min_us > cfg->max_us ||
+      cfg->target_miss_ppm == 0 || cfg->target_miss_ppm >= 1000000 ||
+      cfg->update_every == 0 || cfg->miss_window == 0)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  memset(ctrl, 0, sizeof(*ctrl));
+  ctrl->cfg = *cfg;
+  ctrl->q = 1.0f - (float)cfg->target_miss_ppm / 1000000.0f;
+  ctrl->wake_ahead_us = cfg->max_us;
+  wa_p2_init(ctrl);
+
+  return ESP_OK;
+}
+
+esp_err_t esp_wake_ahead_tbtt_error(esp_wake_ahead_ctrl_t *ctrl,
+                                    int64_t tsf_us, int64_t local_us,
+                                    int32_t *error_us)
+{
+  int64_t predicted;
+  bool anchored = ctrl->anchored;
+
+  predicted = ctrl->anchor_local + (tsf_us - ctrl->anchor_tsf);
+
+  ctrl->anchor_tsf = tsf_us;
+  ctrl->anchor_local = local_us;
+  ctrl->anchored = true;
+
+  if (!anchored)
+    {
+      return ESP_ERR_NOT_FOUND;
+    }
+
+  *error_us = (int32_t)(predicted - local_us);
+  return ESP_OK;
+}
+
+bool esp_wake_ahead_sample(esp_wake_ahead_ctrl_t *ctrl, int32_t error_us,
+                           bool missed)
+{
+  const esp_wake_ahead_config_t *cfg = &ctrl->cfg;
+  uint32_t old = ctrl->wake_ahead_us;
+  uint64_t rate;
+
+  if (!missed)
+    {
+      wa_p2_add(ctrl, (float)error_us);
+    }
+
+  /* Closed loop on the observed miss rate, covering what the open loop
+   * quantile cannot see: beacons that were missed have no error sample.
+   */
+
+  ctrl->window_beacons++;
+  ctrl->window_misses += missed;
+  if (ctrl->window_beacons >= cfg->miss_window)
+    {
+      rate = (uint64_t)ctrl->window_misses * 1000000 / ctrl->window_beacons;
+      if (rate > cfg->target_miss_ppm)
+        {
+          ctrl->boost_us += cfg->miss_step_us;
+        }
+      else
+        {
+          ctrl->boost_us -= ctrl->boost_us / 4;
+        }
+
+      ctrl->window_beacons = 0;
+      ctrl->window_misses = 0;
+    }
+
+  if (ctrl->count < 5)
+    {
+      return false;
+    }
+
+  if (missed || ctrl->count % cfg->update_every == 0)
+    {
+      ctrl->wake_ahead_us = wa_clamp(cfg, ctrl->height[2] + cfg->guard_us +
+                                     ctrl->boost_us);
+    }
+
+  return ctrl->wake_ahead_us != old;
+}
+
+uint32_t esp_wake_ahead_get(const esp_wake_ahead_ctrl_t *ctrl)
+{
+  return ctrl->wake_ahead_us;
+}
+
+esp_err_t esp_wake_ahead_replay(const esp_wake_ahead_config_t *cfg,
+                                const int32_t *errors_us, size_t n,
+                                esp_wake_ahead_replay_result_t *result)
+{
+  esp_wake_ahead_ctrl_t ctrl;
+  uint64_t sum = 0;
+  uint32_t wa;
+  bool missed;
+  size_t i;
+
+  if (errors_us == NULL || result == NULL ||
+      esp_wake_ahead_init(&ctrl, cfg) != ESP_OK)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+  memset(result, 0, sizeof(*result));
+
+  for (i = 0; i < n; i++)
+    {
+      wa = ctrl.wake_ahead_us;
+      missed = errors_us[i] > (int32_t)wa;
+
+      sum += wa;
+      if (wa > result->max_wake_ahead_us)
+        {
+          result->max_wake_ahead_us = wa;
+        }
+
+      result->misses += missed;
+      esp_wake_ahead_sample(&ctrl, errors_us[i], missed);
+    }
+
+  result->samples = n;
+  if (n)
+    {
+      result->miss_ppm = (uint32_t)((uint64_t)result->misses * 1000000 / n);
+      result->avg_wake_ahead_us = (uint32_t)(sum / n);
+    }
+
+  return ESP_OK;
+}
+
+#if SOC_WIFI_HW_TSF
+bool esp_wake_ahead_on_beacon(esp_wake_ahead_ctrl_t *ctrl, bool missed)
+{
+  int32_t error = 0;
+  bool changed;
+
+  if (!esp_wifi_internal_is_tsf_active())
+    {
+      return false;
+    }
+
+  if (!missed &&
+      esp_wake_ahead_tbtt_error(ctrl, esp_wifi_get_tsf_time(WIFI_IF_STA),
+                                esp_timer_get_time(), &error) != ESP_OK)
+    {
+      return false;
+    }
+
+  changed = esp_wake_ahead_sample(ctrl, error, missed);
+  if (changed)
+    {
+      esp_wifi_internal_update_light_sleep_wake_ahead_time(
+        ctrl->wake_ahead_us);
+    }
+
+  return changed;
+}
+#endif